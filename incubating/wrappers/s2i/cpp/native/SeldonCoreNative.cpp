@@ -0,0 +1,162 @@
+// seldon_core_native: native versions of the payload conversions in the
+// Python wrapper's seldon_core/utils.py, which imports it when installed.
+// Arrays are read through the buffer protocol and returned as NumPy arrays
+// over the converted values, and protos are exchanged as wire bytes, so
+// neither side walks the payload element by element in Python. The GIL is
+// released while converting.
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include "prediction.pb.h"
+#include "seldon/Codec.hpp"
+#include "seldon/Ndarray.hpp"
+
+namespace py = pybind11;
+
+namespace {
+
+// Numeric arrays are converted to doubles first, as tolist() would
+using DoubleArray = py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+std::vector<int64_t> shapeOf(const DoubleArray &array) {
+    return std::vector<int64_t>(array.shape(), array.shape() + array.ndim());
+}
+
+// Returns bytes of size, filled in place by write with the GIL released
+template <typename Write>
+py::bytes newBytes(size_t size, Write write) {
+    PyObject *bytes = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(size));
+    if (bytes == nullptr) {
+        throw py::error_already_set();
+    }
+    char *out = PyBytes_AS_STRING(bytes);
+    {
+        py::gil_scoped_release release;
+        write(out);
+    }
+    return py::reinterpret_steal<py::bytes>(bytes);
+}
+
+// SeldonMessage wire bytes for a JSON payload. Raises ValueError when the
+// JSON is malformed or doesn't match the schema.
+py::bytes jsonToMessage(py::str json) {
+    Py_ssize_t length = 0;
+    const char *data = PyUnicode_AsUTF8AndSize(json.ptr(), &length);
+    if (data == nullptr) {
+        throw py::error_already_set();
+    }
+
+    google::protobuf::Arena arena;
+    auto *message = google::protobuf::Arena::CreateMessage<seldon::protos::SeldonMessage>(&arena);
+    {
+        py::gil_scoped_release release;
+        seldon::decodeMessage(data, static_cast<size_t>(length), seldon::PayloadFormat::Json,
+                              *message);
+    }
+    return newBytes(message->ByteSizeLong(), [message](char *out) {
+        message->SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t *>(out));
+    });
+}
+
+// Whether list holds only finite numbers, at any depth. flatten also takes
+// bools, but MessageToDict keeps them as bools and numpy makes a bool array.
+bool finiteNumbers(const google::protobuf::ListValue &list) {
+    for (const google::protobuf::Value &value : list.values()) {
+        switch (value.kind_case()) {
+        case google::protobuf::Value::kNumberValue:
+            if (!std::isfinite(value.number_value())) {
+                return false;
+            }
+            break;
+        case google::protobuf::Value::kListValue:
+            if (!finiteNumbers(value.list_value())) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+// Float64 array for a wire-format ndarray ListValue. Returns None unless
+// it is rectangular and holds only finite numbers, as anything else comes
+// out of the Python conversion as strings, objects or bools.
+py::object ndarrayToArray(py::bytes data) {
+    char *buffer = nullptr;
+    Py_ssize_t length = 0;
+    if (PyBytes_AsStringAndSize(data.ptr(), &buffer, &length) != 0) {
+        throw py::error_already_set();
+    }
+
+    std::unique_ptr<std::vector<double>> values(new std::vector<double>());
+    std::vector<int64_t> shape;
+    bool converted = false;
+    {
+        py::gil_scoped_release release;
+        google::protobuf::ListValue ndarray;
+        if (ndarray.ParseFromArray(buffer, static_cast<int>(length)) &&
+            finiteNumbers(ndarray)) {
+            try {
+                seldon::ndarray::flatten(ndarray, shape, *values);
+                converted = true;
+            } catch (const std::invalid_argument &) {
+                converted = false;
+            }
+        }
+    }
+    if (!converted) {
+        return py::none();
+    }
+
+    // The array keeps the values alive rather than copying them
+    std::vector<py::ssize_t> dims(shape.begin(), shape.end());
+    double *pointer = values->data();
+    py::capsule owner(values.get(),
+                      [](void *owned) { delete static_cast<std::vector<double> *>(owned); });
+    values.release();
+    return DoubleArray(dims, pointer, owner);
+}
+
+// Wire-format ListValue of array nested by its dimensions, as
+// array_to_list_value builds it
+py::bytes arrayToListValue(DoubleArray array) {
+    if (array.ndim() == 0) {
+        throw std::invalid_argument("ndarray needs at least one dimension");
+    }
+    std::vector<int64_t> shape = shapeOf(array);
+    const double *values = array.data();
+    return newBytes(seldon::ndarray::listValueSize(shape), [&](char *out) {
+        seldon::ndarray::writeListValue(values, shape, out);
+    });
+}
+
+// Wire-format Tensor of array
+py::bytes arrayToTensor(DoubleArray array) {
+    std::vector<int64_t> shape = shapeOf(array);
+    const double *values = array.data();
+    return newBytes(seldon::ndarray::tensorSize(shape), [&](char *out) {
+        seldon::ndarray::writeTensor(values, shape, out);
+    });
+}
+
+}
+
+PYBIND11_MODULE(seldon_core_native, m)
+{
+    m.doc() = "Native payload conversions for seldon_core.utils";
+    m.def("json_to_message", &jsonToMessage,
+          "SeldonMessage wire bytes for a JSON string, raising ValueError if invalid");
+    m.def("ndarray_to_array", &ndarrayToArray,
+          "Float64 array for ndarray ListValue bytes, or None if not numeric and rectangular");
+    m.def("array_to_list_value", &arrayToListValue, "ndarray ListValue bytes for a numeric array");
+    m.def("array_to_tensor", &arrayToTensor, "Tensor bytes for a numeric array");
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "prediction.pb.h"
+
+namespace seldon {
+
+class ThreadPool;
+
+// Built-in combiners for the outputs of an ensemble. Each child is read
+// through a TensorView, so tensor and tftensor children are not copied,
+// and the result is written straight into a single output tensor: a
+// tftensor of the same dtype when the first child is a float or double
+// tftensor, a tensor otherwise. Large inputs are reduced with vectorized
+// kernels across pool, ThreadPool::global() by default.
+//
+// The output keeps the names of the first child and merges the tags and
+// metrics of every child's meta, like the Python wrapper. Throws
+// std::invalid_argument for an empty list or children that don't match.
+namespace aggregate {
+
+// Element-wise mean of children of the same shape
+void mean(const protos::SeldonMessageList &input, protos::SeldonMessage &output,
+          ThreadPool *pool = nullptr);
+
+// Element-wise mean weighted by weights, one per child
+void weightedMean(const protos::SeldonMessageList &input, const std::vector<double> &weights,
+                  protos::SeldonMessage &output, ThreadPool *pool = nullptr);
+
+// Hard voting over class scores along the last dimension. Every child
+// votes for its highest scoring class per row, the first one on ties, and
+// the output holds the share of votes each class received, in the shape
+// of the children.
+void maxVote(const protos::SeldonMessageList &input, protos::SeldonMessage &output,
+             ThreadPool *pool = nullptr);
+
+// Concatenates children along axis, counted from the end when negative.
+// The other dimensions must match; names are concatenated along the last
+// axis when every child has them.
+void concat(const protos::SeldonMessageList &input, protos::SeldonMessage &output,
+            int axis = -1, ThreadPool *pool = nullptr);
+
+}
+
+}
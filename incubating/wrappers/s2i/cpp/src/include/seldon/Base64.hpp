@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace seldon {
+namespace base64 {
+
+enum class Kernel {
+    Scalar,
+    // x86-64 CPUs with AVX2, detected at runtime
+    Avx2,
+    // AArch64, where NEON is always available
+    Neon,
+};
+
+// The fastest kernel the CPU supports, picked on first use
+Kernel defaultKernel();
+bool supported(Kernel kernel);
+const char *kernelName(Kernel kernel);
+
+// Length of size bytes once encoded, with padding
+inline size_t encodedSize(size_t size) {
+    return (size + 2) / 3 * 4;
+}
+
+// Most bytes size characters can decode to
+inline size_t decodedSize(size_t size) {
+    return (size + 3) / 4 * 3;
+}
+
+// Writes the padded standard encoding of data, as the protobuf JSON printer
+// does for bytes fields, to out, which must hold encodedSize(size) chars.
+// Falls back to the scalar kernel if kernel isn't supported.
+void encode(const char *data, size_t size, char *out, Kernel kernel = defaultKernel());
+
+// Decodes standard or URL-safe base64, padded or not, accepting what the
+// protobuf JSON parser does for bytes fields. out must hold
+// decodedSize(size) bytes. Returns false if data isn't valid base64,
+// otherwise sets written to the decoded length.
+bool decode(const char *data, size_t size, char *out, size_t &written,
+            Kernel kernel = defaultKernel());
+
+// Appends the encoding of data to out
+void append(const char *data, size_t size, std::string &out);
+
+// Replaces out with the decoding of data, sizing it once up front. Returns
+// false, leaving out unspecified, if data isn't valid base64.
+bool decode(const char *data, size_t size, std::string &out);
+
+}
+}
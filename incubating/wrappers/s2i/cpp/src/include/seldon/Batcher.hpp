@@ -0,0 +1,115 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "prediction.pb.h"
+
+namespace seldon {
+
+namespace metrics {
+class Gauge;
+class Histogram;
+}
+
+struct BatchOptions
+{
+    // Rows along dimension 0 that a batch is filled up to. A single request
+    // with more rows than this is still predicted, on its own.
+    int maxBatchSize = 32;
+    // How long the first request of a batch waits for others to join it
+    int64_t maxBatchDelayUs = 1000;
+    // Batches predicted concurrently
+    int threads = 1;
+
+    // Reads SELDON_CPP_MAX_BATCH_SIZE, SELDON_CPP_MAX_BATCH_DELAY_US and
+    // SELDON_CPP_BATCH_THREADS
+    static BatchOptions fromEnvironment();
+};
+
+// Merges concurrent predictions into one call. Requests whose data is a
+// DefaultData tensor, or a tftensor held in tensor_content or float_val,
+// double_val, int_val or int64_val, are concatenated along dimension 0
+// with other requests of the same type, trailing shape and names. The
+// batched output is split back by row count, and every response keeps its
+// request's Meta.puid. Any other request is predicted on its own.
+//
+// The input of a batch carries the meta of its first request, and the
+// output meta, names and status are copied to every response.
+//
+// The native servers submit requests and are called back once their batch
+// has run, so a batch can hold more requests than there are server
+// threads. The blocking predict is for callers that can't be called back,
+// such as the Python wrapper's predict_raw.
+class Batcher
+{
+public:
+    using Predict = std::function<void(protos::SeldonMessage &, protos::SeldonMessage &)>;
+    // Receives the output of submit, or the exception the batch's predict
+    // raised
+    using Callback = std::function<void(std::exception_ptr error, protos::SeldonMessage &output)>;
+
+    Batcher(Predict predict, BatchOptions options = BatchOptions());
+    ~Batcher();
+
+    Batcher(const Batcher &) = delete;
+    Batcher &operator=(const Batcher &) = delete;
+
+    // Queues input and returns without waiting for it. done is called
+    // exactly once, from a batch thread once the batch has run, or inline
+    // for a request that can't be batched. It must not block.
+    void submit(protos::SeldonMessage &&input, Callback done);
+
+    // Blocks until output holds the response to input. Rethrows the
+    // exception raised by the batch's predict, if any.
+    void predict(protos::SeldonMessage &input, protos::SeldonMessage &output);
+
+    // Batching only applies to SeldonMessage models
+    template <typename Message>
+    void submit(Message &&input, std::function<void(std::exception_ptr, Message &)> done) {
+        throw std::logic_error("Batching requires a SeldonModel of SeldonMessage");
+    }
+
+    template <typename Message>
+    void predict(Message &input, Message &output) {
+        throw std::logic_error("Batching requires a SeldonModel of SeldonMessage");
+    }
+
+private:
+    struct Layout;
+    struct Pending;
+
+    // Works out how a message splits into rows along dimension 0
+    static Layout layoutOf(const protos::SeldonMessage &message);
+    static void concatenate(const std::vector<Pending *> &batch, int64_t rows,
+                            protos::SeldonMessage &input);
+    static void split(const protos::SeldonMessage &output, int64_t rows,
+                      const std::vector<Pending *> &batch);
+
+    // Called with mMutex held
+    void enqueue(Pending *pending);
+    void run();
+    void predictBatch(const std::vector<Pending *> &batch, int64_t rows);
+    static void complete(Pending *pending);
+
+    Predict mPredict;
+    BatchOptions mOptions;
+    metrics::Gauge &mQueueDepth;
+    metrics::Histogram &mBatchSize;
+
+    std::mutex mMutex;
+    std::condition_variable mReady;
+    std::deque<Pending *> mQueue;
+    int64_t mQueuedRows = 0;
+    bool mStopping = false;
+    std::vector<std::thread> mThreads;
+};
+
+}
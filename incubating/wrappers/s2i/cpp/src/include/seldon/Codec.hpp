@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include <google/protobuf/util/json_util.h>
+
+#include "prediction.pb.h"
+#include "seldon/JsonEncoder.hpp"
+#include "seldon/RawModel.hpp"
+
+namespace seldon {
+
+// Decodes message from a request payload. Throws std::invalid_argument if
+// the payload is malformed.
+template <typename Message>
+void decodeMessage(const char *data, size_t size, PayloadFormat format,
+                   Message &message) {
+
+    if (format == PayloadFormat::Proto) {
+        if (!message.ParseFromArray(data, static_cast<int>(size))) {
+            throw std::invalid_argument("Unable to parse protobuf request");
+        }
+        return;
+    }
+
+    auto status = google::protobuf::util::JsonStringToMessage(
+        google::protobuf::StringPiece(data, size), &message);
+    if (!status.ok()) {
+        throw std::invalid_argument(status.ToString());
+    }
+}
+
+// Replaces out with the encoded message
+template <typename Message>
+void encodeMessage(const Message &message, PayloadFormat format,
+                   std::string &out) {
+
+    out.clear();
+    if (format == PayloadFormat::Proto) {
+        message.SerializeToString(&out);
+        return;
+    }
+
+    google::protobuf::util::MessageToJsonString(message, &out);
+}
+
+// JSON options only apply to SeldonMessages, see the overload below
+template <typename Message>
+void encodeMessage(const Message &message, PayloadFormat format,
+                   const json::EncodeOptions &options, std::string &out) {
+    encodeMessage(message, format, out);
+}
+
+// The overloads for request messages decode JSON with the single pass
+// decoders in seldon/JsonDecoder.hpp, falling back to JsonStringToMessage
+// for what they leave to it, and JSON responses are written by the encoder
+// in seldon/JsonEncoder.hpp, falling back to MessageToJsonString. A JSON
+// binData is encoded and decoded with the vectorized kernels in
+// seldon/Base64.hpp, straight into the binData field or out.
+void decodeMessage(const char *data, size_t size, PayloadFormat format,
+                   protos::SeldonMessage &message);
+void decodeMessage(const char *data, size_t size, PayloadFormat format,
+                   protos::SeldonMessageList &list);
+void decodeMessage(const char *data, size_t size, PayloadFormat format,
+                   protos::Feedback &feedback);
+
+void encodeMessage(const protos::SeldonMessage &message, PayloadFormat format,
+                   const json::EncodeOptions &options, std::string &out);
+
+// Encodes with json::EncodeOptions::fromEnvironment(), read once
+void encodeMessage(const protos::SeldonMessage &message, PayloadFormat format,
+                   std::string &out);
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "seldon/Aggregate.hpp"
+#include "seldon/Environment.hpp"
+#include "seldon/Logging.hpp"
+#include "seldon/SeldonModel.hpp"
+
+namespace seldon {
+
+// Ready-made combiners over the kernels in seldon/Aggregate.hpp. Derive
+// the model class from one of them to use it as the aggregate of a graph:
+//
+//   class ModelClass : public seldon::MeanCombiner { };
+//   SELDON_DEFAULT_BIND_MODULE()
+
+class MeanCombiner : public SeldonModelBase
+{
+public:
+    void aggregate(protos::SeldonMessageList &input, protos::SeldonMessage &output) override {
+        seldon::aggregate::mean(input, output);
+    }
+};
+
+class WeightedMeanCombiner : public SeldonModelBase
+{
+public:
+    // Reads the comma separated weights in SELDON_CPP_COMBINER_WEIGHTS.
+    // Without them every aggregate would fail, so a missing or malformed
+    // list fails here, when the model is loaded.
+    WeightedMeanCombiner() {
+        if (!envDoubles("SELDON_CPP_COMBINER_WEIGHTS", this->mWeights)) {
+            const char *weights = std::getenv("SELDON_CPP_COMBINER_WEIGHTS");
+            std::string message = std::string("SELDON_CPP_COMBINER_WEIGHTS=") +
+                                  (weights != nullptr ? weights : "") +
+                                  " is not a comma separated list of numbers";
+            SELDON_LOG_ERROR(message);
+            throw std::runtime_error(message);
+        }
+    }
+
+    explicit WeightedMeanCombiner(std::vector<double> weights) : mWeights(std::move(weights)) { }
+
+    void aggregate(protos::SeldonMessageList &input, protos::SeldonMessage &output) override {
+        seldon::aggregate::weightedMean(input, this->mWeights, output);
+    }
+
+private:
+    std::vector<double> mWeights;
+};
+
+class MaxVoteCombiner : public SeldonModelBase
+{
+public:
+    void aggregate(protos::SeldonMessageList &input, protos::SeldonMessage &output) override {
+        seldon::aggregate::maxVote(input, output);
+    }
+};
+
+class ConcatCombiner : public SeldonModelBase
+{
+public:
+    explicit ConcatCombiner(int axis = -1) : mAxis(axis) { }
+
+    void aggregate(protos::SeldonMessageList &input, protos::SeldonMessage &output) override {
+        seldon::aggregate::concat(input, output, this->mAxis);
+    }
+
+private:
+    int mAxis;
+};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "prediction.pb.h"
+#include "seldon/Metrics.hpp"
+
+namespace seldon {
+namespace metrics {
+
+// Custom metrics for models to record from predict, the native
+// counterpart of returning metrics() from a Python model. They are
+// exported under their key, with their tags as labels, on the /metrics
+// endpoint of the native server: counters summed across per-thread
+// shards, gauges at their last value and timers as histograms in seconds,
+// like the Python wrapper's SeldonMetrics.
+//
+// Each call looks its series up in a per-thread cache, so the registry
+// lock is only taken the first time a thread uses a key and set of tags.
+void count(const std::string &key, double value = 1.0, const Labels &tags = Labels());
+void gauge(const std::string &key, double value, const Labels &tags = Labels());
+void timer(const std::string &key, double milliseconds, const Labels &tags = Labels());
+
+// Records the time until it goes out of scope as a timer
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(std::string key, Labels tags = Labels())
+        : mKey(std::move(key)), mTags(std::move(tags)),
+          mStart(std::chrono::steady_clock::now()) { }
+
+    ~ScopedTimer() {
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - this->mStart;
+        timer(this->mKey, elapsed.count(), this->mTags);
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    std::string mKey;
+    Labels mTags;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+// Collects the custom metrics recorded on the current thread while it is
+// alive, so they can be added to the response's Meta.metrics for the
+// Python wrapper or the next component. Captures nest; only the innermost
+// one collects; an inactive capture doesn't collect at all.
+class Capture
+{
+public:
+    explicit Capture(bool active = true);
+    ~Capture();
+
+    Capture(const Capture &) = delete;
+    Capture &operator=(const Capture &) = delete;
+
+    // Appends one Metric per key and tags: counters summed, gauges at
+    // their last value and every timer on its own
+    void appendTo(protos::Meta &meta) const;
+
+    bool empty() const { return this->mEntries.empty(); }
+
+    // Called by count, gauge and timer
+    static void record(protos::Metric::MetricType type, const std::string &key, double value,
+                       const Labels &tags);
+
+private:
+    struct Entry
+    {
+        protos::Metric::MetricType type;
+        std::string key;
+        Labels tags;
+        double value;
+    };
+
+    std::vector<Entry> mEntries;
+    bool mActive;
+    Capture *mPrevious;
+};
+
+}
+}
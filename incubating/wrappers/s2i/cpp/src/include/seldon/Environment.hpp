@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace seldon {
+
+// Reads a base 10 integer from the environment variable name. Returns
+// fallback when it's unset or empty, or logs a warning and returns
+// fallback when it doesn't hold an integer.
+int64_t envInt(const char *name, int64_t fallback);
+
+// Reads comma separated numbers from the environment variable name into
+// values. Returns false when it's unset or empty, or when any entry isn't
+// a finite number.
+bool envDoubles(const char *name, std::vector<double> &values);
+
+}
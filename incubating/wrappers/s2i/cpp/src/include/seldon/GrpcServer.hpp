@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "seldon/RawModel.hpp"
+
+namespace grpc {
+class AsyncGenericService;
+class Server;
+class ServerCompletionQueue;
+}
+
+namespace seldon {
+
+struct GrpcServerOptions
+{
+    std::string host = "0.0.0.0";
+    // Same default as the Python microservice
+    int port = 5000;
+    // Completion queues, each polled by its own thread; 0 uses one per core
+    int threads = 0;
+    int maxMessageBytes = 256 * 1024 * 1024;
+
+    // Reads PREDICTIVE_UNIT_GRPC_SERVICE_PORT, SELDON_CPP_SERVER_THREADS
+    // and SELDON_CPP_GRPC_MAX_MESSAGE_BYTES
+    static GrpcServerOptions fromEnvironment();
+};
+
+// Asynchronous gRPC server exposing a model on the Model, Seldon, Generic,
+// Transformer, OutputTransformer, Router and Combiner services of
+// prediction.proto. Calls are accepted through the
+// generic service, so messages reach the model as raw wire bytes without
+// generated stubs or an intermediate parse. Only built with
+// SELDON_OPT_BUILD_GRPC.
+//
+// Every thread owns a completion queue and hands the calls it accepted to
+// RawModel::handleBufferAsync, so models that complete asynchronously keep
+// many calls in flight per thread. stop() waits for calls in flight.
+class GrpcServer
+{
+public:
+    GrpcServer(RawModel &model, GrpcServerOptions options = GrpcServerOptions());
+    ~GrpcServer();
+
+    GrpcServer(const GrpcServer &) = delete;
+    GrpcServer &operator=(const GrpcServer &) = delete;
+
+    // Binds the port and starts polling. Throws std::runtime_error if the
+    // port can't be bound.
+    void start();
+    // Stops accepting calls and cancels pending ones; safe to call from
+    // any thread
+    void stop();
+    // Blocks until every polling thread has exited
+    void wait();
+
+    // Bound port, useful when the options asked for port 0
+    int port() const { return this->mPort; }
+
+private:
+    class Call;
+
+    void poll(grpc::ServerCompletionQueue *queue);
+    void callStarted();
+    void callDone();
+
+    RawModel &mModel;
+    GrpcServerOptions mOptions;
+    std::unique_ptr<grpc::AsyncGenericService> mService;
+    std::unique_ptr<grpc::Server> mServer;
+    std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> mQueues;
+    std::vector<std::thread> mThreads;
+    std::atomic<bool> mStopping{false};
+    int mPort = 0;
+
+    // Calls handed to the model and not yet finished
+    std::mutex mMutex;
+    std::condition_variable mIdle;
+    int mInFlight = 0;
+};
+
+}
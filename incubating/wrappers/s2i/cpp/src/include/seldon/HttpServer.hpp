@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "seldon/RawModel.hpp"
+
+namespace seldon {
+
+struct ServerOptions
+{
+    std::string host = "0.0.0.0";
+    // Same defaults as the Python microservice
+    int port = 9000;
+    // Also served on port, set to 0 to disable the separate listener
+    int metricsPort = 6000;
+    // Event loop threads, 0 uses one per core
+    int threads = 0;
+    size_t maxRequestBytes = 256 * 1024 * 1024;
+
+    // Reads PREDICTIVE_UNIT_HTTP_SERVICE_PORT,
+    // PREDICTIVE_UNIT_METRICS_SERVICE_PORT and SELDON_CPP_SERVER_THREADS
+    static ServerOptions fromEnvironment();
+};
+
+// Multi-threaded, event-driven HTTP/1.1 server exposing a model on the
+// same REST routes as the Python microservice:
+//
+//   POST /api/v1.0/predictions, /api/v0.1/predictions, GET|POST /predict
+//   GET|POST /transform-input, /transform-output, /route, /aggregate
+//   POST /api/v1.0/feedback, /api/v0.1/feedback, GET|POST /send-feedback
+//   GET  /metadata
+//   GET  /health/ping
+//   GET  /metrics
+//
+// Every thread runs its own epoll loop and accepts from shared listening
+// sockets, so a connection stays on one thread for its whole lifetime.
+// Requests go to RawModel::handleBufferAsync: synchronous models run inline
+// on the loop thread, while asynchronous and batched ones hand the
+// response back through the loop's eventfd, so a thread can keep many
+// requests in flight. Prediction bodies are JSON unless sent with Content-Type:
+// application/x-protobuf.
+class HttpServer
+{
+public:
+    HttpServer(RawModel &model, ServerOptions options = ServerOptions());
+    ~HttpServer();
+
+    HttpServer(const HttpServer &) = delete;
+    HttpServer &operator=(const HttpServer &) = delete;
+
+    // Binds the listening sockets and starts the event loops. Throws
+    // std::system_error if a port can't be bound.
+    void start();
+    // Asks every loop to exit; safe to call from any thread
+    void stop();
+    // Blocks until every loop has exited
+    void wait();
+
+    // Bound ports, useful when the options asked for port 0
+    int port() const { return this->mPort; }
+    int metricsPort() const { return this->mMetricsPort; }
+
+private:
+    class Worker;
+
+    RawModel &mModel;
+    ServerOptions mOptions;
+    std::vector<int> mListenFds;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::vector<std::thread> mThreads;
+    int mPort = 0;
+    int mMetricsPort = 0;
+};
+
+// Serves model until the process receives SIGINT or SIGTERM. When built
+// with SELDON_OPT_BUILD_GRPC the gRPC services are served alongside, with
+// GrpcServerOptions::fromEnvironment(). Returns the process exit code.
+int serve(RawModel &model, const ServerOptions &options = ServerOptions::fromEnvironment());
+
+}
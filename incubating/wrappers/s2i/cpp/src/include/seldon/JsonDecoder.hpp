@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "prediction.pb.h"
+
+namespace seldon {
+namespace json {
+
+// Single pass JSON decoders for request messages. They write each field
+// straight into message as they go, numbers into tensor values included,
+// rather than through the type resolver and intermediate representation of
+// JsonStringToMessage, and give the same result.
+//
+// They return false, leaving message partly written, for anything they
+// leave to the protobuf parser: customData, tftensor, nulls outside of
+// Values, quoted numbers, numeric enums, duplicate keys, nesting deeper
+// than 32, and JSON that isn't strictly valid, which the protobuf parser
+// may still accept or reject with a proper error. Codec.hpp falls back to
+// it for these.
+bool decode(const char *data, size_t size, protos::SeldonMessage &message);
+bool decode(const char *data, size_t size, protos::SeldonMessageList &list);
+bool decode(const char *data, size_t size, protos::Feedback &feedback);
+
+// Receives the key of each member scanObject finds, and the extent of its
+// value's text
+using MemberCallback = std::function<bool(const char *key, size_t keySize,
+                                          const char *value, const char *valueEnd)>;
+
+// Finds the members of the JSON object at data without decoding them, for
+// callers that only need some. Only strings and nesting are followed, so
+// the values may still be malformed. Returns false if member does, if a
+// key holds escapes, or if data isn't a single object.
+bool scanObject(const char *data, size_t size, const MemberCallback &member);
+
+}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "prediction.pb.h"
+
+namespace seldon {
+namespace json {
+
+struct EncodeOptions
+{
+    // Significant digits float32 tensor values are written with, from 1
+    // to 9, or 0 for the shortest text that reads back as the same float
+    int floatDigits = 0;
+    // Leaves out a status or meta that holds nothing but default values,
+    // which the protobuf printer writes as {}
+    bool omitDefaults = false;
+    // Writes data.tensor and numeric data.tftensor values as "ndarray",
+    // see SeldonModel::enableNdarrayResponses
+    bool ndarray = false;
+
+    // Reads SELDON_CPP_JSON_FLOAT_DIGITS and SELDON_CPP_JSON_OMIT_DEFAULTS
+    static EncodeOptions fromEnvironment();
+};
+
+// Most chars writeNumber writes, e.g. -2.2250738585072014e-308
+constexpr size_t kMaxNumberSize = 24;
+
+// Writes value to out as the shortest decimal that reads back as the same
+// double, found with the Schubfach algorithm rather than printf, and
+// returns the end of what was written. Exponents are used below 1e-4 and
+// from 1e16, like Python's repr. NaN and the infinities are written as the
+// quoted strings the protobuf JSON printer uses.
+char *writeNumber(double value, char *out);
+
+// Shortest decimal that reads back as the same float
+char *writeNumber(float value, char *out);
+
+// Rounds the shortest decimal of value half away from zero to at most
+// digits significant digits. 0 is the same as the overload above.
+char *writeNumber(float value, int digits, char *out);
+
+char *writeNumber(int64_t value, char *out);
+
+inline char *writeNumber(int32_t value, char *out) {
+    return writeNumber(static_cast<int64_t>(value), out);
+}
+
+// Replaces out with the JSON encoding of message, writing straight into
+// out's buffer, so a buffer kept across requests is not reallocated.
+// Fields are written in the same order and with the same escapes as
+// MessageToJsonString, and numbers with writeNumber, so the output reads
+// back as the same message.
+//
+// Returns false, leaving out unspecified, for a customData or a tftensor
+// holding resource handles or variants, and for strings that aren't valid
+// UTF-8, which are left to the protobuf printer.
+bool encode(const protos::SeldonMessage &message, std::string &out,
+            const EncodeOptions &options = EncodeOptions());
+
+}
+}
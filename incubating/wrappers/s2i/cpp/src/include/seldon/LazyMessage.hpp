@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <google/protobuf/arena.h>
+#include <google/protobuf/stubs/stringpiece.h>
+
+#include "prediction.pb.h"
+#include "seldon/JsonEncoder.hpp"
+#include "seldon/RawModel.hpp"
+
+namespace seldon {
+
+// A SeldonMessage request whose status and meta are decoded up front, and
+// whose data, binData, strData, jsonData or customData is kept as the
+// bytes it was sent as until it's read. Encoding it in the format it was
+// parsed from copies those bytes back out as they were, so a router or
+// transformer that only looks at meta costs next to nothing however large
+// the payload is.
+//
+// It points into the request it was parsed from, which must outlive it.
+// The views below let models read the bytes of a wire-format request
+// straight from that buffer, where decoding would copy them.
+class LazyMessage
+{
+public:
+    // The messages are allocated on arena, if any
+    explicit LazyMessage(google::protobuf::Arena *arena = nullptr);
+    ~LazyMessage();
+
+    LazyMessage(const LazyMessage &) = delete;
+    LazyMessage &operator=(const LazyMessage &) = delete;
+
+    // Decodes the status and meta of a request payload. Throws
+    // std::invalid_argument like decodeMessage if they are malformed; the
+    // payload is only checked once it's decoded. Requests the scan can't
+    // follow, such as ones with duplicate or unknown members, are decoded
+    // in full.
+    void parse(const char *data, size_t size, PayloadFormat format);
+
+    const protos::Status &status() const { return this->mMessage->status(); }
+    protos::Status *mutable_status() { return this->mMessage->mutable_status(); }
+    const protos::Meta &meta() const { return this->mMessage->meta(); }
+    protos::Meta *mutable_meta() { return this->mMessage->mutable_meta(); }
+
+    // Which payload the request holds, without decoding it
+    protos::SeldonMessage::DataOneofCase data_oneof_case() const {
+        return this->mDecoded ? this->mMessage->data_oneof_case() : this->mCase;
+    }
+
+    // Whether the payload has been decoded into message()
+    bool decoded() const { return this->mDecoded; }
+
+    // Whether the payload is encoded as the bytes it was sent as
+    bool verbatim() const { return this->mPayload != nullptr; }
+
+    // Whether the payload is a data.ndarray, found without decoding it
+    bool hasNdarray() const;
+
+    // The bytes of a binData or strData payload. For a wire-format request
+    // they point into the request rather than being copied out of it, and
+    // strData isn't checked to be UTF-8. Otherwise they point into
+    // message(). Empty for other payloads.
+    google::protobuf::StringPiece binDataView();
+    google::protobuf::StringPiece strDataView();
+
+    // Decodes the tftensor of a data payload into tensor, all but its
+    // tensor_content, which content is set to instead. It points into a
+    // wire-format request like the views above, and into message()
+    // otherwise. Returns false if the payload holds no tftensor.
+    bool tftensorView(tensorflow::TensorProto &tensor, google::protobuf::StringPiece &content);
+
+    // The whole message, decoding the payload on first call. Throws
+    // std::invalid_argument if it is malformed. Reading it doesn't stop
+    // the payload from being copied out verbatim.
+    const protos::SeldonMessage &message();
+
+    // The whole message, for components that change the payload, which is
+    // then encoded from the message
+    protos::SeldonMessage *mutable_message();
+
+    // Replaces out with the encoded message. A verbatim payload is copied
+    // as it was sent when format is the one it was parsed from.
+    void encode(PayloadFormat format, const json::EncodeOptions &options, std::string &out);
+
+    google::protobuf::Arena *arena() const { return this->mArena; }
+
+private:
+    google::protobuf::StringPiece bytesView(protos::SeldonMessage::DataOneofCase field);
+    void decodePayload();
+    void encodeHead(PayloadFormat format, const json::EncodeOptions &options,
+                    std::string &out);
+
+    google::protobuf::Arena *mArena;
+    // Status and meta, and the payload once decoded
+    protos::SeldonMessage *mMessage;
+    const char *mData = nullptr;
+    size_t mSize = 0;
+    PayloadFormat mFormat = PayloadFormat::Json;
+    protos::SeldonMessage::DataOneofCase mCase = protos::SeldonMessage::DATA_ONEOF_NOT_SET;
+    bool mDecoded = true;
+    // The JSON value of the payload, or its wire-format field, tag included
+    const char *mPayload = nullptr;
+    size_t mPayloadSize = 0;
+};
+
+}
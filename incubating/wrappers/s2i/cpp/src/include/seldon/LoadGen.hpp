@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "seldon/RawModel.hpp"
+
+namespace seldon {
+namespace loadgen {
+
+enum class Target {
+    // RawModel::handleBufferAsync, with no server in between
+    InProcess,
+    // The native HTTP server, over keep-alive connections
+    Rest,
+    // The native gRPC server, when built with SELDON_OPT_BUILD_GRPC
+    Grpc,
+};
+
+struct LoadOptions
+{
+    Target target = Target::InProcess;
+    // host:port of a running server. When empty, the native server is
+    // started in this process for the model and driven over loopback.
+    std::string address;
+    int serverThreads = 0;
+
+    Method method = Method::Predict;
+    // gRPC requests are always sent as protobuf
+    PayloadFormat format = PayloadFormat::Json;
+    // Requests are cycled through in order. Every {{seq}} in a payload is
+    // replaced with the request's sequence number, so requests can be
+    // told apart, e.g. by a cache.
+    std::vector<std::string> payloads;
+
+    // Requests per second to send at whatever the latency, one run per
+    // rate. 0 sends the next request as soon as a worker is free.
+    std::vector<double> rates{0};
+    // Workers, each with its own connection, sending one request at a time
+    int concurrency = 8;
+    double durationSeconds = 10;
+    // Requests sent before this long aren't measured
+    double warmupSeconds = 1;
+
+    // Parses the command line of seldon-loadgen, see usage(). Throws
+    // std::invalid_argument for unknown options or values.
+    static LoadOptions fromArgs(int argc, char **argv);
+    static const char *usage();
+};
+
+struct LoadReport
+{
+    double rate;
+    int concurrency;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    double seconds = 0;
+    // Latency in seconds. With a rate, it is measured from when each
+    // request was due rather than when it was sent, so time spent waiting
+    // for a worker counts and a stalled server can't hide behind the
+    // requests it held back (coordinated omission).
+    double mean = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double p999 = 0;
+    double max = 0;
+    // User and system CPU of this process per measured request, so it
+    // includes the model and server when they run in process
+    double cpuSecondsPerRequest = 0;
+
+    double throughput() const { return this->seconds > 0 ? this->requests / this->seconds : 0; }
+};
+
+// Sends load to model, or to the server at options.address, once for each
+// of options.rates
+std::vector<LoadReport> run(RawModel *model, const LoadOptions &options);
+
+std::string formatText(const std::vector<LoadReport> &reports);
+std::string formatJson(const LoadOptions &options, const std::vector<LoadReport> &reports);
+
+// Implements seldon-loadgen: parses the command line, runs the load and
+// prints the reports. model may be null when only driving an address.
+// Returns the process exit code.
+int main(RawModel *model, int argc, char **argv);
+
+}
+}
+
+// Defines a main() that runs seldon-loadgen against CLASS, in process or
+// through the native server on loopback:
+//
+//   SELDON_LOADGEN_MAIN(ModelClass)
+#define SELDON_LOADGEN_MAIN(CLASS)                      \
+    int main(int argc, char **argv)                     \
+    {                                                   \
+        CLASS model;                                    \
+        return seldon::loadgen::main(&model, argc, argv); \
+    }
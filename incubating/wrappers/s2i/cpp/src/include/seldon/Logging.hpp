@@ -0,0 +1,96 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+
+// Numeric levels match the Python logging module, so SELDON_LOG_LEVEL can
+// be shared between the Python wrapper and the C++ library.
+#define SELDON_LOG_LEVEL_DEBUG 10
+#define SELDON_LOG_LEVEL_INFO 20
+#define SELDON_LOG_LEVEL_WARNING 30
+#define SELDON_LOG_LEVEL_ERROR 40
+#define SELDON_LOG_LEVEL_CRITICAL 50
+
+// Statements below SELDON_MIN_LOG_LEVEL are removed by the preprocessor,
+// arguments included. Release builds (NDEBUG) drop DEBUG by default.
+#ifndef SELDON_MIN_LOG_LEVEL
+#ifdef NDEBUG
+#define SELDON_MIN_LOG_LEVEL SELDON_LOG_LEVEL_INFO
+#else
+#define SELDON_MIN_LOG_LEVEL SELDON_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+namespace seldon {
+namespace log {
+
+enum class Level : int {
+    Debug = SELDON_LOG_LEVEL_DEBUG,
+    Info = SELDON_LOG_LEVEL_INFO,
+    Warning = SELDON_LOG_LEVEL_WARNING,
+    Error = SELDON_LOG_LEVEL_ERROR,
+    Critical = SELDON_LOG_LEVEL_CRITICAL,
+};
+
+// Parses a Python style level name (case insensitive). Returns false and
+// leaves level untouched if the name is not recognised.
+bool parseLevel(const std::string &name, Level &level);
+
+// Runtime threshold, initialised from the SELDON_LOG_LEVEL environment
+// variable on first use and defaulting to INFO.
+Level getLevel();
+void setLevel(Level level);
+
+bool isEnabled(Level level);
+
+// Writes a single formatted line to stderr with one unbuffered write, so
+// concurrent log lines don't interleave and nothing waits on a flush.
+void write(Level level, const char *file, int line, const std::string &message);
+
+}
+}
+
+#define SELDON_LOG_IMPL(LEVEL, MESSAGE)                                   \
+    do {                                                                  \
+        if (::seldon::log::isEnabled(LEVEL)) {                            \
+            std::ostringstream seldonLogStream;                           \
+            seldonLogStream << MESSAGE;                                   \
+            ::seldon::log::write(                                         \
+                LEVEL, __FILE__, __LINE__, seldonLogStream.str());        \
+        }                                                                 \
+    } while (0)
+
+#define SELDON_LOG_DISABLED() \
+    do {                      \
+    } while (0)
+
+#if SELDON_MIN_LOG_LEVEL <= SELDON_LOG_LEVEL_DEBUG
+#define SELDON_LOG_DEBUG(MESSAGE) \
+    SELDON_LOG_IMPL(::seldon::log::Level::Debug, MESSAGE)
+#else
+#define SELDON_LOG_DEBUG(MESSAGE) SELDON_LOG_DISABLED()
+#endif
+
+#if SELDON_MIN_LOG_LEVEL <= SELDON_LOG_LEVEL_INFO
+#define SELDON_LOG_INFO(MESSAGE) \
+    SELDON_LOG_IMPL(::seldon::log::Level::Info, MESSAGE)
+#else
+#define SELDON_LOG_INFO(MESSAGE) SELDON_LOG_DISABLED()
+#endif
+
+#if SELDON_MIN_LOG_LEVEL <= SELDON_LOG_LEVEL_WARNING
+#define SELDON_LOG_WARNING(MESSAGE) \
+    SELDON_LOG_IMPL(::seldon::log::Level::Warning, MESSAGE)
+#else
+#define SELDON_LOG_WARNING(MESSAGE) SELDON_LOG_DISABLED()
+#endif
+
+#if SELDON_MIN_LOG_LEVEL <= SELDON_LOG_LEVEL_ERROR
+#define SELDON_LOG_ERROR(MESSAGE) \
+    SELDON_LOG_IMPL(::seldon::log::Level::Error, MESSAGE)
+#else
+#define SELDON_LOG_ERROR(MESSAGE) SELDON_LOG_DISABLED()
+#endif
+
+#define SELDON_LOG_CRITICAL(MESSAGE) \
+    SELDON_LOG_IMPL(::seldon::log::Level::Critical, MESSAGE)
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace seldon {
+namespace metrics {
+
+using Labels = std::map<std::string, std::string>;
+
+// Buckets spread logarithmically between 1ms and 30s, the same as the
+// BINS used by the Python wrapper's SeldonMetrics
+const std::vector<double> &defaultBuckets();
+
+// Base of every metric series. Updates are lock free; only registration
+// and rendering take the registry lock.
+class Metric
+{
+public:
+    virtual ~Metric() { }
+
+    virtual void render(std::string &out, const std::string &name,
+                        const std::string &labels) const = 0;
+};
+
+class Counter : public Metric
+{
+public:
+    void inc(double value = 1.0);
+    double value() const { return this->mValue.load(std::memory_order_relaxed); }
+
+    void render(std::string &out, const std::string &name,
+                const std::string &labels) const override;
+
+private:
+    std::atomic<double> mValue{0.0};
+};
+
+class Gauge : public Metric
+{
+public:
+    void set(double value) { this->mValue.store(value, std::memory_order_relaxed); }
+    void inc(double value = 1.0);
+    void dec(double value = 1.0) { this->inc(-value); }
+    double value() const { return this->mValue.load(std::memory_order_relaxed); }
+
+    void render(std::string &out, const std::string &name,
+                const std::string &labels) const override;
+
+private:
+    std::atomic<double> mValue{0.0};
+};
+
+class Histogram : public Metric
+{
+public:
+    explicit Histogram(const std::vector<double> &bounds);
+
+    void observe(double value);
+
+    uint64_t count() const { return this->mCount.load(std::memory_order_relaxed); }
+    double sum() const { return this->mSum.load(std::memory_order_relaxed); }
+
+    void render(std::string &out, const std::string &name,
+                const std::string &labels) const override;
+
+private:
+    std::vector<double> mBounds;
+    // One slot per bound plus the +Inf bucket, stored non-cumulatively
+    std::unique_ptr<std::atomic<uint64_t>[]> mBuckets;
+    std::atomic<uint64_t> mCount{0};
+    std::atomic<double> mSum{0.0};
+};
+
+// Id for a new ThreadShards, never reused
+size_t nextShardsId();
+
+// Per-thread copies of a metric's state for hot paths. Each copy is only
+// written by its own thread, so updates are uncontended; readers add them
+// up under a lock that writers only take on their first update.
+template <typename Shard>
+class ThreadShards
+{
+public:
+    ThreadShards() : mId(nextShardsId()) { }
+
+    Shard &local() {
+        // Indexed by id, which is never reused, so an entry can't outlive
+        // its ThreadShards and be mistaken for another's
+        thread_local std::vector<Shard *> tShards;
+        if (this->mId < tShards.size() && tShards[this->mId] != nullptr) {
+            return *tShards[this->mId];
+        }
+
+        Shard *shard = new Shard();
+        {
+            std::lock_guard<std::mutex> lock(this->mMutex);
+            this->mShards.emplace_back(shard);
+        }
+        if (tShards.size() <= this->mId) {
+            tShards.resize(this->mId + 1, nullptr);
+        }
+        tShards[this->mId] = shard;
+        return *shard;
+    }
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        for (const auto &shard : this->mShards) {
+            fn(*shard);
+        }
+    }
+
+private:
+    size_t mId;
+    mutable std::mutex mMutex;
+    std::vector<std::unique_ptr<Shard>> mShards;
+};
+
+// Counter for hot paths, summed across ThreadShards
+class ShardedCounter : public Metric
+{
+public:
+    void inc(double value = 1.0) {
+        std::atomic<double> &local = this->mShards.local().value;
+        local.store(local.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    double value() const;
+
+    void render(std::string &out, const std::string &name,
+                const std::string &labels) const override;
+
+private:
+    struct Shard
+    {
+        std::atomic<double> value{0.0};
+    };
+
+    ThreadShards<Shard> mShards;
+};
+
+// Histogram for hot paths. Every thread records into a shard of its own,
+// so recording costs a couple of uncontended stores, into log-linear
+// buckets that are within 1% of the recorded value, as in HdrHistogram.
+// Values are nanoseconds up to about a minute. It is rendered as a
+// Prometheus histogram over bounds, in seconds, and can report quantiles.
+class HdrHistogram : public Metric
+{
+public:
+    explicit HdrHistogram(const std::vector<double> &bounds = defaultBuckets());
+    ~HdrHistogram();
+
+    HdrHistogram(const HdrHistogram &) = delete;
+    HdrHistogram &operator=(const HdrHistogram &) = delete;
+
+    void record(uint64_t nanos);
+
+    void observe(double seconds) {
+        this->record(seconds > 0 ? static_cast<uint64_t>(seconds * 1e9) : 0);
+    }
+
+    uint64_t count() const;
+    // In seconds
+    double sum() const;
+    // Seconds below which a fraction q of the recorded values fall
+    double quantile(double q) const;
+
+    void render(std::string &out, const std::string &name,
+                const std::string &labels) const override;
+
+private:
+    struct Shard;
+
+    // Adds up every thread's shard
+    std::vector<uint64_t> merged(uint64_t &sumNanos) const;
+
+    std::vector<double> mBounds;
+    ThreadShards<Shard> mShards;
+};
+
+// Set of metric families rendered in the Prometheus text format. Returned
+// references stay valid for the lifetime of the registry, so callers
+// should look a series up once and keep it.
+class Registry
+{
+public:
+    explicit Registry(Labels defaultLabels = Labels());
+
+    // Process wide registry served on /metrics, labelled with the same
+    // deployment, predictor and model labels as the Python wrapper
+    static Registry &global();
+
+    Counter &counter(const std::string &name, const std::string &help,
+                     const Labels &labels = Labels());
+    ShardedCounter &shardedCounter(const std::string &name, const std::string &help,
+                                   const Labels &labels = Labels());
+    Gauge &gauge(const std::string &name, const std::string &help,
+                 const Labels &labels = Labels());
+    Histogram &histogram(const std::string &name, const std::string &help,
+                         const Labels &labels = Labels(),
+                         const std::vector<double> &bounds = defaultBuckets());
+    HdrHistogram &hdrHistogram(const std::string &name, const std::string &help,
+                               const Labels &labels = Labels(),
+                               const std::vector<double> &bounds = defaultBuckets());
+
+    std::string render() const;
+
+private:
+    enum class Type { Counter, ShardedCounter, Gauge, Histogram, HdrHistogram };
+
+    struct Family
+    {
+        Type type;
+        std::string help;
+        std::map<Labels, std::unique_ptr<Metric>> series;
+    };
+
+    static const char *typeName(Type type);
+
+    Family &family(const std::string &name, const std::string &help, Type type);
+
+    Labels mDefaultLabels;
+    mutable std::mutex mMutex;
+    std::map<std::string, Family> mFamilies;
+};
+
+// Formats a value the way Prometheus expects, e.g. "+Inf" or "0.25"
+std::string formatValue(double value);
+
+}
+}
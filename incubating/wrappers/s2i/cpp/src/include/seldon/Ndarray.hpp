@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "prediction.pb.h"
+
+namespace seldon {
+namespace ndarray {
+
+// Whether static_cast from Source to Target is undefined for some values
+template <typename Source, typename Target>
+struct NarrowsToInteger
+    : std::integral_constant<bool, std::is_floating_point<Source>::value &&
+                                       std::is_integral<Target>::value &&
+                                       !std::is_same<Target, bool>::value>
+{
+};
+
+// Casts value like static_cast
+template <typename Target, typename Source>
+typename std::enable_if<!NarrowsToInteger<Source, Target>::value, Target>::type
+checkedCast(Source value) {
+    return static_cast<Target>(value);
+}
+
+// Truncates a floating point value towards zero. Throws
+// std::invalid_argument for NaN and for values that don't fit Target once
+// truncated, which static_cast leaves undefined.
+template <typename Target, typename Source>
+typename std::enable_if<NarrowsToInteger<Source, Target>::value, Target>::type
+checkedCast(Source value) {
+    // Both bounds are powers of two, so they are exact as doubles
+    const double high = std::ldexp(1.0, std::numeric_limits<Target>::digits);
+    const double low = std::is_signed<Target>::value ? -high : 0.0;
+    double truncated = std::trunc(static_cast<double>(value));
+    // NaN fails both comparisons
+    if (!(truncated >= low && truncated < high)) {
+        throw std::invalid_argument(
+            "ndarray value " + std::to_string(value) + " is out of range for " +
+            (std::is_signed<Target>::value ? "int" : "uint") + std::to_string(sizeof(Target) * 8));
+    }
+    return static_cast<Target>(truncated);
+}
+
+// Converts size elements with checkedCast, so narrowing to an integer
+// truncates towards zero and throws for values that don't fit
+template <typename Source, typename Target>
+void convert(const Source *in, size_t size, Target *out) {
+    for (size_t i = 0; i < size; i++) {
+        out[i] = checkedCast<Target>(in[i]);
+    }
+}
+
+// Vectorized with AVX, SSE2 or NEON where the build targets them. The
+// int32_t conversion throws like checkedCast on every path.
+void convert(const double *in, size_t size, float *out);
+void convert(const double *in, size_t size, int32_t *out);
+void convert(const double *in, size_t size, double *out);
+
+// Flattens a (possibly nested) ndarray into row-major values of type T,
+// sizing values once from the shape of its first elements after every
+// list has been checked against it. Throws std::invalid_argument for
+// ragged or non-numeric arrays. Supported for double, float, int32_t and
+// int64_t.
+template <typename T>
+void flatten(const google::protobuf::ListValue &ndarray, std::vector<int64_t> &shape,
+             std::vector<T> &values);
+
+// Appends values as nested ndarray JSON, e.g. [[1,2],[3,4]], with numbers
+// written by seldon::json::writeNumber, float values with floatDigits
+// significant digits. Supported for double, float, int32_t and int64_t.
+template <typename T>
+void appendJson(const T *values, const std::vector<int64_t> &shape, std::string &out,
+                int floatDigits = 0);
+
+// Size of values nested to shape as a wire-format google.protobuf.ListValue
+// of number values, the ndarray the Python wrapper's array_to_list_value
+// builds. shape needs at least one dimension.
+size_t listValueSize(const std::vector<int64_t> &shape);
+
+// Writes that ListValue to out, which must hold listValueSize(shape)
+// bytes, without creating a Value per element
+void writeListValue(const double *values, const std::vector<int64_t> &shape, char *out);
+
+// Size of values as a wire-format seldon.protos.Tensor
+size_t tensorSize(const std::vector<int64_t> &shape);
+
+// Writes that Tensor to out, which must hold tensorSize(shape) bytes
+void writeTensor(const double *values, const std::vector<int64_t> &shape, char *out);
+
+}
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "prediction.pb.h"
+#include "seldon/RawModel.hpp"
+
+namespace seldon {
+
+namespace metrics {
+class Counter;
+class Gauge;
+}
+
+struct CacheOptions
+{
+    // Keys and responses held across every shard, plus a small overhead
+    // per entry
+    int64_t maxBytes = 64 * 1024 * 1024;
+    // How long a response is served for after it was predicted
+    int64_t ttlMs = 60 * 1000;
+    // Independently locked parts of the cache, rounded up to a power of two
+    int shards = 16;
+
+    // Reads SELDON_CPP_CACHE_MAX_BYTES, SELDON_CPP_CACHE_TTL_MS and
+    // SELDON_CPP_CACHE_SHARDS
+    static CacheOptions fromEnvironment();
+};
+
+// Concurrent cache of predictions, split into shards that each keep their
+// entries in LRU order. A new entry is only admitted over the shard's
+// least recently used ones when it has been asked for more often, going
+// by a TinyLFU frequency sketch of recent lookups, so one-off requests
+// don't flush out popular ones.
+//
+// Keys are compared in full, so a hash collision is a miss rather than a
+// wrong response.
+class PredictionCache
+{
+public:
+    enum class Kind {
+        // Exact JSON request body
+        JsonRequest,
+        // Exact protobuf request body
+        ProtoRequest,
+        // Canonical payload of a decoded request, see detail::cacheKey
+        Message,
+    };
+
+    static Kind requestKind(PayloadFormat format) {
+        return format == PayloadFormat::Json ? Kind::JsonRequest : Kind::ProtoRequest;
+    }
+
+    explicit PredictionCache(CacheOptions options = CacheOptions());
+    ~PredictionCache();
+
+    PredictionCache(const PredictionCache &) = delete;
+    PredictionCache &operator=(const PredictionCache &) = delete;
+
+    // Returns the value cached for key, or nullptr if there is none or it
+    // has expired
+    std::shared_ptr<const std::string> get(Kind kind, const char *key, size_t size);
+
+    void put(Kind kind, const char *key, size_t size, std::string value);
+
+    const CacheOptions &options() const { return this->mOptions; }
+
+    size_t entries() const;
+    size_t bytes() const;
+
+private:
+    struct Entry
+    {
+        uint64_t hash;
+        Kind kind;
+        std::string key;
+        std::shared_ptr<const std::string> value;
+        std::chrono::steady_clock::time_point expires;
+
+        size_t bytes() const;
+    };
+
+    // Count-min sketch of 4 bit counters, halved every few thousand
+    // lookups so it follows recent popularity
+    class FrequencySketch
+    {
+    public:
+        explicit FrequencySketch(size_t width);
+
+        void increment(uint64_t hash);
+        int estimate(uint64_t hash) const;
+
+    private:
+        size_t index(uint64_t hash, int row) const;
+
+        std::vector<uint8_t> mCounters;
+        size_t mMask;
+        size_t mAdditions = 0;
+        size_t mSampleSize;
+    };
+
+    struct Shard
+    {
+        explicit Shard(size_t sketchWidth) : sketch(sketchWidth) { }
+
+        mutable std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+        FrequencySketch sketch;
+    };
+
+    Shard &shardOf(uint64_t hash);
+    // Counts the removal against reason, unless it is nullptr
+    void remove(Shard &shard, std::list<Entry>::iterator entry, metrics::Counter *reason);
+
+    CacheOptions mOptions;
+    size_t mShardBytes;
+    std::vector<std::unique_ptr<Shard>> mShards;
+
+    metrics::Counter *mHits[3];
+    metrics::Counter *mMisses[3];
+    metrics::Counter &mExpired;
+    metrics::Counter &mEvicted;
+    metrics::Counter &mRejected;
+    metrics::Gauge &mBytes;
+};
+
+// 64 bit hash of size bytes, used to pick cache shards and entries
+uint64_t hashBytes(const char *data, size_t size, uint64_t seed = 0);
+
+// Replaces key with the canonical form of message's data, binData,
+// strData or jsonData, serialized deterministically, so requests that
+// only differ in their JSON formatting or their meta, puid included, share
+// a key. Returns false for customData and messages without a payload.
+bool payloadKey(const protos::SeldonMessage &message, std::string &key);
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace seldon {
+
+enum class PayloadFormat {
+    // SeldonMessage JSON, as sent by the executor over REST
+    Json,
+    // Wire-format SeldonMessage, as sent over gRPC or as application/x-protobuf
+    Proto,
+};
+
+// Component API methods, matching the rpcs of the Model and Generic
+// services in prediction.proto
+enum class Method {
+    Predict,
+    TransformInput,
+    TransformOutput,
+    Route,
+    Aggregate,
+    SendFeedback,
+    Metadata,
+};
+
+// Name used for the method in logs and metric labels
+inline const char *methodName(Method method) {
+    switch (method) {
+    case Method::Predict:
+        return "predict";
+    case Method::TransformInput:
+        return "transform-input";
+    case Method::TransformOutput:
+        return "transform-output";
+    case Method::Route:
+        return "route";
+    case Method::Aggregate:
+        return "aggregate";
+    case Method::SendFeedback:
+        return "send-feedback";
+    case Method::Metadata:
+        return "metadata";
+    }
+    return "unknown";
+}
+
+// Thrown when a model does not implement the requested method. Servers map
+// it to UNIMPLEMENTED / 501.
+class NotImplementedError : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Python-free view of a model that the native servers drive. SeldonModel
+// implements it by decoding the payload, running the matching method and
+// encoding the response in the same format.
+class RawModel
+{
+public:
+    // Receives the encoded response of handleBufferAsync, or the exception
+    // the request failed with, in which case out is meaningless
+    using Completion = std::function<void(std::exception_ptr error, std::string &out)>;
+
+    virtual ~RawModel() { }
+
+    // Replaces out with the encoded response. Throws std::invalid_argument
+    // when the request can't be decoded.
+    virtual void handleBuffer(Method method, const char *data, size_t size,
+                              PayloadFormat format, std::string &out) = 0;
+
+    // Asynchronous variant the native servers call, so requests waiting on
+    // the model don't hold a server thread. data is only read until this
+    // returns, and done is called exactly once, possibly from another
+    // thread, with errors passed to it rather than thrown. Defaults to
+    // running handleBuffer inline.
+    virtual void handleBufferAsync(Method method, const char *data, size_t size,
+                                   PayloadFormat format, Completion done) {
+        thread_local std::string out;
+        std::exception_ptr error;
+        try {
+            this->handleBuffer(method, data, size, format, out);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        done(error, out);
+    }
+
+    void predictBuffer(const char *data, size_t size, PayloadFormat format,
+                       std::string &out) {
+        this->handleBuffer(Method::Predict, data, size, format, out);
+    }
+};
+
+}
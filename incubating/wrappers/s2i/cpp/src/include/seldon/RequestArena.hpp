@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include <google/protobuf/arena.h>
+
+namespace seldon {
+
+// Per-thread protobuf arena that backs the messages of a single request.
+//
+// The arena starts on a caller-owned initial block which survives Reset(),
+// so once the block is large enough for the typical request, parsing and
+// building messages no longer touches the global allocator. When a request
+// overflows the block, the block is regrown at reset to fit it next time.
+class RequestArena
+{
+public:
+    // Initial block handed to a fresh thread before any request was seen
+    static constexpr size_t kMinBlockSize = 16 * 1024;
+    // Blocks are never grown past this, so one huge request does not pin
+    // memory on every thread forever
+    static constexpr size_t kMaxBlockSize = 64 * 1024 * 1024;
+
+    // Scope of one request. Nested scopes on the same thread share the
+    // arena, and only the outermost one resets it on exit.
+    class Scope
+    {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        google::protobuf::Arena &arena() { return this->mArena.arena(); }
+
+    private:
+        RequestArena &mArena;
+    };
+
+    RequestArena();
+
+    RequestArena(const RequestArena &) = delete;
+    RequestArena &operator=(const RequestArena &) = delete;
+
+    // Arena of the calling thread
+    static RequestArena &local();
+
+    google::protobuf::Arena &arena() { return *this->mArena; }
+
+    size_t blockSize() const { return this->mBlockSize; }
+
+    // Destroys every message allocated since the last reset
+    void reset();
+
+private:
+    void allocate(size_t blockSize);
+
+    std::unique_ptr<char[]> mBlock;
+    size_t mBlockSize = 0;
+    std::unique_ptr<google::protobuf::Arena> mArena;
+    int mDepth = 0;
+};
+
+}
@@ -1,63 +1,1022 @@
 #pragma once
 
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// Set SELDON_WITH_PYTHON=0 to build a model without pybind11, e.g. for the
+// native seldon-cpp-server where SELDON_BIND_MODULE defines main() instead
+#ifndef SELDON_WITH_PYTHON
+#define SELDON_WITH_PYTHON 1
+#endif
+
+#if SELDON_WITH_PYTHON
 #include <pybind11/pybind11.h>
+#endif
 #include <google/protobuf/util/json_util.h>
 
 #include "prediction.pb.h"
+#include "seldon/Batcher.hpp"
+#include "seldon/Codec.hpp"
+#include "seldon/CustomMetrics.hpp"
+#include "seldon/JsonEncoder.hpp"
+#include "seldon/LazyMessage.hpp"
+#include "seldon/Logging.hpp"
+#include "seldon/PredictionCache.hpp"
+#include "seldon/RawModel.hpp"
+#include "seldon/RequestArena.hpp"
+#include "seldon/StageTimer.hpp"
+#include "seldon/Task.hpp"
 
+#if SELDON_WITH_PYTHON
 namespace py = pybind11;
+#else
+#include "seldon/HttpServer.hpp"
+#include "seldon/LoadGen.hpp"
+#endif
 
 namespace seldon {
 
+#if SELDON_WITH_PYTHON
+namespace detail {
+
+// Outputs smaller than this are serialized without dropping the GIL, as
+// re-acquiring it costs more than the copy itself
+constexpr size_t kReleaseGilSerializeBytes = 64 * 1024;
+
+// Serializes message into a bytes object allocated at its final size, so
+// the response is written once instead of going through a std::string.
+// Requires the GIL and ByteSizeLong() to have been called on message.
+template <typename Message>
+py::bytes serializeToBytes(const Message &message, size_t size) {
+
+    PyObject *object = PyBytes_FromStringAndSize(
+        nullptr, static_cast<Py_ssize_t>(size));
+    if (object == nullptr) {
+        throw py::error_already_set();
+    }
+    py::bytes result = py::reinterpret_steal<py::bytes>(object);
+
+    uint8_t *target = reinterpret_cast<uint8_t *>(PyBytes_AS_STRING(object));
+    if (size >= kReleaseGilSerializeBytes) {
+        // Nothing else holds a reference to the new object yet
+        py::gil_scoped_release release;
+        message.SerializeWithCachedSizesToArray(target);
+    } else {
+        message.SerializeWithCachedSizesToArray(target);
+    }
+
+    return result;
+}
+
+}
+#endif
+
+namespace detail {
+
+// Whether a JSON request sent its data as an ndarray
+inline bool hasNdarray(const protos::SeldonMessage &message) {
+    return message.data().has_ndarray();
+}
+
+inline bool hasNdarray(const protos::SeldonMessageList &list) {
+    return list.seldonmessages_size() > 0 && hasNdarray(list.seldonmessages(0));
+}
+
+template <typename Message>
+bool hasNdarray(const Message &message) {
+    return false;
+}
+
+// Canonical cache key of a request, see payloadKey
+inline bool cacheKey(const protos::SeldonMessage &message, std::string &key) {
+    return payloadKey(message, key);
+}
+
+template <typename Message>
+bool cacheKey(const Message &message, std::string &key) {
+    return false;
+}
+
+// A cached output answers later requests, so a puid it carries is
+// replaced with the new request's
+inline void restorePuid(const protos::SeldonMessage &input, protos::SeldonMessage &output) {
+    if (output.has_meta() && !output.meta().puid().empty()) {
+        output.mutable_meta()->set_puid(input.meta().puid());
+    }
+}
+
+template <typename Message>
+void restorePuid(const Message &input, Message &output) { }
+
+// Adds the decode and predict times of a request to its output as TIMER
+// metrics, in milliseconds like the Python wrapper's
+inline void addStageTimers(const StageTimer &timer, protos::Meta &meta) {
+    static const char *const keys[] = {"seldon_cpp_decode_time", "seldon_cpp_predict_time"};
+    const Stage stages[] = {Stage::Decode, Stage::Predict};
+    for (int i = 0; i < 2; i++) {
+        protos::Metric *metric = meta.add_metrics();
+        metric->set_key(keys[i]);
+        metric->set_type(protos::Metric::TIMER);
+        metric->set_value(static_cast<float>(timer.milliseconds(stages[i])));
+    }
+}
+
+inline void addStageTimers(const StageTimer &timer, protos::SeldonMessage &output) {
+    addStageTimers(timer, *output.mutable_meta());
+}
+
+inline void addStageTimers(const StageTimer &timer, LazyMessage &output) {
+    addStageTimers(timer, *output.mutable_meta());
+}
+
+template <typename Message>
+void addStageTimers(const StageTimer &timer, Message &output) { }
+
+inline void addCustomMetrics(const metrics::Capture &capture, protos::SeldonMessage &output) {
+    if (!capture.empty()) {
+        capture.appendTo(*output.mutable_meta());
+    }
+}
+
+inline void addCustomMetrics(const metrics::Capture &capture, LazyMessage &output) {
+    if (!capture.empty()) {
+        capture.appendTo(*output.mutable_meta());
+    }
+}
+
+template <typename Message>
+void addCustomMetrics(const metrics::Capture &capture, Message &output) { }
+
+// Stage timers and custom metrics are appended to the output's metrics,
+// after any the model set, and describe the request that ran the
+// prediction. These find and drop them, so a cached response doesn't
+// replay them to later requests.
+inline int metricCount(const protos::SeldonMessage &output) {
+    return output.meta().metrics_size();
+}
+
+inline int metricCount(const LazyMessage &output) {
+    return output.meta().metrics_size();
+}
+
+template <typename Message>
+int metricCount(const Message &output) {
+    return 0;
+}
+
+inline void removeMetrics(protos::Meta &meta, int first) {
+    meta.mutable_metrics()->DeleteSubrange(first, meta.metrics_size() - first);
+}
+
+inline void removeMetrics(protos::SeldonMessage &output, int first) {
+    removeMetrics(*output.mutable_meta(), first);
+}
+
+inline void removeMetrics(LazyMessage &output, int first) {
+    removeMetrics(*output.mutable_meta(), first);
+}
+
+template <typename Message>
+void removeMetrics(Message &output, int first) { }
+
+// Methods that take a LazyMessage once SeldonModel::enableLazyDecoding is
+// called
+inline bool lazyMethod(Method method) {
+    return method == Method::Predict || method == Method::TransformInput ||
+           method == Method::TransformOutput || method == Method::Route;
+}
+
+// The whole of a lazy request, for the overloads that take a message.
+// Only SeldonMessage components decode lazily.
+template <typename Message>
+Message &decoded(LazyMessage &message) {
+    throw std::logic_error("Lazy decoding is only supported for SeldonMessage");
+}
+
+template <>
+inline protos::SeldonMessage &decoded(LazyMessage &message) {
+    return *message.mutable_message();
+}
+
+#if SELDON_WITH_PYTHON
+// Raises seldon::NotImplementedError as seldon_core's
+// SeldonNotImplementedError, so the Python wrapper falls back to its
+// default behaviour for methods the model leaves out
+inline void registerExceptions() {
+    py::register_exception_translator([](std::exception_ptr error) {
+        try {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        } catch (const NotImplementedError &e) {
+            try {
+                py::object type = py::module::import("seldon_core.user_model")
+                                      .attr("SeldonNotImplementedError");
+                PyErr_SetObject(type.ptr(), py::str(e.what()).ptr());
+            } catch (py::error_already_set &) {
+                PyErr_SetString(PyExc_NotImplementedError, e.what());
+            }
+        }
+    });
+}
+#endif
+
+}
+
+// Base class for C++ components. Every method of the Generic service in
+// proto/prediction.proto can be overridden, either by value or through its
+// in-place overload, which builds the output on the per-request arena.
+// Requests for all of them are decoded, run and encoded on the same path
+// as predict, without holding the GIL.
 template <typename ProtoMessage = protos::SeldonMessage>
-class SeldonModel
+class SeldonModel : public RawModel
 {
 public:
     SeldonModel() { }
 
+    // A copy batches and caches with the same options, but through its own
+    // queue and cache
+    SeldonModel(const SeldonModel &other)
+        : RawModel(other), mEncodeOptions(other.mEncodeOptions),
+          mNdarrayResponses(other.mNdarrayResponses), mLazyDecoding(other.mLazyDecoding),
+          mAsyncPredict(other.mAsyncPredict), mTaskPredict(other.mTaskPredict),
+          mStageTimers(other.mStageTimers), mMetricsInResponse(other.mMetricsInResponse) {
+        if (other.mBatcher) {
+            this->enableBatching(other.mBatchOptions);
+        }
+        if (other.mCache) {
+            this->enableCache(other.mCache->options());
+        }
+    }
+
+    SeldonModel &operator=(const SeldonModel &other) {
+        this->mEncodeOptions = other.mEncodeOptions;
+        this->mNdarrayResponses = other.mNdarrayResponses;
+        this->mLazyDecoding = other.mLazyDecoding;
+        this->mAsyncPredict = other.mAsyncPredict;
+        this->mTaskPredict = other.mTaskPredict;
+        this->mStageTimers = other.mStageTimers;
+        this->mMetricsInResponse = other.mMetricsInResponse;
+        if (other.mBatcher) {
+            this->enableBatching(other.mBatchOptions);
+        } else {
+            this->mBatcher.reset();
+        }
+        if (other.mCache) {
+            this->enableCache(other.mCache->options());
+        } else {
+            this->mCache.reset();
+        }
+        return *this;
+    }
+
     virtual ~SeldonModel() { }
 
-    virtual ProtoMessage predict(ProtoMessage &data) = 0;
+    // Override this, or the in-place overload below, with the model logic
+    virtual ProtoMessage predict(ProtoMessage &data) {
+        throw std::logic_error("SeldonModel::predict is not implemented");
+    }
+
+    // In-place variant used by the raw entry points. Both messages live on
+    // the per-request arena, so building output directly (rather than
+    // returning a heap allocated message) avoids allocator round trips for
+    // every nested field. Defaults to the by-value predict above.
+    virtual void predict(ProtoMessage &input, ProtoMessage &output) {
+        output = this->predict(input);
+    }
+
+    // Receives the output of predictAsync, or the exception it failed with
+    using Callback = std::function<void(std::exception_ptr error, ProtoMessage &output)>;
+
+    // Asynchronous variant for models that run predictions on their own
+    // executor, or wait on another process. It must not block, and must
+    // call done exactly once, from any thread. The native servers and
+    // predict_raw_async only use it once enableAsyncPredict() or
+    // enableBatching() is called. Defaults to submitting the request to
+    // the batcher when there is one, and to running predict inline
+    // otherwise.
+    virtual void predictAsync(ProtoMessage &&input, Callback done) {
+        if (this->mBatcher) {
+            this->mBatcher->submit(std::move(input), std::move(done));
+            return;
+        }
+        ProtoMessage output;
+        std::exception_ptr error;
+        try {
+            this->runUncached(input, output);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        done(error, output);
+    }
+
+    std::future<ProtoMessage> predictAsync(ProtoMessage &&input) {
+        auto promise = std::make_shared<std::promise<ProtoMessage>>();
+        std::future<ProtoMessage> result = promise->get_future();
+        this->predictAsync(std::move(input),
+                           [promise](std::exception_ptr error, ProtoMessage &output) {
+            if (error) {
+                promise->set_exception(error);
+            } else {
+                promise->set_value(std::move(output));
+            }
+        });
+        return result;
+    }
+
+#if SELDON_WITH_COROUTINES
+    // Coroutine variant, for models whose predictions wait on other
+    // coroutines, e.g. a cache lookup or a downstream call, and may move
+    // to a ThreadPool with seldon::schedule. The native servers and
+    // predict_raw_async only use it once enableTaskPredict() is called.
+    // Defaults to awaiting predictAsync, so synchronous models work too.
+    virtual Task<ProtoMessage> predictTask(ProtoMessage input) {
+        co_return co_await awaitCallback<ProtoMessage>([this, &input](Callback done) {
+            this->predictAsync(std::move(input), std::move(done));
+        });
+    }
+
+    // Routes predictions from the native servers through predictTask. Call
+    // it from the constructor of models that override predictTask.
+    void enableTaskPredict() {
+        this->mTaskPredict = true;
+    }
+#endif
+
+    // Input and output transformers pass requests through unchanged unless
+    // overridden, like the Python wrapper
+    virtual ProtoMessage transformInput(ProtoMessage &data) {
+        return data;
+    }
+
+    virtual void transformInput(ProtoMessage &input, ProtoMessage &output) {
+        output = this->transformInput(input);
+    }
+
+    virtual ProtoMessage transformOutput(ProtoMessage &data) {
+        return data;
+    }
+
+    virtual void transformOutput(ProtoMessage &input, ProtoMessage &output) {
+        output = this->transformOutput(input);
+    }
+
+    // Routers answer with the index of the child to send the request to,
+    // as a 1x1 ndarray or tensor
+    virtual ProtoMessage route(ProtoMessage &data) {
+        throw NotImplementedError("Route not defined");
+    }
+
+    virtual void route(ProtoMessage &input, ProtoMessage &output) {
+        output = this->route(input);
+    }
+
+    // Lazy variants of predict, the transformers and the router, used
+    // instead of the overloads above once enableLazyDecoding() is called.
+    // The request's status and meta are decoded, but its payload only once
+    // it's read through message(), and a transformer that leaves it alone
+    // sends it back as it came. Wire-format binData, strData and
+    // tensor_content can be read in place through the LazyMessage views.
+    // They default to decoding the whole request and calling the overloads
+    // above, through the cache and batcher for predictions.
+    virtual void predict(LazyMessage &input, ProtoMessage &output) {
+        this->runPredict(detail::decoded<ProtoMessage>(input), output);
+    }
+
+    virtual void transformInput(LazyMessage &message) {
+        ProtoMessage &input = detail::decoded<ProtoMessage>(message);
+        RequestArena::Scope scope;
+        ProtoMessage *output = newMessage(scope.arena());
+        this->transformInput(input, *output);
+        input.Swap(output);
+    }
+
+    virtual void transformOutput(LazyMessage &message) {
+        ProtoMessage &input = detail::decoded<ProtoMessage>(message);
+        RequestArena::Scope scope;
+        ProtoMessage *output = newMessage(scope.arena());
+        this->transformOutput(input, *output);
+        input.Swap(output);
+    }
+
+    virtual void route(LazyMessage &input, ProtoMessage &output) {
+        this->route(detail::decoded<ProtoMessage>(input), output);
+    }
+
+    // Combiners merge the outputs of their children
+    virtual ProtoMessage aggregate(protos::SeldonMessageList &data) {
+        throw NotImplementedError("Aggregate not defined");
+    }
+
+    virtual void aggregate(protos::SeldonMessageList &input, ProtoMessage &output) {
+        output = this->aggregate(input);
+    }
+
+    // Opts in to merging concurrent predictions into batches along
+    // dimension 0, see seldon/Batcher.hpp. Call it from the model's
+    // constructor; requests that can't be batched go straight to predict.
+    // The native servers then hand predictions to predictAsync, so their
+    // threads don't wait for a batch to fill up.
+    void enableBatching(BatchOptions options = BatchOptions::fromEnvironment()) {
+        this->mBatchOptions = options;
+        this->mBatcher.reset(new Batcher(
+            [this](ProtoMessage &input, ProtoMessage &output) {
+                this->predict(input, output);
+            },
+            options));
+    }
+
+    // Answers JSON requests that send an ndarray with an ndarray, like the
+    // Python wrapper does, when the model returns a tensor or tftensor. The
+    // ndarray text is written straight from the dense values, which is far
+    // cheaper than building it as a ListValue in the model.
+    void enableNdarrayResponses() {
+        this->mNdarrayResponses = true;
+    }
+
+    // Decodes predict, transform and route requests as a LazyMessage, see
+    // seldon/LazyMessage.hpp, and runs them through the overloads that
+    // take one. Call it from the constructor of routers and transformers
+    // that only look at meta, so large payloads are neither decoded nor
+    // encoded again, and of models that read wire-format blobs in place.
+    // Asynchronous predictions still take the whole message.
+    void enableLazyDecoding() {
+        this->mLazyDecoding = true;
+    }
+
+    // Sets how JSON responses are written, e.g. with fewer digits for
+    // float32 values, see seldon/JsonEncoder.hpp. Defaults to
+    // json::EncodeOptions::fromEnvironment().
+    void setEncodeOptions(const json::EncodeOptions &options) {
+        this->mEncodeOptions = options;
+    }
+
+    // Adds the time each request spent being decoded and in the model to
+    // its response's Meta.metrics, as seldon_cpp_decode_time and
+    // seldon_cpp_predict_time TIMER entries. The stages are always
+    // recorded in the seldon_cpp_*_seconds histograms.
+    void enableStageTimers() {
+        this->mStageTimers = true;
+    }
+
+    // Adds the custom metrics the model records through seldon::metrics
+    // while handling a request to its response's Meta.metrics, so the
+    // Python wrapper and the rest of the graph see them without the model
+    // building them itself. Only metrics recorded on the request's thread
+    // are collected, so not those of batched or asynchronous predictions.
+    void enableMetricsInResponse() {
+        this->mMetricsInResponse = true;
+    }
+
+    // Serves repeated predictions from a PredictionCache, for models whose
+    // output only depends on the request's data, binData, strData or
+    // jsonData. Requests with the exact bytes of a cached one are answered
+    // without being decoded; others are looked up by their canonical
+    // payload once decoded, so a new puid or other meta still hits. Call
+    // it from the model's constructor.
+    void enableCache(CacheOptions options = CacheOptions::fromEnvironment()) {
+        this->mCache.reset(new PredictionCache(options));
+    }
+
+    // Routes predictions from the native servers through predictAsync, so
+    // a server thread can keep many requests in flight. Call it from the
+    // constructor of models that override predictAsync.
+    void enableAsyncPredict() {
+        this->mAsyncPredict = true;
+    }
+
+    // Handles feedback on an earlier prediction. Like the Python wrapper,
+    // models that don't override it accept feedback with an empty response.
+    virtual ProtoMessage sendFeedback(protos::Feedback &feedback) {
+        return ProtoMessage();
+    }
+
+    virtual void sendFeedback(protos::Feedback &feedback, ProtoMessage &output) {
+        output = this->sendFeedback(feedback);
+    }
+
+    // Served on the Metadata rpc and /metadata. Defaults to the JSON
+    // metadata in the MODEL_METADATA environment variable, if any.
+    virtual protos::SeldonModelMetadata metadata() {
+        protos::SeldonModelMetadata result;
+        const char *environment = std::getenv("MODEL_METADATA");
+        if (environment != nullptr &&
+            !google::protobuf::util::JsonStringToMessage(environment, &result).ok()) {
+            SELDON_LOG_WARNING("Ignoring MODEL_METADATA, only JSON metadata is supported");
+            result.Clear();
+        }
+        return result;
+    }
+
+    void handleBuffer(Method method, const char *data, size_t size,
+                      PayloadFormat format, std::string &out) override {
+
+        if (method == Method::Metadata) {
+            encodeMessage(this->metadata(), format, out);
+            return;
+        }
+
+        bool cached = method == Method::Predict && this->mCache;
+        if (cached && this->getCached(PredictionCache::requestKind(format), data, size, out)) {
+            return;
+        }
+
+        if (this->mLazyDecoding && detail::lazyMethod(method)) {
+            this->handleLazy(method, data, size, format, cached, out);
+            return;
+        }
+
+        RequestArena::Scope scope;
+        StageTimer timer(method);
+        bool ndarrayRequest = false;
+        int requestMetrics = 0;
+        ProtoMessage *output = this->handleMessage(method, data, size, format, scope.arena(),
+                                                   timer, ndarrayRequest, requestMetrics);
+        SELDON_LOG_DEBUG("Handled " << methodName(method) << " request of " << size << " bytes");
+        this->encodeOutput(*output, format, ndarrayRequest, out);
+        timer.lap(Stage::Encode);
+
+        if (cached) {
+            this->putCached(data, size, format, ndarrayRequest, *output, requestMetrics, out);
+        }
+    }
+
+    void handleBufferAsync(Method method, const char *data, size_t size, PayloadFormat format,
+                           Completion done) override {
+
+        if (method != Method::Predict ||
+            !(this->mAsyncPredict || this->mTaskPredict || this->mBatcher)) {
+            RawModel::handleBufferAsync(method, data, size, format, std::move(done));
+            return;
+        }
+
+        thread_local std::string out;
+        if (this->mCache && this->getCached(PredictionCache::requestKind(format), data, size, out)) {
+            done(nullptr, out);
+            return;
+        }
+
+        // The request outlives this call, so it's decoded onto the heap
+        // rather than the per-thread arena
+        StageTimer timer(method);
+        ProtoMessage input;
+        try {
+            decodeMessage(data, size, format, input);
+        } catch (...) {
+            std::string out;
+            done(std::current_exception(), out);
+            return;
+        }
+        bool ndarrayRequest = detail::hasNdarray(input);
+        timer.lap(Stage::Decode);
+
+        std::string request;
+        std::string key;
+        bool cacheable = this->mCache && detail::cacheKey(input, key);
+        ProtoMessage cached;
+        bool hit = cacheable && this->getCached(key, input, cached);
+        if (this->mCache) {
+            request.assign(data, size);
+        }
+
+        Callback encode = [this, format, ndarrayRequest, done, request, key, timer,
+                           store = cacheable && !hit](std::exception_ptr error,
+                                                      ProtoMessage &output) mutable {
+            thread_local std::string out;
+            timer.lap(Stage::Predict);
+            if (!error) {
+                try {
+                    if (store) {
+                        this->mCache->put(PredictionCache::Kind::Message, key.data(), key.size(),
+                                          output.SerializeAsString());
+                    }
+                    int requestMetrics = detail::metricCount(output);
+                    if (this->mStageTimers) {
+                        detail::addStageTimers(timer, output);
+                    }
+                    this->encodeOutput(output, format, ndarrayRequest, out);
+                    timer.lap(Stage::Encode);
+                    if (this->mCache) {
+                        this->putCached(request.data(), request.size(), format, ndarrayRequest,
+                                        output, requestMetrics, out);
+                    }
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            done(error, out);
+        };
+        if (hit) {
+            encode(nullptr, cached);
+            return;
+        }
+        try {
+#if SELDON_WITH_COROUTINES
+            if (this->mTaskPredict) {
+                start(this->predictTask(std::move(input)), std::move(encode));
+                return;
+            }
+#endif
+            this->predictAsync(std::move(input), std::move(encode));
+        } catch (...) {
+            // Only reached if the prediction threw before taking the callback
+            std::string out;
+            done(std::current_exception(), out);
+        }
+    }
 
+#if SELDON_WITH_PYTHON
     virtual py::bytes predictRaw(py::bytes &data) {
+        return this->handleRaw(Method::Predict, data);
+    }
+
+    virtual py::bytes predictRawProto(py::bytes &data) {
+        if (this->mCache) {
+            // Cached responses are already serialized
+            return this->handleRaw(Method::Predict, data, PayloadFormat::Proto);
+        }
+        return this->handleRawProto(Method::Predict, data);
+    }
+
+    // Calls callback(response, None) with the JSON response bytes, or
+    // callback(None, message) on failure, from whichever thread completes
+    // the prediction. Returns as soon as the request has been decoded.
+    virtual void predictRawAsync(py::bytes &data, py::function callback) {
 
         py::buffer_info info(py::buffer(data).request());
         const char *charData = reinterpret_cast<const char *>(info.ptr);
         size_t charLength = static_cast<size_t>(info.size);
 
-        std::string strData(charData, charLength);
-        std::cout << "starting function with str: " << strData << std::endl;
+        // Only copied and destroyed with the GIL held
+        auto *function = new py::function(std::move(callback));
+        py::gil_scoped_release release;
+        this->handleBufferAsync(
+            Method::Predict, charData, charLength, PayloadFormat::Json,
+            [function](std::exception_ptr error, std::string &out) {
+                py::gil_scoped_acquire acquire;
+                std::unique_ptr<py::function> owned(function);
+                try {
+                    if (!error) {
+                        (*owned)(py::bytes(out.data(), out.size()), py::none());
+                        return;
+                    }
+                    try {
+                        std::rethrow_exception(error);
+                    } catch (const std::exception &e) {
+                        (*owned)(py::none(), py::str(e.what()));
+                    }
+                } catch (py::error_already_set &e) {
+                    // Nothing can catch it on this thread
+                    e.restore();
+                    PyErr_WriteUnraisable(owned->ptr());
+                }
+            });
+    }
 
-        ProtoMessage input;
-        google::protobuf::util::JsonStringToMessage(strData, &input);
-        std::cout << "Converted to jsonmessage" << std::endl;
+    virtual py::bytes transformInputRaw(py::bytes &data) {
+        return this->handleRaw(Method::TransformInput, data);
+    }
+
+    virtual py::bytes transformInputRawProto(py::bytes &data) {
+        return this->handleRawProto(Method::TransformInput, data);
+    }
+
+    virtual py::bytes transformOutputRaw(py::bytes &data) {
+        return this->handleRaw(Method::TransformOutput, data);
+    }
+
+    virtual py::bytes transformOutputRawProto(py::bytes &data) {
+        return this->handleRawProto(Method::TransformOutput, data);
+    }
+
+    virtual py::bytes routeRaw(py::bytes &data) {
+        return this->handleRaw(Method::Route, data);
+    }
+
+    virtual py::bytes routeRawProto(py::bytes &data) {
+        return this->handleRawProto(Method::Route, data);
+    }
+
+    virtual py::bytes aggregateRaw(py::bytes &data) {
+        return this->handleRaw(Method::Aggregate, data);
+    }
 
-        ProtoMessage output = this->predict(input);
+    virtual py::bytes aggregateRawProto(py::bytes &data) {
+        return this->handleRawProto(Method::Aggregate, data);
+    }
+
+    virtual py::bytes sendFeedbackRaw(py::bytes &data) {
+        return this->handleRaw(Method::SendFeedback, data);
+    }
+
+    virtual py::bytes sendFeedbackRawProto(py::bytes &data) {
+        return this->handleRawProto(Method::SendFeedback, data);
+    }
+#endif
+
+protected:
+    // Parses a request for method and runs it. The output is owned by
+    // arena, so the caller can serialize it straight into its own buffer.
+    // ndarrayRequest is set when the request data is an ndarray, and
+    // requestMetrics to the index of the first metric added for this
+    // request alone.
+    ProtoMessage *handleMessage(Method method, const char *data, size_t size,
+                                PayloadFormat format, google::protobuf::Arena &arena,
+                                StageTimer &timer, bool &ndarrayRequest, int &requestMetrics) {
+
+        ProtoMessage *output = newMessage(arena);
+        metrics::Capture capture(this->mMetricsInResponse);
+
+        if (method == Method::Aggregate) {
+            auto *input = google::protobuf::Arena::CreateMessage<protos::SeldonMessageList>(&arena);
+            decodeMessage(data, size, format, *input);
+            ndarrayRequest = detail::hasNdarray(*input);
+            timer.lap(Stage::Decode);
+            this->aggregate(*input, *output);
+            requestMetrics = this->finishPredict(timer, capture, *output);
+            return output;
+        }
+
+        if (method == Method::SendFeedback) {
+            auto *feedback = google::protobuf::Arena::CreateMessage<protos::Feedback>(&arena);
+            decodeMessage(data, size, format, *feedback);
+            timer.lap(Stage::Decode);
+            this->sendFeedback(*feedback, *output);
+            requestMetrics = this->finishPredict(timer, capture, *output);
+            return output;
+        }
+
+        ProtoMessage *input = newMessage(arena);
+        decodeMessage(data, size, format, *input);
+        ndarrayRequest = detail::hasNdarray(*input);
+        timer.lap(Stage::Decode);
+
+        switch (method) {
+        case Method::Predict:
+            this->runPredict(*input, *output);
+            break;
+        case Method::TransformInput:
+            this->transformInput(*input, *output);
+            break;
+        case Method::TransformOutput:
+            this->transformOutput(*input, *output);
+            break;
+        case Method::Route:
+            this->route(*input, *output);
+            break;
+        default:
+            throw NotImplementedError(std::string("Unsupported method ") + methodName(method));
+        }
+        requestMetrics = this->finishPredict(timer, capture, *output);
+        return output;
+    }
+
+    // Runs a predict, transform or route request on a LazyMessage, caching
+    // the response when cached is set
+    void handleLazy(Method method, const char *data, size_t size, PayloadFormat format,
+                    bool cached, std::string &out) {
+
+        RequestArena::Scope scope;
+        StageTimer timer(method);
+        metrics::Capture capture(this->mMetricsInResponse);
+        LazyMessage input(&scope.arena());
+        input.parse(data, size, format);
+        bool ndarrayRequest = this->mNdarrayResponses && format == PayloadFormat::Json &&
+                              input.hasNdarray();
+        timer.lap(Stage::Decode);
+
+        if (method == Method::Predict || method == Method::Route) {
+            ProtoMessage *output = newMessage(scope.arena());
+            if (method == Method::Predict) {
+                this->predict(input, *output);
+            } else {
+                this->route(input, *output);
+            }
+            int requestMetrics = this->finishPredict(timer, capture, *output);
+            this->encodeOutput(*output, format, ndarrayRequest, out);
+            if (cached) {
+                this->putCached(data, size, format, ndarrayRequest, *output, requestMetrics, out);
+            }
+        } else {
+            if (method == Method::TransformInput) {
+                this->transformInput(input);
+            } else {
+                this->transformOutput(input);
+            }
+            this->finishPredict(timer, capture, input);
+            this->encodeOutput(input, format, ndarrayRequest, out);
+        }
+        SELDON_LOG_DEBUG("Handled " << methodName(method) << " request of " << size
+                         << " bytes, payload " << (input.verbatim() ? "verbatim" : "encoded"));
+        timer.lap(Stage::Encode);
+    }
+
+    // Adds the stage timers and custom metrics of a request to its output,
+    // and returns the index of the first one
+    template <typename Output>
+    int finishPredict(StageTimer &timer, const metrics::Capture &capture, Output &output) {
+        timer.lap(Stage::Predict);
+        int requestMetrics = detail::metricCount(output);
+        if (this->mStageTimers) {
+            detail::addStageTimers(timer, output);
+        }
+        detail::addCustomMetrics(capture, output);
+        return requestMetrics;
+    }
+
+#if SELDON_WITH_PYTHON
+    // Runs a JSON request with the GIL released
+    py::bytes handleRaw(Method method, py::bytes &data,
+                        PayloadFormat format = PayloadFormat::Json) {
+
+        // The bytes object is immutable and kept alive by the caller, so
+        // its buffer can be parsed in place once the GIL is released
+        py::buffer_info info(py::buffer(data).request());
+        const char *charData = reinterpret_cast<const char *>(info.ptr);
+        size_t charLength = static_cast<size_t>(info.size);
+
+        thread_local std::string outString;
+        {
+            // Everything past this point is plain C++, so other Python
+            // threads can run while we parse, run and serialize
+            py::gil_scoped_release release;
+            this->handleBuffer(method, charData, charLength, format, outString);
+        }
+
+        return py::bytes(outString.data(), outString.size());
+    }
+
+    // Runs a wire-format request, serializing the output straight into the
+    // returned bytes object
+    py::bytes handleRawProto(Method method, py::bytes &data) {
 
-        std::cout << "Converting output" << std::endl;
+        if (this->mLazyDecoding && detail::lazyMethod(method)) {
+            // The request is viewed in place, and a verbatim payload is
+            // copied rather than serialized
+            return this->handleRaw(method, data, PayloadFormat::Proto);
+        }
 
-        std::string outString;
-        google::protobuf::util::MessageToJsonString(output, &outString);
+        py::buffer_info info(py::buffer(data).request());
+        const char *charData = reinterpret_cast<const char *>(info.ptr);
+        size_t charLength = static_cast<size_t>(info.size);
+
+        // Keeps the arena alive until the response has been serialized
+        RequestArena::Scope scope;
+        StageTimer timer(method);
+        ProtoMessage *output;
+        size_t outLength;
+        {
+            py::gil_scoped_release release;
+            bool ndarrayRequest = false;
+            int requestMetrics = 0;
+            output = this->handleMessage(method, charData, charLength, PayloadFormat::Proto,
+                                         scope.arena(), timer, ndarrayRequest, requestMetrics);
+            outLength = output->ByteSizeLong();
+        }
+
+        py::bytes result = detail::serializeToBytes(*output, outLength);
+        timer.lap(Stage::Encode);
+        return result;
+    }
+#endif
+
+    json::EncodeOptions encodeOptions(bool ndarrayRequest) const {
+        json::EncodeOptions options = this->mEncodeOptions;
+        options.ndarray = ndarrayRequest && this->mNdarrayResponses;
+        return options;
+    }
+
+    void encodeOutput(const ProtoMessage &output, PayloadFormat format, bool ndarrayRequest,
+                      std::string &out) {
+        encodeMessage(output, format, this->encodeOptions(ndarrayRequest), out);
+        SELDON_LOG_DEBUG("Serialized response of " << out.size() << " bytes");
+    }
+
+    void encodeOutput(LazyMessage &output, PayloadFormat format, bool ndarrayRequest,
+                      std::string &out) {
+        output.encode(format, this->encodeOptions(ndarrayRequest), out);
+    }
+
+    // Caches out, the encoded output of a prediction, as the response to
+    // the request in data. When metrics were added for the request from
+    // requestMetrics on, output is encoded again without them for the
+    // cache, so hits don't report timings or custom metrics they didn't
+    // record.
+    template <typename Output>
+    void putCached(const char *data, size_t size, PayloadFormat format, bool ndarrayRequest,
+                   Output &output, int requestMetrics, const std::string &out) {
+        PredictionCache::Kind kind = PredictionCache::requestKind(format);
+        if (detail::metricCount(output) == requestMetrics) {
+            this->mCache->put(kind, data, size, out);
+            return;
+        }
+        detail::removeMetrics(output, requestMetrics);
+        std::string cached;
+        this->encodeOutput(output, format, ndarrayRequest, cached);
+        this->mCache->put(kind, data, size, std::move(cached));
+    }
 
-        std::cout << "Returning output" << std::endl;
-        return outString;
+    void runPredict(ProtoMessage &input, ProtoMessage &output) {
+        thread_local std::string key;
+        bool cacheable = this->mCache && detail::cacheKey(input, key);
+        if (cacheable && this->getCached(key, input, output)) {
+            return;
+        }
+        this->runUncached(input, output);
+        if (cacheable) {
+            this->mCache->put(PredictionCache::Kind::Message, key.data(), key.size(),
+                              output.SerializeAsString());
+        }
     }
 
+    void runUncached(ProtoMessage &input, ProtoMessage &output) {
+        if (this->mBatcher) {
+            this->mBatcher->predict(input, output);
+        } else {
+            this->predict(input, output);
+        }
+    }
+
+    bool getCached(PredictionCache::Kind kind, const char *data, size_t size, std::string &out) {
+        std::shared_ptr<const std::string> cached = this->mCache->get(kind, data, size);
+        if (!cached) {
+            return false;
+        }
+        out = *cached;
+        return true;
+    }
+
+    bool getCached(const std::string &key, const ProtoMessage &input, ProtoMessage &output) {
+        std::shared_ptr<const std::string> cached =
+            this->mCache->get(PredictionCache::Kind::Message, key.data(), key.size());
+        if (!cached || !output.ParseFromString(*cached)) {
+            return false;
+        }
+        detail::restorePuid(input, output);
+        return true;
+    }
+
+    static ProtoMessage *newMessage(google::protobuf::Arena &arena) {
+        return google::protobuf::Arena::CreateMessage<ProtoMessage>(&arena);
+    }
+
+private:
+    json::EncodeOptions mEncodeOptions = json::EncodeOptions::fromEnvironment();
+    bool mNdarrayResponses = false;
+    bool mLazyDecoding = false;
+    bool mAsyncPredict = false;
+    bool mTaskPredict = false;
+    bool mStageTimers = false;
+    bool mMetricsInResponse = false;
+    BatchOptions mBatchOptions;
+    std::unique_ptr<Batcher> mBatcher;
+    std::unique_ptr<PredictionCache> mCache;
 };
 
 using SeldonModelBase = SeldonModel<protos::SeldonMessage>;
 
+#if SELDON_WITH_PYTHON
 #define SELDON_BIND_MODULE(PACKAGE, CLASS)  \
     PYBIND11_MODULE(PACKAGE, m)                       \
     {                                                 \
+    seldon::detail::registerExceptions();             \
     py::class_<CLASS>(m, #CLASS)                      \
         .def(py::init())                              \
-        .def("predict_raw", &CLASS::predictRaw); \
+        .def("predict_raw", &CLASS::predictRaw)        \
+        .def("predict_raw_proto", &CLASS::predictRawProto) \
+        .def("predict_raw_async", &CLASS::predictRawAsync) \
+        .def("transform_input_raw", &CLASS::transformInputRaw) \
+        .def("transform_input_raw_proto", &CLASS::transformInputRawProto) \
+        .def("transform_output_raw", &CLASS::transformOutputRaw) \
+        .def("transform_output_raw_proto", &CLASS::transformOutputRawProto) \
+        .def("route_raw", &CLASS::routeRaw)            \
+        .def("route_raw_proto", &CLASS::routeRawProto) \
+        .def("aggregate_raw", &CLASS::aggregateRaw)    \
+        .def("aggregate_raw_proto", &CLASS::aggregateRawProto) \
+        .def("send_feedback_raw", &CLASS::sendFeedbackRaw) \
+        .def("send_feedback_raw_proto", &CLASS::sendFeedbackRawProto); \
+    }
+#elif defined(SELDON_LOADGEN)
+// Built as the model's seldon-loadgen instead, see seldon/LoadGen.hpp
+#define SELDON_BIND_MODULE(PACKAGE, CLASS)  \
+    SELDON_LOADGEN_MAIN(CLASS)
+#else
+#define SELDON_BIND_MODULE(PACKAGE, CLASS)  \
+    int main()                                        \
+    {                                                 \
+        CLASS model;                                  \
+        return seldon::serve(model);                  \
     }
+#endif
 
 #define SELDON_DEFAULT_BIND_MODULE()           \
     SELDON_BIND_MODULE(SeldonPackage, ModelClass)
 
 
 }
-
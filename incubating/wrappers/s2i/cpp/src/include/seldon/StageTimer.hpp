@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "seldon/RawModel.hpp"
+
+namespace seldon {
+
+// Stages a request goes through in SeldonModel. Predict covers whichever
+// method the request is for.
+enum class Stage {
+    Decode,
+    Predict,
+    Encode,
+};
+
+// Times the stages of one request on the monotonic clock, recording each
+// into the seldon_cpp_decode_seconds, seldon_cpp_predict_seconds or
+// seldon_cpp_encode_seconds HdrHistogram of the global registry, labelled
+// with the method
+class StageTimer
+{
+public:
+    explicit StageTimer(Method method)
+        : mMethod(method), mLast(std::chrono::steady_clock::now()) { }
+
+    // Records the time since the previous lap, or since the timer was
+    // created, against stage
+    void lap(Stage stage);
+
+    double milliseconds(Stage stage) const {
+        return static_cast<double>(this->mNanos[static_cast<int>(stage)]) / 1e6;
+    }
+
+private:
+    Method mMethod;
+    std::chrono::steady_clock::time_point mLast;
+    uint64_t mNanos[3] = {0, 0, 0};
+};
+
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+// Coroutine support is only available when building with C++20, see
+// SELDON_OPT_CXX20. Set SELDON_WITH_COROUTINES=0 to leave it out anyway.
+#ifndef SELDON_WITH_COROUTINES
+#if defined(__cpp_impl_coroutine)
+#define SELDON_WITH_COROUTINES 1
+#else
+#define SELDON_WITH_COROUTINES 0
+#endif
+#endif
+
+#if SELDON_WITH_COROUTINES
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "seldon/ThreadPool.hpp"
+
+namespace seldon {
+
+// Lazily started coroutine producing a T. A Task runs when it is awaited,
+// or when handed to start() or spawn(), and resumes whoever awaited it
+// once it returns, on the thread it finished on. Each Task can be
+// awaited once.
+//
+//   seldon::Task<SeldonMessage> predictTask(SeldonMessage input) override {
+//       co_await seldon::schedule(this->mPool);
+//       SeldonMessage features = co_await this->lookup(input);
+//       co_return this->score(features);
+//   }
+template <typename T>
+class Task
+{
+public:
+    class promise_type
+    {
+    public:
+        Task get_return_object() noexcept {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        // Hands the thread straight to the awaiting coroutine, so long
+        // chains of tasks finishing inline don't grow the stack
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(
+                std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().mContinuation;
+            }
+
+            void await_resume() noexcept { }
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        template <typename U>
+        void return_value(U &&value) {
+            this->mValue.emplace(std::forward<U>(value));
+        }
+
+        void unhandled_exception() noexcept {
+            this->mError = std::current_exception();
+        }
+
+    private:
+        friend class Task;
+
+        std::coroutine_handle<> mContinuation = std::noop_coroutine();
+        std::optional<T> mValue;
+        std::exception_ptr mError;
+    };
+
+    Task(Task &&other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) { }
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (this->mHandle) {
+                this->mHandle.destroy();
+            }
+            this->mHandle = std::exchange(other.mHandle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        if (this->mHandle) {
+            this->mHandle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        this->mHandle.promise().mContinuation = awaiting;
+        return this->mHandle;
+    }
+
+    T await_resume() {
+        promise_type &promise = this->mHandle.promise();
+        if (promise.mError) {
+            std::rethrow_exception(promise.mError);
+        }
+        return std::move(*promise.mValue);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : mHandle(handle) { }
+
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+namespace detail {
+
+class ScheduleAwaiter
+{
+public:
+    explicit ScheduleAwaiter(ThreadPool &pool) : mPool(pool) { }
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        this->mPool.post([handle]() { handle.resume(); });
+    }
+
+    void await_resume() const noexcept { }
+
+private:
+    ThreadPool &mPool;
+};
+
+template <typename T>
+class CallbackAwaiter
+{
+public:
+    using Callback = std::function<void(std::exception_ptr error, T &value)>;
+
+    explicit CallbackAwaiter(std::function<void(Callback)> begin) : mBegin(std::move(begin)) { }
+
+    bool await_ready() const noexcept { return false; }
+
+    // Whichever of the callback and this call finishes second resumes the
+    // coroutine, so a callback made inline doesn't resume it recursively
+    bool await_suspend(std::coroutine_handle<> handle) {
+        this->mBegin([this, handle](std::exception_ptr error, T &value) {
+            this->mError = error;
+            if (!error) {
+                this->mValue.emplace(std::move(value));
+            }
+            if (this->mCompleted.exchange(true)) {
+                handle.resume();
+            }
+        });
+        return !this->mCompleted.exchange(true);
+    }
+
+    T await_resume() {
+        if (this->mError) {
+            std::rethrow_exception(this->mError);
+        }
+        return std::move(*this->mValue);
+    }
+
+private:
+    std::function<void(Callback)> mBegin;
+    std::atomic<bool> mCompleted{false};
+    std::optional<T> mValue;
+    std::exception_ptr mError;
+};
+
+// Coroutine that starts eagerly and frees itself when it returns
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept { }
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+template <typename T>
+Detached run(ThreadPool *pool, Task<T> task,
+             std::function<void(std::exception_ptr error, T &value)> done) {
+    if (pool != nullptr) {
+        co_await ScheduleAwaiter(*pool);
+    }
+    std::optional<T> value;
+    std::exception_ptr error;
+    try {
+        value.emplace(co_await task);
+    } catch (...) {
+        error = std::current_exception();
+        value.emplace();
+    }
+    done(error, *value);
+}
+
+}
+
+// Resumes the awaiting coroutine on one of pool's threads
+inline detail::ScheduleAwaiter schedule(ThreadPool &pool) {
+    return detail::ScheduleAwaiter(pool);
+}
+
+// Adapts a callback based API, such as SeldonModel::predictAsync, to
+// co_await. begin is called with the callback to pass on, which must be
+// called exactly once; the coroutine resumes on the thread that calls it.
+template <typename T>
+detail::CallbackAwaiter<T> awaitCallback(
+    std::function<void(std::function<void(std::exception_ptr, T &)>)> begin) {
+    return detail::CallbackAwaiter<T>(std::move(begin));
+}
+
+// Runs task on the calling thread until it first suspends, then calls done
+// with its result, or the exception it failed with, on the thread it
+// finishes on. done must not throw.
+template <typename T>
+void start(Task<T> task,
+           std::type_identity_t<std::function<void(std::exception_ptr error, T &value)>> done) {
+    detail::run(nullptr, std::move(task), std::move(done));
+}
+
+// Like start, but runs task on pool
+template <typename T>
+void spawn(ThreadPool &pool, Task<T> task,
+           std::type_identity_t<std::function<void(std::exception_ptr error, T &value)>> done) {
+    detail::run(&pool, std::move(task), std::move(done));
+}
+
+// Blocks the calling thread until task finishes, for tests and for calling
+// coroutines from synchronous code
+template <typename T>
+T syncWait(Task<T> task) {
+    std::promise<T> promise;
+    std::future<T> result = promise.get_future();
+    start(std::move(task), [&promise](std::exception_ptr error, T &value) {
+        if (error) {
+            promise.set_exception(error);
+        } else {
+            promise.set_value(std::move(value));
+        }
+    });
+    return result.get();
+}
+
+}
+
+#endif
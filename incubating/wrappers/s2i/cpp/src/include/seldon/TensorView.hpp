@@ -0,0 +1,399 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <google/protobuf/stubs/stringpiece.h>
+
+#include "prediction.pb.h"
+#include "seldon/Environment.hpp"
+#include "seldon/Ndarray.hpp"
+
+namespace seldon {
+
+// Element types a tftensor can hold in tensor_content, and the field that
+// carries them as typed values
+template <typename T>
+struct TensorTraits;
+
+#define SELDON_TENSOR_TRAITS(TYPE, DTYPE)                                 \
+    template <>                                                           \
+    struct TensorTraits<TYPE>                                             \
+    {                                                                     \
+        static constexpr tensorflow::DataType dtype = tensorflow::DTYPE;  \
+    };
+
+SELDON_TENSOR_TRAITS(float, DT_FLOAT)
+SELDON_TENSOR_TRAITS(double, DT_DOUBLE)
+SELDON_TENSOR_TRAITS(int8_t, DT_INT8)
+SELDON_TENSOR_TRAITS(int16_t, DT_INT16)
+SELDON_TENSOR_TRAITS(int32_t, DT_INT32)
+SELDON_TENSOR_TRAITS(int64_t, DT_INT64)
+SELDON_TENSOR_TRAITS(uint8_t, DT_UINT8)
+SELDON_TENSOR_TRAITS(uint16_t, DT_UINT16)
+SELDON_TENSOR_TRAITS(uint32_t, DT_UINT32)
+SELDON_TENSOR_TRAITS(uint64_t, DT_UINT64)
+SELDON_TENSOR_TRAITS(bool, DT_BOOL)
+
+#undef SELDON_TENSOR_TRAITS
+
+namespace detail {
+
+// Throws std::invalid_argument for a negative dimension, or for a shape
+// with more elements than an int64_t counts
+inline int64_t elementCount(const std::vector<int64_t> &shape) {
+    int64_t count = 1;
+    for (int64_t dim : shape) {
+        if (dim < 0) {
+            throw std::invalid_argument("Tensor has a negative dimension " + std::to_string(dim));
+        }
+        if (dim > 0 && count > std::numeric_limits<int64_t>::max() / dim) {
+            throw std::invalid_argument("Tensor shape holds too many elements");
+        }
+        count *= dim;
+    }
+    return count;
+}
+
+// Most elements a tftensor's single typed value is repeated to fill, set
+// by SELDON_CPP_MAX_BROADCAST_ELEMENTS. A request of a few bytes can
+// otherwise ask for a view of any size.
+inline int64_t maxBroadcastElements() {
+    static const int64_t max = envInt("SELDON_CPP_MAX_BROADCAST_ELEMENTS", 1 << 20);
+    return max;
+}
+
+// ndarray::flatten writes the common types directly, the rest go through
+// doubles
+template <typename T>
+void flattenNdarray(const google::protobuf::ListValue &ndarray, std::vector<int64_t> &shape,
+                    std::vector<T> &values) {
+    std::vector<double> numbers;
+    ndarray::flatten(ndarray, shape, numbers);
+    values.resize(numbers.size());
+    ndarray::convert(numbers.data(), numbers.size(), values.data());
+}
+
+#define SELDON_FLATTEN_NDARRAY(TYPE)                                                          \
+    inline void flattenNdarray(const google::protobuf::ListValue &ndarray,                    \
+                               std::vector<int64_t> &shape, std::vector<TYPE> &values) {      \
+        ndarray::flatten(ndarray, shape, values);                                             \
+    }
+
+SELDON_FLATTEN_NDARRAY(double)
+SELDON_FLATTEN_NDARRAY(float)
+SELDON_FLATTEN_NDARRAY(int32_t)
+SELDON_FLATTEN_NDARRAY(int64_t)
+
+#undef SELDON_FLATTEN_NDARRAY
+
+}
+
+// Read-only, row-major view of the tensor held by a DefaultData. Views
+// point straight into the message where its storage already holds T
+// (Tensor.values as double, tensor_content or a typed *_val field of the
+// matching dtype), so the message must outlive them. Other payloads,
+// including ndarray, are converted into storage owned by the view.
+template <typename T>
+class TensorView
+{
+    static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                  "TensorView holds numbers, view bool tensors as uint8_t");
+
+public:
+    TensorView() { }
+
+    // Throws std::invalid_argument if data holds no tensor, or one that
+    // can't be converted to T
+    explicit TensorView(const protos::DefaultData &data) {
+        if (data.has_tensor()) {
+            this->fromTensor(data.tensor());
+        } else if (data.has_tftensor()) {
+            this->fromTfTensor(data.tftensor(), data.tftensor().tensor_content());
+        } else if (data.has_ndarray()) {
+            detail::flattenNdarray(data.ndarray(), this->mShape, this->mStorage);
+            this->mData = this->mStorage.data();
+            this->mSize = this->mStorage.size();
+        } else {
+            throw std::invalid_argument("Message data holds no tensor");
+        }
+        this->computeStrides();
+    }
+
+    explicit TensorView(const protos::SeldonMessage &message) : TensorView(message.data()) { }
+
+    // Views a tftensor whose tensor_content is held apart from it, such as
+    // one from LazyMessage::tftensorView, pointing into content when it
+    // holds T
+    TensorView(const tensorflow::TensorProto &tensor, google::protobuf::StringPiece content) {
+        this->fromTfTensor(tensor, content);
+        this->computeStrides();
+    }
+
+    TensorView(const TensorView &other) { *this = other; }
+
+    TensorView &operator=(const TensorView &other) {
+        this->mShape = other.mShape;
+        this->mStrides = other.mStrides;
+        this->mStorage = other.mStorage;
+        this->mSize = other.mSize;
+        this->mData = other.owning() ? this->mStorage.data() : other.mData;
+        return *this;
+    }
+
+    // Moving a vector keeps its buffer, so mData stays valid
+    TensorView(TensorView &&other) = default;
+    TensorView &operator=(TensorView &&other) = default;
+
+    const T *data() const { return this->mData; }
+    size_t size() const { return this->mSize; }
+    const T *begin() const { return this->mData; }
+    const T *end() const { return this->mData + this->mSize; }
+    const T &operator[](size_t index) const { return this->mData[index]; }
+
+    const std::vector<int64_t> &shape() const { return this->mShape; }
+    // Strides in elements, in the same order as shape
+    const std::vector<int64_t> &strides() const { return this->mStrides; }
+    size_t rank() const { return this->mShape.size(); }
+
+    // Whether the values were copied out of the message
+    bool owning() const { return !this->mStorage.empty(); }
+
+private:
+    void fromTensor(const protos::Tensor &tensor) {
+        this->mShape.assign(tensor.shape().begin(), tensor.shape().end());
+        if (this->mShape.empty()) {
+            this->mShape.push_back(tensor.values_size());
+        }
+        this->checkSize(tensor.values_size());
+        this->wrap(tensor.values().data(), tensor.values_size());
+    }
+
+    void fromTfTensor(const tensorflow::TensorProto &tensor,
+                      google::protobuf::StringPiece content) {
+        for (const auto &dim : tensor.tensor_shape().dim()) {
+            this->mShape.push_back(dim.size());
+        }
+        int64_t count = detail::elementCount(this->mShape);
+
+        if (!content.empty()) {
+            this->fromContent(tensor.dtype(), content, count);
+            return;
+        }
+        switch (tensor.dtype()) {
+        case tensorflow::DT_FLOAT:
+            this->fromValues(tensor.float_val().data(), tensor.float_val_size(), count);
+            break;
+        case tensorflow::DT_DOUBLE:
+            this->fromValues(tensor.double_val().data(), tensor.double_val_size(), count);
+            break;
+        case tensorflow::DT_INT8:
+        case tensorflow::DT_INT16:
+        case tensorflow::DT_INT32:
+        case tensorflow::DT_UINT8:
+        case tensorflow::DT_UINT16:
+            this->fromValues(tensor.int_val().data(), tensor.int_val_size(), count);
+            break;
+        case tensorflow::DT_INT64:
+            this->fromValues(tensor.int64_val().data(), tensor.int64_val_size(), count);
+            break;
+        case tensorflow::DT_UINT32:
+            this->fromValues(tensor.uint32_val().data(), tensor.uint32_val_size(), count);
+            break;
+        case tensorflow::DT_UINT64:
+            this->fromValues(tensor.uint64_val().data(), tensor.uint64_val_size(), count);
+            break;
+        case tensorflow::DT_BOOL:
+            this->fromValues(tensor.bool_val().data(), tensor.bool_val_size(), count);
+            break;
+        default:
+            throw std::invalid_argument("Unsupported tftensor dtype " +
+                                        tensorflow::DataType_Name(tensor.dtype()));
+        }
+    }
+
+    void fromContent(tensorflow::DataType dtype, google::protobuf::StringPiece content,
+                     int64_t count) {
+        switch (dtype) {
+        case tensorflow::DT_FLOAT:
+            return this->fromBytes<float>(content, count);
+        case tensorflow::DT_DOUBLE:
+            return this->fromBytes<double>(content, count);
+        case tensorflow::DT_INT8:
+            return this->fromBytes<int8_t>(content, count);
+        case tensorflow::DT_INT16:
+            return this->fromBytes<int16_t>(content, count);
+        case tensorflow::DT_INT32:
+            return this->fromBytes<int32_t>(content, count);
+        case tensorflow::DT_INT64:
+            return this->fromBytes<int64_t>(content, count);
+        case tensorflow::DT_UINT8:
+            return this->fromBytes<uint8_t>(content, count);
+        case tensorflow::DT_UINT16:
+            return this->fromBytes<uint16_t>(content, count);
+        case tensorflow::DT_UINT32:
+            return this->fromBytes<uint32_t>(content, count);
+        case tensorflow::DT_UINT64:
+            return this->fromBytes<uint64_t>(content, count);
+        case tensorflow::DT_BOOL:
+            return this->fromBoolBytes(content, count);
+        default:
+            throw std::invalid_argument("Unsupported tftensor dtype " +
+                                        tensorflow::DataType_Name(dtype));
+        }
+    }
+
+    static void checkContent(google::protobuf::StringPiece content, int64_t count,
+                             size_t elementSize) {
+        // Dividing can't overflow where multiplying count could
+        if (content.size() % elementSize != 0 ||
+            content.size() / elementSize != static_cast<uint64_t>(count)) {
+            throw std::invalid_argument("tensor_content holds " + std::to_string(content.size()) +
+                                        " bytes for " + std::to_string(count) + " elements");
+        }
+    }
+
+    template <typename Source>
+    void fromBytes(google::protobuf::StringPiece content, int64_t count) {
+        checkContent(content, count, sizeof(Source));
+        const char *bytes = content.data();
+        if (reinterpret_cast<uintptr_t>(bytes) % alignof(Source) == 0) {
+            this->wrap(reinterpret_cast<const Source *>(bytes), count);
+            return;
+        }
+        this->mStorage.resize(static_cast<size_t>(count));
+        for (size_t i = 0; i < this->mStorage.size(); i++) {
+            Source value;
+            std::memcpy(&value, bytes + i * sizeof(Source), sizeof(Source));
+            this->mStorage[i] = ndarray::checkedCast<T>(value);
+        }
+        this->mData = this->mStorage.data();
+        this->mSize = this->mStorage.size();
+    }
+
+    // Any byte other than 0 is true, where reading it as a bool would be
+    // undefined for bytes other than 0 and 1
+    void fromBoolBytes(google::protobuf::StringPiece content, int64_t count) {
+        checkContent(content, count, 1);
+        this->mStorage.resize(static_cast<size_t>(count));
+        for (size_t i = 0; i < this->mStorage.size(); i++) {
+            this->mStorage[i] = static_cast<T>(static_cast<uint8_t>(content[i]) != 0);
+        }
+        this->mData = this->mStorage.data();
+        this->mSize = this->mStorage.size();
+    }
+
+    template <typename Source>
+    void fromValues(const Source *values, int size, int64_t count) {
+        if (size == count) {
+            this->wrap(values, count);
+        } else if (size == 1) {
+            // A single value is repeated to fill the shape
+            if (count > detail::maxBroadcastElements()) {
+                throw std::invalid_argument("tftensor repeats one value over " +
+                                            std::to_string(count) + " elements, more than " +
+                                            std::to_string(detail::maxBroadcastElements()));
+            }
+            this->mStorage.assign(static_cast<size_t>(count), ndarray::checkedCast<T>(values[0]));
+            this->mData = this->mStorage.data();
+            this->mSize = this->mStorage.size();
+        } else {
+            this->checkSize(size);
+        }
+    }
+
+    void checkSize(int64_t size) {
+        int64_t count = detail::elementCount(this->mShape);
+        if (size != count) {
+            throw std::invalid_argument("Tensor holds " + std::to_string(size) +
+                                        " values for " + std::to_string(count) + " elements");
+        }
+    }
+
+    // Points at values in place when they already hold T, copying otherwise
+    void wrap(const T *values, int64_t size) {
+        this->mData = values;
+        this->mSize = static_cast<size_t>(size);
+    }
+
+    template <typename Source>
+    void wrap(const Source *values, int64_t size) {
+        this->own(values, static_cast<size_t>(size));
+    }
+
+    template <typename Source>
+    void own(const Source *values, size_t size) {
+        this->mStorage.resize(size);
+        ndarray::convert(values, size, this->mStorage.data());
+        this->mData = this->mStorage.data();
+        this->mSize = size;
+    }
+
+    void computeStrides() {
+        this->mStrides.assign(this->mShape.size(), 1);
+        for (size_t i = this->mShape.size(); i > 1; i--) {
+            this->mStrides[i - 2] = this->mStrides[i - 1] * this->mShape[i - 1];
+        }
+    }
+
+    const T *mData = nullptr;
+    size_t mSize = 0;
+    std::vector<int64_t> mShape;
+    std::vector<int64_t> mStrides;
+    std::vector<T> mStorage;
+};
+
+// Writes an output tensor straight into its final field. The field is
+// sized once up front and data() points into it, so values are produced
+// in place rather than through an intermediate vector.
+template <typename T>
+class TensorBuilder
+{
+public:
+    // Builds into Tensor.values, which only holds doubles
+    static TensorBuilder tensor(protos::DefaultData &data, const std::vector<int64_t> &shape) {
+        static_assert(std::is_same<T, double>::value, "Tensor.values only holds doubles");
+        protos::Tensor *tensor = data.mutable_tensor();
+        tensor->clear_shape();
+        for (int64_t dim : shape) {
+            tensor->add_shape(static_cast<int32_t>(dim));
+        }
+        auto *values = tensor->mutable_values();
+        values->Resize(static_cast<int>(detail::elementCount(shape)), 0.0);
+        return TensorBuilder(values->mutable_data(), static_cast<size_t>(values->size()));
+    }
+
+    // Builds into TensorProto.tensor_content with the dtype of T
+    static TensorBuilder tftensor(protos::DefaultData &data, const std::vector<int64_t> &shape) {
+        tensorflow::TensorProto *tensor = data.mutable_tftensor();
+        tensor->Clear();
+        tensor->set_dtype(TensorTraits<T>::dtype);
+        for (int64_t dim : shape) {
+            tensor->mutable_tensor_shape()->add_dim()->set_size(dim);
+        }
+        size_t size = static_cast<size_t>(detail::elementCount(shape));
+        std::string *content = tensor->mutable_tensor_content();
+        content->resize(size * sizeof(T));
+        // Heap and inline string buffers are at least 8-byte aligned
+        return TensorBuilder(reinterpret_cast<T *>(&(*content)[0]), size);
+    }
+
+    T *data() { return this->mData; }
+    size_t size() const { return this->mSize; }
+    T *begin() { return this->mData; }
+    T *end() { return this->mData + this->mSize; }
+    T &operator[](size_t index) { return this->mData[index]; }
+
+private:
+    TensorBuilder(T *data, size_t size) : mData(data), mSize(size) { }
+
+    T *mData;
+    size_t mSize;
+};
+
+}
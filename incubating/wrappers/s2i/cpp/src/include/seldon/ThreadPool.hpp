@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace seldon {
+
+// Fixed set of worker threads for splitting CPU-bound work, such as the
+// reductions in seldon/Aggregate.hpp, across cores, and for running
+// posted work, such as coroutines resumed with seldon::schedule from
+// seldon/Task.hpp
+class ThreadPool
+{
+public:
+    // Runs on one thread per core when threads is 0 or less
+    explicit ThreadPool(int threads = 0);
+
+    // Runs the work already posted, then joins the threads
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Splits [0, size) into ranges of at least grain items and runs fn on
+    // each, on the pool and the calling thread. Blocks until every range is
+    // done and rethrows the first exception raised by fn, if any. Pool
+    // threads busy with other work are not waited for, as the calling
+    // thread runs whatever ranges they don't pick up. Called from within
+    // fn, it runs inline instead, so it can be nested.
+    void parallelFor(size_t size, size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+    // Runs work on a pool thread, in the order posted. Unlike ranges of
+    // parallelFor, work may block or call parallelFor itself.
+    void post(std::function<void()> work);
+
+    int threads() const { return static_cast<int>(this->mThreads.size()); }
+
+    // Shared pool sized by SELDON_CPP_POOL_THREADS, one thread per core
+    // by default
+    static ThreadPool &global();
+
+private:
+    void run();
+
+    std::mutex mMutex;
+    std::condition_variable mReady;
+    std::deque<std::function<void()>> mTasks;
+    bool mStopping = false;
+    std::vector<std::thread> mThreads;
+};
+
+}
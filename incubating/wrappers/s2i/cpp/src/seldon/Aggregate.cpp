@@ -0,0 +1,330 @@
+#include "seldon/Aggregate.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "seldon/TensorView.hpp"
+#include "seldon/ThreadPool.hpp"
+
+namespace seldon {
+namespace aggregate {
+
+namespace {
+
+// Output elements per range handed to the pool. Every range reads this
+// many values from each child, which keeps the output chunk in cache.
+constexpr size_t kGrain = 8192;
+
+// out[i] += weight * in[i]
+void accumulate(const double *in, double weight, size_t size, double *out) {
+    size_t i = 0;
+#if defined(__AVX__)
+    __m256d factor = _mm256_set1_pd(weight);
+    for (; i + 4 <= size; i += 4) {
+        __m256d sum = _mm256_add_pd(_mm256_loadu_pd(out + i),
+                                    _mm256_mul_pd(factor, _mm256_loadu_pd(in + i)));
+        _mm256_storeu_pd(out + i, sum);
+    }
+#elif defined(__SSE2__)
+    __m128d factor = _mm_set1_pd(weight);
+    for (; i + 2 <= size; i += 2) {
+        __m128d sum = _mm_add_pd(_mm_loadu_pd(out + i), _mm_mul_pd(factor, _mm_loadu_pd(in + i)));
+        _mm_storeu_pd(out + i, sum);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float64x2_t factor = vdupq_n_f64(weight);
+    for (; i + 2 <= size; i += 2) {
+        vst1q_f64(out + i, vfmaq_f64(vld1q_f64(out + i), factor, vld1q_f64(in + i)));
+    }
+#endif
+    for (; i < size; i++) {
+        out[i] += weight * in[i];
+    }
+}
+
+void accumulate(const float *in, float weight, size_t size, float *out) {
+    size_t i = 0;
+#if defined(__AVX__)
+    __m256 factor = _mm256_set1_ps(weight);
+    for (; i + 8 <= size; i += 8) {
+        __m256 sum = _mm256_add_ps(_mm256_loadu_ps(out + i),
+                                   _mm256_mul_ps(factor, _mm256_loadu_ps(in + i)));
+        _mm256_storeu_ps(out + i, sum);
+    }
+#elif defined(__SSE2__)
+    __m128 factor = _mm_set1_ps(weight);
+    for (; i + 4 <= size; i += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(factor, _mm_loadu_ps(in + i)));
+        _mm_storeu_ps(out + i, sum);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t factor = vdupq_n_f32(weight);
+    for (; i + 4 <= size; i += 4) {
+        vst1q_f32(out + i, vfmaq_f32(vld1q_f32(out + i), factor, vld1q_f32(in + i)));
+    }
+#endif
+    for (; i < size; i++) {
+        out[i] += weight * in[i];
+    }
+}
+
+// Float tftensors are combined as floats, everything else as doubles
+bool isFloat(const protos::SeldonMessageList &input) {
+    const protos::DefaultData &data = input.seldonmessages(0).data();
+    return data.has_tftensor() && data.tftensor().dtype() == tensorflow::DT_FLOAT;
+}
+
+template <typename T>
+std::vector<TensorView<T>> viewsOf(const protos::SeldonMessageList &input) {
+    std::vector<TensorView<T>> views;
+    views.reserve(static_cast<size_t>(input.seldonmessages_size()));
+    for (const protos::SeldonMessage &message : input.seldonmessages()) {
+        views.emplace_back(message.data());
+    }
+    return views;
+}
+
+template <typename T>
+void checkSameShape(const std::vector<TensorView<T>> &views) {
+    for (size_t i = 1; i < views.size(); i++) {
+        if (views[i].shape() != views[0].shape()) {
+            throw std::invalid_argument("Child " + std::to_string(i) +
+                                        " doesn't match the shape of the first child");
+        }
+    }
+}
+
+TensorBuilder<double> newOutput(const protos::SeldonMessageList &input,
+                                const std::vector<int64_t> &shape, double,
+                                protos::SeldonMessage &output) {
+    protos::DefaultData &data = *output.mutable_data();
+    if (input.seldonmessages(0).data().has_tftensor()) {
+        return TensorBuilder<double>::tftensor(data, shape);
+    }
+    return TensorBuilder<double>::tensor(data, shape);
+}
+
+TensorBuilder<float> newOutput(const protos::SeldonMessageList &input,
+                               const std::vector<int64_t> &shape, float,
+                               protos::SeldonMessage &output) {
+    return TensorBuilder<float>::tftensor(*output.mutable_data(), shape);
+}
+
+void mergeMeta(const protos::SeldonMessageList &input, protos::SeldonMessage &output) {
+    for (const protos::SeldonMessage &message : input.seldonmessages()) {
+        if (!message.has_meta()) {
+            continue;
+        }
+        protos::Meta &meta = *output.mutable_meta();
+        for (const auto &tag : message.meta().tags()) {
+            (*meta.mutable_tags())[tag.first] = tag.second;
+        }
+        meta.mutable_metrics()->MergeFrom(message.meta().metrics());
+    }
+}
+
+void checkNotEmpty(const protos::SeldonMessageList &input) {
+    if (input.seldonmessages_size() == 0) {
+        throw std::invalid_argument("Nothing to aggregate");
+    }
+}
+
+template <typename T>
+void weightedSum(const protos::SeldonMessageList &input, const std::vector<double> &weights,
+                 protos::SeldonMessage &output, ThreadPool &pool) {
+
+    std::vector<TensorView<T>> views = viewsOf<T>(input);
+    checkSameShape(views);
+
+    output.Clear();
+    auto result = newOutput(input, views[0].shape(), T(), output);
+    T *out = result.data();
+
+    pool.parallelFor(result.size(), kGrain, [&](size_t begin, size_t end) {
+        std::fill(out + begin, out + end, T(0));
+        for (size_t i = 0; i < views.size(); i++) {
+            accumulate(views[i].data() + begin, static_cast<T>(weights[i]), end - begin,
+                       out + begin);
+        }
+    });
+
+    output.mutable_data()->mutable_names()->CopyFrom(input.seldonmessages(0).data().names());
+    mergeMeta(input, output);
+}
+
+template <typename T>
+void vote(const protos::SeldonMessageList &input, protos::SeldonMessage &output,
+          ThreadPool &pool) {
+
+    std::vector<TensorView<T>> views = viewsOf<T>(input);
+    checkSameShape(views);
+    const std::vector<int64_t> &shape = views[0].shape();
+    if (shape.empty() || shape.back() <= 0) {
+        throw std::invalid_argument("Max vote needs at least one class");
+    }
+
+    output.Clear();
+    auto result = newOutput(input, shape, T(), output);
+    T *out = result.data();
+    size_t classes = static_cast<size_t>(shape.back());
+    size_t rows = result.size() / classes;
+    T share = static_cast<T>(1.0 / static_cast<double>(views.size()));
+
+    pool.parallelFor(rows, std::max<size_t>(1, kGrain / classes), [&](size_t begin, size_t end) {
+        std::fill(out + begin * classes, out + end * classes, T(0));
+        for (const TensorView<T> &view : views) {
+            for (size_t row = begin; row < end; row++) {
+                const T *scores = view.data() + row * classes;
+                size_t best = static_cast<size_t>(std::max_element(scores, scores + classes) - scores);
+                out[row * classes + best] += share;
+            }
+        }
+    });
+
+    output.mutable_data()->mutable_names()->CopyFrom(input.seldonmessages(0).data().names());
+    mergeMeta(input, output);
+}
+
+template <typename T>
+void concatenate(const protos::SeldonMessageList &input, protos::SeldonMessage &output, int axis,
+                 ThreadPool &pool) {
+
+    std::vector<TensorView<T>> views = viewsOf<T>(input);
+    int rank = static_cast<int>(views[0].rank());
+    if (axis < 0) {
+        axis += rank;
+    }
+    if (axis < 0 || axis >= rank) {
+        throw std::invalid_argument("Concat axis is out of range");
+    }
+
+    std::vector<int64_t> shape = views[0].shape();
+    shape[axis] = 0;
+    for (size_t i = 0; i < views.size(); i++) {
+        const std::vector<int64_t> &childShape = views[i].shape();
+        bool matches = static_cast<int>(childShape.size()) == rank;
+        for (int dim = 0; matches && dim < rank; dim++) {
+            matches = dim == axis || childShape[dim] == views[0].shape()[dim];
+        }
+        if (!matches) {
+            throw std::invalid_argument("Child " + std::to_string(i) +
+                                        " can't be concatenated with the first child");
+        }
+        shape[axis] += childShape[axis];
+    }
+
+    // Every outer index holds one contiguous block per child
+    size_t outer = static_cast<size_t>(detail::elementCount(
+        std::vector<int64_t>(shape.begin(), shape.begin() + axis)));
+    std::vector<size_t> inner;
+    size_t outInner = 0;
+    for (const TensorView<T> &view : views) {
+        inner.push_back(outer == 0 ? 0 : view.size() / outer);
+        outInner += inner.back();
+    }
+
+    output.Clear();
+    auto result = newOutput(input, shape, T(), output);
+    T *out = result.data();
+
+    pool.parallelFor(outer, std::max<size_t>(1, kGrain / std::max<size_t>(outInner, 1)),
+                     [&](size_t begin, size_t end) {
+        for (size_t index = begin; index < end; index++) {
+            T *target = out + index * outInner;
+            for (size_t i = 0; i < views.size(); i++) {
+                std::memcpy(target, views[i].data() + index * inner[i], inner[i] * sizeof(T));
+                target += inner[i];
+            }
+        }
+    });
+
+    auto *names = output.mutable_data()->mutable_names();
+    if (axis + 1 < rank) {
+        names->CopyFrom(input.seldonmessages(0).data().names());
+    } else {
+        for (const protos::SeldonMessage &message : input.seldonmessages()) {
+            if (message.data().names_size() == 0) {
+                names->Clear();
+                break;
+            }
+            names->MergeFrom(message.data().names());
+        }
+    }
+    mergeMeta(input, output);
+}
+
+ThreadPool &poolOrGlobal(ThreadPool *pool) {
+    return pool != nullptr ? *pool : ThreadPool::global();
+}
+
+}
+
+void mean(const protos::SeldonMessageList &input, protos::SeldonMessage &output,
+          ThreadPool *pool) {
+    checkNotEmpty(input);
+    std::vector<double> weights(static_cast<size_t>(input.seldonmessages_size()),
+                                1.0 / input.seldonmessages_size());
+    if (isFloat(input)) {
+        weightedSum<float>(input, weights, output, poolOrGlobal(pool));
+    } else {
+        weightedSum<double>(input, weights, output, poolOrGlobal(pool));
+    }
+}
+
+void weightedMean(const protos::SeldonMessageList &input, const std::vector<double> &weights,
+                  protos::SeldonMessage &output, ThreadPool *pool) {
+    checkNotEmpty(input);
+    if (weights.size() != static_cast<size_t>(input.seldonmessages_size())) {
+        throw std::invalid_argument("Expected " + std::to_string(input.seldonmessages_size()) +
+                                    " weights but got " + std::to_string(weights.size()));
+    }
+
+    double total = 0;
+    for (double weight : weights) {
+        total += weight;
+    }
+    if (total == 0) {
+        throw std::invalid_argument("Weights add up to zero");
+    }
+    std::vector<double> normalized;
+    for (double weight : weights) {
+        normalized.push_back(weight / total);
+    }
+
+    if (isFloat(input)) {
+        weightedSum<float>(input, normalized, output, poolOrGlobal(pool));
+    } else {
+        weightedSum<double>(input, normalized, output, poolOrGlobal(pool));
+    }
+}
+
+void maxVote(const protos::SeldonMessageList &input, protos::SeldonMessage &output,
+             ThreadPool *pool) {
+    checkNotEmpty(input);
+    if (isFloat(input)) {
+        vote<float>(input, output, poolOrGlobal(pool));
+    } else {
+        vote<double>(input, output, poolOrGlobal(pool));
+    }
+}
+
+void concat(const protos::SeldonMessageList &input, protos::SeldonMessage &output, int axis,
+            ThreadPool *pool) {
+    checkNotEmpty(input);
+    if (isFloat(input)) {
+        concatenate<float>(input, output, axis, poolOrGlobal(pool));
+    } else {
+        concatenate<double>(input, output, axis, poolOrGlobal(pool));
+    }
+}
+
+}
+}
@@ -0,0 +1,425 @@
+#include "seldon/Base64.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SELDON_BASE64_AVX2 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SELDON_BASE64_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace seldon {
+namespace base64 {
+
+namespace {
+
+const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Decode table values past the 64 digits. The URL-safe digits are marked
+// so that the two alphabets can't be mixed.
+constexpr uint8_t kInvalid = 0xFF;
+constexpr uint8_t kPadding = 0xFE;
+constexpr uint8_t kUrlSafe = 0x40;
+
+struct DecodeTable
+{
+    DecodeTable() {
+        for (uint8_t &value : this->values) {
+            value = kInvalid;
+        }
+        for (uint8_t digit = 0; digit < 64; digit++) {
+            this->values[static_cast<uint8_t>(kAlphabet[digit])] = digit;
+        }
+        this->values['-'] = kUrlSafe | 62;
+        this->values['_'] = kUrlSafe | 63;
+        this->values['='] = kPadding;
+    }
+
+    uint8_t values[256];
+};
+
+const DecodeTable kDecode;
+
+void encodeScalar(const uint8_t *in, size_t size, char *out) {
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3) {
+        uint32_t group = uint32_t(in[i]) << 16 | uint32_t(in[i + 1]) << 8 | in[i + 2];
+        *out++ = kAlphabet[group >> 18];
+        *out++ = kAlphabet[(group >> 12) & 0x3F];
+        *out++ = kAlphabet[(group >> 6) & 0x3F];
+        *out++ = kAlphabet[group & 0x3F];
+    }
+    if (i + 1 == size) {
+        uint32_t group = uint32_t(in[i]) << 16;
+        *out++ = kAlphabet[group >> 18];
+        *out++ = kAlphabet[(group >> 12) & 0x3F];
+        *out++ = '=';
+        *out++ = '=';
+    } else if (i + 2 == size) {
+        uint32_t group = uint32_t(in[i]) << 16 | uint32_t(in[i + 1]) << 8;
+        *out++ = kAlphabet[group >> 18];
+        *out++ = kAlphabet[(group >> 12) & 0x3F];
+        *out++ = kAlphabet[(group >> 6) & 0x3F];
+        *out++ = '=';
+    }
+}
+
+// Sets urlSafe if data holds any URL-safe digits, so the caller can check
+// the whole input for standard ones
+bool decodeScalar(const uint8_t *in, size_t size, uint8_t *out, size_t &written,
+                  bool &urlSafe) {
+    const uint8_t *table = kDecode.values;
+    uint8_t *begin = out;
+    uint32_t group = 0;
+    int digits = 0;
+    size_t i = 0;
+    while (i < size) {
+        // Whole groups of four standard digits
+        if (digits == 0) {
+            for (; i + 4 <= size; i += 4) {
+                uint32_t a = table[in[i]];
+                uint32_t b = table[in[i + 1]];
+                uint32_t c = table[in[i + 2]];
+                uint32_t d = table[in[i + 3]];
+                if ((a | b | c | d) >= 64) {
+                    break;
+                }
+                uint32_t quad = a << 18 | b << 12 | c << 6 | d;
+                out[0] = static_cast<uint8_t>(quad >> 16);
+                out[1] = static_cast<uint8_t>(quad >> 8);
+                out[2] = static_cast<uint8_t>(quad);
+                out += 3;
+            }
+            if (i == size) {
+                break;
+            }
+        }
+
+        uint8_t value = table[in[i]];
+        if (value == kPadding) {
+            break;
+        }
+        if (value == kInvalid) {
+            return false;
+        }
+        if (value & kUrlSafe) {
+            urlSafe = true;
+            value &= 0x3F;
+        }
+        group = group << 6 | value;
+        if (++digits == 4) {
+            out[0] = static_cast<uint8_t>(group >> 16);
+            out[1] = static_cast<uint8_t>(group >> 8);
+            out[2] = static_cast<uint8_t>(group);
+            out += 3;
+            group = 0;
+            digits = 0;
+        }
+        i++;
+    }
+
+    // Only padding may follow the first '=', up to a whole group
+    size_t padding = size - i;
+    for (; i < size; i++) {
+        if (in[i] != '=') {
+            return false;
+        }
+    }
+    if (digits == 1 || (padding > 0 && digits + padding != 4)) {
+        return false;
+    }
+    // The bits past the last byte must be zero
+    if (digits == 2) {
+        if (group & 0xF) {
+            return false;
+        }
+        *out++ = static_cast<uint8_t>(group >> 4);
+    } else if (digits == 3) {
+        if (group & 0x3) {
+            return false;
+        }
+        *out++ = static_cast<uint8_t>(group >> 10);
+        *out++ = static_cast<uint8_t>(group >> 2);
+    }
+    written = static_cast<size_t>(out - begin);
+    return true;
+}
+
+#if SELDON_BASE64_AVX2
+
+// Kernels after "Faster Base64 Encoding and Decoding using AVX2
+// Instructions" (Muła, Lemire), built for AVX2 whatever the target flags so
+// they can be picked at runtime
+
+// Encodes 24 bytes to 32 chars at a time while 28 bytes can be read.
+// Returns the bytes consumed.
+__attribute__((target("avx2"))) size_t encodeAvx2(const uint8_t *in, size_t size, char *out) {
+    const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,
+        'A', 0, 0);
+
+    size_t i = 0;
+    for (; i + 28 <= size; i += 24) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 12));
+        __m256i bytes = _mm256_shuffle_epi8(_mm256_set_m128i(high, low), spread);
+
+        // Every 32 bit lane holds 3 bytes, split into four 6 bit digits
+        __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0FC0FC00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003F03F0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i digits = _mm256_or_si256(ac, bd);
+
+        // Offset from each digit to its character, by digit range
+        __m256i range = _mm256_subs_epu8(digits, _mm256_set1_epi8(51));
+        __m256i letters = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), digits);
+        range = _mm256_or_si256(range, _mm256_and_si256(letters, _mm256_set1_epi8(13)));
+        __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), digits);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), chars);
+        out += 32;
+    }
+    return i;
+}
+
+// Decodes 32 standard digits to 24 bytes at a time, stopping at the first
+// block with anything else in it and leaving the rest to decodeScalar.
+// Stores are 32 bytes wide, so it stops short of the end of out. Returns
+// the chars consumed.
+__attribute__((target("avx2"))) size_t decodeAvx2(const uint8_t *in, size_t size, uint8_t *out) {
+    const __m256i validLow = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B,
+        0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B,
+        0x1B, 0x1A);
+    const __m256i validHigh = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10);
+    const __m256i shifts = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0,
+                                            0, 0);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+    size_t i = 0;
+    for (; i + 44 <= size; i += 32) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi32(chars, 4), nibble);
+        __m256i low = _mm256_and_si256(chars, nibble);
+        if (!_mm256_testz_si256(_mm256_shuffle_epi8(validLow, low),
+                                _mm256_shuffle_epi8(validHigh, high))) {
+            break;
+        }
+
+        // '/' shares its high nibble with '+', so it's shifted one entry down
+        __m256i shift = _mm256_shuffle_epi8(
+            shifts, _mm256_add_epi8(_mm256_cmpeq_epi8(chars, slash), high));
+        __m256i digits = _mm256_add_epi8(chars, shift);
+
+        // Packs each four 6 bit digits into 3 bytes, then the bytes together
+        __m256i pairs = _mm256_maddubs_epi16(digits, _mm256_set1_epi32(0x01400140));
+        __m256i groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(groups, pack), lanes);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), bytes);
+        out += 24;
+    }
+    return i;
+}
+
+bool hasAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif
+
+#if SELDON_BASE64_NEON
+
+uint8x16x4_t loadTable(const uint8_t *table) {
+    uint8x16x4_t result;
+    result.val[0] = vld1q_u8(table);
+    result.val[1] = vld1q_u8(table + 16);
+    result.val[2] = vld1q_u8(table + 32);
+    result.val[3] = vld1q_u8(table + 48);
+    return result;
+}
+
+// Encodes 48 bytes to 64 chars at a time. Returns the bytes consumed.
+size_t encodeNeon(const uint8_t *in, size_t size, char *out) {
+    const uint8x16x4_t alphabet = loadTable(reinterpret_cast<const uint8_t *>(kAlphabet));
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+
+    size_t i = 0;
+    for (; i + 48 <= size; i += 48) {
+        uint8x16x3_t bytes = vld3q_u8(in + i);
+        uint8x16x4_t digits;
+        digits.val[0] = vshrq_n_u8(bytes.val[0], 2);
+        digits.val[1] = vandq_u8(
+            vorrq_u8(vshlq_n_u8(bytes.val[0], 4), vshrq_n_u8(bytes.val[1], 4)), mask);
+        digits.val[2] = vandq_u8(
+            vorrq_u8(vshlq_n_u8(bytes.val[1], 2), vshrq_n_u8(bytes.val[2], 6)), mask);
+        digits.val[3] = vandq_u8(bytes.val[2], mask);
+
+        uint8x16x4_t chars;
+        for (int j = 0; j < 4; j++) {
+            chars.val[j] = vqtbl4q_u8(alphabet, digits.val[j]);
+        }
+        vst4q_u8(reinterpret_cast<uint8_t *>(out), chars);
+        out += 64;
+    }
+    return i;
+}
+
+// Decodes 64 digits to 48 bytes at a time, stopping at the first block
+// with anything else in it and leaving the rest to decodeScalar. Returns
+// the chars consumed.
+size_t decodeNeon(const uint8_t *in, size_t size, uint8_t *out) {
+    const uint8x16x4_t lowTable = loadTable(kDecode.values);
+    const uint8x16x4_t highTable = loadTable(kDecode.values + 64);
+    const uint8x16_t offset = vdupq_n_u8(64);
+    const uint8x16_t ascii = vdupq_n_u8(0x80);
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        uint8x16x4_t chars = vld4q_u8(in + i);
+        uint8x16x4_t digits;
+        uint8x16_t error = vdupq_n_u8(0);
+        for (int j = 0; j < 4; j++) {
+            // Chars past 127 miss both tables, so they're flagged separately
+            uint8x16_t digit = vqtbl4q_u8(lowTable, chars.val[j]);
+            digit = vqtbx4q_u8(digit, highTable, vsubq_u8(chars.val[j], offset));
+            error = vorrq_u8(error, vorrq_u8(digit, vandq_u8(chars.val[j], ascii)));
+            digits.val[j] = digit;
+        }
+        if (vmaxvq_u8(error) >= 64) {
+            break;
+        }
+
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(digits.val[0], 2), vshrq_n_u8(digits.val[1], 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(digits.val[1], 4), vshrq_n_u8(digits.val[2], 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(digits.val[2], 6), digits.val[3]);
+        vst3q_u8(out, bytes);
+        out += 48;
+    }
+    return i;
+}
+
+#endif
+
+}
+
+Kernel defaultKernel() {
+#if SELDON_BASE64_AVX2
+    return hasAvx2() ? Kernel::Avx2 : Kernel::Scalar;
+#elif SELDON_BASE64_NEON
+    return Kernel::Neon;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+bool supported(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar:
+        return true;
+    case Kernel::Avx2:
+#if SELDON_BASE64_AVX2
+        return hasAvx2();
+#else
+        return false;
+#endif
+    case Kernel::Neon:
+#if SELDON_BASE64_NEON
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char *kernelName(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar:
+        return "scalar";
+    case Kernel::Avx2:
+        return "avx2";
+    case Kernel::Neon:
+        return "neon";
+    }
+    return "unknown";
+}
+
+void encode(const char *data, size_t size, char *out, Kernel kernel) {
+    const uint8_t *in = reinterpret_cast<const uint8_t *>(data);
+    size_t done = 0;
+#if SELDON_BASE64_AVX2
+    if (kernel == Kernel::Avx2 && hasAvx2()) {
+        done = encodeAvx2(in, size, out);
+    }
+#elif SELDON_BASE64_NEON
+    if (kernel == Kernel::Neon) {
+        done = encodeNeon(in, size, out);
+    }
+#endif
+    encodeScalar(in + done, size - done, out + done / 3 * 4);
+}
+
+bool decode(const char *data, size_t size, char *out, size_t &written, Kernel kernel) {
+    const uint8_t *in = reinterpret_cast<const uint8_t *>(data);
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(out);
+    size_t done = 0;
+#if SELDON_BASE64_AVX2
+    if (kernel == Kernel::Avx2 && hasAvx2()) {
+        done = decodeAvx2(in, size, bytes);
+    }
+#elif SELDON_BASE64_NEON
+    if (kernel == Kernel::Neon) {
+        done = decodeNeon(in, size, bytes);
+    }
+#endif
+    size_t tail = 0;
+    bool urlSafe = false;
+    if (!decodeScalar(in + done, size - done, bytes + done / 4 * 3, tail, urlSafe)) {
+        return false;
+    }
+    // The vectorized kernels only take standard digits
+    if (urlSafe && (std::memchr(data, '+', size) != nullptr ||
+                    std::memchr(data, '/', size) != nullptr)) {
+        return false;
+    }
+    written = done / 4 * 3 + tail;
+    return true;
+}
+
+void append(const char *data, size_t size, std::string &out) {
+    size_t start = out.size();
+    out.resize(start + encodedSize(size));
+    encode(data, size, &out[start]);
+}
+
+bool decode(const char *data, size_t size, std::string &out) {
+    out.resize(decodedSize(size));
+    size_t written = 0;
+    if (!decode(data, size, &out[0], written)) {
+        return false;
+    }
+    out.resize(written);
+    return true;
+}
+
+}
+}
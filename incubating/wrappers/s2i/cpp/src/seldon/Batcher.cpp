@@ -0,0 +1,459 @@
+#include "seldon/Batcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "seldon/Environment.hpp"
+#include "seldon/Logging.hpp"
+#include "seldon/Metrics.hpp"
+#include "seldon/RequestArena.hpp"
+
+namespace seldon {
+
+namespace {
+
+enum class Kind {
+    // Not batchable, predicted on its own
+    None,
+    Tensor,
+    TfContent,
+    TfFloat,
+    TfDouble,
+    TfInt,
+    TfInt64,
+};
+
+std::vector<double> batchSizeBuckets() {
+    std::vector<double> bounds;
+    for (double bound = 1; bound <= 4096; bound *= 2) {
+        bounds.push_back(bound);
+    }
+    return bounds;
+}
+
+template <typename T>
+void copyRows(const google::protobuf::RepeatedField<T> &source, int64_t begin, int64_t count,
+              google::protobuf::RepeatedField<T> *target) {
+    target->Resize(static_cast<int>(count), T());
+    std::copy(source.begin() + begin, source.begin() + begin + count, target->begin());
+}
+
+bool sameNames(const protos::SeldonMessage &a, const protos::SeldonMessage &b) {
+    const auto &aNames = a.data().names();
+    const auto &bNames = b.data().names();
+    return aNames.size() == bNames.size() && std::equal(aNames.begin(), aNames.end(), bNames.begin());
+}
+
+}
+
+struct Batcher::Layout
+{
+    Kind kind = Kind::None;
+    int64_t rows = 0;
+    // Values, or tensor_content bytes, per row
+    int64_t rowSize = 0;
+    int dtype = 0;
+    std::vector<int64_t> trailing;
+
+    bool compatible(const Layout &other) const {
+        return this->kind == other.kind && this->dtype == other.dtype &&
+               this->trailing == other.trailing;
+    }
+};
+
+struct Batcher::Pending
+{
+    protos::SeldonMessage *input;
+    protos::SeldonMessage *output;
+    Layout layout;
+    std::chrono::steady_clock::time_point arrival;
+    std::exception_ptr error;
+    // Set for submitted requests, which own their messages and are freed
+    // once called back
+    Callback callback;
+    protos::SeldonMessage ownedInput;
+    protos::SeldonMessage ownedOutput;
+    // Blocked requests wait for done under the batcher's lock
+    bool done = false;
+    std::condition_variable finished;
+};
+
+BatchOptions BatchOptions::fromEnvironment() {
+    BatchOptions options;
+    options.maxBatchSize = static_cast<int>(envInt("SELDON_CPP_MAX_BATCH_SIZE", options.maxBatchSize));
+    options.maxBatchDelayUs = envInt("SELDON_CPP_MAX_BATCH_DELAY_US", options.maxBatchDelayUs);
+    options.threads = static_cast<int>(envInt("SELDON_CPP_BATCH_THREADS", options.threads));
+    return options;
+}
+
+Batcher::Batcher(Predict predict, BatchOptions options)
+    : mPredict(std::move(predict)), mOptions(options),
+      mQueueDepth(metrics::Registry::global().gauge(
+          "seldon_cpp_batch_queue_depth", "Requests waiting to be batched")),
+      mBatchSize(metrics::Registry::global().histogram(
+          "seldon_cpp_batch_size", "Rows per batched prediction", metrics::Labels(),
+          batchSizeBuckets())) {
+
+    for (int i = 0; i < std::max(1, this->mOptions.threads); i++) {
+        this->mThreads.emplace_back([this]() { this->run(); });
+    }
+}
+
+Batcher::~Batcher() {
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mStopping = true;
+    }
+    this->mReady.notify_all();
+    for (auto &thread : this->mThreads) {
+        thread.join();
+    }
+}
+
+void Batcher::submit(protos::SeldonMessage &&input, Callback done) {
+    std::unique_ptr<Pending> pending(new Pending());
+    pending->ownedInput = std::move(input);
+    pending->input = &pending->ownedInput;
+    pending->output = &pending->ownedOutput;
+    pending->layout = layoutOf(pending->ownedInput);
+    pending->callback = std::move(done);
+    if (pending->layout.kind == Kind::None) {
+        try {
+            this->mPredict(pending->ownedInput, pending->ownedOutput);
+        } catch (...) {
+            pending->error = std::current_exception();
+        }
+        complete(pending.release());
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mMutex);
+    this->enqueue(pending.release());
+}
+
+void Batcher::predict(protos::SeldonMessage &input, protos::SeldonMessage &output) {
+    Pending pending;
+    pending.input = &input;
+    pending.output = &output;
+    pending.layout = layoutOf(input);
+    if (pending.layout.kind == Kind::None) {
+        this->mPredict(input, output);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mMutex);
+    this->enqueue(&pending);
+    pending.finished.wait(lock, [&pending]() { return pending.done; });
+    if (pending.error) {
+        std::rethrow_exception(pending.error);
+    }
+}
+
+void Batcher::enqueue(Pending *pending) {
+    pending->arrival = std::chrono::steady_clock::now();
+    this->mQueue.push_back(pending);
+    this->mQueuedRows += pending->layout.rows;
+    this->mQueueDepth.set(static_cast<double>(this->mQueue.size()));
+    // A batcher may be waiting for its batch to fill up rather than for work
+    this->mReady.notify_all();
+}
+
+void Batcher::run() {
+    std::vector<Pending *> batch;
+    std::vector<Pending *> submitted;
+    std::unique_lock<std::mutex> lock(this->mMutex);
+
+    while (true) {
+        this->mReady.wait(lock, [this]() { return this->mStopping || !this->mQueue.empty(); });
+        if (this->mQueue.empty()) {
+            return;
+        }
+
+        // Give the oldest request until its deadline to be joined by others
+        auto deadline = this->mQueue.front()->arrival +
+                        std::chrono::microseconds(this->mOptions.maxBatchDelayUs);
+        this->mReady.wait_until(lock, deadline, [this]() {
+            return this->mStopping || this->mQueue.empty() ||
+                   this->mQueuedRows >= this->mOptions.maxBatchSize;
+        });
+        if (this->mQueue.empty()) {
+            // Taken by another batcher
+            continue;
+        }
+
+        // Fill the batch with whatever can be concatenated with the oldest
+        // request, leaving the rest queued for the next one
+        Pending *first = this->mQueue.front();
+        this->mQueue.pop_front();
+        batch.assign(1, first);
+        int64_t rows = first->layout.rows;
+        for (auto it = this->mQueue.begin();
+             it != this->mQueue.end() && rows < this->mOptions.maxBatchSize;) {
+            Pending *pending = *it;
+            if (pending->layout.compatible(first->layout) &&
+                rows + pending->layout.rows <= this->mOptions.maxBatchSize &&
+                sameNames(*pending->input, *first->input)) {
+                batch.push_back(pending);
+                rows += pending->layout.rows;
+                it = this->mQueue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        this->mQueuedRows -= rows;
+        this->mQueueDepth.set(static_cast<double>(this->mQueue.size()));
+
+        lock.unlock();
+        this->predictBatch(batch, rows);
+        lock.lock();
+
+        // A blocked request may return and free its Pending as soon as the
+        // lock is released, so the submitted ones are picked out first and
+        // called back without the lock
+        submitted.clear();
+        for (Pending *pending : batch) {
+            if (pending->callback) {
+                submitted.push_back(pending);
+            } else {
+                pending->done = true;
+                pending->finished.notify_one();
+            }
+        }
+        lock.unlock();
+        for (Pending *pending : submitted) {
+            complete(pending);
+        }
+        lock.lock();
+    }
+}
+
+void Batcher::complete(Pending *pending) {
+    std::unique_ptr<Pending> owned(pending);
+    try {
+        pending->callback(pending->error, *pending->output);
+    } catch (const std::exception &e) {
+        SELDON_LOG_ERROR("Batched prediction callback failed: " << e.what());
+    }
+}
+
+void Batcher::predictBatch(const std::vector<Pending *> &batch, int64_t rows) {
+    this->mBatchSize.observe(static_cast<double>(rows));
+    try {
+        if (batch.size() == 1) {
+            this->mPredict(*batch[0]->input, *batch[0]->output);
+            return;
+        }
+
+        SELDON_LOG_DEBUG("Predicting " << batch.size() << " requests as a batch of " << rows
+                         << " rows");
+        RequestArena::Scope scope;
+        auto *input = google::protobuf::Arena::CreateMessage<protos::SeldonMessage>(&scope.arena());
+        auto *output = google::protobuf::Arena::CreateMessage<protos::SeldonMessage>(&scope.arena());
+        concatenate(batch, rows, *input);
+        this->mPredict(*input, *output);
+        split(*output, rows, batch);
+    } catch (...) {
+        std::exception_ptr error = std::current_exception();
+        for (Pending *pending : batch) {
+            pending->error = error;
+        }
+    }
+}
+
+Batcher::Layout Batcher::layoutOf(const protos::SeldonMessage &message) {
+    Layout layout;
+    if (!message.has_data()) {
+        return layout;
+    }
+    const protos::DefaultData &data = message.data();
+
+    int64_t elements = 1;
+    if (data.has_tensor()) {
+        const protos::Tensor &tensor = data.tensor();
+        if (tensor.shape_size() == 0) {
+            return layout;
+        }
+        for (int i = 0; i < tensor.shape_size(); i++) {
+            elements *= tensor.shape(i);
+            if (i > 0) {
+                layout.trailing.push_back(tensor.shape(i));
+            }
+        }
+        layout.rows = tensor.shape(0);
+        if (layout.rows <= 0 || elements != tensor.values_size()) {
+            return layout;
+        }
+        layout.kind = Kind::Tensor;
+        layout.rowSize = elements / layout.rows;
+        return layout;
+    }
+
+    if (!data.has_tftensor()) {
+        return layout;
+    }
+    const tensorflow::TensorProto &tensor = data.tftensor();
+    const tensorflow::TensorShapeProto &shape = tensor.tensor_shape();
+    if (shape.unknown_rank() || shape.dim_size() == 0) {
+        return layout;
+    }
+    for (int i = 0; i < shape.dim_size(); i++) {
+        elements *= shape.dim(i).size();
+        if (i > 0) {
+            layout.trailing.push_back(shape.dim(i).size());
+        }
+    }
+    layout.rows = shape.dim(0).size();
+    layout.dtype = tensor.dtype();
+    if (layout.rows <= 0 || elements <= 0) {
+        return layout;
+    }
+
+    if (!tensor.tensor_content().empty()) {
+        if (tensor.tensor_content().size() % layout.rows == 0) {
+            layout.kind = Kind::TfContent;
+            layout.rowSize = static_cast<int64_t>(tensor.tensor_content().size()) / layout.rows;
+        }
+        return layout;
+    }
+    // Typed values are only batched when every element is present, as a
+    // shorter list would be broadcast
+    if (tensor.float_val_size() == elements) {
+        layout.kind = Kind::TfFloat;
+    } else if (tensor.double_val_size() == elements) {
+        layout.kind = Kind::TfDouble;
+    } else if (tensor.int_val_size() == elements) {
+        layout.kind = Kind::TfInt;
+    } else if (tensor.int64_val_size() == elements) {
+        layout.kind = Kind::TfInt64;
+    }
+    layout.rowSize = elements / layout.rows;
+    return layout;
+}
+
+void Batcher::concatenate(const std::vector<Pending *> &batch, int64_t rows,
+                          protos::SeldonMessage &input) {
+
+    const protos::SeldonMessage &first = *batch[0]->input;
+    const Layout &layout = batch[0]->layout;
+    input.mutable_meta()->CopyFrom(first.meta());
+    protos::DefaultData *data = input.mutable_data();
+    data->mutable_names()->CopyFrom(first.data().names());
+
+    if (layout.kind == Kind::Tensor) {
+        protos::Tensor *tensor = data->mutable_tensor();
+        tensor->add_shape(static_cast<int>(rows));
+        for (int64_t dim : layout.trailing) {
+            tensor->add_shape(static_cast<int>(dim));
+        }
+        tensor->mutable_values()->Reserve(static_cast<int>(rows * layout.rowSize));
+        for (Pending *pending : batch) {
+            tensor->mutable_values()->MergeFrom(pending->input->data().tensor().values());
+        }
+        return;
+    }
+
+    tensorflow::TensorProto *tensor = data->mutable_tftensor();
+    tensor->set_dtype(first.data().tftensor().dtype());
+    tensor->mutable_tensor_shape()->add_dim()->set_size(rows);
+    for (int64_t dim : layout.trailing) {
+        tensor->mutable_tensor_shape()->add_dim()->set_size(dim);
+    }
+    if (layout.kind == Kind::TfContent) {
+        std::string *content = tensor->mutable_tensor_content();
+        content->reserve(static_cast<size_t>(rows * layout.rowSize));
+        for (Pending *pending : batch) {
+            content->append(pending->input->data().tftensor().tensor_content());
+        }
+        return;
+    }
+    for (Pending *pending : batch) {
+        const tensorflow::TensorProto &source = pending->input->data().tftensor();
+        switch (layout.kind) {
+        case Kind::TfFloat:
+            tensor->mutable_float_val()->MergeFrom(source.float_val());
+            break;
+        case Kind::TfDouble:
+            tensor->mutable_double_val()->MergeFrom(source.double_val());
+            break;
+        case Kind::TfInt:
+            tensor->mutable_int_val()->MergeFrom(source.int_val());
+            break;
+        case Kind::TfInt64:
+            tensor->mutable_int64_val()->MergeFrom(source.int64_val());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void Batcher::split(const protos::SeldonMessage &output, int64_t rows,
+                    const std::vector<Pending *> &batch) {
+
+    Layout layout = layoutOf(output);
+    if (layout.kind == Kind::None || layout.rows != rows) {
+        throw std::runtime_error("Batched prediction of " + std::to_string(rows) +
+                                 " rows must return a tensor or tftensor with " +
+                                 std::to_string(rows) + " rows");
+    }
+
+    int64_t offset = 0;
+    for (Pending *pending : batch) {
+        protos::SeldonMessage &target = *pending->output;
+        int64_t count = pending->layout.rows;
+
+        target.mutable_meta()->CopyFrom(output.meta());
+        target.mutable_meta()->set_puid(pending->input->meta().puid());
+        if (output.has_status()) {
+            target.mutable_status()->CopyFrom(output.status());
+        }
+        protos::DefaultData *data = target.mutable_data();
+        data->mutable_names()->CopyFrom(output.data().names());
+
+        int64_t begin = offset * layout.rowSize;
+        int64_t size = count * layout.rowSize;
+        offset += count;
+
+        if (layout.kind == Kind::Tensor) {
+            protos::Tensor *tensor = data->mutable_tensor();
+            tensor->add_shape(static_cast<int>(count));
+            for (int64_t dim : layout.trailing) {
+                tensor->add_shape(static_cast<int>(dim));
+            }
+            copyRows(output.data().tensor().values(), begin, size, tensor->mutable_values());
+            continue;
+        }
+
+        const tensorflow::TensorProto &source = output.data().tftensor();
+        tensorflow::TensorProto *tensor = data->mutable_tftensor();
+        tensor->set_dtype(source.dtype());
+        tensor->mutable_tensor_shape()->add_dim()->set_size(count);
+        for (int64_t dim : layout.trailing) {
+            tensor->mutable_tensor_shape()->add_dim()->set_size(dim);
+        }
+        switch (layout.kind) {
+        case Kind::TfContent:
+            tensor->set_tensor_content(source.tensor_content().data() + begin,
+                                       static_cast<size_t>(size));
+            break;
+        case Kind::TfFloat:
+            copyRows(source.float_val(), begin, size, tensor->mutable_float_val());
+            break;
+        case Kind::TfDouble:
+            copyRows(source.double_val(), begin, size, tensor->mutable_double_val());
+            break;
+        case Kind::TfInt:
+            copyRows(source.int_val(), begin, size, tensor->mutable_int_val());
+            break;
+        case Kind::TfInt64:
+            copyRows(source.int64_val(), begin, size, tensor->mutable_int64_val());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+#include "seldon/Codec.hpp"
+
+#include <cstring>
+
+#include "seldon/Base64.hpp"
+#include "seldon/JsonDecoder.hpp"
+
+namespace seldon {
+
+namespace {
+
+// Finds the string value of a top level binData member in the JSON object
+// at data, returning false if there is none, or if it is escaped or the
+// object can't be followed
+bool findBinData(const char *data, size_t size, const char *&begin, const char *&end) {
+    begin = nullptr;
+    bool scanned = json::scanObject(
+        data, size, [&](const char *key, size_t keySize, const char *value, const char *valueEnd) {
+            if (keySize == 7 && std::memcmp(key, "binData", 7) == 0 && *value == '"' &&
+                std::memchr(value, '\\', static_cast<size_t>(valueEnd - value)) == nullptr) {
+                begin = value + 1;
+                end = valueEnd - 1;
+            }
+            return true;
+        });
+    return scanned && begin != nullptr;
+}
+
+// Tries the single pass decoder, returning false once message has been
+// cleared for the protobuf parser
+template <typename Message>
+bool decodeJson(const char *data, size_t size, PayloadFormat format, Message &message) {
+    if (format != PayloadFormat::Json) {
+        return false;
+    }
+    if (json::decode(data, size, message)) {
+        return true;
+    }
+    message.Clear();
+    return false;
+}
+
+}
+
+void decodeMessage(const char *data, size_t size, PayloadFormat format,
+                   protos::SeldonMessage &message) {
+
+    if (decodeJson(data, size, format, message)) {
+        return;
+    }
+
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    if (format == PayloadFormat::Json && findBinData(data, size, begin, end)) {
+        // The rest of the request is small next to the blob, so it's parsed
+        // as usual with an empty binData in its place
+        std::string rest;
+        rest.reserve(size - static_cast<size_t>(end - begin));
+        rest.append(data, begin);
+        rest.append(end, data + size);
+        decodeMessage<protos::SeldonMessage>(rest.data(), rest.size(), format, message);
+        if (message.data_oneof_case() == protos::SeldonMessage::kBinData &&
+            base64::decode(begin, static_cast<size_t>(end - begin), *message.mutable_bindata())) {
+            return;
+        }
+        // Leaves anything unusual to the protobuf parser, errors included
+        message.Clear();
+    }
+    decodeMessage<protos::SeldonMessage>(data, size, format, message);
+}
+
+void decodeMessage(const char *data, size_t size, PayloadFormat format,
+                   protos::SeldonMessageList &list) {
+    if (!decodeJson(data, size, format, list)) {
+        decodeMessage<protos::SeldonMessageList>(data, size, format, list);
+    }
+}
+
+void decodeMessage(const char *data, size_t size, PayloadFormat format,
+                   protos::Feedback &feedback) {
+    if (!decodeJson(data, size, format, feedback)) {
+        decodeMessage<protos::Feedback>(data, size, format, feedback);
+    }
+}
+
+void encodeMessage(const protos::SeldonMessage &message, PayloadFormat format,
+                   const json::EncodeOptions &options, std::string &out) {
+    if (format != PayloadFormat::Json || !json::encode(message, out, options)) {
+        encodeMessage<protos::SeldonMessage>(message, format, out);
+    }
+}
+
+void encodeMessage(const protos::SeldonMessage &message, PayloadFormat format,
+                   std::string &out) {
+    static const json::EncodeOptions options = json::EncodeOptions::fromEnvironment();
+    encodeMessage(message, format, options, out);
+}
+
+}
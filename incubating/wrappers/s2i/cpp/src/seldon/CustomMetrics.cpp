@@ -0,0 +1,155 @@
+#include "seldon/CustomMetrics.hpp"
+
+#include <stdexcept>
+#include <unordered_map>
+
+#include "seldon/Logging.hpp"
+
+namespace seldon {
+namespace metrics {
+
+namespace {
+
+thread_local Capture *tCapture = nullptr;
+
+// Key of a series in the per-thread caches
+std::string seriesKey(const std::string &key, const Labels &tags) {
+    std::string result = key;
+    for (const auto &tag : tags) {
+        result.push_back('\0');
+        result.append(tag.first);
+        result.push_back('\0');
+        result.append(tag.second);
+    }
+    return result;
+}
+
+// Prometheus metric names may also hold colons, label names may not
+bool validName(const std::string &name, bool colons) {
+    if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+        return false;
+    }
+    for (char c : name) {
+        bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        if (!letter && !(c >= '0' && c <= '9') && !(colons && c == ':')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns why key and tags can't be exported, or an empty string
+std::string checkNames(const std::string &key, const Labels &tags) {
+    if (!validName(key, true)) {
+        return "\"" + key + "\" is not a valid Prometheus metric name";
+    }
+    for (const auto &tag : tags) {
+        if (!validName(tag.first, false) || tag.first.compare(0, 2, "__") == 0) {
+            return "tag \"" + tag.first + "\" is not a valid Prometheus label name";
+        }
+    }
+    return std::string();
+}
+
+// Returns null for a series that can't be recorded, a bad name or a key
+// already used with another type. That is a bug in the model rather than in
+// the request, so it is logged once per thread and the value dropped.
+template <typename Series, typename Lookup>
+Series *cached(const std::string &key, const Labels &tags, Lookup lookup) {
+    thread_local std::unordered_map<std::string, Series *> tSeries;
+    std::string cacheKey = seriesKey(key, tags);
+    auto found = tSeries.find(cacheKey);
+    if (found != tSeries.end()) {
+        return found->second;
+    }
+    Series *series = nullptr;
+    std::string problem = checkNames(key, tags);
+    if (problem.empty()) {
+        try {
+            series = &lookup();
+        } catch (const std::logic_error &e) {
+            problem = e.what();
+        }
+    }
+    if (series == nullptr) {
+        SELDON_LOG_ERROR("Dropping custom metric " << key << ": " << problem);
+    }
+    tSeries.emplace(std::move(cacheKey), series);
+    return series;
+}
+
+}
+
+void count(const std::string &key, double value, const Labels &tags) {
+    ShardedCounter *counter = cached<ShardedCounter>(key, tags, [&]() -> ShardedCounter & {
+        return Registry::global().shardedCounter(key, "Custom counter", tags);
+    });
+    if (counter != nullptr) {
+        counter->inc(value);
+        Capture::record(protos::Metric::COUNTER, key, value, tags);
+    }
+}
+
+void gauge(const std::string &key, double value, const Labels &tags) {
+    Gauge *series = cached<Gauge>(key, tags, [&]() -> Gauge & {
+        return Registry::global().gauge(key, "Custom gauge", tags);
+    });
+    if (series != nullptr) {
+        series->set(value);
+        Capture::record(protos::Metric::GAUGE, key, value, tags);
+    }
+}
+
+void timer(const std::string &key, double milliseconds, const Labels &tags) {
+    HdrHistogram *histogram = cached<HdrHistogram>(key, tags, [&]() -> HdrHistogram & {
+        return Registry::global().hdrHistogram(key, "Custom timer", tags);
+    });
+    if (histogram != nullptr) {
+        histogram->observe(milliseconds / 1000);
+        Capture::record(protos::Metric::TIMER, key, milliseconds, tags);
+    }
+}
+
+Capture::Capture(bool active) : mActive(active), mPrevious(tCapture) {
+    if (active) {
+        tCapture = this;
+    }
+}
+
+Capture::~Capture() {
+    if (this->mActive) {
+        tCapture = this->mPrevious;
+    }
+}
+
+void Capture::record(protos::Metric::MetricType type, const std::string &key, double value,
+                     const Labels &tags) {
+    Capture *capture = tCapture;
+    if (capture == nullptr) {
+        return;
+    }
+    if (type != protos::Metric::TIMER) {
+        for (Entry &entry : capture->mEntries) {
+            if (entry.type == type && entry.key == key && entry.tags == tags) {
+                entry.value = type == protos::Metric::COUNTER ? entry.value + value : value;
+                return;
+            }
+        }
+    }
+    capture->mEntries.push_back(Entry{type, key, tags, value});
+}
+
+void Capture::appendTo(protos::Meta &meta) const {
+    for (const Entry &entry : this->mEntries) {
+        protos::Metric *metric = meta.add_metrics();
+        metric->set_key(entry.key);
+        metric->set_type(entry.type);
+        metric->set_value(static_cast<float>(entry.value));
+        for (const auto &tag : entry.tags) {
+            (*metric->mutable_tags())[tag.first] = tag.second;
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,61 @@
+#include "seldon/Environment.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+#include "seldon/Logging.hpp"
+
+namespace seldon {
+
+int64_t envInt(const char *name, int64_t fallback) {
+    const char *value = std::getenv(name);
+    if (value == nullptr || *value == '\0') {
+        return fallback;
+    }
+
+    char *end;
+    errno = 0;
+    long long parsed = std::strtoll(value, &end, 10);
+    while (std::isspace(static_cast<unsigned char>(*end))) {
+        end++;
+    }
+    if (end == value || *end != '\0' || errno == ERANGE) {
+        SELDON_LOG_WARNING("Ignoring " << name << "=" << value << ", which is not an integer");
+        return fallback;
+    }
+    return parsed;
+}
+
+bool envDoubles(const char *name, std::vector<double> &values) {
+    const char *value = std::getenv(name);
+    if (value == nullptr || *value == '\0') {
+        return false;
+    }
+
+    std::vector<double> parsed;
+    const char *begin = value;
+    while (true) {
+        char *end;
+        errno = 0;
+        double number = std::strtod(begin, &end);
+        while (std::isspace(static_cast<unsigned char>(*end))) {
+            end++;
+        }
+        if (end == begin || (*end != ',' && *end != '\0') || errno == ERANGE ||
+            !std::isfinite(number)) {
+            return false;
+        }
+        parsed.push_back(number);
+        if (*end == '\0') {
+            break;
+        }
+        begin = end + 1;
+    }
+    values = std::move(parsed);
+    return true;
+}
+
+}
@@ -0,0 +1,293 @@
+#include "seldon/GrpcServer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#include <grpcpp/generic/async_generic_service.h>
+#include <grpcpp/grpcpp.h>
+
+#include "seldon/Environment.hpp"
+#include "seldon/Logging.hpp"
+
+namespace seldon {
+
+namespace {
+
+// Pending calls get this long to complete once the server is stopped
+constexpr int kShutdownGraceMillis = 1000;
+
+struct Route
+{
+    const char *path;
+    Method method;
+};
+
+// Full method names of the rpcs a model serves. Seldon/GraphMetadata is
+// answered with UNIMPLEMENTED.
+const Route kRoutes[] = {
+    {"/seldon.protos.Model/Predict", Method::Predict},
+    {"/seldon.protos.Model/SendFeedback", Method::SendFeedback},
+    {"/seldon.protos.Model/Metadata", Method::Metadata},
+    {"/seldon.protos.Seldon/Predict", Method::Predict},
+    {"/seldon.protos.Seldon/SendFeedback", Method::SendFeedback},
+    {"/seldon.protos.Seldon/ModelMetadata", Method::Metadata},
+    {"/seldon.protos.Generic/TransformInput", Method::TransformInput},
+    {"/seldon.protos.Generic/TransformOutput", Method::TransformOutput},
+    {"/seldon.protos.Generic/Route", Method::Route},
+    {"/seldon.protos.Generic/Aggregate", Method::Aggregate},
+    {"/seldon.protos.Generic/SendFeedback", Method::SendFeedback},
+    {"/seldon.protos.Router/Route", Method::Route},
+    {"/seldon.protos.Router/SendFeedback", Method::SendFeedback},
+    {"/seldon.protos.Transformer/TransformInput", Method::TransformInput},
+    {"/seldon.protos.OutputTransformer/TransformOutput", Method::TransformOutput},
+    {"/seldon.protos.Combiner/Aggregate", Method::Aggregate},
+};
+
+const Route *findRoute(const std::string &path) {
+    for (const Route &route : kRoutes) {
+        if (path == route.path) {
+            return &route;
+        }
+    }
+    return nullptr;
+}
+
+void deleteString(void *string) {
+    delete static_cast<std::string *>(string);
+}
+
+}
+
+// One accepted rpc. Every call is a single request and a single response,
+// so it moves through accept, read and finish, and owns itself in between:
+// the completion queue hands it back as the tag of each step.
+class GrpcServer::Call
+{
+public:
+    Call(GrpcServer &server, grpc::ServerCompletionQueue *queue)
+        : mServer(server), mQueue(queue), mStream(&mContext) {
+        this->mServer.mService->RequestCall(&this->mContext, &this->mStream, queue, queue, this);
+    }
+
+    void proceed(bool ok) {
+        switch (this->mState) {
+        case State::Accept:
+            if (!ok) {
+                // The server is shutting down
+                delete this;
+                return;
+            }
+            // Keep one call waiting on this queue until the server stops,
+            // as a queue that has been shut down can't take new requests
+            if (!this->mServer.mStopping) {
+                new Call(this->mServer, this->mQueue);
+            }
+            this->mState = State::Read;
+            this->mStream.Read(&this->mRequest, this);
+            return;
+        case State::Read:
+            this->mState = State::Finish;
+            if (!ok) {
+                this->mStream.Finish(
+                    grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Missing request message"),
+                    this);
+                return;
+            }
+            this->handle();
+            return;
+        case State::Finish:
+            delete this;
+            return;
+        }
+    }
+
+private:
+    enum class State {
+        Accept,
+        Read,
+        Finish,
+    };
+
+    void handle() {
+        const Route *route = findRoute(this->mContext.method());
+        if (route == nullptr) {
+            this->mStream.Finish(
+                grpc::Status(grpc::StatusCode::UNIMPLEMENTED,
+                             "Method " + this->mContext.method() + " is not implemented"),
+                this);
+            return;
+        }
+
+        // Requests arriving in several slices are joined once, everything
+        // else is decoded straight from the transport buffer
+        grpc::Slice request;
+        if (!this->mRequest.TrySingleSlice(&request).ok()) {
+            this->mRequest.DumpToSingleSlice(&request);
+        }
+
+        Method method = route->method;
+        this->mServer.callStarted();
+        this->mServer.mModel.handleBufferAsync(
+            method, reinterpret_cast<const char *>(request.begin()), request.size(),
+            PayloadFormat::Proto, [this, method](std::exception_ptr error, std::string &out) {
+                this->finish(method, error, out);
+            });
+    }
+
+    // May run on any thread, once the model is done with the request
+    void finish(Method method, std::exception_ptr error, std::string &out) {
+        // The call deletes itself as soon as the finish completes
+        GrpcServer &server = this->mServer;
+
+        grpc::Status status = statusOf(method, error);
+        if (!status.ok()) {
+            this->mStream.Finish(status, this);
+            server.callDone();
+            return;
+        }
+
+        // Owned by the response slice from here on, so the encoded bytes
+        // are handed to gRPC without a copy
+        std::string *bytes = new std::string();
+        bytes->swap(out);
+        grpc::Slice slice(&(*bytes)[0], bytes->size(), deleteString, bytes);
+        this->mResponse = grpc::ByteBuffer(&slice, 1);
+        this->mStream.WriteAndFinish(this->mResponse, grpc::WriteOptions(), grpc::Status::OK,
+                                     this);
+        server.callDone();
+    }
+
+    static grpc::Status statusOf(Method method, std::exception_ptr error) {
+        if (!error) {
+            return grpc::Status::OK;
+        }
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::invalid_argument &e) {
+            SELDON_LOG_WARNING("Invalid request: " << e.what());
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, e.what());
+        } catch (const NotImplementedError &e) {
+            return grpc::Status(grpc::StatusCode::UNIMPLEMENTED, e.what());
+        } catch (const std::exception &e) {
+            SELDON_LOG_ERROR(methodName(method) << " failed: " << e.what());
+            return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
+        } catch (...) {
+            SELDON_LOG_ERROR(methodName(method) << " failed");
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Unknown error");
+        }
+    }
+
+    GrpcServer &mServer;
+    grpc::ServerCompletionQueue *mQueue;
+    grpc::GenericServerContext mContext;
+    grpc::GenericServerAsyncReaderWriter mStream;
+    grpc::ByteBuffer mRequest;
+    grpc::ByteBuffer mResponse;
+    State mState = State::Accept;
+};
+
+GrpcServerOptions GrpcServerOptions::fromEnvironment() {
+    GrpcServerOptions options;
+    options.port = static_cast<int>(envInt("PREDICTIVE_UNIT_GRPC_SERVICE_PORT", options.port));
+    options.threads = static_cast<int>(envInt("SELDON_CPP_SERVER_THREADS", options.threads));
+    options.maxMessageBytes =
+        static_cast<int>(envInt("SELDON_CPP_GRPC_MAX_MESSAGE_BYTES", options.maxMessageBytes));
+    return options;
+}
+
+GrpcServer::GrpcServer(RawModel &model, GrpcServerOptions options)
+    : mModel(model), mOptions(std::move(options)), mService(new grpc::AsyncGenericService()) { }
+
+GrpcServer::~GrpcServer() {
+    this->stop();
+    this->wait();
+}
+
+void GrpcServer::start() {
+    int threads = this->mOptions.threads;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(this->mOptions.host + ":" + std::to_string(this->mOptions.port),
+                             grpc::InsecureServerCredentials(), &this->mPort);
+    builder.SetMaxReceiveMessageSize(this->mOptions.maxMessageBytes);
+    builder.SetMaxSendMessageSize(this->mOptions.maxMessageBytes);
+    builder.RegisterAsyncGenericService(this->mService.get());
+    for (int i = 0; i < threads; i++) {
+        this->mQueues.push_back(builder.AddCompletionQueue());
+    }
+
+    this->mServer = builder.BuildAndStart();
+    if (this->mServer == nullptr || this->mPort == 0) {
+        this->mServer.reset();
+        this->mQueues.clear();
+        throw std::runtime_error("Unable to bind gRPC port " +
+                                 std::to_string(this->mOptions.port));
+    }
+
+    for (auto &queue : this->mQueues) {
+        grpc::ServerCompletionQueue *polled = queue.get();
+        new Call(*this, polled);
+        this->mThreads.emplace_back([this, polled]() { this->poll(polled); });
+    }
+
+    SELDON_LOG_INFO("Native gRPC server listening on port " << this->mPort << " with "
+                    << threads << " threads");
+}
+
+void GrpcServer::stop() {
+    if (this->mServer == nullptr || this->mStopping.exchange(true)) {
+        return;
+    }
+    // Shutdown waits for the pollers to complete pending calls, and calls
+    // still with the model finish onto the queues, so the queues can only
+    // be shut down after both
+    this->mServer->Shutdown(std::chrono::system_clock::now() +
+                            std::chrono::milliseconds(kShutdownGraceMillis));
+    {
+        std::unique_lock<std::mutex> lock(this->mMutex);
+        this->mIdle.wait(lock, [this]() { return this->mInFlight == 0; });
+    }
+    for (auto &queue : this->mQueues) {
+        queue->Shutdown();
+    }
+}
+
+void GrpcServer::wait() {
+    for (auto &thread : this->mThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    this->mThreads.clear();
+    // Queues are drained once their pollers exit, and must outlive the server
+    this->mServer.reset();
+    this->mQueues.clear();
+}
+
+void GrpcServer::callStarted() {
+    std::lock_guard<std::mutex> lock(this->mMutex);
+    this->mInFlight++;
+}
+
+void GrpcServer::callDone() {
+    std::lock_guard<std::mutex> lock(this->mMutex);
+    if (--this->mInFlight == 0) {
+        this->mIdle.notify_all();
+    }
+}
+
+void GrpcServer::poll(grpc::ServerCompletionQueue *queue) {
+    void *tag;
+    bool ok;
+    while (queue->Next(&tag, &ok)) {
+        static_cast<Call *>(tag)->proceed(ok);
+    }
+}
+
+}
@@ -0,0 +1,912 @@
+#include "seldon/HttpServer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "seldon/Environment.hpp"
+#include "seldon/Logging.hpp"
+#include "seldon/Metrics.hpp"
+#if SELDON_WITH_GRPC
+#include "seldon/GrpcServer.hpp"
+#endif
+
+namespace seldon {
+
+namespace {
+
+constexpr size_t kMaxHeaderBytes = 64 * 1024;
+constexpr size_t kReadChunkBytes = 64 * 1024;
+constexpr int kMaxEvents = 256;
+
+const char *const kJsonContentType = "application/json";
+const char *const kProtoContentType = "application/x-protobuf";
+const char *const kMetricsContentType = "text/plain; version=0.0.4; charset=utf-8";
+
+std::system_error systemError(const std::string &what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+bool equalsIgnoreCase(const char *a, size_t aLength, const char *b) {
+    size_t bLength = std::strlen(b);
+    if (aLength != bLength) {
+        return false;
+    }
+    for (size_t i = 0; i < aLength; i++) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) !=
+            std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool containsIgnoreCase(const std::string &haystack, const char *needle) {
+    auto it = std::search(
+        haystack.begin(), haystack.end(), needle, needle + std::strlen(needle),
+        [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) ==
+                   std::tolower(static_cast<unsigned char>(b));
+        });
+    return it != haystack.end();
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+std::string urlDecode(const std::string &value) {
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '+') {
+            decoded.push_back(' ');
+        } else if (value[i] == '%' && i + 2 < value.size() &&
+                   hexValue(value[i + 1]) >= 0 && hexValue(value[i + 2]) >= 0) {
+            decoded.push_back(static_cast<char>(hexValue(value[i + 1]) * 16 +
+                                                hexValue(value[i + 2])));
+            i += 2;
+        } else {
+            decoded.push_back(value[i]);
+        }
+    }
+    return decoded;
+}
+
+// Returns the decoded value of a query string parameter, or false
+bool queryParam(const std::string &query, const char *name, std::string &value) {
+    size_t nameLength = std::strlen(name);
+    size_t start = 0;
+    while (start <= query.size()) {
+        size_t end = query.find('&', start);
+        if (end == std::string::npos) {
+            end = query.size();
+        }
+        if (end - start > nameLength && query.compare(start, nameLength, name) == 0 &&
+            query[start + nameLength] == '=') {
+            value = urlDecode(query.substr(start + nameLength + 1, end - start - nameLength - 1));
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+std::string jsonEscape(const std::string &value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+        case '"':
+            escaped.append("\\\"");
+            break;
+        case '\\':
+            escaped.append("\\\\");
+            break;
+        case '\n':
+            escaped.append("\\n");
+            break;
+        case '\r':
+            escaped.append("\\r");
+            break;
+        case '\t':
+            escaped.append("\\t");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                escaped.append(buffer);
+            } else {
+                escaped.push_back(c);
+            }
+        }
+    }
+    return escaped;
+}
+
+// Error body in the same shape as the Python SeldonMicroserviceException
+std::string errorBody(const std::string &info, const char *reason) {
+    return "{\"status\":{\"status\":1,\"info\":\"" + jsonEscape(info) +
+           "\",\"code\":-1,\"reason\":\"" + reason + "\"}}";
+}
+
+const char *statusText(int status) {
+    switch (status) {
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 411:
+        return "Length Required";
+    case 413:
+        return "Payload Too Large";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 500:
+        return "Internal Server Error";
+    case 501:
+        return "Not Implemented";
+    default:
+        return "Unknown";
+    }
+}
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw systemError("fcntl");
+    }
+}
+
+int listenOn(const std::string &host, int port, int &boundPort) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw systemError("socket");
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        close(fd);
+        throw std::invalid_argument("Invalid listen address " + host);
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        auto error = systemError("Unable to listen on port " + std::to_string(port));
+        close(fd);
+        throw error;
+    }
+    setNonBlocking(fd);
+
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length);
+    boundPort = ntohs(address.sin_port);
+    return fd;
+}
+
+struct Request
+{
+    std::string method;
+    std::string path;
+    std::string query;
+    std::string contentType;
+    const char *body = nullptr;
+    size_t bodyLength = 0;
+};
+
+// Response of a request the model completed off the worker's thread
+struct Completed
+{
+    int fd;
+    uint64_t connection;
+    Method method;
+    PayloadFormat format;
+    std::chrono::steady_clock::time_point start;
+    std::exception_ptr error;
+    std::string body;
+};
+
+struct RequestMetrics
+{
+    metrics::Counter *requests[2];
+    metrics::Histogram *seconds;
+};
+
+struct Route
+{
+    const char *path;
+    Method method;
+    bool allowGet;
+    bool allowPost;
+};
+
+// The worker whose loop runs on this thread, if any
+thread_local const void *tWorker = nullptr;
+
+// Same paths as the Python microservice
+const Route kRoutes[] = {
+    {"/api/v1.0/predictions", Method::Predict, false, true},
+    {"/api/v0.1/predictions", Method::Predict, false, true},
+    {"/predict", Method::Predict, true, true},
+    {"/transform-input", Method::TransformInput, true, true},
+    {"/transform-output", Method::TransformOutput, true, true},
+    {"/route", Method::Route, true, true},
+    {"/aggregate", Method::Aggregate, true, true},
+    {"/api/v1.0/feedback", Method::SendFeedback, false, true},
+    {"/api/v0.1/feedback", Method::SendFeedback, false, true},
+    {"/send-feedback", Method::SendFeedback, true, true},
+    {"/metadata", Method::Metadata, true, false},
+};
+
+const Route *findRoute(const std::string &path) {
+    for (const Route &route : kRoutes) {
+        if (path == route.path) {
+            return &route;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+class HttpServer::Worker
+{
+public:
+    Worker(HttpServer &server) : mServer(server) {
+        this->mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (this->mEpollFd < 0) {
+            throw systemError("epoll_create1");
+        }
+        this->mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (this->mWakeFd < 0) {
+            throw systemError("eventfd");
+        }
+        this->add(this->mWakeFd, EPOLLIN, &this->mWakeFd);
+
+        for (int &fd : server.mListenFds) {
+#ifdef EPOLLEXCLUSIVE
+            // Only wake one loop per incoming connection where supported
+            if (this->tryAdd(fd, EPOLLIN | EPOLLEXCLUSIVE, &fd)) {
+                continue;
+            }
+#endif
+            this->add(fd, EPOLLIN, &fd);
+        }
+    }
+
+    ~Worker() {
+        // Requests still with the model complete into this worker
+        {
+            std::unique_lock<std::mutex> lock(this->mMutex);
+            this->mIdle.wait(lock, [this]() { return this->mInFlight == 0; });
+        }
+        for (auto &entry : this->mConnections) {
+            close(entry.first);
+        }
+        close(this->mWakeFd);
+        close(this->mEpollFd);
+    }
+
+    void run() {
+        tWorker = this;
+        epoll_event events[kMaxEvents];
+        while (!this->mStopping.load(std::memory_order_acquire)) {
+            int count = epoll_wait(this->mEpollFd, events, kMaxEvents, -1);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                SELDON_LOG_ERROR("epoll_wait failed: " << std::strerror(errno));
+                return;
+            }
+            for (int i = 0; i < count; i++) {
+                void *tag = events[i].data.ptr;
+                if (tag == &this->mWakeFd) {
+                    uint64_t count;
+                    ssize_t bytes = ::read(this->mWakeFd, &count, sizeof(count));
+                    (void)bytes;
+                    this->drainCompleted();
+                    continue;
+                }
+                auto listener = std::find_if(
+                    this->mServer.mListenFds.begin(), this->mServer.mListenFds.end(),
+                    [tag](const int &fd) { return &fd == tag; });
+                if (listener != this->mServer.mListenFds.end()) {
+                    this->accept(*listener);
+                } else {
+                    this->onConnectionEvent(static_cast<Connection *>(tag), events[i].events);
+                }
+            }
+        }
+    }
+
+    void stop() {
+        this->mStopping.store(true, std::memory_order_release);
+        uint64_t one = 1;
+        ssize_t written = ::write(this->mWakeFd, &one, sizeof(one));
+        (void)written;
+    }
+
+private:
+    struct Connection
+    {
+        int fd;
+        // Tells a connection apart from a later one reusing its fd
+        uint64_t id;
+        std::string in;
+        // Offset of the first unconsumed byte in in
+        size_t inOffset = 0;
+        std::string out;
+        size_t outOffset = 0;
+        bool closeAfterWrite = false;
+        bool continueSent = false;
+        bool peerClosed = false;
+        // A request is with the model; later ones wait in in, so responses
+        // go out in order
+        bool pending = false;
+    };
+
+    bool tryAdd(int fd, uint32_t events, void *tag) {
+        epoll_event event;
+        event.events = events;
+        event.data.ptr = tag;
+        return epoll_ctl(this->mEpollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    void add(int fd, uint32_t events, void *tag) {
+        if (!this->tryAdd(fd, events, tag)) {
+            throw systemError("epoll_ctl");
+        }
+    }
+
+    void accept(int listenFd) {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    SELDON_LOG_WARNING("accept failed: " << std::strerror(errno));
+                }
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            std::unique_ptr<Connection> connection(new Connection());
+            connection->fd = fd;
+            connection->id = ++this->mNextId;
+            if (!this->tryAdd(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, connection.get())) {
+                close(fd);
+                continue;
+            }
+            this->mConnections[fd] = std::move(connection);
+        }
+    }
+
+    void closeConnection(Connection *connection) {
+        int fd = connection->fd;
+        epoll_ctl(this->mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        this->mConnections.erase(fd);
+    }
+
+    void onConnectionEvent(Connection *connection, uint32_t events) {
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            this->closeConnection(connection);
+            return;
+        }
+
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
+            if (!this->read(connection)) {
+                connection->peerClosed = true;
+            }
+            this->process(connection);
+        }
+        this->flushOrClose(connection);
+    }
+
+    void flushOrClose(Connection *connection) {
+        if (!this->flush(connection)) {
+            this->closeConnection(connection);
+            return;
+        }
+        bool drained = connection->outOffset == connection->out.size();
+        if (drained && !connection->pending &&
+            (connection->closeAfterWrite || connection->peerClosed)) {
+            this->closeConnection(connection);
+        }
+    }
+
+    // Reads until the socket would block. Returns false once the peer has
+    // closed its side.
+    bool read(Connection *connection) {
+        while (true) {
+            size_t size = connection->in.size();
+            connection->in.resize(size + kReadChunkBytes);
+            ssize_t count = ::read(connection->fd, &connection->in[size], kReadChunkBytes);
+            if (count > 0) {
+                connection->in.resize(size + static_cast<size_t>(count));
+                continue;
+            }
+            connection->in.resize(size);
+            if (count == 0) {
+                return false;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    // Writes as much pending output as the socket takes. Returns false on
+    // a write error.
+    bool flush(Connection *connection) {
+        while (connection->outOffset < connection->out.size()) {
+            ssize_t count = ::send(connection->fd, connection->out.data() + connection->outOffset,
+                                   connection->out.size() - connection->outOffset, MSG_NOSIGNAL);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            connection->outOffset += static_cast<size_t>(count);
+        }
+        connection->out.clear();
+        connection->outOffset = 0;
+        return true;
+    }
+
+    // Handles every complete request in the read buffer, in order
+    void process(Connection *connection) {
+        while (!connection->closeAfterWrite && !connection->pending &&
+               this->processOne(connection)) {
+        }
+        if (connection->inOffset == connection->in.size()) {
+            connection->in.clear();
+            connection->inOffset = 0;
+        } else if (connection->inOffset > kMaxHeaderBytes) {
+            connection->in.erase(0, connection->inOffset);
+            connection->inOffset = 0;
+        }
+    }
+
+    // Returns false if the buffer doesn't hold a complete request yet
+    bool processOne(Connection *connection) {
+        const std::string &in = connection->in;
+        size_t start = connection->inOffset;
+
+        size_t headerEnd = in.find("\r\n\r\n", start);
+        if (headerEnd == std::string::npos) {
+            if (in.size() - start > kMaxHeaderBytes) {
+                this->respondError(connection, 431, "Request headers too large", true);
+            }
+            return false;
+        }
+
+        Request request;
+        size_t lineEnd = in.find("\r\n", start);
+        size_t methodEnd = in.find(' ', start);
+        size_t targetEnd = methodEnd == std::string::npos ? std::string::npos
+                                                          : in.find(' ', methodEnd + 1);
+        if (methodEnd == std::string::npos || targetEnd == std::string::npos ||
+            targetEnd > lineEnd) {
+            this->respondError(connection, 400, "Malformed request line", true);
+            return false;
+        }
+        request.method = in.substr(start, methodEnd - start);
+        std::string target = in.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        size_t queryStart = target.find('?');
+        request.path = target.substr(0, queryStart);
+        if (queryStart != std::string::npos) {
+            request.query = target.substr(queryStart + 1);
+        }
+        bool http10 = in.compare(targetEnd + 1, 8, "HTTP/1.0") == 0;
+
+        size_t contentLength = 0;
+        bool keepAlive = !http10;
+        bool expectContinue = false;
+        size_t lineStart = lineEnd + 2;
+        while (lineStart < headerEnd) {
+            size_t end = in.find("\r\n", lineStart);
+            size_t colon = in.find(':', lineStart);
+            if (colon != std::string::npos && colon < end) {
+                const char *name = in.data() + lineStart;
+                size_t nameLength = colon - lineStart;
+                size_t valueStart = colon + 1;
+                while (valueStart < end && (in[valueStart] == ' ' || in[valueStart] == '\t')) {
+                    valueStart++;
+                }
+                std::string value = in.substr(valueStart, end - valueStart);
+
+                if (equalsIgnoreCase(name, nameLength, "content-length")) {
+                    contentLength = static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10));
+                } else if (equalsIgnoreCase(name, nameLength, "content-type")) {
+                    request.contentType = value;
+                } else if (equalsIgnoreCase(name, nameLength, "connection")) {
+                    if (containsIgnoreCase(value, "close")) {
+                        keepAlive = false;
+                    } else if (containsIgnoreCase(value, "keep-alive")) {
+                        keepAlive = true;
+                    }
+                } else if (equalsIgnoreCase(name, nameLength, "transfer-encoding")) {
+                    this->respondError(connection, 411, "Chunked requests are not supported", true);
+                    return false;
+                } else if (equalsIgnoreCase(name, nameLength, "expect")) {
+                    expectContinue = containsIgnoreCase(value, "100-continue");
+                }
+            }
+            lineStart = end + 2;
+        }
+
+        if (contentLength > this->mServer.mOptions.maxRequestBytes) {
+            this->respondError(connection, 413, "Request body too large", true);
+            return false;
+        }
+
+        size_t bodyStart = headerEnd + 4;
+        if (in.size() - bodyStart < contentLength) {
+            if (expectContinue && !connection->continueSent) {
+                connection->out.append("HTTP/1.1 100 Continue\r\n\r\n");
+                connection->continueSent = true;
+            }
+            return false;
+        }
+
+        request.body = in.data() + bodyStart;
+        request.bodyLength = contentLength;
+        connection->inOffset = bodyStart + contentLength;
+        connection->closeAfterWrite = !keepAlive;
+        connection->continueSent = false;
+
+        this->dispatch(connection, request);
+        return true;
+    }
+
+    void dispatch(Connection *connection, const Request &request) {
+        const std::string &path = request.path;
+
+        if (path == "/health/ping") {
+            this->respond(connection, 200, "text/html; charset=utf-8", "pong");
+            return;
+        } else if (path == "/metrics") {
+            this->respond(connection, 200, kMetricsContentType,
+                          metrics::Registry::global().render());
+            return;
+        }
+
+        const Route *route = findRoute(path);
+        if (route == nullptr) {
+            this->respondError(connection, 404, "Unknown path " + path, false);
+            return;
+        }
+        if (!((request.method == "GET" && route->allowGet) ||
+              (request.method == "POST" && route->allowPost))) {
+            this->respondError(connection, 405, "Method not allowed", false);
+            return;
+        }
+        this->handle(connection, request, route->method);
+    }
+
+    void handle(Connection *connection, const Request &request, Method method) {
+        auto start = std::chrono::steady_clock::now();
+
+        const char *data = request.body;
+        size_t size = request.bodyLength;
+        std::string queryJson;
+        if (queryParam(request.query, "json", queryJson)) {
+            data = queryJson.data();
+            size = queryJson.size();
+        }
+
+        PayloadFormat format = containsIgnoreCase(request.contentType, kProtoContentType)
+                                   ? PayloadFormat::Proto
+                                   : PayloadFormat::Json;
+
+        connection->pending = true;
+        {
+            std::lock_guard<std::mutex> lock(this->mMutex);
+            this->mInFlight++;
+        }
+        int fd = connection->fd;
+        uint64_t id = connection->id;
+        this->mDispatching = id;
+        this->mServer.mModel.handleBufferAsync(
+            method, data, size, format,
+            [this, fd, id, method, format, start](std::exception_ptr error, std::string &out) {
+                this->onDone(Completed{fd, id, method, format, start, error, std::string()}, out);
+            });
+        this->mDispatching = 0;
+    }
+
+    // Runs on whichever thread completed the request
+    void onDone(Completed completed, std::string &out) {
+        if (tWorker == this && this->mDispatching == completed.connection) {
+            // Completed inline, so the response goes out with this read
+            this->complete(completed, out);
+            std::lock_guard<std::mutex> lock(this->mMutex);
+            this->finishInFlight();
+            return;
+        }
+
+        completed.body.swap(out);
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mCompleted.push_back(std::move(completed));
+        uint64_t one = 1;
+        ssize_t written = ::write(this->mWakeFd, &one, sizeof(one));
+        (void)written;
+        this->finishInFlight();
+    }
+
+    // Requires mMutex
+    void finishInFlight() {
+        if (--this->mInFlight == 0) {
+            this->mIdle.notify_all();
+        }
+    }
+
+    void drainCompleted() {
+        std::vector<Completed> completed;
+        {
+            std::lock_guard<std::mutex> lock(this->mMutex);
+            completed.swap(this->mCompleted);
+        }
+        for (Completed &entry : completed) {
+            Connection *connection = this->complete(entry, entry.body);
+            if (connection != nullptr) {
+                // Requests that arrived in the meantime are handled now
+                this->process(connection);
+                this->flushOrClose(connection);
+            }
+        }
+    }
+
+    // Writes the response, unless the connection has been closed since.
+    // Returns the connection it was written to.
+    Connection *complete(const Completed &completed, const std::string &body) {
+        auto found = this->mConnections.find(completed.fd);
+        if (found == this->mConnections.end() || found->second->id != completed.connection) {
+            return nullptr;
+        }
+        Connection *connection = found->second.get();
+        connection->pending = false;
+
+        bool ok = false;
+        if (!completed.error) {
+            this->respond(connection, 200,
+                          completed.format == PayloadFormat::Proto ? kProtoContentType
+                                                                   : kJsonContentType,
+                          body);
+            ok = true;
+        } else {
+            try {
+                std::rethrow_exception(completed.error);
+            } catch (const std::invalid_argument &e) {
+                SELDON_LOG_WARNING("Invalid request: " << e.what());
+                this->respondError(connection, 400, e.what(), false);
+            } catch (const NotImplementedError &e) {
+                this->respondError(connection, 501, e.what(), false,
+                                   "MICROSERVICE_NOT_IMPLEMENTED");
+            } catch (const std::exception &e) {
+                SELDON_LOG_ERROR(methodName(completed.method) << " failed: " << e.what());
+                this->respondError(connection, 500, e.what(), false,
+                                   "MICROSERVICE_INTERNAL_ERROR");
+            } catch (...) {
+                SELDON_LOG_ERROR(methodName(completed.method) << " failed");
+                this->respondError(connection, 500, "Unknown error", false,
+                                   "MICROSERVICE_INTERNAL_ERROR");
+            }
+        }
+
+        auto elapsed =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - completed.start);
+        RequestMetrics &requestMetrics = this->methodMetrics(completed.method);
+        requestMetrics.requests[ok ? 0 : 1]->inc();
+        requestMetrics.seconds->observe(elapsed.count());
+        return connection;
+    }
+
+    static RequestMetrics &methodMetrics(Method method) {
+        static RequestMetrics requestMetrics[] = {
+            newRequestMetrics(Method::Predict),
+            newRequestMetrics(Method::TransformInput),
+            newRequestMetrics(Method::TransformOutput),
+            newRequestMetrics(Method::Route),
+            newRequestMetrics(Method::Aggregate),
+            newRequestMetrics(Method::SendFeedback),
+            newRequestMetrics(Method::Metadata),
+        };
+        return requestMetrics[static_cast<int>(method)];
+    }
+
+    static RequestMetrics newRequestMetrics(Method method) {
+        auto &registry = metrics::Registry::global();
+        const char *requestsHelp = "Requests handled by the native server";
+        const char *name = methodName(method);
+        RequestMetrics result;
+        result.requests[0] = &registry.counter(
+            "seldon_cpp_requests_total", requestsHelp, {{"method", name}, {"code", "200"}});
+        result.requests[1] = &registry.counter(
+            "seldon_cpp_requests_total", requestsHelp, {{"method", name}, {"code", "error"}});
+        result.seconds = &registry.histogram(
+            "seldon_cpp_request_seconds", "Time spent handling requests in the native server",
+            {{"method", name}});
+        return result;
+    }
+
+    void respond(Connection *connection, int status, const char *contentType,
+                 const std::string &body) {
+        std::string &out = connection->out;
+        char header[256];
+        int length = std::snprintf(
+            header, sizeof(header),
+            "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+            status, statusText(status), contentType, body.size(),
+            connection->closeAfterWrite ? "Connection: close\r\n" : "");
+        out.reserve(out.size() + static_cast<size_t>(length) + body.size());
+        out.append(header, static_cast<size_t>(length));
+        out.append(body);
+    }
+
+    void respondError(Connection *connection, int status, const std::string &info,
+                      bool closeConnection,
+                      const char *reason = "MICROSERVICE_BAD_DATA") {
+        if (closeConnection) {
+            connection->closeAfterWrite = true;
+        }
+        this->respond(connection, status, kJsonContentType, errorBody(info, reason));
+    }
+
+    HttpServer &mServer;
+    int mEpollFd = -1;
+    int mWakeFd = -1;
+    std::atomic<bool> mStopping{false};
+    std::unordered_map<int, std::unique_ptr<Connection>> mConnections;
+    uint64_t mNextId = 0;
+    // Connection whose request is being handed to the model
+    uint64_t mDispatching = 0;
+
+    // Guards the completions handed over from other threads
+    std::mutex mMutex;
+    std::condition_variable mIdle;
+    std::vector<Completed> mCompleted;
+    size_t mInFlight = 0;
+};
+
+ServerOptions ServerOptions::fromEnvironment() {
+    ServerOptions options;
+    options.port = static_cast<int>(envInt("PREDICTIVE_UNIT_HTTP_SERVICE_PORT", options.port));
+    options.metricsPort =
+        static_cast<int>(envInt("PREDICTIVE_UNIT_METRICS_SERVICE_PORT", options.metricsPort));
+    options.threads = static_cast<int>(envInt("SELDON_CPP_SERVER_THREADS", options.threads));
+    return options;
+}
+
+HttpServer::HttpServer(RawModel &model, ServerOptions options)
+    : mModel(model), mOptions(std::move(options)) { }
+
+HttpServer::~HttpServer() {
+    this->stop();
+    this->wait();
+    for (int fd : this->mListenFds) {
+        close(fd);
+    }
+}
+
+void HttpServer::start() {
+    this->mListenFds.push_back(listenOn(this->mOptions.host, this->mOptions.port, this->mPort));
+    if (this->mOptions.metricsPort != 0 && this->mOptions.metricsPort != this->mOptions.port) {
+        this->mListenFds.push_back(
+            listenOn(this->mOptions.host, this->mOptions.metricsPort, this->mMetricsPort));
+    } else {
+        this->mMetricsPort = this->mPort;
+    }
+
+    int threads = this->mOptions.threads;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < threads; i++) {
+        this->mWorkers.emplace_back(new Worker(*this));
+    }
+    for (auto &worker : this->mWorkers) {
+        Worker *loop = worker.get();
+        this->mThreads.emplace_back([loop]() { loop->run(); });
+    }
+
+    SELDON_LOG_INFO("Native server listening on port " << this->mPort << " (metrics on "
+                    << this->mMetricsPort << ") with " << threads << " threads");
+}
+
+void HttpServer::stop() {
+    for (auto &worker : this->mWorkers) {
+        worker->stop();
+    }
+}
+
+void HttpServer::wait() {
+    for (auto &thread : this->mThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    this->mThreads.clear();
+    this->mWorkers.clear();
+}
+
+int serve(RawModel &model, const ServerOptions &options) {
+    // Block the shutdown signals before any thread starts, so they are only
+    // ever delivered to the sigwait below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    HttpServer server(model, options);
+#if SELDON_WITH_GRPC
+    GrpcServer grpcServer(model, GrpcServerOptions::fromEnvironment());
+#endif
+    try {
+        server.start();
+#if SELDON_WITH_GRPC
+        grpcServer.start();
+#endif
+    } catch (const std::exception &e) {
+        SELDON_LOG_CRITICAL("Unable to start native server: " << e.what());
+        return 1;
+    }
+
+    int signal = 0;
+    sigwait(&signals, &signal);
+    SELDON_LOG_INFO("Received signal " << signal << ", shutting down");
+
+    server.stop();
+#if SELDON_WITH_GRPC
+    grpcServer.stop();
+    grpcServer.wait();
+#endif
+    server.wait();
+    return 0;
+}
+
+}
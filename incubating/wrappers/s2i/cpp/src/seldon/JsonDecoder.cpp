@@ -0,0 +1,924 @@
+#include "seldon/JsonDecoder.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "seldon/Base64.hpp"
+
+namespace seldon {
+namespace json {
+
+namespace {
+
+using google::protobuf::ListValue;
+using google::protobuf::Struct;
+using google::protobuf::Value;
+
+// Deeper Values are left to the protobuf parser, which has its own limit
+constexpr int kMaxDepth = 32;
+
+// Powers of ten that are exact as doubles
+const double kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                               1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                               1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Returns the first '"', '\\' or control character in [p, end), or end, 16
+// bytes at a time where the build targets SSE2 or NEON. Sets nonAscii if
+// it passes over any byte past 0x7F.
+const char *scanString(const char *p, const char *end, bool &nonAscii) {
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; p + 16 <= end; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i stop = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+        unsigned high = static_cast<unsigned>(_mm_movemask_epi8(chunk));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(stop));
+        if (mask != 0) {
+            unsigned index = static_cast<unsigned>(__builtin_ctz(mask));
+            nonAscii |= (high & ((1u << index) - 1)) != 0;
+            return p + index;
+        }
+        nonAscii |= high != 0;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x1F);
+    for (; p + 16 <= end; p += 16) {
+        uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+        uint8x16_t stop = vorrq_u8(vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)),
+                                   vcleq_u8(chunk, control));
+        if (vmaxvq_u8(stop) != 0) {
+            // The loop below finds which
+            break;
+        }
+        nonAscii |= vmaxvq_u8(chunk) >= 0x80;
+    }
+#endif
+    for (; p < end; p++) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\' || c < 0x20) {
+            break;
+        }
+        nonAscii |= c >= 0x80;
+    }
+    return p;
+}
+
+// Returns the first quote, brace or bracket in [p, end), or end, 16 bytes
+// at a time like scanString
+const char *scanNesting(const char *p, const char *end) {
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    // Braces and brackets are the only bytes that match once 0x20 is set
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    for (; p + 16 <= end; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i folded = _mm_or_si128(chunk, lower);
+        __m128i stop = _mm_or_si128(
+            _mm_cmpeq_epi8(chunk, quote),
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(stop));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t lower = vdupq_n_u8(0x20);
+    const uint8x16_t open = vdupq_n_u8('{');
+    const uint8x16_t close = vdupq_n_u8('}');
+    for (; p + 16 <= end; p += 16) {
+        uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+        uint8x16_t folded = vorrq_u8(chunk, lower);
+        uint8x16_t stop = vorrq_u8(vceqq_u8(chunk, quote),
+                                   vorrq_u8(vceqq_u8(folded, open), vceqq_u8(folded, close)));
+        if (vmaxvq_u8(stop) != 0) {
+            break;
+        }
+    }
+#endif
+    for (; p < end; p++) {
+        char c = *p;
+        if (c == '"' || c == '{' || c == '}' || c == '[' || c == ']') {
+            break;
+        }
+    }
+    return p;
+}
+
+const char *skipSpace(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+// Returns the end of the string starting at the quote at p, or nullptr if
+// it isn't terminated. Sets escaped if it holds any escapes.
+const char *skipString(const char *p, const char *end, bool &escaped) {
+    bool nonAscii = false;
+    escaped = false;
+    for (p++; p < end; p++) {
+        p = scanString(p, end, nonAscii);
+        if (p == end) {
+            break;
+        }
+        if (*p == '"') {
+            return p + 1;
+        }
+        if (*p == '\\') {
+            escaped = true;
+            p++;
+        }
+    }
+    return nullptr;
+}
+
+// Returns the end of the JSON value starting at p, or nullptr if it is
+// cut short
+const char *skipValue(const char *p, const char *end) {
+    bool escaped;
+    int depth = 0;
+    while (p < end) {
+        switch (*p) {
+        case '"':
+            p = skipString(p, end, escaped);
+            if (p == nullptr) {
+                return nullptr;
+            }
+            if (depth == 0) {
+                return p;
+            }
+            p = scanNesting(p, end);
+            continue;
+        case '{':
+        case '[':
+            depth++;
+            p = scanNesting(p + 1, end);
+            continue;
+        case '}':
+        case ']':
+            if (depth == 0) {
+                return p;
+            }
+            if (--depth == 0) {
+                return p + 1;
+            }
+            p = scanNesting(p + 1, end);
+            continue;
+        case ',':
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            if (depth == 0) {
+                return p;
+            }
+            break;
+        }
+        p++;
+    }
+    return depth == 0 ? p : nullptr;
+}
+
+// Whether text is well-formed UTF-8, without overlong forms or surrogates
+bool validUtf8(const std::string &text) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(text.data());
+    const unsigned char *end = p + text.size();
+    while (p < end) {
+        unsigned char c = *p;
+        if (c < 0x80) {
+            p++;
+            continue;
+        }
+        int length;
+        uint32_t code;
+        uint32_t minimum;
+        if ((c & 0xE0) == 0xC0) {
+            length = 2;
+            code = c & 0x1F;
+            minimum = 0x80;
+        } else if ((c & 0xF0) == 0xE0) {
+            length = 3;
+            code = c & 0x0F;
+            minimum = 0x800;
+        } else if ((c & 0xF8) == 0xF0) {
+            length = 4;
+            code = c & 0x07;
+            minimum = 0x10000;
+        } else {
+            return false;
+        }
+        if (end - p < length) {
+            return false;
+        }
+        for (int i = 1; i < length; i++) {
+            if ((p[i] & 0xC0) != 0x80) {
+                return false;
+            }
+            code = code << 6 | (p[i] & 0x3F);
+        }
+        if (code < minimum || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+            return false;
+        }
+        p += length;
+    }
+    return true;
+}
+
+void appendUtf8(uint32_t code, std::string &out) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | code >> 6));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | code >> 12));
+        out.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | code >> 18));
+        out.push_back(static_cast<char>(0x80 | (code >> 12 & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Marks a field as seen, failing on duplicates, which the protobuf parser
+// treats differently depending on the field
+bool once(unsigned &seen, unsigned field) {
+    if (seen & field) {
+        return false;
+    }
+    seen |= field;
+    return true;
+}
+
+class Parser
+{
+public:
+    Parser(const char *data, size_t size) : mPos(data), mEnd(data + size) { }
+
+    // Parses the whole input as one message
+    template <typename Message>
+    bool document(Message &message) {
+        return this->parse(message) && this->next() == '\0' && this->mPos == this->mEnd;
+    }
+
+private:
+    // Skips whitespace, returning the next char or '\0' at the end
+    char next() {
+        while (this->mPos < this->mEnd) {
+            char c = *this->mPos;
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                return c;
+            }
+            this->mPos++;
+        }
+        return '\0';
+    }
+
+    // Calls member(key) for each member of an object, which parses its value
+    template <typename Member>
+    bool object(Member member) {
+        if (this->next() != '{') {
+            return false;
+        }
+        this->mPos++;
+        if (this->next() == '}') {
+            this->mPos++;
+            return true;
+        }
+        std::string key;
+        while (true) {
+            if (!this->string(key) || this->next() != ':') {
+                return false;
+            }
+            this->mPos++;
+            if (!member(key)) {
+                return false;
+            }
+            char c = this->next();
+            this->mPos++;
+            if (c == '}') {
+                return true;
+            }
+            if (c != ',') {
+                return false;
+            }
+        }
+    }
+
+    // Calls element() for each element of an array, which parses it
+    template <typename Element>
+    bool array(Element element) {
+        if (this->next() != '[') {
+            return false;
+        }
+        this->mPos++;
+        if (this->next() == ']') {
+            this->mPos++;
+            return true;
+        }
+        while (true) {
+            if (!element()) {
+                return false;
+            }
+            char c = this->next();
+            this->mPos++;
+            if (c == ']') {
+                return true;
+            }
+            if (c != ',') {
+                return false;
+            }
+        }
+    }
+
+    bool literal(const char *text, size_t size) {
+        if (static_cast<size_t>(this->mEnd - this->mPos) < size ||
+            std::memcmp(this->mPos, text, size) != 0) {
+            return false;
+        }
+        this->mPos += size;
+        return true;
+    }
+
+    bool string(std::string &out) {
+        if (this->next() != '"') {
+            return false;
+        }
+        this->mPos++;
+        out.clear();
+        bool nonAscii = false;
+        while (true) {
+            const char *stop = scanString(this->mPos, this->mEnd, nonAscii);
+            out.append(this->mPos, stop);
+            this->mPos = stop;
+            if (stop == this->mEnd) {
+                return false;
+            }
+            if (*stop == '"') {
+                this->mPos++;
+                break;
+            }
+            // Raw control characters aren't valid JSON
+            if (*stop != '\\' || !this->escape(out)) {
+                return false;
+            }
+        }
+        return !nonAscii || validUtf8(out);
+    }
+
+    // A string without escapes, as a range of the input
+    bool rawString(const char *&begin, const char *&end) {
+        if (this->next() != '"') {
+            return false;
+        }
+        bool nonAscii = false;
+        begin = this->mPos + 1;
+        end = scanString(begin, this->mEnd, nonAscii);
+        if (end == this->mEnd || *end != '"') {
+            return false;
+        }
+        this->mPos = end + 1;
+        return true;
+    }
+
+    // Appends the escape sequence at the backslash at mPos
+    bool escape(std::string &out) {
+        if (this->mEnd - this->mPos < 2) {
+            return false;
+        }
+        char c = this->mPos[1];
+        this->mPos += 2;
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+            out.push_back(c);
+            return true;
+        case 'b':
+            out.push_back('\b');
+            return true;
+        case 'f':
+            out.push_back('\f');
+            return true;
+        case 'n':
+            out.push_back('\n');
+            return true;
+        case 'r':
+            out.push_back('\r');
+            return true;
+        case 't':
+            out.push_back('\t');
+            return true;
+        case 'u':
+            break;
+        default:
+            return false;
+        }
+
+        uint32_t code;
+        if (!this->hex(code)) {
+            return false;
+        }
+        if (code >= 0xD800 && code <= 0xDBFF) {
+            uint32_t low;
+            if (this->mEnd - this->mPos < 2 || this->mPos[0] != '\\' || this->mPos[1] != 'u') {
+                return false;
+            }
+            this->mPos += 2;
+            if (!this->hex(low) || low < 0xDC00 || low > 0xDFFF) {
+                return false;
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        } else if (code >= 0xDC00 && code <= 0xDFFF) {
+            return false;
+        }
+        appendUtf8(code, out);
+        return true;
+    }
+
+    bool hex(uint32_t &code) {
+        if (this->mEnd - this->mPos < 4) {
+            return false;
+        }
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *this->mPos++;
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= static_cast<uint32_t>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                code |= static_cast<uint32_t>(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                code |= static_cast<uint32_t>(c - 'A' + 10);
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Parses a JSON number. Up to 19 significant digits times a power of
+    // ten that a double holds exactly is exact with one multiplication or
+    // division (Clinger's fast path). Anything else goes through strtod.
+    bool number(double &out) {
+        this->next();
+        const char *start = this->mPos;
+        const char *p = start;
+        const char *end = this->mEnd;
+        bool negative = p < end && *p == '-';
+        if (negative) {
+            p++;
+        }
+        if (p == end || !isDigit(*p)) {
+            return false;
+        }
+
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool truncated = false;
+        bool integer = true;
+        if (*p == '0') {
+            p++;
+        } else {
+            for (; p < end && isDigit(*p); p++) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    digits++;
+                } else {
+                    truncated = true;
+                    exponent++;
+                }
+            }
+        }
+        if (p < end && *p == '.') {
+            integer = false;
+            p++;
+            if (p == end || !isDigit(*p)) {
+                return false;
+            }
+            for (; p < end && isDigit(*p); p++) {
+                if (mantissa == 0 && *p == '0') {
+                    exponent--;
+                } else if (digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    digits++;
+                    exponent--;
+                } else {
+                    truncated = true;
+                }
+            }
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            integer = false;
+            p++;
+            bool negativeExponent = p < end && *p == '-';
+            if (p < end && (*p == '-' || *p == '+')) {
+                p++;
+            }
+            if (p == end || !isDigit(*p)) {
+                return false;
+            }
+            int value = 0;
+            for (; p < end && isDigit(*p); p++) {
+                if (value < 100000) {
+                    value = value * 10 + (*p - '0');
+                }
+            }
+            exponent += negativeExponent ? -value : value;
+        }
+        this->mPos = p;
+
+        if (integer && mantissa == 0) {
+            // The protobuf parser reads integers as such, so -0 is 0
+            out = 0;
+            return true;
+        }
+        if (!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+            double value = static_cast<double>(mantissa);
+            value = exponent < 0 ? value / kPowersOfTen[-exponent] : value * kPowersOfTen[exponent];
+            out = negative ? -value : value;
+            return true;
+        }
+
+        // strtod needs a terminated string. The C locale's decimal point
+        // is assumed, as nothing here sets another.
+        thread_local std::string text;
+        text.assign(start, p);
+        out = std::strtod(text.c_str(), nullptr);
+        // Out of range, which the protobuf parser rejects or rounds its own way
+        return std::isfinite(out) && (out != 0 || mantissa == 0);
+    }
+
+    bool number(float &out) {
+        double value;
+        if (!this->number(value) || std::fabs(value) > FLT_MAX) {
+            return false;
+        }
+        out = static_cast<float>(value);
+        return true;
+    }
+
+    // An integer literal. The protobuf parser also takes 1.0 and "1".
+    bool number(int32_t &out) {
+        this->next();
+        const char *p = this->mPos;
+        bool negative = p < this->mEnd && *p == '-';
+        if (negative) {
+            p++;
+        }
+        const char *digits = p;
+        int64_t value = 0;
+        for (; p < this->mEnd && isDigit(*p) && p - digits < 11; p++) {
+            value = value * 10 + (*p - '0');
+        }
+        if (p == digits || (*digits == '0' && p - digits > 1) ||
+            (p < this->mEnd && (isDigit(*p) || *p == '.' || *p == 'e' || *p == 'E'))) {
+            return false;
+        }
+        value = negative ? -value : value;
+        if (value < INT32_MIN || value > INT32_MAX) {
+            return false;
+        }
+        this->mPos = p;
+        out = static_cast<int32_t>(value);
+        return true;
+    }
+
+    bool parse(Value &value, int depth) {
+        switch (this->next()) {
+        case '{':
+            return depth < kMaxDepth && this->parse(*value.mutable_struct_value(), depth + 1);
+        case '[':
+            return depth < kMaxDepth && this->parse(*value.mutable_list_value(), depth + 1);
+        case '"':
+            return this->string(*value.mutable_string_value());
+        case 't':
+            value.set_bool_value(true);
+            return this->literal("true", 4);
+        case 'f':
+            value.set_bool_value(false);
+            return this->literal("false", 5);
+        case 'n':
+            value.set_null_value(google::protobuf::NULL_VALUE);
+            return this->literal("null", 4);
+        default:
+            double number;
+            if (!this->number(number)) {
+                return false;
+            }
+            value.set_number_value(number);
+            return true;
+        }
+    }
+
+    bool parse(ListValue &list, int depth) {
+        return this->array([&]() { return this->parse(*list.add_values(), depth); });
+    }
+
+    bool parse(Struct &object, int depth) {
+        auto &fields = *object.mutable_fields();
+        return this->object([&](const std::string &key) {
+            return fields.count(key) == 0 && this->parse(fields[key], depth);
+        });
+    }
+
+    bool parse(protos::Tensor &tensor) {
+        unsigned seen = 0;
+        return this->object([&](const std::string &key) {
+            if (key == "shape") {
+                auto &shape = *tensor.mutable_shape();
+                return once(seen, 1) && this->array([&]() {
+                    int32_t dimension;
+                    if (!this->number(dimension)) {
+                        return false;
+                    }
+                    shape.Add(dimension);
+                    return true;
+                });
+            }
+            if (key == "values") {
+                auto &values = *tensor.mutable_values();
+                return once(seen, 2) && this->array([&]() {
+                    double value;
+                    if (!this->number(value)) {
+                        return false;
+                    }
+                    values.Add(value);
+                    return true;
+                });
+            }
+            return false;
+        });
+    }
+
+    bool parse(protos::DefaultData &data) {
+        unsigned seen = 0;
+        return this->object([&](const std::string &key) {
+            if (key == "names") {
+                return once(seen, 1) &&
+                       this->array([&]() { return this->string(*data.add_names()); });
+            }
+            if (data.data_oneof_case() != protos::DefaultData::DATA_ONEOF_NOT_SET) {
+                return false;
+            }
+            if (key == "tensor") {
+                return this->parse(*data.mutable_tensor());
+            }
+            if (key == "ndarray") {
+                return this->parse(*data.mutable_ndarray(), 0);
+            }
+            // tftensor is left to the protobuf parser
+            return false;
+        });
+    }
+
+    bool parse(protos::Status &status) {
+        unsigned seen = 0;
+        return this->object([&](const std::string &key) {
+            if (key == "code") {
+                int32_t code;
+                if (!once(seen, 1) || !this->number(code)) {
+                    return false;
+                }
+                status.set_code(code);
+                return true;
+            }
+            if (key == "info") {
+                return once(seen, 2) && this->string(*status.mutable_info());
+            }
+            if (key == "reason") {
+                return once(seen, 4) && this->string(*status.mutable_reason());
+            }
+            if (key == "status") {
+                protos::Status::StatusFlag flag;
+                if (!once(seen, 8) || !this->string(this->mScratch) ||
+                    !protos::Status::StatusFlag_Parse(this->mScratch, &flag)) {
+                    return false;
+                }
+                status.set_status(flag);
+                return true;
+            }
+            return false;
+        });
+    }
+
+    bool parse(protos::Metric &metric) {
+        unsigned seen = 0;
+        return this->object([&](const std::string &key) {
+            if (key == "key") {
+                return once(seen, 1) && this->string(*metric.mutable_key());
+            }
+            if (key == "type") {
+                protos::Metric::MetricType type;
+                if (!once(seen, 2) || !this->string(this->mScratch) ||
+                    !protos::Metric::MetricType_Parse(this->mScratch, &type)) {
+                    return false;
+                }
+                metric.set_type(type);
+                return true;
+            }
+            if (key == "value") {
+                float value;
+                if (!once(seen, 4) || !this->number(value)) {
+                    return false;
+                }
+                metric.set_value(value);
+                return true;
+            }
+            if (key == "tags") {
+                auto &tags = *metric.mutable_tags();
+                return once(seen, 8) && this->object([&](const std::string &tag) {
+                    return tags.count(tag) == 0 && this->string(tags[tag]);
+                });
+            }
+            return false;
+        });
+    }
+
+    bool parse(protos::Meta &meta) {
+        unsigned seen = 0;
+        return this->object([&](const std::string &key) {
+            if (key == "puid") {
+                return once(seen, 1) && this->string(*meta.mutable_puid());
+            }
+            if (key == "tags") {
+                auto &tags = *meta.mutable_tags();
+                return once(seen, 2) && this->object([&](const std::string &tag) {
+                    return tags.count(tag) == 0 && this->parse(tags[tag], 0);
+                });
+            }
+            if (key == "routing") {
+                auto &routing = *meta.mutable_routing();
+                return once(seen, 4) && this->object([&](const std::string &unit) {
+                    return routing.count(unit) == 0 && this->number(routing[unit]);
+                });
+            }
+            if (key == "requestPath") {
+                auto &requestPath = *meta.mutable_requestpath();
+                return once(seen, 8) && this->object([&](const std::string &unit) {
+                    return requestPath.count(unit) == 0 && this->string(requestPath[unit]);
+                });
+            }
+            if (key == "metrics") {
+                return once(seen, 16) &&
+                       this->array([&]() { return this->parse(*meta.add_metrics()); });
+            }
+            return false;
+        });
+    }
+
+    bool parse(protos::SeldonMessage &message) {
+        unsigned seen = 0;
+        return this->object([&](const std::string &key) {
+            if (key == "status") {
+                return once(seen, 1) && this->parse(*message.mutable_status());
+            }
+            if (key == "meta") {
+                return once(seen, 2) && this->parse(*message.mutable_meta());
+            }
+            if (message.data_oneof_case() != protos::SeldonMessage::DATA_ONEOF_NOT_SET) {
+                return false;
+            }
+            if (key == "data") {
+                return this->parse(*message.mutable_data());
+            }
+            if (key == "binData") {
+                const char *begin;
+                const char *end;
+                return this->rawString(begin, end) &&
+                       base64::decode(begin, static_cast<size_t>(end - begin),
+                                      *message.mutable_bindata());
+            }
+            if (key == "strData") {
+                return this->string(*message.mutable_strdata());
+            }
+            if (key == "jsonData") {
+                return this->parse(*message.mutable_jsondata(), 0);
+            }
+            // customData is left to the protobuf parser
+            return false;
+        });
+    }
+
+    bool parse(protos::SeldonMessageList &list) {
+        unsigned seen = 0;
+        return this->object([&](const std::string &key) {
+            return key == "seldonMessages" && once(seen, 1) &&
+                   this->array([&]() { return this->parse(*list.add_seldonmessages()); });
+        });
+    }
+
+    bool parse(protos::Feedback &feedback) {
+        unsigned seen = 0;
+        return this->object([&](const std::string &key) {
+            if (key == "request") {
+                return once(seen, 1) && this->parse(*feedback.mutable_request());
+            }
+            if (key == "response") {
+                return once(seen, 2) && this->parse(*feedback.mutable_response());
+            }
+            if (key == "reward") {
+                float reward;
+                if (!once(seen, 4) || !this->number(reward)) {
+                    return false;
+                }
+                feedback.set_reward(reward);
+                return true;
+            }
+            if (key == "truth") {
+                return once(seen, 8) && this->parse(*feedback.mutable_truth());
+            }
+            return false;
+        });
+    }
+
+    const char *mPos;
+    const char *mEnd;
+    // Enum names
+    std::string mScratch;
+};
+
+}
+
+bool decode(const char *data, size_t size, protos::SeldonMessage &message) {
+    return Parser(data, size).document(message);
+}
+
+bool decode(const char *data, size_t size, protos::SeldonMessageList &list) {
+    return Parser(data, size).document(list);
+}
+
+bool decode(const char *data, size_t size, protos::Feedback &feedback) {
+    return Parser(data, size).document(feedback);
+}
+
+bool scanObject(const char *data, size_t size, const MemberCallback &member) {
+    const char *last = data + size;
+    const char *p = skipSpace(data, last);
+    if (p == last || *p != '{') {
+        return false;
+    }
+    p = skipSpace(p + 1, last);
+    if (p < last && *p == '}') {
+        return skipSpace(p + 1, last) == last;
+    }
+    while (p < last && *p == '"') {
+        bool escaped;
+        const char *key = p + 1;
+        p = skipString(p, last, escaped);
+        if (p == nullptr || escaped) {
+            return false;
+        }
+        size_t keySize = static_cast<size_t>(p - 1 - key);
+        p = skipSpace(p, last);
+        if (p == last || *p != ':') {
+            return false;
+        }
+        const char *value = skipSpace(p + 1, last);
+        p = skipValue(value, last);
+        if (p == nullptr || p == value || !member(key, keySize, value, p)) {
+            return false;
+        }
+        p = skipSpace(p, last);
+        if (p == last) {
+            return false;
+        }
+        if (*p == '}') {
+            return skipSpace(p + 1, last) == last;
+        }
+        if (*p != ',') {
+            return false;
+        }
+        p = skipSpace(p + 1, last);
+    }
+    return false;
+}
+
+}
+}
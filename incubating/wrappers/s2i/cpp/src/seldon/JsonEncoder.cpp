@@ -0,0 +1,1124 @@
+#include "seldon/JsonEncoder.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "seldon/Base64.hpp"
+#include "seldon/Environment.hpp"
+#include "seldon/Ndarray.hpp"
+#include "seldon/TensorView.hpp"
+
+namespace seldon {
+namespace json {
+
+namespace {
+
+using google::protobuf::ListValue;
+using google::protobuf::Value;
+
+// Makes room for size more chars at the end of out and returns where they
+// start, so a field can be written without a bounds check per char. commit
+// trims out back to what was written.
+char *reserve(std::string &out, size_t size) {
+    size_t used = out.size();
+    out.resize(used + size);
+    return &out[used];
+}
+
+void commit(std::string &out, const char *end) {
+    out.resize(static_cast<size_t>(end - out.data()));
+}
+
+// 128-bit products, which GCC and Clang have a type for on 64-bit targets
+struct Product
+{
+    uint64_t high;
+    uint64_t low;
+};
+
+Product multiply(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return {static_cast<uint64_t>(product >> 64), static_cast<uint64_t>(product)};
+#else
+    uint64_t aLow = a & 0xFFFFFFFF;
+    uint64_t aHigh = a >> 32;
+    uint64_t bLow = b & 0xFFFFFFFF;
+    uint64_t bHigh = b >> 32;
+    uint64_t lowLow = aLow * bLow;
+    uint64_t highLow = aHigh * bLow;
+    uint64_t lowHigh = aLow * bHigh;
+    uint64_t middle = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + (lowHigh & 0xFFFFFFFF);
+    return {aHigh * bHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32),
+            (middle << 32) | (lowLow & 0xFFFFFFFF)};
+#endif
+}
+
+// Powers of ten a double's shortest decimal can need to be scaled by
+constexpr int kMinPow10 = -292;
+constexpr int kMaxPow10 = 324;
+
+// floor(log2(10^e)), floor(log10(2^e)) and floor(log10(3/4 * 2^e)) for the
+// exponents of doubles
+int floorLog2Pow10(int e) {
+    return (e * 1741647) >> 19;
+}
+
+int floorLog10Pow2(int e) {
+    return (e * 1262611) >> 22;
+}
+
+int floorLog10ThreeQuartersPow2(int e) {
+    return (e * 1262611 - 524031) >> 22;
+}
+
+// 10^e as a 128-bit g with 2^127 <= g < 2^128, rounded up from
+// 10^e / 2^(floorLog2Pow10(e) - 127). The table is worked out with exact
+// multiple precision arithmetic on first use, rather than pasted in.
+class Pow10Table
+{
+public:
+    Pow10Table() {
+        // 10^e for e >= 0, in 32-bit limbs with the least significant first
+        std::vector<uint32_t> power = {1};
+        for (int e = 0; e <= kMaxPow10; e++) {
+            if (e > 0) {
+                multiplyBy10(power);
+            }
+            this->set(e, power);
+        }
+        // 2^kShift / 10^e rounded down, which has the leading bits of 10^-e
+        // as long as it keeps more than 128 of them
+        constexpr int kShift = 1120;
+        std::vector<uint32_t> quotient(kShift / 32 + 1, 0);
+        quotient.back() = 1u << (kShift % 32);
+        for (int e = 1; e <= -kMinPow10; e++) {
+            divideBy10(quotient);
+            this->set(-e, quotient);
+        }
+    }
+
+    const Product &operator[](int e) const {
+        return this->mPowers[e - kMinPow10];
+    }
+
+private:
+    static void multiplyBy10(std::vector<uint32_t> &number) {
+        uint64_t carry = 0;
+        for (uint32_t &limb : number) {
+            uint64_t product = static_cast<uint64_t>(limb) * 10 + carry;
+            limb = static_cast<uint32_t>(product);
+            carry = product >> 32;
+        }
+        if (carry != 0) {
+            number.push_back(static_cast<uint32_t>(carry));
+        }
+    }
+
+    static void divideBy10(std::vector<uint32_t> &number) {
+        uint64_t remainder = 0;
+        for (size_t i = number.size(); i-- > 0;) {
+            uint64_t dividend = remainder << 32 | number[i];
+            number[i] = static_cast<uint32_t>(dividend / 10);
+            remainder = dividend % 10;
+        }
+        while (number.size() > 1 && number.back() == 0) {
+            number.pop_back();
+        }
+    }
+
+    // The 64 bits of number from bit from up, with zeros below bit 0
+    static uint64_t bits(const std::vector<uint32_t> &number, int from) {
+        uint64_t result = 0;
+        for (int bit = from + 63; bit >= from; bit--) {
+            result <<= 1;
+            if (bit >= 0 && static_cast<size_t>(bit / 32) < number.size()) {
+                result |= (number[static_cast<size_t>(bit / 32)] >> (bit % 32)) & 1;
+            }
+        }
+        return result;
+    }
+
+    void set(int e, const std::vector<uint32_t> &number) {
+        int length = static_cast<int>(number.size() - 1) * 32;
+        for (uint32_t top = number.back(); top != 0; top >>= 1) {
+            length++;
+        }
+        Product &power = this->mPowers[e - kMinPow10];
+        power.high = bits(number, length - 64);
+        power.low = bits(number, length - 128);
+        if (++power.low == 0) {
+            power.high++;
+        }
+    }
+
+    Product mPowers[kMaxPow10 - kMinPow10 + 1];
+};
+
+const Pow10Table &pow10() {
+    static const Pow10Table table;
+    return table;
+}
+
+// g * cp / 2^128, with its lowest bit set if that isn't exact
+uint64_t roundToOdd(const Product &g, uint64_t cp) {
+    Product low = multiply(g.low, cp);
+    Product high = multiply(g.high, cp);
+    uint64_t middle = high.low + low.high;
+    uint64_t top = high.high + (middle < high.low);
+    return top | (middle > 1);
+}
+
+// significand * 10^exponent
+struct Decimal
+{
+    uint64_t significand;
+    int exponent;
+};
+
+// The shortest decimal in the interval that rounds to c * 2^q, and the
+// closest to it if there are several, with the Schubfach algorithm.
+// lowerCloser is set when the next float down is nearer than the next up.
+Decimal shortest(uint64_t c, int q, bool lowerCloser) {
+    bool even = (c & 1) == 0;
+    uint64_t cbl = 4 * c - 2 + lowerCloser;
+    uint64_t cb = 4 * c;
+    uint64_t cbr = 4 * c + 2;
+
+    int k = lowerCloser ? floorLog10ThreeQuartersPow2(q) : floorLog10Pow2(q);
+    int h = q + floorLog2Pow10(-k) + 1;
+    const Product &g = pow10()[-k];
+    uint64_t vbl = roundToOdd(g, cbl << h);
+    uint64_t vb = roundToOdd(g, cb << h);
+    uint64_t vbr = roundToOdd(g, cbr << h);
+
+    uint64_t lower = vbl + !even;
+    uint64_t upper = vbr - !even;
+
+    // One digit fewer than s, when exactly one of its neighbours is in
+    // the interval
+    uint64_t s = vb / 4;
+    if (s >= 10) {
+        uint64_t sp = s / 10;
+        bool upInside = lower <= 40 * sp;
+        bool wpInside = 40 * sp + 40 <= upper;
+        if (upInside != wpInside) {
+            return {sp + wpInside, k + 1};
+        }
+    }
+
+    bool uInside = lower <= 4 * s;
+    bool wInside = 4 * s + 4 <= upper;
+    if (uInside != wInside) {
+        return {s + wInside, k};
+    }
+
+    uint64_t middle = 4 * s + 2;
+    bool roundUp = vb > middle || (vb == middle && (s & 1) != 0);
+    return {s + roundUp, k};
+}
+
+// Nonzero, finite values only. Integers that are exact in the significand
+// are their own shortest decimal.
+Decimal shortest(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint64_t fraction = bits & ((uint64_t(1) << 52) - 1);
+    int exponent = static_cast<int>(bits >> 52 & 0x7FF);
+    if (exponent == 0) {
+        return shortest(fraction, -1074, false);
+    }
+
+    uint64_t c = fraction | uint64_t(1) << 52;
+    int q = exponent - 1075;
+    if (q <= 0 && q >= -52 && (c & ((uint64_t(1) << -q) - 1)) == 0) {
+        return {c >> -q, 0};
+    }
+    return shortest(c, q, fraction == 0 && exponent > 1);
+}
+
+Decimal shortest(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t fraction = bits & ((uint32_t(1) << 23) - 1);
+    int exponent = static_cast<int>(bits >> 23 & 0xFF);
+    if (exponent == 0) {
+        return shortest(fraction, -149, false);
+    }
+
+    uint64_t c = fraction | uint32_t(1) << 23;
+    int q = exponent - 150;
+    if (q <= 0 && q >= -23 && (c & ((uint64_t(1) << -q) - 1)) == 0) {
+        return {c >> -q, 0};
+    }
+    return shortest(c, q, fraction == 0 && exponent > 1);
+}
+
+const char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes the digits of value to the end of a buffer, returning where they
+// start
+char *writeDigits(uint64_t value, char *end) {
+    while (value >= 100) {
+        end -= 2;
+        std::memcpy(end, kDigitPairs + value % 100 * 2, 2);
+        value /= 100;
+    }
+    if (value >= 10) {
+        end -= 2;
+        std::memcpy(end, kDigitPairs + value * 2, 2);
+    } else {
+        *--end = static_cast<char>('0' + value);
+    }
+    return end;
+}
+
+char *writeUnsigned(uint64_t value, char *out) {
+    char buffer[20];
+    char *end = buffer + sizeof(buffer);
+    char *begin = writeDigits(value, end);
+    std::memcpy(out, begin, static_cast<size_t>(end - begin));
+    return out + (end - begin);
+}
+
+// Writes decimal as Python's repr writes floats, fixed from 1e-4 up to
+// 1e16 and with an exponent otherwise, but without the ".0" it gives
+// integers, as the protobuf printer writes them
+char *writeDecimal(Decimal decimal, char *out) {
+    while (decimal.significand % 10 == 0) {
+        decimal.significand /= 10;
+        decimal.exponent++;
+    }
+
+    char buffer[20];
+    char *end = buffer + sizeof(buffer);
+    const char *digits = writeDigits(decimal.significand, end);
+    int length = static_cast<int>(end - digits);
+    int point = decimal.exponent + length - 1;
+
+    if (point >= -4 && point < 16) {
+        if (decimal.exponent >= 0) {
+            std::memcpy(out, digits, static_cast<size_t>(length));
+            out += length;
+            std::memset(out, '0', static_cast<size_t>(decimal.exponent));
+            return out + decimal.exponent;
+        }
+        if (point >= 0) {
+            std::memcpy(out, digits, static_cast<size_t>(point + 1));
+            out += point + 1;
+            *out++ = '.';
+            std::memcpy(out, digits + point + 1, static_cast<size_t>(length - point - 1));
+            return out + (length - point - 1);
+        }
+        *out++ = '0';
+        *out++ = '.';
+        std::memset(out, '0', static_cast<size_t>(-point - 1));
+        out += -point - 1;
+        std::memcpy(out, digits, static_cast<size_t>(length));
+        return out + length;
+    }
+
+    *out++ = digits[0];
+    if (length > 1) {
+        *out++ = '.';
+        std::memcpy(out, digits + 1, static_cast<size_t>(length - 1));
+        out += length - 1;
+    }
+    *out++ = 'e';
+    *out++ = point < 0 ? '-' : '+';
+    unsigned magnitude = static_cast<unsigned>(point < 0 ? -point : point);
+    if (magnitude >= 100) {
+        *out++ = static_cast<char>('0' + magnitude / 100);
+        magnitude %= 100;
+    }
+    std::memcpy(out, kDigitPairs + magnitude * 2, 2);
+    return out + 2;
+}
+
+// Writes NaN, the infinities and zeros, returning nullptr for anything
+// else
+template <typename T>
+char *writeSpecial(T value, char *out) {
+    const char *text;
+    if (std::isnan(value)) {
+        text = "\"NaN\"";
+    } else if (std::isinf(value)) {
+        text = value > 0 ? "\"Infinity\"" : "\"-Infinity\"";
+    } else if (value == 0) {
+        text = std::signbit(value) ? "-0" : "0";
+    } else {
+        return nullptr;
+    }
+    size_t length = std::strlen(text);
+    std::memcpy(out, text, length);
+    return out + length;
+}
+
+// Code points past ASCII that the protobuf printer escapes, which are
+// invisible or change the direction of text
+bool escapedCode(uint32_t code) {
+    return (code >= 0x7F && code <= 0x9F) || code == 0xAD || (code >= 0x600 && code <= 0x603) ||
+           code == 0x6DD || code == 0x70F || code == 0x17B4 || code == 0x17B5 ||
+           (code >= 0x200B && code <= 0x200F) || (code >= 0x2028 && code <= 0x202E) ||
+           (code >= 0x2060 && code <= 0x2064) || (code >= 0x206A && code <= 0x206F) ||
+           code == 0xFEFF || (code >= 0xFFF9 && code <= 0xFFFB) ||
+           (code >= 0x1D173 && code <= 0x1D17A) || code == 0xE0001 ||
+           (code >= 0xE0020 && code <= 0xE007F);
+}
+
+// How each ASCII char is written: 0 as it is, 1 as a \u escape, and
+// anything else as that char after a backslash
+struct AsciiEscapes
+{
+    constexpr AsciiEscapes() : table() {
+        for (int c = 0; c < 0x20; c++) {
+            this->table[c] = 1;
+        }
+        this->table['\b'] = 'b';
+        this->table['\t'] = 't';
+        this->table['\n'] = 'n';
+        this->table['\f'] = 'f';
+        this->table['\r'] = 'r';
+        this->table['"'] = '"';
+        this->table['\\'] = '\\';
+        this->table['<'] = 1;
+        this->table['>'] = 1;
+        this->table[0x7F] = 1;
+    }
+
+    char table[128];
+};
+
+constexpr AsciiEscapes kAsciiEscapes;
+
+char *writeUnicodeEscape(uint32_t unit, char *out) {
+    static const char kHex[] = "0123456789abcdef";
+    out[0] = '\\';
+    out[1] = 'u';
+    out[2] = kHex[unit >> 12 & 0xF];
+    out[3] = kHex[unit >> 8 & 0xF];
+    out[4] = kHex[unit >> 4 & 0xF];
+    out[5] = kHex[unit & 0xF];
+    return out + 6;
+}
+
+// Reads the UTF-8 sequence of length bytes at p, returning false if it is
+// malformed, overlong or a surrogate
+bool readUtf8(const unsigned char *p, int length, uint32_t &code) {
+    static const uint32_t kMinimum[] = {0, 0, 0x80, 0x800, 0x10000};
+    code = p[0] & (0x7F >> length);
+    for (int i = 1; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return false;
+        }
+        code = code << 6 | (p[i] & 0x3F);
+    }
+    return code >= kMinimum[length] && code <= 0x10FFFF && (code < 0xD800 || code > 0xDFFF);
+}
+
+int utf8Length(unsigned char lead) {
+    if ((lead & 0xE0) == 0xC0) {
+        return 2;
+    }
+    if ((lead & 0xF0) == 0xE0) {
+        return 3;
+    }
+    if ((lead & 0xF8) == 0xF0) {
+        return 4;
+    }
+    return 0;
+}
+
+bool defaultTensorDtype(const tensorflow::TensorProto &tensor) {
+    switch (tensor.dtype()) {
+    case tensorflow::DT_FLOAT:
+    case tensorflow::DT_DOUBLE:
+    case tensorflow::DT_INT8:
+    case tensorflow::DT_INT16:
+    case tensorflow::DT_INT32:
+    case tensorflow::DT_INT64:
+    case tensorflow::DT_UINT8:
+    case tensorflow::DT_UINT16:
+    case tensorflow::DT_UINT32:
+    case tensorflow::DT_UINT64:
+    case tensorflow::DT_BOOL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Protobuf writes float fields that are +0 or -0 as absent
+bool isZero(float value) {
+    return value <= 0 && value >= 0;
+}
+
+class Encoder
+{
+public:
+    Encoder(std::string &out, const EncodeOptions &options) : mOut(out), mOptions(options) { }
+
+    bool message(const protos::SeldonMessage &message) {
+        this->mOut.push_back('{');
+        bool first = true;
+        if (message.has_status() &&
+            !(this->mOptions.omitDefaults && message.status().ByteSizeLong() == 0)) {
+            this->key(first, "status");
+            this->status(message.status());
+        }
+        if (message.has_meta() &&
+            !(this->mOptions.omitDefaults && message.meta().ByteSizeLong() == 0)) {
+            this->key(first, "meta");
+            this->meta(message.meta());
+        }
+        switch (message.data_oneof_case()) {
+        case protos::SeldonMessage::kData:
+            this->key(first, "data");
+            this->data(message.data());
+            break;
+        case protos::SeldonMessage::kBinData:
+            this->key(first, "binData");
+            this->bytes(message.bindata());
+            break;
+        case protos::SeldonMessage::kStrData:
+            this->key(first, "strData");
+            this->string(message.strdata());
+            break;
+        case protos::SeldonMessage::kJsonData:
+            // As for any Value, protobuf leaves out one with no kind
+            if (message.jsondata().kind_case() != Value::KIND_NOT_SET) {
+                this->key(first, "jsonData");
+                this->value(message.jsondata());
+            }
+            break;
+        case protos::SeldonMessage::kCustomData:
+            return false;
+        case protos::SeldonMessage::DATA_ONEOF_NOT_SET:
+            break;
+        }
+        this->mOut.push_back('}');
+        return this->mValid;
+    }
+
+private:
+    void key(bool &first, const char *name) {
+        this->mOut.append(first ? "\"" : ",\"");
+        this->mOut.append(name);
+        this->mOut.append("\":");
+        first = false;
+    }
+
+    template <typename T>
+    void number(T value) {
+        char *p = reserve(this->mOut, kMaxNumberSize);
+        commit(this->mOut, writeNumber(value, p));
+    }
+
+    template <typename T>
+    void numbers(const google::protobuf::RepeatedField<T> &values) {
+        char *p = reserve(this->mOut, values.size() * (kMaxNumberSize + 1) + 2);
+        *p++ = '[';
+        for (int i = 0; i < values.size(); i++) {
+            if (i > 0) {
+                *p++ = ',';
+            }
+            p = writeNumber(values.Get(i), p);
+        }
+        *p++ = ']';
+        commit(this->mOut, p);
+    }
+
+    void floats(const google::protobuf::RepeatedField<float> &values) {
+        int digits = this->mOptions.floatDigits;
+        char *p = reserve(this->mOut, values.size() * (kMaxNumberSize + 1) + 2);
+        *p++ = '[';
+        for (int i = 0; i < values.size(); i++) {
+            if (i > 0) {
+                *p++ = ',';
+            }
+            p = writeNumber(values.Get(i), digits, p);
+        }
+        *p++ = ']';
+        commit(this->mOut, p);
+    }
+
+    // 64-bit integers are quoted, as JavaScript can't hold them all
+    void quoted(const google::protobuf::RepeatedField<int64_t> &values) {
+        char *p = reserve(this->mOut, values.size() * (kMaxNumberSize + 3) + 2);
+        *p++ = '[';
+        for (int i = 0; i < values.size(); i++) {
+            if (i > 0) {
+                *p++ = ',';
+            }
+            *p++ = '"';
+            p = writeNumber(values.Get(i), p);
+            *p++ = '"';
+        }
+        *p++ = ']';
+        commit(this->mOut, p);
+    }
+
+    void quoted(const google::protobuf::RepeatedField<uint64_t> &values) {
+        char *p = reserve(this->mOut, values.size() * (kMaxNumberSize + 3) + 2);
+        *p++ = '[';
+        for (int i = 0; i < values.size(); i++) {
+            if (i > 0) {
+                *p++ = ',';
+            }
+            *p++ = '"';
+            p = writeUnsigned(values.Get(i), p);
+            *p++ = '"';
+        }
+        *p++ = ']';
+        commit(this->mOut, p);
+    }
+
+    void numbers(const google::protobuf::RepeatedField<uint32_t> &values) {
+        char *p = reserve(this->mOut, values.size() * (kMaxNumberSize + 1) + 2);
+        *p++ = '[';
+        for (int i = 0; i < values.size(); i++) {
+            if (i > 0) {
+                *p++ = ',';
+            }
+            p = writeUnsigned(values.Get(i), p);
+        }
+        *p++ = ']';
+        commit(this->mOut, p);
+    }
+
+    void booleans(const google::protobuf::RepeatedField<bool> &values) {
+        this->mOut.push_back('[');
+        for (int i = 0; i < values.size(); i++) {
+            if (i > 0) {
+                this->mOut.push_back(',');
+            }
+            this->mOut.append(values.Get(i) ? "true" : "false");
+        }
+        this->mOut.push_back(']');
+    }
+
+    void string(const std::string &text) {
+        // No char takes more than 6 to write
+        char *p = reserve(this->mOut, text.size() * 6 + 2);
+        const unsigned char *in = reinterpret_cast<const unsigned char *>(text.data());
+        const unsigned char *end = in + text.size();
+        *p++ = '"';
+        while (in < end) {
+            unsigned char c = *in;
+            if (c < 0x80) {
+                char escape = kAsciiEscapes.table[c];
+                if (escape == 0) {
+                    *p++ = static_cast<char>(c);
+                } else if (escape == 1) {
+                    p = writeUnicodeEscape(c, p);
+                } else {
+                    *p++ = '\\';
+                    *p++ = escape;
+                }
+                in++;
+                continue;
+            }
+
+            int length = utf8Length(c);
+            uint32_t code;
+            if (length == 0 || end - in < length || !readUtf8(in, length, code)) {
+                this->mValid = false;
+                break;
+            }
+            if (!escapedCode(code)) {
+                std::memcpy(p, in, static_cast<size_t>(length));
+                p += length;
+            } else if (code < 0x10000) {
+                p = writeUnicodeEscape(code, p);
+            } else {
+                code -= 0x10000;
+                p = writeUnicodeEscape(0xD800 + (code >> 10), p);
+                p = writeUnicodeEscape(0xDC00 + (code & 0x3FF), p);
+            }
+            in += length;
+        }
+        *p++ = '"';
+        commit(this->mOut, p);
+    }
+
+    void strings(const google::protobuf::RepeatedPtrField<std::string> &values) {
+        this->mOut.push_back('[');
+        for (int i = 0; i < values.size(); i++) {
+            if (i > 0) {
+                this->mOut.push_back(',');
+            }
+            this->string(values.Get(i));
+        }
+        this->mOut.push_back(']');
+    }
+
+    void bytes(const std::string &data) {
+        this->mOut.push_back('"');
+        base64::append(data.data(), data.size(), this->mOut);
+        this->mOut.push_back('"');
+    }
+
+    // Enums are written by name, or by number if they have none
+    void enumValue(const google::protobuf::EnumDescriptor *descriptor, int value) {
+        const google::protobuf::EnumValueDescriptor *named = descriptor->FindValueByNumber(value);
+        if (named != nullptr) {
+            this->mOut.push_back('"');
+            this->mOut.append(named->name());
+            this->mOut.push_back('"');
+        } else {
+            this->number(value);
+        }
+    }
+
+    void value(const Value &value) {
+        switch (value.kind_case()) {
+        case Value::kNullValue:
+            this->mOut.append("null");
+            break;
+        case Value::kNumberValue:
+            this->number(value.number_value());
+            break;
+        case Value::kStringValue:
+            this->string(value.string_value());
+            break;
+        case Value::kBoolValue:
+            this->mOut.append(value.bool_value() ? "true" : "false");
+            break;
+        case Value::kStructValue:
+            this->fields(value.struct_value().fields());
+            break;
+        case Value::kListValue:
+            this->list(value.list_value());
+            break;
+        case Value::KIND_NOT_SET:
+            break;
+        }
+    }
+
+    void list(const ListValue &list) {
+        // Rows of numbers, as in most ndarrays, are written in one go
+        bool numeric = true;
+        for (const Value &value : list.values()) {
+            if (value.kind_case() != Value::kNumberValue) {
+                numeric = false;
+                break;
+            }
+        }
+        if (numeric) {
+            char *p = reserve(this->mOut, list.values_size() * (kMaxNumberSize + 1) + 2);
+            *p++ = '[';
+            for (int i = 0; i < list.values_size(); i++) {
+                if (i > 0) {
+                    *p++ = ',';
+                }
+                p = writeNumber(list.values(i).number_value(), p);
+            }
+            *p++ = ']';
+            commit(this->mOut, p);
+            return;
+        }
+
+        this->mOut.push_back('[');
+        bool first = true;
+        for (const Value &value : list.values()) {
+            if (value.kind_case() == Value::KIND_NOT_SET) {
+                continue;
+            }
+            if (!first) {
+                this->mOut.push_back(',');
+            }
+            first = false;
+            this->value(value);
+        }
+        this->mOut.push_back(']');
+    }
+
+    void fields(const google::protobuf::Map<std::string, Value> &fields) {
+        this->mOut.push_back('{');
+        bool first = true;
+        for (const auto &field : fields) {
+            if (field.second.kind_case() == Value::KIND_NOT_SET) {
+                continue;
+            }
+            if (!first) {
+                this->mOut.push_back(',');
+            }
+            first = false;
+            this->string(field.first);
+            this->mOut.push_back(':');
+            this->value(field.second);
+        }
+        this->mOut.push_back('}');
+    }
+
+    void strings(const google::protobuf::Map<std::string, std::string> &map) {
+        this->mOut.push_back('{');
+        bool first = true;
+        for (const auto &entry : map) {
+            if (!first) {
+                this->mOut.push_back(',');
+            }
+            first = false;
+            this->string(entry.first);
+            this->mOut.push_back(':');
+            this->string(entry.second);
+        }
+        this->mOut.push_back('}');
+    }
+
+    void status(const protos::Status &status) {
+        this->mOut.push_back('{');
+        bool first = true;
+        if (status.code() != 0) {
+            this->key(first, "code");
+            this->number(status.code());
+        }
+        if (!status.info().empty()) {
+            this->key(first, "info");
+            this->string(status.info());
+        }
+        if (!status.reason().empty()) {
+            this->key(first, "reason");
+            this->string(status.reason());
+        }
+        if (status.status() != 0) {
+            this->key(first, "status");
+            this->enumValue(protos::Status::StatusFlag_descriptor(), status.status());
+        }
+        this->mOut.push_back('}');
+    }
+
+    void meta(const protos::Meta &meta) {
+        this->mOut.push_back('{');
+        bool first = true;
+        if (!meta.puid().empty()) {
+            this->key(first, "puid");
+            this->string(meta.puid());
+        }
+        if (!meta.tags().empty()) {
+            this->key(first, "tags");
+            this->fields(meta.tags());
+        }
+        if (!meta.routing().empty()) {
+            this->key(first, "routing");
+            this->mOut.push_back('{');
+            bool firstRoute = true;
+            for (const auto &route : meta.routing()) {
+                if (!firstRoute) {
+                    this->mOut.push_back(',');
+                }
+                firstRoute = false;
+                this->string(route.first);
+                this->mOut.push_back(':');
+                this->number(route.second);
+            }
+            this->mOut.push_back('}');
+        }
+        if (!meta.requestpath().empty()) {
+            this->key(first, "requestPath");
+            this->strings(meta.requestpath());
+        }
+        if (meta.metrics_size() > 0) {
+            this->key(first, "metrics");
+            this->mOut.push_back('[');
+            for (int i = 0; i < meta.metrics_size(); i++) {
+                if (i > 0) {
+                    this->mOut.push_back(',');
+                }
+                this->metric(meta.metrics(i));
+            }
+            this->mOut.push_back(']');
+        }
+        this->mOut.push_back('}');
+    }
+
+    void metric(const protos::Metric &metric) {
+        this->mOut.push_back('{');
+        bool first = true;
+        if (!metric.key().empty()) {
+            this->key(first, "key");
+            this->string(metric.key());
+        }
+        if (metric.type() != 0) {
+            this->key(first, "type");
+            this->enumValue(protos::Metric::MetricType_descriptor(), metric.type());
+        }
+        if (!isZero(metric.value())) {
+            this->key(first, "value");
+            this->number(metric.value());
+        }
+        if (!metric.tags().empty()) {
+            this->key(first, "tags");
+            this->strings(metric.tags());
+        }
+        this->mOut.push_back('}');
+    }
+
+    void data(const protos::DefaultData &data) {
+        this->mOut.push_back('{');
+        bool first = true;
+        if (data.names_size() > 0) {
+            this->key(first, "names");
+            this->strings(data.names());
+        }
+        switch (data.data_oneof_case()) {
+        case protos::DefaultData::kTensor:
+            if (this->mOptions.ndarray) {
+                this->key(first, "ndarray");
+                this->denseNdarray<double>(data);
+            } else {
+                this->key(first, "tensor");
+                this->tensor(data.tensor());
+            }
+            break;
+        case protos::DefaultData::kNdarray:
+            this->key(first, "ndarray");
+            this->list(data.ndarray());
+            break;
+        case protos::DefaultData::kTftensor:
+            if (this->mOptions.ndarray && defaultTensorDtype(data.tftensor())) {
+                this->key(first, "ndarray");
+                this->tftensorNdarray(data);
+            } else {
+                this->key(first, "tftensor");
+                this->tftensor(data.tftensor());
+            }
+            break;
+        case protos::DefaultData::DATA_ONEOF_NOT_SET:
+            break;
+        }
+        this->mOut.push_back('}');
+    }
+
+    void tensor(const protos::Tensor &tensor) {
+        this->mOut.push_back('{');
+        bool first = true;
+        if (tensor.shape_size() > 0) {
+            this->key(first, "shape");
+            this->numbers(tensor.shape());
+        }
+        if (tensor.values_size() > 0) {
+            this->key(first, "values");
+            this->numbers(tensor.values());
+        }
+        this->mOut.push_back('}');
+    }
+
+    template <typename T>
+    void denseNdarray(const protos::DefaultData &data) {
+        TensorView<T> view(data);
+        ndarray::appendJson(view.data(), view.shape(), this->mOut, this->mOptions.floatDigits);
+    }
+
+    // Narrower integers are widened to int32_t, and uint64 and bool values
+    // to doubles
+    void tftensorNdarray(const protos::DefaultData &data) {
+        switch (data.tftensor().dtype()) {
+        case tensorflow::DT_FLOAT:
+            this->denseNdarray<float>(data);
+            break;
+        case tensorflow::DT_INT8:
+        case tensorflow::DT_INT16:
+        case tensorflow::DT_INT32:
+        case tensorflow::DT_UINT8:
+        case tensorflow::DT_UINT16:
+            this->denseNdarray<int32_t>(data);
+            break;
+        case tensorflow::DT_INT64:
+        case tensorflow::DT_UINT32:
+            this->denseNdarray<int64_t>(data);
+            break;
+        default:
+            this->denseNdarray<double>(data);
+        }
+    }
+
+    void tftensor(const tensorflow::TensorProto &tensor) {
+        this->mOut.push_back('{');
+        bool first = true;
+        if (tensor.dtype() != 0) {
+            this->key(first, "dtype");
+            this->enumValue(tensorflow::DataType_descriptor(), tensor.dtype());
+        }
+        if (tensor.has_tensor_shape()) {
+            this->key(first, "tensorShape");
+            this->shape(tensor.tensor_shape());
+        }
+        if (tensor.version_number() != 0) {
+            this->key(first, "versionNumber");
+            this->number(tensor.version_number());
+        }
+        if (!tensor.tensor_content().empty()) {
+            this->key(first, "tensorContent");
+            this->bytes(tensor.tensor_content());
+        }
+        if (tensor.float_val_size() > 0) {
+            this->key(first, "floatVal");
+            this->floats(tensor.float_val());
+        }
+        if (tensor.double_val_size() > 0) {
+            this->key(first, "doubleVal");
+            this->numbers(tensor.double_val());
+        }
+        if (tensor.int_val_size() > 0) {
+            this->key(first, "intVal");
+            this->numbers(tensor.int_val());
+        }
+        if (tensor.string_val_size() > 0) {
+            this->key(first, "stringVal");
+            this->mOut.push_back('[');
+            for (int i = 0; i < tensor.string_val_size(); i++) {
+                if (i > 0) {
+                    this->mOut.push_back(',');
+                }
+                this->bytes(tensor.string_val(i));
+            }
+            this->mOut.push_back(']');
+        }
+        if (tensor.scomplex_val_size() > 0) {
+            this->key(first, "scomplexVal");
+            this->floats(tensor.scomplex_val());
+        }
+        if (tensor.int64_val_size() > 0) {
+            this->key(first, "int64Val");
+            this->quoted(tensor.int64_val());
+        }
+        if (tensor.bool_val_size() > 0) {
+            this->key(first, "boolVal");
+            this->booleans(tensor.bool_val());
+        }
+        if (tensor.dcomplex_val_size() > 0) {
+            this->key(first, "dcomplexVal");
+            this->numbers(tensor.dcomplex_val());
+        }
+        if (tensor.half_val_size() > 0) {
+            this->key(first, "halfVal");
+            this->numbers(tensor.half_val());
+        }
+        if (tensor.uint32_val_size() > 0) {
+            this->key(first, "uint32Val");
+            this->numbers(tensor.uint32_val());
+        }
+        if (tensor.uint64_val_size() > 0) {
+            this->key(first, "uint64Val");
+            this->quoted(tensor.uint64_val());
+        }
+        this->mOut.push_back('}');
+    }
+
+    void shape(const tensorflow::TensorShapeProto &shape) {
+        this->mOut.push_back('{');
+        bool first = true;
+        if (shape.dim_size() > 0) {
+            this->key(first, "dim");
+            this->mOut.push_back('[');
+            for (int i = 0; i < shape.dim_size(); i++) {
+                const tensorflow::TensorShapeProto::Dim &dim = shape.dim(i);
+                if (i > 0) {
+                    this->mOut.push_back(',');
+                }
+                this->mOut.push_back('{');
+                bool firstField = true;
+                if (dim.size() != 0) {
+                    this->key(firstField, "size");
+                    this->mOut.push_back('"');
+                    this->number(dim.size());
+                    this->mOut.push_back('"');
+                }
+                if (!dim.name().empty()) {
+                    this->key(firstField, "name");
+                    this->string(dim.name());
+                }
+                this->mOut.push_back('}');
+            }
+            this->mOut.push_back(']');
+        }
+        if (shape.unknown_rank()) {
+            this->key(first, "unknownRank");
+            this->mOut.append("true");
+        }
+        this->mOut.push_back('}');
+    }
+
+    std::string &mOut;
+    const EncodeOptions &mOptions;
+    bool mValid = true;
+};
+
+}
+
+EncodeOptions EncodeOptions::fromEnvironment() {
+    EncodeOptions options;
+    options.floatDigits =
+        static_cast<int>(envInt("SELDON_CPP_JSON_FLOAT_DIGITS", options.floatDigits));
+    options.omitDefaults = envInt("SELDON_CPP_JSON_OMIT_DEFAULTS", options.omitDefaults) != 0;
+    return options;
+}
+
+char *writeNumber(double value, char *out) {
+    char *end = writeSpecial(value, out);
+    if (end != nullptr) {
+        return end;
+    }
+    if (value < 0) {
+        *out++ = '-';
+        value = -value;
+    }
+    return writeDecimal(shortest(value), out);
+}
+
+char *writeNumber(float value, char *out) {
+    return writeNumber(value, 0, out);
+}
+
+char *writeNumber(float value, int digits, char *out) {
+    char *end = writeSpecial(value, out);
+    if (end != nullptr) {
+        return end;
+    }
+    if (value < 0) {
+        *out++ = '-';
+        value = -value;
+    }
+
+    Decimal decimal = shortest(value);
+    if (digits > 0) {
+        // Shortest float decimals have at most 9 digits
+        static const uint64_t kPowers[] = {1,      10,      100,      1000,      10000,
+                                           100000, 1000000, 10000000, 100000000, 1000000000};
+        int length = 1;
+        while (length < 10 && decimal.significand >= kPowers[length]) {
+            length++;
+        }
+        if (length > digits) {
+            uint64_t divisor = kPowers[length - digits];
+            uint64_t remainder = decimal.significand % divisor;
+            decimal.significand = decimal.significand / divisor + (remainder * 2 >= divisor);
+            decimal.exponent += length - digits;
+        }
+    }
+    return writeDecimal(decimal, out);
+}
+
+char *writeNumber(int64_t value, char *out) {
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (value < 0) {
+        *out++ = '-';
+        magnitude = 0 - magnitude;
+    }
+    return writeUnsigned(magnitude, out);
+}
+
+bool encode(const protos::SeldonMessage &message, std::string &out,
+            const EncodeOptions &options) {
+    out.clear();
+    Encoder encoder(out, options);
+    return encoder.message(message);
+}
+
+}
+}
@@ -0,0 +1,404 @@
+#include "seldon/LazyMessage.hpp"
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include "seldon/Codec.hpp"
+#include "seldon/JsonDecoder.hpp"
+
+namespace seldon {
+
+namespace {
+
+using protos::SeldonMessage;
+
+// JSON names of the top level members, by field number
+const char *const kMemberNames[] = {nullptr, "status", "meta", "data", "binData",
+                                    "strData", "jsonData", "customData"};
+constexpr int kMembers = 8;
+
+// Other spellings, such as bin_data, are left to decodeMessage
+int memberField(const char *key, size_t keySize) {
+    for (int field = 1; field < kMembers; field++) {
+        if (std::strlen(kMemberNames[field]) == keySize &&
+            std::memcmp(kMemberNames[field], key, keySize) == 0) {
+            return field;
+        }
+    }
+    return 0;
+}
+
+struct Range
+{
+    const char *begin = nullptr;
+    const char *end = nullptr;
+
+    size_t size() const { return static_cast<size_t>(this->end - this->begin); }
+};
+
+// Where the status, meta and payload of a request are. The status and meta
+// ranges hold their JSON value or wire-format contents, the payload range
+// its JSON value or whole field.
+struct Layout
+{
+    Range status;
+    Range meta;
+    Range payload;
+    int field = 0;
+
+    // Records a member, failing on duplicates and on a second payload,
+    // which are left to decodeMessage
+    bool add(int field, Range range, Range contents) {
+        Range *target = field == SeldonMessage::kStatusFieldNumber ? &this->status
+                        : field == SeldonMessage::kMetaFieldNumber ? &this->meta
+                                                                   : &this->payload;
+        if (target->begin != nullptr) {
+            return false;
+        }
+        if (target == &this->payload) {
+            *target = range;
+            this->field = field;
+        } else {
+            *target = contents;
+        }
+        return true;
+    }
+};
+
+bool scanJson(const char *data, size_t size, Layout &layout) {
+    return json::scanObject(
+        data, size, [&layout](const char *key, size_t keySize, const char *value,
+                              const char *valueEnd) {
+            int field = memberField(key, keySize);
+            // A null payload leaves the oneof unset, or sets a null jsonData
+            if (field == 0 || (field >= SeldonMessage::kDataFieldNumber && *value == 'n')) {
+                return false;
+            }
+            return layout.add(field, {value, valueEnd}, {value, valueEnd});
+        });
+}
+
+// Wire type of length-delimited fields, the only kind a SeldonMessage has
+// at the top level
+constexpr int kLengthDelimited = 2;
+
+// Calls field(number, wireType, range, contents) for each field of the
+// wire-format message at data, where range spans the whole field and
+// contents its value, past the length of a length-delimited one. Returns
+// false if field does, or if the message is malformed or holds groups.
+template <typename Field>
+bool scanFields(const char *data, size_t size, Field field) {
+    if (size > static_cast<size_t>(INT_MAX)) {
+        return false;
+    }
+    google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t *>(data),
+                                                 static_cast<int>(size));
+    while (input.CurrentPosition() < static_cast<int>(size)) {
+        const char *begin = data + input.CurrentPosition();
+        uint32_t tag = input.ReadTag();
+        const char *contents = data + input.CurrentPosition();
+        uint64_t varint;
+        uint32_t length;
+        bool read;
+        switch (tag & 7) {
+        case 0:
+            read = input.ReadVarint64(&varint);
+            break;
+        case 1:
+            read = input.Skip(8);
+            break;
+        case kLengthDelimited:
+            read = input.ReadVarint32(&length) && length <= INT_MAX;
+            contents = data + input.CurrentPosition();
+            read = read && input.Skip(static_cast<int>(length));
+            break;
+        case 5:
+            read = input.Skip(4);
+            break;
+        default:
+            read = false;
+        }
+        const char *end = data + input.CurrentPosition();
+        if (!read || !field(static_cast<int>(tag >> 3), static_cast<int>(tag & 7),
+                            Range{begin, end}, Range{contents, end})) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool scanProto(const char *data, size_t size, Layout &layout) {
+    return scanFields(data, size, [&layout](int field, int wireType, Range range, Range contents) {
+        return field > 0 && field < kMembers && wireType == kLengthDelimited &&
+               layout.add(field, range, contents);
+    });
+}
+
+// The value of the only field of a wire-format payload
+Range payloadContents(const char *payload, size_t size) {
+    Range contents;
+    scanFields(payload, size, [&contents](int, int, Range, Range value) {
+        contents = value;
+        return true;
+    });
+    return contents;
+}
+
+// Moves the status and meta of from to to, which must be on the same arena
+void moveHead(SeldonMessage &from, SeldonMessage &to) {
+    if (from.has_status()) {
+        to.unsafe_arena_set_allocated_status(from.unsafe_arena_release_status());
+    }
+    if (from.has_meta()) {
+        to.unsafe_arena_set_allocated_meta(from.unsafe_arena_release_meta());
+    }
+}
+
+// Owns message unless it's on an arena
+std::unique_ptr<SeldonMessage> own(SeldonMessage *message) {
+    return std::unique_ptr<SeldonMessage>(message->GetArena() == nullptr ? message : nullptr);
+}
+
+}
+
+LazyMessage::LazyMessage(google::protobuf::Arena *arena)
+    : mArena(arena),
+      mMessage(google::protobuf::Arena::CreateMessage<SeldonMessage>(arena)) { }
+
+LazyMessage::~LazyMessage() {
+    if (this->mArena == nullptr) {
+        delete this->mMessage;
+    }
+}
+
+void LazyMessage::parse(const char *data, size_t size, PayloadFormat format) {
+    this->mMessage->Clear();
+    this->mData = data;
+    this->mSize = size;
+    this->mFormat = format;
+    this->mPayload = nullptr;
+    this->mPayloadSize = 0;
+
+    Layout layout;
+    bool scanned = format == PayloadFormat::Json ? scanJson(data, size, layout)
+                                                 : scanProto(data, size, layout);
+    if (!scanned) {
+        decodeMessage(data, size, format, *this->mMessage);
+        this->mDecoded = true;
+        return;
+    }
+
+    if (format == PayloadFormat::Json) {
+        // Small next to the payload, so decoded on their own
+        std::string head = "{";
+        if (layout.status.begin != nullptr) {
+            head.append("\"status\":").append(layout.status.begin, layout.status.size());
+        }
+        if (layout.meta.begin != nullptr) {
+            head.append(head.size() > 1 ? ",\"meta\":" : "\"meta\":");
+            head.append(layout.meta.begin, layout.meta.size());
+        }
+        head.push_back('}');
+        decodeMessage(head.data(), head.size(), format, *this->mMessage);
+    } else {
+        if ((layout.status.begin != nullptr &&
+             !this->mMessage->mutable_status()->ParseFromArray(
+                 layout.status.begin, static_cast<int>(layout.status.size()))) ||
+            (layout.meta.begin != nullptr &&
+             !this->mMessage->mutable_meta()->ParseFromArray(
+                 layout.meta.begin, static_cast<int>(layout.meta.size())))) {
+            throw std::invalid_argument("Unable to parse protobuf request");
+        }
+    }
+
+    this->mCase = static_cast<SeldonMessage::DataOneofCase>(layout.field);
+    this->mDecoded = layout.payload.begin == nullptr;
+    this->mPayload = layout.payload.begin;
+    this->mPayloadSize = layout.payload.size();
+}
+
+bool LazyMessage::hasNdarray() const {
+    if (this->mDecoded) {
+        return this->mMessage->data().has_ndarray();
+    }
+    if (this->mCase != SeldonMessage::kData) {
+        return false;
+    }
+
+    bool ndarray = false;
+    if (this->mFormat == PayloadFormat::Json) {
+        json::scanObject(this->mPayload, this->mPayloadSize,
+                         [&ndarray](const char *key, size_t keySize, const char *, const char *) {
+                             ndarray = keySize == 7 && std::memcmp(key, "ndarray", 7) == 0;
+                             return !ndarray;
+                         });
+        return ndarray;
+    }
+    // The payload is the whole data field, so its fields are one level down
+    Range data = payloadContents(this->mPayload, this->mPayloadSize);
+    scanFields(data.begin, data.size(), [&ndarray](int field, int, Range, Range) {
+        if (field != protos::DefaultData::kNamesFieldNumber) {
+            ndarray = field == protos::DefaultData::kNdarrayFieldNumber;
+        }
+        return true;
+    });
+    return ndarray;
+}
+
+google::protobuf::StringPiece LazyMessage::binDataView() {
+    return this->bytesView(SeldonMessage::kBinData);
+}
+
+google::protobuf::StringPiece LazyMessage::strDataView() {
+    return this->bytesView(SeldonMessage::kStrData);
+}
+
+google::protobuf::StringPiece LazyMessage::bytesView(SeldonMessage::DataOneofCase field) {
+    if (this->data_oneof_case() != field) {
+        return google::protobuf::StringPiece();
+    }
+    if (this->mPayload != nullptr && this->mFormat == PayloadFormat::Proto) {
+        Range contents = payloadContents(this->mPayload, this->mPayloadSize);
+        return google::protobuf::StringPiece(contents.begin, contents.size());
+    }
+    const SeldonMessage &message = this->message();
+    return field == SeldonMessage::kBinData ? message.bindata() : message.strdata();
+}
+
+bool LazyMessage::tftensorView(tensorflow::TensorProto &tensor,
+                               google::protobuf::StringPiece &content) {
+    tensor.Clear();
+    content = google::protobuf::StringPiece();
+    if (this->data_oneof_case() != SeldonMessage::kData) {
+        return false;
+    }
+
+    if (this->mPayload != nullptr && this->mFormat == PayloadFormat::Proto) {
+        // Only a data holding nothing but names and a single tftensor is
+        // scanned, anything protobuf would merge is decoded instead
+        Range data = payloadContents(this->mPayload, this->mPayloadSize);
+        Range tftensor;
+        int tensors = 0;
+        scanFields(data.begin, data.size(), [&](int field, int, Range, Range contents) {
+            if (field != protos::DefaultData::kNamesFieldNumber) {
+                tensors++;
+                tftensor = field == protos::DefaultData::kTftensorFieldNumber ? contents : Range();
+            }
+            return true;
+        });
+        if (tensors == 1 && tftensor.begin != nullptr) {
+            // The tensor without its content is small, and parsed as usual
+            std::string rest;
+            bool scanned = scanFields(
+                tftensor.begin, tftensor.size(),
+                [&](int field, int wireType, Range range, Range contents) {
+                    if (field == tensorflow::TensorProto::kTensorContentFieldNumber &&
+                        wireType == kLengthDelimited) {
+                        content = google::protobuf::StringPiece(contents.begin, contents.size());
+                    } else {
+                        rest.append(range.begin, range.size());
+                    }
+                    return true;
+                });
+            if (scanned && tensor.ParseFromString(rest)) {
+                return true;
+            }
+            tensor.Clear();
+            content = google::protobuf::StringPiece();
+        }
+    }
+
+    if (!this->message().data().has_tftensor()) {
+        return false;
+    }
+    // The content is set aside while the rest is copied
+    tensorflow::TensorProto *source = this->mMessage->mutable_data()->mutable_tftensor();
+    std::string saved;
+    source->mutable_tensor_content()->swap(saved);
+    tensor.CopyFrom(*source);
+    source->mutable_tensor_content()->swap(saved);
+    content = source->tensor_content();
+    return true;
+}
+
+const SeldonMessage &LazyMessage::message() {
+    if (!this->mDecoded) {
+        this->decodePayload();
+    }
+    return *this->mMessage;
+}
+
+SeldonMessage *LazyMessage::mutable_message() {
+    this->message();
+    this->mPayload = nullptr;
+    this->mPayloadSize = 0;
+    return this->mMessage;
+}
+
+void LazyMessage::decodePayload() {
+    SeldonMessage *full = google::protobuf::Arena::CreateMessage<SeldonMessage>(this->mArena);
+    std::unique_ptr<SeldonMessage> owned = own(full);
+    if (this->mFormat == PayloadFormat::Proto) {
+        // The field on its own is a message holding just the payload
+        decodeMessage(this->mPayload, this->mPayloadSize, this->mFormat, *full);
+    } else {
+        decodeMessage(this->mData, this->mSize, this->mFormat, *full);
+        full->clear_status();
+        full->clear_meta();
+    }
+    // Keeps any changes made to the status and meta
+    moveHead(*this->mMessage, *full);
+    this->mMessage->Swap(full);
+    this->mDecoded = true;
+}
+
+void LazyMessage::encode(PayloadFormat format, const json::EncodeOptions &options,
+                         std::string &out) {
+
+    if (this->mPayload == nullptr || format != this->mFormat) {
+        encodeMessage(this->message(), format, options, out);
+        return;
+    }
+
+    this->encodeHead(format, options, out);
+    if (format == PayloadFormat::Proto) {
+        out.append(this->mPayload, this->mPayloadSize);
+        return;
+    }
+    out.pop_back();
+    if (out.size() > 1) {
+        out.push_back(',');
+    }
+    out.push_back('"');
+    out.append(kMemberNames[this->mCase]);
+    out.append("\":");
+    out.append(this->mPayload, this->mPayloadSize);
+    out.push_back('}');
+}
+
+// Encodes the status and meta, setting aside a payload that was decoded
+// but is still written verbatim
+void LazyMessage::encodeHead(PayloadFormat format, const json::EncodeOptions &options,
+                             std::string &out) {
+    if (this->mMessage->data_oneof_case() == SeldonMessage::DATA_ONEOF_NOT_SET) {
+        encodeMessage(*this->mMessage, format, options, out);
+        return;
+    }
+    SeldonMessage *head = google::protobuf::Arena::CreateMessage<SeldonMessage>(this->mArena);
+    std::unique_ptr<SeldonMessage> owned = own(head);
+    moveHead(*this->mMessage, *head);
+    try {
+        encodeMessage(*head, format, options, out);
+    } catch (...) {
+        moveHead(*head, *this->mMessage);
+        throw;
+    }
+    moveHead(*head, *this->mMessage);
+}
+
+}
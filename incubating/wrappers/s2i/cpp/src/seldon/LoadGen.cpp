@@ -0,0 +1,689 @@
+#include "seldon/LoadGen.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "prediction.pb.h"
+#include "seldon/HttpServer.hpp"
+#include "seldon/Logging.hpp"
+#include "seldon/Metrics.hpp"
+#if SELDON_WITH_GRPC
+#include <grpcpp/generic/generic_stub.h>
+#include <grpcpp/grpcpp.h>
+
+#include "seldon/GrpcServer.hpp"
+#endif
+
+namespace seldon {
+namespace loadgen {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char *const kSequence = "{{seq}}";
+
+// Payload split around its {{seq}} placeholders
+class Template
+{
+public:
+    explicit Template(const std::string &payload) {
+        size_t begin = 0;
+        size_t found;
+        while ((found = payload.find(kSequence, begin)) != std::string::npos) {
+            this->mParts.push_back(payload.substr(begin, found - begin));
+            begin = found + std::strlen(kSequence);
+        }
+        this->mParts.push_back(payload.substr(begin));
+    }
+
+    // Returns the payload for request sequence, built in scratch when it
+    // has placeholders
+    const std::string &render(uint64_t sequence, std::string &scratch) const {
+        if (this->mParts.size() == 1) {
+            return this->mParts[0];
+        }
+        std::string number = std::to_string(sequence);
+        scratch.clear();
+        for (size_t i = 0; i < this->mParts.size(); i++) {
+            if (i > 0) {
+                scratch.append(number);
+            }
+            scratch.append(this->mParts[i]);
+        }
+        return scratch;
+    }
+
+private:
+    std::vector<std::string> mParts;
+};
+
+// One worker's connection to the target. call returns false when the
+// request failed.
+class Client
+{
+public:
+    virtual ~Client() { }
+    virtual bool call(const std::string &request) = 0;
+};
+
+class InProcessClient : public Client
+{
+public:
+    InProcessClient(RawModel &model, Method method, PayloadFormat format)
+        : mModel(model), mMethod(method), mFormat(format) { }
+
+    // Waits for the completion, so models that predict asynchronously are
+    // measured to the end of the request
+    bool call(const std::string &request) override {
+        auto done = std::make_shared<std::promise<bool>>();
+        std::future<bool> result = done->get_future();
+        this->mModel.handleBufferAsync(
+            this->mMethod, request.data(), request.size(), this->mFormat,
+            [done](std::exception_ptr error, std::string &out) { done->set_value(!error); });
+        return result.get();
+    }
+
+private:
+    RawModel &mModel;
+    Method mMethod;
+    PayloadFormat mFormat;
+};
+
+void splitAddress(const std::string &address, std::string &host, std::string &port) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == address.size()) {
+        throw std::invalid_argument("Expected host:port, got " + address);
+    }
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+}
+
+const char *restPath(Method method) {
+    switch (method) {
+    case Method::Predict:
+        return "/api/v1.0/predictions";
+    case Method::TransformInput:
+        return "/transform-input";
+    case Method::TransformOutput:
+        return "/transform-output";
+    case Method::Route:
+        return "/route";
+    case Method::Aggregate:
+        return "/aggregate";
+    case Method::SendFeedback:
+        return "/api/v1.0/feedback";
+    case Method::Metadata:
+        return "/metadata";
+    }
+    return "/";
+}
+
+// Blocking HTTP/1.1 client over one keep-alive connection, reconnecting
+// after errors
+class RestClient : public Client
+{
+public:
+    RestClient(const std::string &address, Method method, PayloadFormat format) {
+        splitAddress(address, this->mHost, this->mPort);
+        this->mHead = std::string(method == Method::Metadata ? "GET " : "POST ") +
+                      restPath(method) + " HTTP/1.1\r\nHost: " + address + "\r\nContent-Type: " +
+                      (format == PayloadFormat::Proto ? "application/x-protobuf"
+                                                      : "application/json") +
+                      "\r\nContent-Length: ";
+    }
+
+    ~RestClient() override {
+        this->disconnect();
+    }
+
+    bool call(const std::string &request) override {
+        try {
+            if (this->mFd < 0) {
+                this->connect();
+            }
+            this->mBuffer.assign(this->mHead);
+            this->mBuffer.append(std::to_string(request.size()));
+            this->mBuffer.append("\r\n\r\n");
+            this->mBuffer.append(request);
+            this->send(this->mBuffer);
+            return this->receive();
+        } catch (const std::system_error &e) {
+            this->disconnect();
+            return false;
+        }
+    }
+
+private:
+    void connect() {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *found = nullptr;
+        int status = getaddrinfo(this->mHost.c_str(), this->mPort.c_str(), &hints, &found);
+        if (status != 0) {
+            throw std::system_error(EHOSTUNREACH, std::generic_category(), gai_strerror(status));
+        }
+        std::unique_ptr<addrinfo, void (*)(addrinfo *)> addresses(found, freeaddrinfo);
+
+        int fd = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+        if (fd < 0 || ::connect(fd, found->ai_addr, found->ai_addrlen) != 0) {
+            int error = errno;
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw std::system_error(error, std::generic_category(), "connect");
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        this->mFd = fd;
+    }
+
+    void disconnect() {
+        if (this->mFd >= 0) {
+            close(this->mFd);
+            this->mFd = -1;
+        }
+    }
+
+    void send(const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t count = ::send(this->mFd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (count < 0 && errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "send");
+            }
+            sent += count > 0 ? static_cast<size_t>(count) : 0;
+        }
+    }
+
+    void readMore() {
+        char chunk[64 * 1024];
+        ssize_t count = recv(this->mFd, chunk, sizeof(chunk), 0);
+        if (count == 0) {
+            throw std::system_error(ECONNRESET, std::generic_category(), "recv");
+        }
+        if (count < 0 && errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "recv");
+        }
+        this->mBuffer.append(chunk, count > 0 ? static_cast<size_t>(count) : 0);
+    }
+
+    // Reads a whole response, returning whether its status was 2xx
+    bool receive() {
+        this->mBuffer.clear();
+        size_t headerEnd;
+        while ((headerEnd = this->mBuffer.find("\r\n\r\n")) == std::string::npos) {
+            this->readMore();
+        }
+
+        size_t length = 0;
+        size_t line = this->mBuffer.find("\r\n");
+        while (line < headerEnd) {
+            size_t next = this->mBuffer.find("\r\n", line + 2);
+            const char *field = this->mBuffer.data() + line + 2;
+            if (next - line - 2 > 15 && strncasecmp(field, "content-length:", 15) == 0) {
+                length = std::strtoull(field + 15, nullptr, 10);
+            }
+            line = next;
+        }
+        while (this->mBuffer.size() < headerEnd + 4 + length) {
+            this->readMore();
+        }
+
+        bool ok = this->mBuffer.compare(0, 10, "HTTP/1.1 2") == 0;
+        if (this->mBuffer.find("\r\nConnection: close", 0) < headerEnd) {
+            this->disconnect();
+        }
+        return ok;
+    }
+
+    std::string mHost;
+    std::string mPort;
+    std::string mHead;
+    std::string mBuffer;
+    int mFd = -1;
+};
+
+#if SELDON_WITH_GRPC
+const char *grpcPath(Method method) {
+    switch (method) {
+    case Method::Predict:
+        return "/seldon.protos.Model/Predict";
+    case Method::TransformInput:
+        return "/seldon.protos.Generic/TransformInput";
+    case Method::TransformOutput:
+        return "/seldon.protos.Generic/TransformOutput";
+    case Method::Route:
+        return "/seldon.protos.Generic/Route";
+    case Method::Aggregate:
+        return "/seldon.protos.Generic/Aggregate";
+    case Method::SendFeedback:
+        return "/seldon.protos.Model/SendFeedback";
+    case Method::Metadata:
+        return "/seldon.protos.Model/Metadata";
+    }
+    return "/";
+}
+
+// Unary calls with raw payloads through the generic stub, on a channel of
+// the worker's own
+class GrpcClient : public Client
+{
+public:
+    GrpcClient(const std::string &address, Method method, int worker) : mPath(grpcPath(method)) {
+        grpc::ChannelArguments arguments;
+        // Distinct arguments keep channels from sharing a connection
+        arguments.SetInt("seldon.loadgen.worker", worker);
+        arguments.SetMaxReceiveMessageSize(-1);
+        arguments.SetMaxSendMessageSize(-1);
+        this->mStub.reset(new grpc::GenericStub(grpc::CreateCustomChannel(
+            address, grpc::InsecureChannelCredentials(), arguments)));
+    }
+
+    bool call(const std::string &request) override {
+        grpc::Slice slice(request);
+        grpc::ByteBuffer requestBuffer(&slice, 1);
+        grpc::ByteBuffer responseBuffer;
+        grpc::ClientContext context;
+        grpc::Status status;
+
+        auto reader = this->mStub->PrepareUnaryCall(&context, this->mPath, requestBuffer,
+                                                    &this->mQueue);
+        reader->StartCall();
+        reader->Finish(&responseBuffer, &status, nullptr);
+        void *tag;
+        bool ok;
+        return this->mQueue.Next(&tag, &ok) && ok && status.ok();
+    }
+
+private:
+    std::string mPath;
+    std::unique_ptr<grpc::GenericStub> mStub;
+    grpc::CompletionQueue mQueue;
+};
+#endif
+
+double cpuSeconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+std::string defaultPayload(PayloadFormat format) {
+    protos::SeldonMessage message;
+    auto *tensor = message.mutable_data()->mutable_tensor();
+    tensor->add_shape(1);
+    tensor->add_shape(4);
+    for (double value : {1.0, 2.0, 3.0, 4.0}) {
+        tensor->add_values(value);
+    }
+    return format == PayloadFormat::Proto
+               ? message.SerializeAsString()
+               : "{\"data\":{\"tensor\":{\"shape\":[1,4],\"values\":[1,2,3,4]}}}";
+}
+
+std::unique_ptr<Client> newClient(RawModel *model, const LoadOptions &options,
+                                  const std::string &address, int worker) {
+    switch (options.target) {
+    case Target::InProcess:
+        return std::unique_ptr<Client>(new InProcessClient(*model, options.method, options.format));
+    case Target::Rest:
+        return std::unique_ptr<Client>(new RestClient(address, options.method, options.format));
+    case Target::Grpc:
+#if SELDON_WITH_GRPC
+        return std::unique_ptr<Client>(new GrpcClient(address, options.method, worker));
+#else
+        throw std::invalid_argument("Built without gRPC, see SELDON_OPT_BUILD_GRPC");
+#endif
+    }
+    return nullptr;
+}
+
+LoadReport measure(std::vector<std::unique_ptr<Client>> &clients,
+                   const std::vector<Template> &templates, const LoadOptions &options,
+                   double rate) {
+    metrics::HdrHistogram latency;
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> latencyNanos{0};
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point measured =
+        start + std::chrono::nanoseconds(static_cast<int64_t>(options.warmupSeconds * 1e9));
+    Clock::time_point end =
+        measured + std::chrono::nanoseconds(static_cast<int64_t>(options.durationSeconds * 1e9));
+    std::chrono::duration<double, std::nano> interval(rate > 0 ? 1e9 / rate : 0);
+
+    auto work = [&](Client &client) {
+        std::string scratch;
+        while (true) {
+            uint64_t next = sequence.fetch_add(1);
+            Clock::time_point due;
+            if (rate > 0) {
+                // Open loop: request next is due at a fixed time, whether
+                // or not earlier ones have been answered
+                due = start + std::chrono::duration_cast<Clock::duration>(interval * next);
+                if (due >= end) {
+                    return;
+                }
+                std::this_thread::sleep_until(due);
+            } else {
+                due = Clock::now();
+                if (due >= end) {
+                    return;
+                }
+            }
+
+            const std::string &request = templates[next % templates.size()].render(next, scratch);
+            bool ok = client.call(request);
+            if (due < measured) {
+                continue;
+            }
+            if (!ok) {
+                errors++;
+                continue;
+            }
+            uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 Clock::now() - due).count();
+            latency.record(nanos);
+            latencyNanos += nanos;
+            requests++;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (auto &client : clients) {
+        Client *worker = client.get();
+        workers.emplace_back([&work, worker]() { work(*worker); });
+    }
+    std::this_thread::sleep_until(measured);
+    double cpuStart = cpuSeconds();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double cpu = cpuSeconds() - cpuStart;
+
+    LoadReport report;
+    report.rate = rate;
+    report.concurrency = static_cast<int>(clients.size());
+    report.requests = requests;
+    report.errors = errors;
+    report.seconds = std::chrono::duration<double>(Clock::now() - measured).count();
+    if (report.requests > 0) {
+        report.mean = latencyNanos / 1e9 / report.requests;
+        report.p50 = latency.quantile(0.5);
+        report.p90 = latency.quantile(0.9);
+        report.p99 = latency.quantile(0.99);
+        report.p999 = latency.quantile(0.999);
+        report.max = latency.quantile(1.0);
+        report.cpuSecondsPerRequest = cpu / (report.requests + report.errors);
+    }
+    return report;
+}
+
+Target parseTarget(const std::string &value) {
+    if (value == "inprocess") {
+        return Target::InProcess;
+    } else if (value == "rest") {
+        return Target::Rest;
+    } else if (value == "grpc") {
+        return Target::Grpc;
+    }
+    throw std::invalid_argument("Unknown target " + value);
+}
+
+Method parseMethod(const std::string &value) {
+    for (Method method : {Method::Predict, Method::TransformInput, Method::TransformOutput,
+                          Method::Route, Method::Aggregate, Method::SendFeedback,
+                          Method::Metadata}) {
+        if (value == methodName(method)) {
+            return method;
+        }
+    }
+    throw std::invalid_argument("Unknown method " + value);
+}
+
+double parseNumber(const std::string &option, const std::string &value) {
+    char *end = nullptr;
+    double number = std::strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || number < 0) {
+        throw std::invalid_argument("Invalid value " + value + " for " + option);
+    }
+    return number;
+}
+
+const char *targetName(Target target) {
+    switch (target) {
+    case Target::InProcess:
+        return "inprocess";
+    case Target::Rest:
+        return "rest";
+    case Target::Grpc:
+        return "grpc";
+    }
+    return "unknown";
+}
+
+}
+
+const char *LoadOptions::usage() {
+    return "Usage: seldon-loadgen [options]\n"
+           "  --target inprocess|rest|grpc  where to send requests (inprocess)\n"
+           "  --address HOST:PORT           running server to load, instead of\n"
+           "                                starting the native server on loopback\n"
+           "  --server-threads N            threads of the loopback server (one per core)\n"
+           "  --method NAME                 predict, transform-input, transform-output,\n"
+           "                                route, aggregate, send-feedback or metadata\n"
+           "  --format json|proto           payload format, gRPC is always proto (json)\n"
+           "  --payload FILE                request body, repeat to cycle through several;\n"
+           "                                {{seq}} is replaced with the request number\n"
+           "  --rate R[,R...]               requests per second, one run each; 0 sends\n"
+           "                                as fast as the workers allow (0)\n"
+           "  --concurrency N               workers, each with a connection (8)\n"
+           "  --duration SECONDS            measured time per run (10)\n"
+           "  --warmup SECONDS              unmeasured time before each run (1)\n"
+           "  --json                        print the reports as JSON\n";
+}
+
+LoadOptions LoadOptions::fromArgs(int argc, char **argv) {
+    LoadOptions options;
+    bool formatSet = false;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--json" || option == "--help") {
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + option);
+        }
+        std::string value = argv[++i];
+        if (option == "--target") {
+            options.target = parseTarget(value);
+        } else if (option == "--address") {
+            options.address = value;
+        } else if (option == "--server-threads") {
+            options.serverThreads = static_cast<int>(parseNumber(option, value));
+        } else if (option == "--method") {
+            options.method = parseMethod(value);
+        } else if (option == "--format") {
+            if (value != "json" && value != "proto") {
+                throw std::invalid_argument("Unknown format " + value);
+            }
+            options.format = value == "proto" ? PayloadFormat::Proto : PayloadFormat::Json;
+            formatSet = true;
+        } else if (option == "--payload") {
+            std::ifstream file(value, std::ios::binary);
+            if (!file) {
+                throw std::invalid_argument("Unable to read " + value);
+            }
+            std::ostringstream contents;
+            contents << file.rdbuf();
+            options.payloads.push_back(contents.str());
+        } else if (option == "--rate") {
+            options.rates.clear();
+            size_t begin = 0;
+            while (begin <= value.size()) {
+                size_t end = std::min(value.find(',', begin), value.size());
+                options.rates.push_back(parseNumber(option, value.substr(begin, end - begin)));
+                begin = end + 1;
+            }
+        } else if (option == "--concurrency") {
+            options.concurrency = std::max(1, static_cast<int>(parseNumber(option, value)));
+        } else if (option == "--duration") {
+            options.durationSeconds = parseNumber(option, value);
+        } else if (option == "--warmup") {
+            options.warmupSeconds = parseNumber(option, value);
+        } else {
+            throw std::invalid_argument("Unknown option " + option);
+        }
+    }
+    if (options.target == Target::Grpc) {
+        if (formatSet && options.format != PayloadFormat::Proto) {
+            throw std::invalid_argument("gRPC requests are always sent as proto");
+        }
+        options.format = PayloadFormat::Proto;
+    }
+    return options;
+}
+
+std::vector<LoadReport> run(RawModel *model, const LoadOptions &options) {
+    if (model == nullptr && (options.target == Target::InProcess || options.address.empty())) {
+        throw std::invalid_argument("No model to load, pass the address of a server");
+    }
+
+    // Starts the native server for the model on loopback unless given a
+    // server to load
+    std::string address = options.address;
+    std::unique_ptr<HttpServer> httpServer;
+#if SELDON_WITH_GRPC
+    std::unique_ptr<GrpcServer> grpcServer;
+#endif
+    if (address.empty() && options.target == Target::Rest) {
+        ServerOptions serverOptions;
+        serverOptions.host = "127.0.0.1";
+        serverOptions.port = 0;
+        serverOptions.metricsPort = 0;
+        serverOptions.threads = options.serverThreads;
+        httpServer.reset(new HttpServer(*model, serverOptions));
+        httpServer->start();
+        address = "127.0.0.1:" + std::to_string(httpServer->port());
+    }
+#if SELDON_WITH_GRPC
+    if (address.empty() && options.target == Target::Grpc) {
+        GrpcServerOptions serverOptions;
+        serverOptions.host = "127.0.0.1";
+        serverOptions.port = 0;
+        serverOptions.threads = options.serverThreads;
+        grpcServer.reset(new GrpcServer(*model, serverOptions));
+        grpcServer->start();
+        address = "127.0.0.1:" + std::to_string(grpcServer->port());
+    }
+#endif
+
+    std::vector<Template> templates;
+    for (const std::string &payload : options.payloads) {
+        templates.emplace_back(payload);
+    }
+    if (templates.empty()) {
+        templates.emplace_back(defaultPayload(options.format));
+    }
+
+    std::vector<LoadReport> reports;
+    for (double rate : options.rates) {
+        std::vector<std::unique_ptr<Client>> clients;
+        for (int i = 0; i < options.concurrency; i++) {
+            clients.push_back(newClient(model, options, address, i));
+        }
+        reports.push_back(measure(clients, templates, options, rate));
+    }
+    return reports;
+}
+
+std::string formatText(const std::vector<LoadReport> &reports) {
+    std::string out;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%10s %6s %10s %8s %9s %9s %9s %9s %9s %10s\n", "rate",
+                  "conc", "req/s", "errors", "p50 ms", "p99 ms", "p99.9 ms", "max ms",
+                  "mean ms", "cpu us/req");
+    out.append(line);
+    for (const LoadReport &report : reports) {
+        std::snprintf(line, sizeof(line),
+                      "%10.0f %6d %10.1f %8llu %9.3f %9.3f %9.3f %9.3f %9.3f %10.1f\n",
+                      report.rate, report.concurrency, report.throughput(),
+                      static_cast<unsigned long long>(report.errors), report.p50 * 1e3,
+                      report.p99 * 1e3, report.p999 * 1e3, report.max * 1e3, report.mean * 1e3,
+                      report.cpuSecondsPerRequest * 1e6);
+        out.append(line);
+    }
+    return out;
+}
+
+std::string formatJson(const LoadOptions &options, const std::vector<LoadReport> &reports) {
+    std::ostringstream out;
+    out << "{\"target\":\"" << targetName(options.target) << "\",\"method\":\""
+        << methodName(options.method) << "\",\"format\":\""
+        << (options.format == PayloadFormat::Proto ? "proto" : "json")
+        << "\",\"duration_seconds\":" << options.durationSeconds << ",\"runs\":[";
+    for (size_t i = 0; i < reports.size(); i++) {
+        const LoadReport &report = reports[i];
+        out << (i > 0 ? "," : "") << "{\"rate\":" << report.rate
+            << ",\"concurrency\":" << report.concurrency << ",\"requests\":" << report.requests
+            << ",\"errors\":" << report.errors << ",\"throughput\":" << report.throughput()
+            << ",\"latency_seconds\":{\"mean\":" << report.mean << ",\"p50\":" << report.p50
+            << ",\"p90\":" << report.p90 << ",\"p99\":" << report.p99
+            << ",\"p99.9\":" << report.p999 << ",\"max\":" << report.max
+            << "},\"cpu_seconds_per_request\":" << report.cpuSecondsPerRequest << "}";
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+int main(RawModel *model, int argc, char **argv) {
+    bool json = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--help") == 0) {
+            std::cout << LoadOptions::usage();
+            return 0;
+        }
+        json = json || std::strcmp(argv[i], "--json") == 0;
+    }
+
+    try {
+        LoadOptions options = LoadOptions::fromArgs(argc, argv);
+        std::vector<LoadReport> reports = run(model, options);
+        std::cout << (json ? formatJson(options, reports) : formatText(reports));
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << "\n" << LoadOptions::usage();
+        return 2;
+    } catch (const std::exception &e) {
+        SELDON_LOG_CRITICAL("Load generation failed: " << e.what());
+        return 1;
+    }
+    return 0;
+}
+
+}
+}
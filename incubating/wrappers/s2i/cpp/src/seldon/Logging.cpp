@@ -0,0 +1,122 @@
+#include "seldon/Logging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+namespace seldon {
+namespace log {
+
+namespace {
+
+const char *levelName(Level level) {
+    switch (level) {
+    case Level::Debug:
+        return "DEBUG";
+    case Level::Info:
+        return "INFO";
+    case Level::Warning:
+        return "WARNING";
+    case Level::Error:
+        return "ERROR";
+    case Level::Critical:
+        return "CRITICAL";
+    }
+    return "UNKNOWN";
+}
+
+Level levelFromEnvironment() {
+    Level level = Level::Info;
+    const char *value = std::getenv("SELDON_LOG_LEVEL");
+    if (value != nullptr) {
+        parseLevel(value, level);
+    }
+    return level;
+}
+
+std::atomic<int> &currentLevel() {
+    static std::atomic<int> level(static_cast<int>(levelFromEnvironment()));
+    return level;
+}
+
+const char *baseName(const char *path) {
+    const char *name = path;
+    for (const char *c = path; *c != '\0'; c++) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+    return name;
+}
+
+}
+
+bool parseLevel(const std::string &name, Level &level) {
+    std::string upper(name);
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) {
+        return static_cast<char>(std::toupper(c));
+    });
+
+    for (Level candidate : {Level::Debug, Level::Info, Level::Warning,
+                            Level::Error, Level::Critical}) {
+        if (upper == levelName(candidate)) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+Level getLevel() {
+    return static_cast<Level>(currentLevel().load(std::memory_order_relaxed));
+}
+
+void setLevel(Level level) {
+    currentLevel().store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool isEnabled(Level level) {
+    return static_cast<int>(level) >=
+           currentLevel().load(std::memory_order_relaxed);
+}
+
+void write(Level level, const char *file, int line, const std::string &message) {
+
+    auto now = std::chrono::system_clock::now();
+    std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      now.time_since_epoch()).count() % 1000;
+
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &local);
+
+    // Same layout as the LOG_FORMAT used by the Python microservice
+    char prefix[256];
+    int prefixLength = std::snprintf(
+        prefix, sizeof(prefix), "%s,%03d - seldon:%s:%d - %s:  ", timestamp,
+        static_cast<int>(millis), baseName(file), line, levelName(level));
+    if (prefixLength < 0) {
+        return;
+    }
+
+    std::string output;
+    output.reserve(static_cast<size_t>(prefixLength) + message.size() + 1);
+    output.append(prefix, std::min(static_cast<size_t>(prefixLength), sizeof(prefix) - 1));
+    output.append(message);
+    output.push_back('\n');
+
+    std::fwrite(output.data(), 1, output.size(), stderr);
+}
+
+}
+}
@@ -0,0 +1,456 @@
+#include "seldon/Metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+namespace seldon {
+namespace metrics {
+
+namespace {
+
+void atomicAdd(std::atomic<double> &target, double value) {
+    double current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value,
+                                         std::memory_order_relaxed)) {
+    }
+}
+
+std::string escapeLabelValue(const std::string &value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped.push_back('\\');
+            escaped.push_back(c);
+        } else if (c == '\n') {
+            escaped.append("\\n");
+        } else {
+            escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+std::string renderLabels(const Labels &labels) {
+    if (labels.empty()) {
+        return std::string();
+    }
+    std::string out = "{";
+    bool first = true;
+    for (const auto &label : labels) {
+        if (!first) {
+            out.push_back(',');
+        }
+        first = false;
+        out.append(label.first);
+        out.append("=\"");
+        out.append(escapeLabelValue(label.second));
+        out.push_back('"');
+    }
+    out.push_back('}');
+    return out;
+}
+
+// Appends an extra label to an already rendered label set
+std::string withLabel(const std::string &labels, const std::string &name,
+                      const std::string &value) {
+    std::string label = name + "=\"" + value + "\"";
+    if (labels.empty()) {
+        return "{" + label + "}";
+    }
+    return labels.substr(0, labels.size() - 1) + "," + label + "}";
+}
+
+void renderSample(std::string &out, const std::string &name,
+                  const std::string &labels, const std::string &value) {
+    out.append(name);
+    out.append(labels);
+    out.push_back(' ');
+    out.append(value);
+    out.push_back('\n');
+}
+
+std::string envOr(const char *name, const char *fallback) {
+    const char *value = std::getenv(name);
+    return value != nullptr ? value : fallback;
+}
+
+// HdrHistogram buckets: values below 2^kSubBucketBits get a bucket each,
+// larger ones share a bucket with values that have the same top
+// kSubBucketBits bits
+constexpr int kSubBucketBits = 7;
+constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+constexpr uint64_t kHalfSubBuckets = kSubBuckets / 2;
+constexpr int kMaxValueBits = 36;
+constexpr uint64_t kMaxValue = (uint64_t(1) << kMaxValueBits) - 1;
+constexpr size_t kHdrBuckets = (kMaxValueBits - kSubBucketBits + 2) * kHalfSubBuckets;
+
+int highestBit(uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+size_t hdrBucket(uint64_t value) {
+    value = std::min(value, kMaxValue);
+    if (value < kSubBuckets) {
+        return static_cast<size_t>(value);
+    }
+    int shift = highestBit(value) - (kSubBucketBits - 1);
+    return static_cast<size_t>(shift * kHalfSubBuckets + (value >> shift));
+}
+
+// Smallest value counted in bucket
+uint64_t hdrLowest(size_t bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    uint64_t shift = bucket / kHalfSubBuckets - 1;
+    return (bucket - shift * kHalfSubBuckets) << shift;
+}
+
+std::atomic<size_t> nextId{0};
+
+Labels defaultLabelsFromEnvironment() {
+    const char *notImplemented = "NOT_IMPLEMENTED";
+
+    std::string image = envOr("PREDICTIVE_UNIT_IMAGE", "NOT_IMPLEMENTED:NOT_IMPLEMENTED");
+    size_t separator = image.rfind(':');
+    std::string imageName = image.substr(0, separator);
+    std::string imageVersion =
+        separator == std::string::npos ? std::string() : image.substr(separator + 1);
+
+    Labels labels;
+    labels["deployment_name"] = envOr("SELDON_DEPLOYMENT_ID", notImplemented);
+    labels["model_name"] = envOr("PREDICTIVE_UNIT_ID", notImplemented);
+    labels["model_image"] = imageName;
+    labels["model_version"] = imageVersion;
+    labels["predictor_name"] = envOr("PREDICTOR_ID", notImplemented);
+    return labels;
+}
+
+}
+
+const std::vector<double> &defaultBuckets() {
+    static const std::vector<double> buckets = []() {
+        std::vector<double> bounds;
+        const int numBuckets = 50;
+        double low = std::log10(0.001);
+        double high = std::log10(30.0);
+        for (int i = 0; i < numBuckets; i++) {
+            bounds.push_back(std::pow(10.0, low + (high - low) * i / (numBuckets - 1)));
+        }
+        return bounds;
+    }();
+    return buckets;
+}
+
+std::string formatValue(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    // Prefer the short form when it round trips
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    if (std::strtod(buffer, nullptr) != value) {
+        std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    }
+    return buffer;
+}
+
+void Counter::inc(double value) {
+    atomicAdd(this->mValue, value);
+}
+
+void Counter::render(std::string &out, const std::string &name,
+                     const std::string &labels) const {
+    renderSample(out, name, labels, formatValue(this->value()));
+}
+
+size_t nextShardsId() {
+    return nextId.fetch_add(1);
+}
+
+double ShardedCounter::value() const {
+    double result = 0;
+    this->mShards.forEach([&result](const Shard &shard) {
+        result += shard.value.load(std::memory_order_relaxed);
+    });
+    return result;
+}
+
+void ShardedCounter::render(std::string &out, const std::string &name,
+                            const std::string &labels) const {
+    renderSample(out, name, labels, formatValue(this->value()));
+}
+
+void Gauge::inc(double value) {
+    atomicAdd(this->mValue, value);
+}
+
+void Gauge::render(std::string &out, const std::string &name,
+                   const std::string &labels) const {
+    renderSample(out, name, labels, formatValue(this->value()));
+}
+
+Histogram::Histogram(const std::vector<double> &bounds)
+    : mBounds(bounds), mBuckets(new std::atomic<uint64_t>[bounds.size() + 1]) {
+    if (!std::is_sorted(this->mBounds.begin(), this->mBounds.end())) {
+        throw std::invalid_argument("Histogram bounds must be sorted");
+    }
+    for (size_t i = 0; i <= this->mBounds.size(); i++) {
+        this->mBuckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    size_t bucket = static_cast<size_t>(
+        std::lower_bound(this->mBounds.begin(), this->mBounds.end(), value) -
+        this->mBounds.begin());
+    this->mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    this->mCount.fetch_add(1, std::memory_order_relaxed);
+    atomicAdd(this->mSum, value);
+}
+
+void Histogram::render(std::string &out, const std::string &name,
+                       const std::string &labels) const {
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= this->mBounds.size(); i++) {
+        cumulative += this->mBuckets[i].load(std::memory_order_relaxed);
+        std::string bound = i < this->mBounds.size()
+                                ? formatValue(this->mBounds[i])
+                                : std::string("+Inf");
+        renderSample(out, name + "_bucket", withLabel(labels, "le", bound),
+                     std::to_string(cumulative));
+    }
+    renderSample(out, name + "_sum", labels, formatValue(this->sum()));
+    renderSample(out, name + "_count", labels, std::to_string(cumulative));
+}
+
+// Only its own thread writes to a shard, so plain loads and stores are
+// enough; the atomics let render read it at the same time
+struct HdrHistogram::Shard
+{
+    Shard() {
+        for (auto &count : this->counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint64_t> counts[kHdrBuckets];
+    std::atomic<uint64_t> sumNanos{0};
+};
+
+HdrHistogram::HdrHistogram(const std::vector<double> &bounds) : mBounds(bounds) {
+    if (!std::is_sorted(this->mBounds.begin(), this->mBounds.end())) {
+        throw std::invalid_argument("Histogram bounds must be sorted");
+    }
+}
+
+HdrHistogram::~HdrHistogram() { }
+
+void HdrHistogram::record(uint64_t nanos) {
+    Shard &shard = this->mShards.local();
+    std::atomic<uint64_t> &count = shard.counts[hdrBucket(nanos)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    shard.sumNanos.store(shard.sumNanos.load(std::memory_order_relaxed) + nanos,
+                         std::memory_order_relaxed);
+}
+
+std::vector<uint64_t> HdrHistogram::merged(uint64_t &sumNanos) const {
+    std::vector<uint64_t> counts(kHdrBuckets, 0);
+    sumNanos = 0;
+    this->mShards.forEach([&](const Shard &shard) {
+        for (size_t i = 0; i < kHdrBuckets; i++) {
+            counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+        }
+        sumNanos += shard.sumNanos.load(std::memory_order_relaxed);
+    });
+    return counts;
+}
+
+uint64_t HdrHistogram::count() const {
+    uint64_t sumNanos;
+    std::vector<uint64_t> counts = this->merged(sumNanos);
+    uint64_t total = 0;
+    for (uint64_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+double HdrHistogram::sum() const {
+    uint64_t sumNanos;
+    this->merged(sumNanos);
+    return static_cast<double>(sumNanos) / 1e9;
+}
+
+double HdrHistogram::quantile(double q) const {
+    uint64_t sumNanos;
+    std::vector<uint64_t> counts = this->merged(sumNanos);
+    uint64_t total = 0;
+    for (uint64_t count : counts) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::min(std::max(q, 0.0), 1.0) * total));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < kHdrBuckets; i++) {
+        cumulative += counts[i];
+        if (cumulative >= rank) {
+            // Middle of the bucket
+            uint64_t low = hdrLowest(i);
+            uint64_t high = hdrLowest(i + 1);
+            return static_cast<double>(low + (high - low - 1) / 2) / 1e9;
+        }
+    }
+    return static_cast<double>(kMaxValue) / 1e9;
+}
+
+void HdrHistogram::render(std::string &out, const std::string &name,
+                          const std::string &labels) const {
+    uint64_t sumNanos;
+    std::vector<uint64_t> counts = this->merged(sumNanos);
+
+    uint64_t cumulative = 0;
+    size_t bucket = 0;
+    for (double bound : this->mBounds) {
+        double limit = bound * 1e9;
+        while (bucket < kHdrBuckets && static_cast<double>(hdrLowest(bucket)) <= limit) {
+            cumulative += counts[bucket++];
+        }
+        renderSample(out, name + "_bucket", withLabel(labels, "le", formatValue(bound)),
+                     std::to_string(cumulative));
+    }
+    for (; bucket < kHdrBuckets; bucket++) {
+        cumulative += counts[bucket];
+    }
+    renderSample(out, name + "_bucket", withLabel(labels, "le", "+Inf"),
+                 std::to_string(cumulative));
+    renderSample(out, name + "_sum", labels, formatValue(static_cast<double>(sumNanos) / 1e9));
+    renderSample(out, name + "_count", labels, std::to_string(cumulative));
+}
+
+const char *Registry::typeName(Type type) {
+    switch (type) {
+    case Type::Counter:
+    case Type::ShardedCounter:
+        return "counter";
+    case Type::Gauge:
+        return "gauge";
+    case Type::Histogram:
+    case Type::HdrHistogram:
+        return "histogram";
+    }
+    return "untyped";
+}
+
+Registry::Registry(Labels defaultLabels) : mDefaultLabels(std::move(defaultLabels)) { }
+
+Registry &Registry::global() {
+    static Registry registry(defaultLabelsFromEnvironment());
+    return registry;
+}
+
+Registry::Family &Registry::family(const std::string &name, const std::string &help,
+                                   Type type) {
+    auto it = this->mFamilies.find(name);
+    if (it == this->mFamilies.end()) {
+        it = this->mFamilies.emplace(name, Family{type, help, {}}).first;
+    } else if (it->second.type != type) {
+        throw std::logic_error("Metric " + name + " is already registered with another type");
+    }
+    return it->second;
+}
+
+Counter &Registry::counter(const std::string &name, const std::string &help,
+                           const Labels &labels) {
+    std::lock_guard<std::mutex> lock(this->mMutex);
+    auto &series = this->family(name, help, Type::Counter).series[labels];
+    if (!series) {
+        series.reset(new Counter());
+    }
+    return static_cast<Counter &>(*series);
+}
+
+ShardedCounter &Registry::shardedCounter(const std::string &name, const std::string &help,
+                                         const Labels &labels) {
+    std::lock_guard<std::mutex> lock(this->mMutex);
+    auto &series = this->family(name, help, Type::ShardedCounter).series[labels];
+    if (!series) {
+        series.reset(new ShardedCounter());
+    }
+    return static_cast<ShardedCounter &>(*series);
+}
+
+Gauge &Registry::gauge(const std::string &name, const std::string &help,
+                       const Labels &labels) {
+    std::lock_guard<std::mutex> lock(this->mMutex);
+    auto &series = this->family(name, help, Type::Gauge).series[labels];
+    if (!series) {
+        series.reset(new Gauge());
+    }
+    return static_cast<Gauge &>(*series);
+}
+
+Histogram &Registry::histogram(const std::string &name, const std::string &help,
+                               const Labels &labels, const std::vector<double> &bounds) {
+    std::lock_guard<std::mutex> lock(this->mMutex);
+    auto &series = this->family(name, help, Type::Histogram).series[labels];
+    if (!series) {
+        series.reset(new Histogram(bounds));
+    }
+    return static_cast<Histogram &>(*series);
+}
+
+HdrHistogram &Registry::hdrHistogram(const std::string &name, const std::string &help,
+                                     const Labels &labels, const std::vector<double> &bounds) {
+    std::lock_guard<std::mutex> lock(this->mMutex);
+    auto &series = this->family(name, help, Type::HdrHistogram).series[labels];
+    if (!series) {
+        series.reset(new HdrHistogram(bounds));
+    }
+    return static_cast<HdrHistogram &>(*series);
+}
+
+std::string Registry::render() const {
+    std::lock_guard<std::mutex> lock(this->mMutex);
+
+    std::string out;
+    for (const auto &entry : this->mFamilies) {
+        const std::string &name = entry.first;
+        const Family &family = entry.second;
+
+        out.append("# HELP " + name + " " + family.help + "\n");
+        out.append("# TYPE " + name + " " + typeName(family.type) + "\n");
+
+        for (const auto &series : family.series) {
+            Labels labels = this->mDefaultLabels;
+            for (const auto &label : series.first) {
+                labels[label.first] = label.second;
+            }
+            series.second->render(out, name, renderLabels(labels));
+        }
+    }
+    return out;
+}
+
+}
+}
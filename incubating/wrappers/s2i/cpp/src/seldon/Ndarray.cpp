@@ -0,0 +1,391 @@
+#include "seldon/Ndarray.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "seldon/JsonEncoder.hpp"
+#include "seldon/TensorView.hpp"
+
+namespace seldon {
+namespace ndarray {
+
+namespace {
+
+// Leaf values are gathered into a chunk of doubles on the stack, then
+// converted to the target type in one vectorized pass
+constexpr size_t kChunkSize = 256;
+
+// Doubles strictly between these truncate to an int32_t
+constexpr double kInt32Low = -2147483649.0;
+constexpr double kInt32High = 2147483648.0;
+
+// Checks that every list down to the innermost dimension has the length
+// shape gives it, without reading the numbers themselves. Once it passes,
+// the product of shape is the number of values the request holds.
+void checkShape(const google::protobuf::ListValue &list, const std::vector<int64_t> &shape,
+                size_t depth) {
+    if (list.values_size() != shape[depth]) {
+        throw std::invalid_argument("ndarray is ragged at dimension " + std::to_string(depth));
+    }
+    if (depth + 1 == shape.size()) {
+        return;
+    }
+    for (const google::protobuf::Value &value : list.values()) {
+        if (value.kind_case() != google::protobuf::Value::kListValue) {
+            throw std::invalid_argument("ndarray is ragged at dimension " + std::to_string(depth));
+        }
+        checkShape(value.list_value(), shape, depth + 1);
+    }
+}
+
+// Writes the values of an ndarray that passed checkShape
+template <typename T>
+class Flattener
+{
+public:
+    Flattener(const std::vector<int64_t> &shape, T *out) : mShape(shape), mOut(out) { }
+
+    void flatten(const google::protobuf::ListValue &list, size_t depth) {
+        if (depth + 1 < this->mShape.size()) {
+            for (const google::protobuf::Value &value : list.values()) {
+                this->flatten(value.list_value(), depth + 1);
+            }
+            return;
+        }
+
+        for (const google::protobuf::Value &value : list.values()) {
+            double number;
+            switch (value.kind_case()) {
+            case google::protobuf::Value::kNumberValue:
+                number = value.number_value();
+                break;
+            case google::protobuf::Value::kBoolValue:
+                number = value.bool_value() ? 1.0 : 0.0;
+                break;
+            case google::protobuf::Value::kListValue:
+                throw std::invalid_argument("ndarray is ragged at dimension " +
+                                            std::to_string(depth));
+            default:
+                throw std::invalid_argument("ndarray holds a non-numeric value");
+            }
+            this->mChunk[this->mChunkSize++] = number;
+            if (this->mChunkSize == kChunkSize) {
+                this->drain();
+            }
+        }
+    }
+
+    void drain() {
+        convert(this->mChunk, this->mChunkSize, this->mOut);
+        this->mOut += this->mChunkSize;
+        this->mChunkSize = 0;
+    }
+
+private:
+    const std::vector<int64_t> &mShape;
+    T *mOut;
+    double mChunk[kChunkSize];
+    size_t mChunkSize = 0;
+};
+
+template <typename T>
+char *writeValue(T value, int floatDigits, char *out) {
+    return json::writeNumber(value, out);
+}
+
+char *writeValue(float value, int floatDigits, char *out) {
+    return json::writeNumber(value, floatDigits, out);
+}
+
+// Writes values nested to shape from depth on, with the brackets and
+// commas between them
+template <typename T>
+char *writeDimension(const T *&values, const std::vector<int64_t> &shape, size_t depth,
+                     int floatDigits, char *out) {
+    *out++ = '[';
+    int64_t size = shape[depth];
+    for (int64_t i = 0; i < size; i++) {
+        if (i > 0) {
+            *out++ = ',';
+        }
+        if (depth + 1 == shape.size()) {
+            out = writeValue(*values++, floatDigits, out);
+        } else {
+            out = writeDimension(values, shape, depth + 1, floatDigits, out);
+        }
+    }
+    *out++ = ']';
+    return out;
+}
+
+}
+
+void convert(const double *in, size_t size, double *out) {
+    std::memcpy(out, in, size * sizeof(double));
+}
+
+void convert(const double *in, size_t size, float *out) {
+    size_t i = 0;
+#if defined(__AVX__)
+    for (; i + 4 <= size; i += 4) {
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(_mm256_loadu_pd(in + i)));
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= size; i += 4) {
+        __m128 low = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+        __m128 high = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+        _mm_storeu_ps(out + i, _mm_movelh_ps(low, high));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= size; i += 4) {
+        float32x2_t low = vcvt_f32_f64(vld1q_f64(in + i));
+        float32x2_t high = vcvt_f32_f64(vld1q_f64(in + i + 2));
+        vst1q_f32(out + i, vcombine_f32(low, high));
+    }
+#endif
+    for (; i < size; i++) {
+        out[i] = static_cast<float>(in[i]);
+    }
+}
+
+void convert(const double *in, size_t size, int32_t *out) {
+    // A block with a value out of range is left to the scalar loop, which
+    // throws at that value
+    size_t i = 0;
+#if defined(__AVX__)
+    const __m256d low = _mm256_set1_pd(kInt32Low);
+    const __m256d high = _mm256_set1_pd(kInt32High);
+    for (; i + 4 <= size; i += 4) {
+        __m256d values = _mm256_loadu_pd(in + i);
+        __m256d valid = _mm256_and_pd(_mm256_cmp_pd(values, low, _CMP_GT_OQ),
+                                      _mm256_cmp_pd(values, high, _CMP_LT_OQ));
+        if (_mm256_movemask_pd(valid) != 0xF) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm256_cvttpd_epi32(values));
+    }
+#elif defined(__SSE2__)
+    const __m128d low = _mm_set1_pd(kInt32Low);
+    const __m128d high = _mm_set1_pd(kInt32High);
+    for (; i + 4 <= size; i += 4) {
+        __m128d first = _mm_loadu_pd(in + i);
+        __m128d second = _mm_loadu_pd(in + i + 2);
+        __m128d valid = _mm_and_pd(
+            _mm_and_pd(_mm_cmpgt_pd(first, low), _mm_cmplt_pd(first, high)),
+            _mm_and_pd(_mm_cmpgt_pd(second, low), _mm_cmplt_pd(second, high)));
+        if (_mm_movemask_pd(valid) != 0x3) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                         _mm_unpacklo_epi64(_mm_cvttpd_epi32(first), _mm_cvttpd_epi32(second)));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float64x2_t low = vdupq_n_f64(kInt32Low);
+    const float64x2_t high = vdupq_n_f64(kInt32High);
+    for (; i + 4 <= size; i += 4) {
+        float64x2_t first = vld1q_f64(in + i);
+        float64x2_t second = vld1q_f64(in + i + 2);
+        uint64x2_t valid = vandq_u64(vandq_u64(vcgtq_f64(first, low), vcltq_f64(first, high)),
+                                     vandq_u64(vcgtq_f64(second, low), vcltq_f64(second, high)));
+        if ((vgetq_lane_u64(valid, 0) & vgetq_lane_u64(valid, 1)) == 0) {
+            break;
+        }
+        int32x2_t lowHalf = vmovn_s64(vcvtq_s64_f64(first));
+        int32x2_t highHalf = vmovn_s64(vcvtq_s64_f64(second));
+        vst1q_s32(out + i, vcombine_s32(lowHalf, highHalf));
+    }
+#endif
+    for (; i < size; i++) {
+        out[i] = checkedCast<int32_t>(in[i]);
+    }
+}
+
+template <typename T>
+void flatten(const google::protobuf::ListValue &ndarray, std::vector<int64_t> &shape,
+             std::vector<T> &values) {
+
+    // The first element at every depth fixes the shape. Every other list
+    // is checked against it before values is sized, so a ragged request
+    // can't claim more values than it sent.
+    shape.clear();
+    const google::protobuf::ListValue *list = &ndarray;
+    while (true) {
+        shape.push_back(list->values_size());
+        if (list->values_size() == 0 ||
+            list->values(0).kind_case() != google::protobuf::Value::kListValue) {
+            break;
+        }
+        list = &list->values(0).list_value();
+    }
+    checkShape(ndarray, shape, 0);
+
+    values.resize(static_cast<size_t>(detail::elementCount(shape)));
+    Flattener<T> flattener(shape, values.data());
+    flattener.flatten(ndarray, 0);
+    flattener.drain();
+}
+
+template <typename T>
+void appendJson(const T *values, const std::vector<int64_t> &shape, std::string &out,
+                int floatDigits) {
+    // Room for every number and list, each with a comma after it, so the
+    // text is written without a bounds check per number
+    size_t size = json::kMaxNumberSize;
+    for (size_t depth = shape.size(); depth-- > 0;) {
+        size = static_cast<size_t>(shape[depth]) * (size + 1) + 2;
+    }
+    size_t used = out.size();
+    out.resize(used + size);
+    char *end;
+    if (shape.empty()) {
+        end = writeValue(*values, floatDigits, &out[used]);
+    } else {
+        end = writeDimension(values, shape, 0, floatDigits, &out[used]);
+    }
+    out.resize(static_cast<size_t>(end - out.data()));
+}
+
+namespace {
+
+// Wire-format keys: ListValue.values, Value.number_value, Value.list_value,
+// Tensor.shape and Tensor.values
+constexpr char kListValues = (1 << 3) | 2;
+constexpr char kNumberValue = (2 << 3) | 1;
+constexpr char kListValue = (6 << 3) | 2;
+constexpr char kTensorShape = (1 << 3) | 2;
+constexpr char kTensorValues = (2 << 3) | 2;
+
+size_t varintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+char *writeVarint(uint64_t value, char *out) {
+    while (value >= 0x80) {
+        *out++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+// Size of a Value at depth, holding a number below the last dimension and
+// a list of the next dimension above it
+size_t valueSize(const std::vector<int64_t> &shape, size_t depth);
+
+size_t listSize(const std::vector<int64_t> &shape, size_t depth) {
+    size_t value = valueSize(shape, depth + 1);
+    return static_cast<size_t>(shape[depth]) * (1 + varintSize(value) + value);
+}
+
+size_t valueSize(const std::vector<int64_t> &shape, size_t depth) {
+    if (depth == shape.size()) {
+        return 1 + sizeof(double);
+    }
+    size_t list = listSize(shape, depth);
+    return 1 + varintSize(list) + list;
+}
+
+// Every list and value at a depth has the same size, so they are computed
+// once per dimension rather than per element
+char *writeList(const double *&values, const std::vector<int64_t> &shape, size_t depth,
+                const std::vector<size_t> &valueSizes, const std::vector<size_t> &listSizes,
+                char *out) {
+    for (int64_t i = 0; i < shape[depth]; i++) {
+        *out++ = kListValues;
+        out = writeVarint(valueSizes[depth + 1], out);
+        if (depth + 1 == shape.size()) {
+            *out++ = kNumberValue;
+            std::memcpy(out, values++, sizeof(double));
+            out += sizeof(double);
+        } else {
+            *out++ = kListValue;
+            out = writeVarint(listSizes[depth + 1], out);
+            out = writeList(values, shape, depth + 1, valueSizes, listSizes, out);
+        }
+    }
+    return out;
+}
+
+size_t shapeSize(const std::vector<int64_t> &shape) {
+    size_t size = 0;
+    for (int64_t dim : shape) {
+        size += varintSize(static_cast<uint64_t>(dim));
+    }
+    return size;
+}
+
+}
+
+size_t listValueSize(const std::vector<int64_t> &shape) {
+    return listSize(shape, 0);
+}
+
+void writeListValue(const double *values, const std::vector<int64_t> &shape, char *out) {
+    std::vector<size_t> valueSizes(shape.size() + 1);
+    std::vector<size_t> listSizes(shape.size());
+    for (size_t depth = 0; depth <= shape.size(); depth++) {
+        valueSizes[depth] = valueSize(shape, depth);
+        if (depth < shape.size()) {
+            listSizes[depth] = listSize(shape, depth);
+        }
+    }
+    writeList(values, shape, 0, valueSizes, listSizes, out);
+}
+
+size_t tensorSize(const std::vector<int64_t> &shape) {
+    size_t size = 0;
+    if (!shape.empty()) {
+        size_t dims = shapeSize(shape);
+        size += 1 + varintSize(dims) + dims;
+    }
+    size_t count = static_cast<size_t>(detail::elementCount(shape));
+    if (count > 0) {
+        size += 1 + varintSize(count * sizeof(double)) + count * sizeof(double);
+    }
+    return size;
+}
+
+void writeTensor(const double *values, const std::vector<int64_t> &shape, char *out) {
+    if (!shape.empty()) {
+        *out++ = kTensorShape;
+        out = writeVarint(shapeSize(shape), out);
+        for (int64_t dim : shape) {
+            out = writeVarint(static_cast<uint64_t>(dim), out);
+        }
+    }
+    size_t count = static_cast<size_t>(detail::elementCount(shape));
+    if (count > 0) {
+        // Packed doubles are little-endian, like every target this builds for
+        *out++ = kTensorValues;
+        out = writeVarint(count * sizeof(double), out);
+        std::memcpy(out, values, count * sizeof(double));
+    }
+}
+
+#define SELDON_NDARRAY_INSTANTIATE(TYPE)                                                     \
+    template void flatten<TYPE>(const google::protobuf::ListValue &, std::vector<int64_t> &, \
+                                std::vector<TYPE> &);                                        \
+    template void appendJson<TYPE>(const TYPE *, const std::vector<int64_t> &, std::string &, \
+                                   int);
+
+SELDON_NDARRAY_INSTANTIATE(double)
+SELDON_NDARRAY_INSTANTIATE(float)
+SELDON_NDARRAY_INSTANTIATE(int32_t)
+SELDON_NDARRAY_INSTANTIATE(int64_t)
+
+#undef SELDON_NDARRAY_INSTANTIATE
+
+}
+}
@@ -0,0 +1,334 @@
+#include "seldon/PredictionCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include "seldon/Environment.hpp"
+#include "seldon/Metrics.hpp"
+
+namespace seldon {
+
+namespace {
+
+// Rough heap cost of an entry beyond its key and value: the list node,
+// the index slot and the shared value's control block
+constexpr size_t kEntryOverhead = 128;
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t read64(const char *data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint32_t read32(const char *data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint64_t hashRound(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * kPrime2, 31) * kPrime1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    return (acc ^ hashRound(0, value)) * kPrime1 + kPrime4;
+}
+
+size_t nextPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+const char *kindLabel(PredictionCache::Kind kind) {
+    switch (kind) {
+    case PredictionCache::Kind::JsonRequest:
+        return "json";
+    case PredictionCache::Kind::ProtoRequest:
+        return "proto";
+    case PredictionCache::Kind::Message:
+        return "message";
+    }
+    return "unknown";
+}
+
+}
+
+// XXH64, which reads 32 bytes per iteration over four independent lanes
+uint64_t hashBytes(const char *data, size_t size, uint64_t seed) {
+    const char *end = data + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (; data + 32 <= end; data += 32) {
+            v1 = hashRound(v1, read64(data));
+            v2 = hashRound(v2, read64(data + 8));
+            v3 = hashRound(v3, read64(data + 16));
+            v4 = hashRound(v4, read64(data + 24));
+        }
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+
+    hash += size;
+    for (; data + 8 <= end; data += 8) {
+        hash = rotl(hash ^ hashRound(0, read64(data)), 27) * kPrime1 + kPrime4;
+    }
+    if (data + 4 <= end) {
+        hash = rotl(hash ^ (read32(data) * kPrime1), 23) * kPrime2 + kPrime3;
+        data += 4;
+    }
+    for (; data < end; data++) {
+        hash = rotl(hash ^ (static_cast<uint8_t>(*data) * kPrime5), 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+bool payloadKey(const protos::SeldonMessage &message, std::string &key) {
+    key.clear();
+    const google::protobuf::Message *payload;
+    switch (message.data_oneof_case()) {
+    case protos::SeldonMessage::kData:
+        key.push_back('d');
+        payload = &message.data();
+        break;
+    case protos::SeldonMessage::kJsonData:
+        key.push_back('j');
+        payload = &message.jsondata();
+        break;
+    case protos::SeldonMessage::kBinData:
+        key.push_back('b');
+        key.append(message.bindata());
+        return true;
+    case protos::SeldonMessage::kStrData:
+        key.push_back('s');
+        key.append(message.strdata());
+        return true;
+    default:
+        return false;
+    }
+
+    // The coded stream trims key back to what was written when it goes
+    // out of scope
+    google::protobuf::io::StringOutputStream stream(&key);
+    google::protobuf::io::CodedOutputStream coded(&stream);
+    coded.SetSerializationDeterministic(true);
+    return payload->SerializeToCodedStream(&coded);
+}
+
+CacheOptions CacheOptions::fromEnvironment() {
+    CacheOptions options;
+    options.maxBytes = envInt("SELDON_CPP_CACHE_MAX_BYTES", options.maxBytes);
+    options.ttlMs = envInt("SELDON_CPP_CACHE_TTL_MS", options.ttlMs);
+    options.shards = static_cast<int>(envInt("SELDON_CPP_CACHE_SHARDS", options.shards));
+    return options;
+}
+
+size_t PredictionCache::Entry::bytes() const {
+    return this->key.size() + this->value->size() + kEntryOverhead;
+}
+
+PredictionCache::FrequencySketch::FrequencySketch(size_t width)
+    : mCounters(4 * width, 0), mMask(width - 1), mSampleSize(10 * width) { }
+
+size_t PredictionCache::FrequencySketch::index(uint64_t hash, int row) const {
+    static const uint64_t kSeeds[] = {kPrime1, kPrime2, kPrime3, kPrime4};
+    uint64_t mixed = (hash + kSeeds[row]) * kSeeds[row];
+    return static_cast<size_t>(row) * (this->mMask + 1) + ((mixed >> 32) & this->mMask);
+}
+
+void PredictionCache::FrequencySketch::increment(uint64_t hash) {
+    for (int row = 0; row < 4; row++) {
+        uint8_t &counter = this->mCounters[this->index(hash, row)];
+        if (counter < 15) {
+            counter++;
+        }
+    }
+    if (++this->mAdditions >= this->mSampleSize) {
+        for (uint8_t &counter : this->mCounters) {
+            counter >>= 1;
+        }
+        this->mAdditions /= 2;
+    }
+}
+
+int PredictionCache::FrequencySketch::estimate(uint64_t hash) const {
+    int result = 15;
+    for (int row = 0; row < 4; row++) {
+        result = std::min<int>(result, this->mCounters[this->index(hash, row)]);
+    }
+    return result;
+}
+
+PredictionCache::PredictionCache(CacheOptions options)
+    : mOptions(options),
+      mExpired(metrics::Registry::global().counter(
+          "seldon_cpp_cache_evictions_total", "Cached predictions removed",
+          {{"reason", "expired"}})),
+      mEvicted(metrics::Registry::global().counter(
+          "seldon_cpp_cache_evictions_total", "Cached predictions removed", {{"reason", "size"}})),
+      mRejected(metrics::Registry::global().counter(
+          "seldon_cpp_cache_rejections_total",
+          "Predictions not cached as they were asked for less often than the ones they'd replace")),
+      mBytes(metrics::Registry::global().gauge(
+          "seldon_cpp_cache_bytes", "Bytes held by cached predictions")) {
+
+    size_t shards = nextPowerOfTwo(static_cast<size_t>(std::max(1, options.shards)));
+    this->mShardBytes = static_cast<size_t>(std::max<int64_t>(0, options.maxBytes)) / shards;
+
+    // Sized for entries of around 1KB, which is plenty for the sketch to
+    // tell popular keys apart from one-off ones
+    size_t sketchWidth = nextPowerOfTwo(std::max<size_t>(this->mShardBytes / 1024, 256));
+    sketchWidth = std::min<size_t>(sketchWidth, size_t(1) << 16);
+    for (size_t i = 0; i < shards; i++) {
+        this->mShards.emplace_back(new Shard(sketchWidth));
+    }
+
+    for (Kind kind : {Kind::JsonRequest, Kind::ProtoRequest, Kind::Message}) {
+        metrics::Labels labels = {{"kind", kindLabel(kind)}};
+        this->mHits[static_cast<int>(kind)] = &metrics::Registry::global().counter(
+            "seldon_cpp_cache_hits_total", "Predictions served from the cache", labels);
+        this->mMisses[static_cast<int>(kind)] = &metrics::Registry::global().counter(
+            "seldon_cpp_cache_misses_total", "Predictions not found in the cache", labels);
+    }
+}
+
+PredictionCache::~PredictionCache() {
+    this->mBytes.dec(static_cast<double>(this->bytes()));
+}
+
+std::shared_ptr<const std::string> PredictionCache::get(Kind kind, const char *key, size_t size) {
+    uint64_t hash = hashBytes(key, size, static_cast<uint64_t>(kind));
+    Shard &shard = this->shardOf(hash);
+    auto now = std::chrono::steady_clock::now();
+
+    std::shared_ptr<const std::string> value;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.sketch.increment(hash);
+        auto found = shard.index.find(hash);
+        if (found != shard.index.end()) {
+            auto entry = found->second;
+            if (entry->kind == kind && entry->key.size() == size &&
+                std::memcmp(entry->key.data(), key, size) == 0) {
+                if (entry->expires <= now) {
+                    this->remove(shard, entry, &this->mExpired);
+                } else {
+                    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+                    value = entry->value;
+                }
+            }
+        }
+    }
+
+    (value ? this->mHits : this->mMisses)[static_cast<int>(kind)]->inc();
+    return value;
+}
+
+void PredictionCache::put(Kind kind, const char *key, size_t size, std::string value) {
+    uint64_t hash = hashBytes(key, size, static_cast<uint64_t>(kind));
+    Shard &shard = this->shardOf(hash);
+    auto now = std::chrono::steady_clock::now();
+
+    Entry entry{hash, kind, std::string(key, size),
+                std::make_shared<const std::string>(std::move(value)),
+                now + std::chrono::milliseconds(this->mOptions.ttlMs)};
+    size_t bytes = entry.bytes();
+    if (bytes > this->mShardBytes) {
+        this->mRejected.inc();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(hash);
+    if (found != shard.index.end()) {
+        this->remove(shard, found->second, nullptr);
+    }
+
+    // Expired entries go first; live ones only make way for a key that
+    // has been asked for more often
+    int frequency = shard.sketch.estimate(hash);
+    while (shard.bytes + bytes > this->mShardBytes) {
+        auto victim = std::prev(shard.lru.end());
+        if (victim->expires <= now) {
+            this->remove(shard, victim, &this->mExpired);
+        } else if (frequency > shard.sketch.estimate(victim->hash)) {
+            this->remove(shard, victim, &this->mEvicted);
+        } else {
+            this->mRejected.inc();
+            return;
+        }
+    }
+
+    shard.lru.push_front(std::move(entry));
+    shard.index[hash] = shard.lru.begin();
+    shard.bytes += bytes;
+    this->mBytes.inc(static_cast<double>(bytes));
+}
+
+size_t PredictionCache::entries() const {
+    size_t result = 0;
+    for (const auto &shard : this->mShards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        result += shard->lru.size();
+    }
+    return result;
+}
+
+size_t PredictionCache::bytes() const {
+    size_t result = 0;
+    for (const auto &shard : this->mShards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        result += shard->bytes;
+    }
+    return result;
+}
+
+PredictionCache::Shard &PredictionCache::shardOf(uint64_t hash) {
+    return *this->mShards[(hash >> 32) & (this->mShards.size() - 1)];
+}
+
+void PredictionCache::remove(Shard &shard, std::list<Entry>::iterator entry,
+                             metrics::Counter *reason) {
+    size_t bytes = entry->bytes();
+    shard.bytes -= bytes;
+    this->mBytes.dec(static_cast<double>(bytes));
+    shard.index.erase(entry->hash);
+    shard.lru.erase(entry);
+    if (reason != nullptr) {
+        reason->inc();
+    }
+}
+
+}
@@ -0,0 +1,57 @@
+#include "seldon/RequestArena.hpp"
+
+#include <algorithm>
+
+namespace seldon {
+
+constexpr size_t RequestArena::kMinBlockSize;
+constexpr size_t RequestArena::kMaxBlockSize;
+
+RequestArena::Scope::Scope() : mArena(RequestArena::local()) {
+    this->mArena.mDepth++;
+}
+
+RequestArena::Scope::~Scope() {
+    if (--this->mArena.mDepth == 0) {
+        this->mArena.reset();
+    }
+}
+
+RequestArena::RequestArena() {
+    this->allocate(kMinBlockSize);
+}
+
+RequestArena &RequestArena::local() {
+    thread_local RequestArena arena;
+    return arena;
+}
+
+void RequestArena::reset() {
+    size_t used = static_cast<size_t>(this->mArena->SpaceAllocated());
+
+    if (used > this->mBlockSize && this->mBlockSize < kMaxBlockSize) {
+        // The last request spilled into heap blocks; size the initial block
+        // so that a request like it fits next time
+        size_t blockSize = this->mBlockSize;
+        while (blockSize < used && blockSize < kMaxBlockSize) {
+            blockSize *= 2;
+        }
+        this->allocate(std::min(blockSize, kMaxBlockSize));
+    } else {
+        this->mArena->Reset();
+    }
+}
+
+void RequestArena::allocate(size_t blockSize) {
+    // The old arena must go before the block it was built on
+    this->mArena.reset();
+    this->mBlock.reset(new char[blockSize]);
+    this->mBlockSize = blockSize;
+
+    google::protobuf::ArenaOptions options;
+    options.initial_block = this->mBlock.get();
+    options.initial_block_size = blockSize;
+    this->mArena.reset(new google::protobuf::Arena(options));
+}
+
+}
@@ -0,0 +1,49 @@
+#include "seldon/StageTimer.hpp"
+
+#include <atomic>
+#include <string>
+
+#include "seldon/Metrics.hpp"
+
+namespace seldon {
+
+namespace {
+
+constexpr int kMethods = static_cast<int>(Method::Metadata) + 1;
+constexpr int kStages = static_cast<int>(Stage::Encode) + 1;
+
+// Series are only registered once a method is used, so /metrics doesn't
+// list every stage of methods the model never serves
+metrics::HdrHistogram &histogramOf(Method method, Stage stage) {
+    static std::atomic<metrics::HdrHistogram *> histograms[kMethods][kStages];
+    static const char *const names[kStages] = {"decode", "predict", "encode"};
+    static const char *const helps[kStages] = {
+        "Time spent decoding requests",
+        "Time spent in the model",
+        "Time spent encoding responses",
+    };
+
+    auto &slot = histograms[static_cast<int>(method)][static_cast<int>(stage)];
+    metrics::HdrHistogram *histogram = slot.load(std::memory_order_acquire);
+    if (histogram == nullptr) {
+        // The registry hands every thread the same series
+        histogram = &metrics::Registry::global().hdrHistogram(
+            std::string("seldon_cpp_") + names[static_cast<int>(stage)] + "_seconds",
+            helps[static_cast<int>(stage)], {{"method", methodName(method)}});
+        slot.store(histogram, std::memory_order_release);
+    }
+    return *histogram;
+}
+
+}
+
+void StageTimer::lap(Stage stage) {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t nanos = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->mLast).count());
+    this->mLast = now;
+    this->mNanos[static_cast<int>(stage)] += nanos;
+    histogramOf(this->mMethod, stage).record(nanos);
+}
+
+}
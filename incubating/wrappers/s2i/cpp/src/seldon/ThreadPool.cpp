@@ -0,0 +1,154 @@
+#include "seldon/ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+#include "seldon/Environment.hpp"
+
+namespace seldon {
+
+namespace {
+
+// Set while running a range, so nested parallelFor calls run inline
+// rather than queueing helpers that every pool thread is too busy to run
+thread_local bool tInRange = false;
+
+struct Ranges
+{
+    const std::function<void(size_t, size_t)> *fn;
+    size_t size;
+    size_t count;
+    std::atomic<size_t> next{0};
+
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t activeHelpers = 0;
+    std::exception_ptr error;
+
+    // Claims ranges until there are none left
+    void drain() {
+        tInRange = true;
+        size_t index;
+        while ((index = this->next.fetch_add(1)) < this->count) {
+            size_t begin = this->size * index / this->count;
+            size_t end = this->size * (index + 1) / this->count;
+            try {
+                (*this->fn)(begin, end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (!this->error) {
+                    this->error = std::current_exception();
+                }
+            }
+        }
+        tInRange = false;
+    }
+
+    // Run by pool threads. A helper only counts once it has seen ranges
+    // left, so the caller never waits on one still queued.
+    void help() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->next.load() >= this->count) {
+                return;
+            }
+            this->activeHelpers++;
+        }
+        this->drain();
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (--this->activeHelpers == 0) {
+            this->done.notify_one();
+        }
+    }
+};
+
+}
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < threads; i++) {
+        this->mThreads.emplace_back([this]() { this->run(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mStopping = true;
+    }
+    this->mReady.notify_all();
+    for (auto &thread : this->mThreads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t size, size_t grain,
+                             const std::function<void(size_t, size_t)> &fn) {
+    if (size == 0) {
+        return;
+    }
+
+    grain = std::max<size_t>(grain, 1);
+    size_t count = std::min((size + grain - 1) / grain, this->mThreads.size() + 1);
+    if (count <= 1 || tInRange) {
+        fn(0, size);
+        return;
+    }
+
+    // Helpers may outlive the call, still queued or holding the lock when
+    // the caller wakes up, so they share ownership of the state
+    auto ranges = std::make_shared<Ranges>();
+    ranges->fn = &fn;
+    ranges->size = size;
+    ranges->count = count;
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        for (size_t i = 0; i + 1 < count; i++) {
+            this->mTasks.emplace_back([ranges]() { ranges->help(); });
+        }
+    }
+    this->mReady.notify_all();
+
+    ranges->drain();
+
+    std::unique_lock<std::mutex> lock(ranges->mutex);
+    ranges->done.wait(lock, [&ranges]() { return ranges->activeHelpers == 0; });
+    if (ranges->error) {
+        std::rethrow_exception(ranges->error);
+    }
+}
+
+void ThreadPool::post(std::function<void()> work) {
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mTasks.push_back(std::move(work));
+    }
+    this->mReady.notify_one();
+}
+
+ThreadPool &ThreadPool::global() {
+    static ThreadPool pool(static_cast<int>(envInt("SELDON_CPP_POOL_THREADS", 0)));
+    return pool;
+}
+
+void ThreadPool::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(this->mMutex);
+            this->mReady.wait(lock, [this]() { return this->mStopping || !this->mTasks.empty(); });
+            if (this->mTasks.empty()) {
+                return;
+            }
+            task = std::move(this->mTasks.front());
+            this->mTasks.pop_front();
+        }
+        task();
+    }
+}
+
+}
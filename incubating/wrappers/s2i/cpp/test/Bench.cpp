@@ -0,0 +1,447 @@
+// Benchmarks for the hot paths of the wrapper. Prints a table to stderr
+// and the results as JSON, in the format of Google Benchmark's
+// --benchmark_format=json so its compare.py can diff two runs:
+//
+//   seldon-bench [--filter TEXT] [--min-time-ms N] [--repetitions N]
+//                [--max-elements N] [--max-threads N] [--out FILE]
+//
+// Payloads are generated from a fixed seed, so runs on the same build and
+// machine are comparable.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pybind11/embed.h>
+
+#include "seldon/SeldonModel.hpp"
+#include "seldon/TensorView.hpp"
+
+namespace {
+
+// Allocations made by the current thread, counted by the replacement
+// operator new below
+thread_local uint64_t tAllocations = 0;
+
+}
+
+void *operator new(size_t size) {
+    tAllocations++;
+    void *pointer = std::malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+
+using seldon::protos::SeldonMessage;
+using Clock = std::chrono::steady_clock;
+
+// Returns its input, so every benchmark measures the wrapper rather than
+// a model
+class EchoModel : public seldon::SeldonModelBase
+{
+public:
+    void predict(SeldonMessage &input, SeldonMessage &output) override {
+        output.Swap(&input);
+    }
+};
+
+struct Options
+{
+    std::string filter;
+    double minTimeMs = 200;
+    int repetitions = 5;
+    int64_t maxElements = 1000000;
+    int maxThreads = 0;
+    std::string out;
+};
+
+struct Result
+{
+    std::string name;
+    int64_t iterations;
+    // Median of the repetitions
+    double realNs;
+    double cpuNs;
+    double allocations;
+    double itemsPerSecond;
+};
+
+double cpuNow() {
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC * 1e9;
+}
+
+double elapsedNs(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+class Runner
+{
+public:
+    explicit Runner(Options options) : mOptions(std::move(options)) { }
+
+    bool selected(const std::string &name) const {
+        return name.find(this->mOptions.filter) != std::string::npos;
+    }
+
+    const Options &options() const { return this->mOptions; }
+
+    // Times fn on the calling thread. The iteration count is doubled until
+    // a repetition takes minTimeMs, then each repetition runs that many.
+    void run(const std::string &name, const std::function<void()> &fn) {
+        if (!this->selected(name)) {
+            return;
+        }
+
+        fn();
+        int64_t iterations = 1;
+        while (true) {
+            Clock::time_point start = Clock::now();
+            for (int64_t i = 0; i < iterations; i++) {
+                fn();
+            }
+            if (elapsedNs(start) >= this->mOptions.minTimeMs * 1e6 || iterations >= (1 << 30)) {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        std::vector<double> real;
+        std::vector<double> cpu;
+        uint64_t allocations = tAllocations;
+        for (int r = 0; r < this->mOptions.repetitions; r++) {
+            double cpuStart = cpuNow();
+            Clock::time_point start = Clock::now();
+            for (int64_t i = 0; i < iterations; i++) {
+                fn();
+            }
+            real.push_back(elapsedNs(start) / iterations);
+            cpu.push_back((cpuNow() - cpuStart) / iterations);
+        }
+        double perIteration = static_cast<double>(tAllocations - allocations) /
+                              (iterations * this->mOptions.repetitions);
+
+        double realNs = median(real);
+        this->add(Result{name, iterations, realNs, median(cpu), perIteration, 1e9 / realNs});
+    }
+
+    // Runs fn on threads threads for minTimeMs and reports the throughput
+    // of all of them together
+    void runThreads(const std::string &name, int threads, const std::function<void()> &fn) {
+        if (!this->selected(name)) {
+            return;
+        }
+
+        std::vector<double> rates;
+        std::vector<double> cpu;
+        int64_t total = 0;
+        for (int r = 0; r < this->mOptions.repetitions; r++) {
+            double cpuStart = cpuNow();
+            std::atomic<bool> stop{false};
+            std::atomic<int64_t> done{0};
+            std::vector<std::thread> workers;
+            Clock::time_point start = Clock::now();
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&]() {
+                    int64_t count = 0;
+                    while (!stop.load(std::memory_order_relaxed)) {
+                        fn();
+                        count++;
+                    }
+                    done += count;
+                });
+            }
+            std::this_thread::sleep_for(
+                std::chrono::microseconds(static_cast<int64_t>(this->mOptions.minTimeMs * 1000)));
+            stop = true;
+            for (auto &worker : workers) {
+                worker.join();
+            }
+            rates.push_back(done * 1e9 / elapsedNs(start));
+            cpu.push_back((cpuNow() - cpuStart) / std::max<int64_t>(done, 1));
+            total += done;
+        }
+
+        // Real time is per request across all threads, CPU time is that
+        // of the whole process per request
+        double rate = median(rates);
+        this->add(Result{name, total, 1e9 / rate, median(cpu), 0, rate});
+    }
+
+    std::string json() const {
+        std::ostringstream out;
+        char date[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        out << "{\n  \"context\": {\n"
+            << "    \"date\": \"" << date << "\",\n"
+            << "    \"executable\": \"seldon-bench\",\n"
+            << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+            << "    \"compiler\": \"" << __VERSION__ << "\",\n"
+#ifdef NDEBUG
+            << "    \"library_build_type\": \"release\",\n"
+#else
+            << "    \"library_build_type\": \"debug\",\n"
+#endif
+            << "    \"repetitions\": " << this->mOptions.repetitions << ",\n"
+            << "    \"min_time_ms\": " << this->mOptions.minTimeMs << "\n"
+            << "  },\n  \"benchmarks\": [";
+        for (size_t i = 0; i < this->mResults.size(); i++) {
+            const Result &result = this->mResults[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\n"
+                << "      \"name\": \"" << result.name << "\",\n"
+                << "      \"run_name\": \"" << result.name << "\",\n"
+                << "      \"run_type\": \"aggregate\",\n"
+                << "      \"aggregate_name\": \"median\",\n"
+                << "      \"iterations\": " << result.iterations << ",\n"
+                << "      \"real_time\": " << result.realNs << ",\n"
+                << "      \"cpu_time\": " << result.cpuNs << ",\n"
+                << "      \"time_unit\": \"ns\",\n"
+                << "      \"allocations_per_iteration\": " << result.allocations << ",\n"
+                << "      \"items_per_second\": " << result.itemsPerSecond << "\n"
+                << "    }";
+        }
+        out << "\n  ]\n}\n";
+        return out.str();
+    }
+
+private:
+    void add(Result result) {
+        std::fprintf(stderr, "%-48s %14.0f ns %14.0f ns %10.1f allocs %14.0f /s\n",
+                     result.name.c_str(), result.realNs, result.cpuNs, result.allocations,
+                     result.itemsPerSecond);
+        this->mResults.push_back(std::move(result));
+    }
+
+    Options mOptions;
+    std::vector<Result> mResults;
+};
+
+// Shape with up to 1000 columns holding elements values
+std::vector<int64_t> shapeOf(int64_t elements) {
+    int64_t columns = std::min<int64_t>(elements, 1000);
+    return {elements / columns, columns};
+}
+
+SeldonMessage payload(const std::string &kind, int64_t elements) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> value(-1, 1);
+    std::vector<int64_t> shape = shapeOf(elements);
+
+    SeldonMessage message;
+    message.mutable_meta()->set_puid("bench");
+    if (kind == "tensor") {
+        auto output = seldon::TensorBuilder<double>::tensor(*message.mutable_data(), shape);
+        std::generate(output.begin(), output.end(), [&]() { return value(random); });
+    } else if (kind == "tftensor") {
+        auto output = seldon::TensorBuilder<float>::tftensor(*message.mutable_data(), shape);
+        std::generate(output.begin(), output.end(), [&]() { return value(random); });
+    } else if (kind == "binData") {
+        // The raw bytes of as many floats, base64 encoded in JSON
+        std::string *bytes = message.mutable_bindata();
+        bytes->resize(static_cast<size_t>(elements) * sizeof(float));
+        std::generate(bytes->begin(), bytes->end(),
+                      [&]() { return static_cast<char>(random() & 0xFF); });
+    } else {
+        auto *rows = message.mutable_data()->mutable_ndarray();
+        for (int64_t r = 0; r < shape[0]; r++) {
+            auto *row = rows->add_values()->mutable_list_value();
+            for (int64_t c = 0; c < shape[1]; c++) {
+                row->add_values()->set_number_value(value(random));
+            }
+        }
+    }
+    return message;
+}
+
+// Small tensor under the kind of meta a deep inference graph builds up
+SeldonMessage metaHeavy() {
+    SeldonMessage message = payload("tensor", 10);
+    auto *meta = message.mutable_meta();
+    for (int i = 0; i < 50; i++) {
+        std::string index = std::to_string(i);
+        (*meta->mutable_tags())["tag-" + index].set_string_value("value-" + index);
+        (*meta->mutable_routing())["router-" + index] = i % 3;
+        (*meta->mutable_requestpath())["model-" + index] = "seldonio/model-" + index + ":1.0";
+        auto *metric = meta->add_metrics();
+        metric->set_key("metric_" + index);
+        metric->set_type(seldon::protos::Metric::TIMER);
+        metric->set_value(static_cast<float>(i));
+        (*metric->mutable_tags())["model"] = "model-" + index;
+    }
+    return message;
+}
+
+std::string toJson(const SeldonMessage &message) {
+    std::string json;
+    google::protobuf::util::MessageToJsonString(message, &json);
+    return json;
+}
+
+std::string toProto(const SeldonMessage &message) {
+    return message.SerializeAsString();
+}
+
+// predictRaw and predictRawProto from Python, through py::bytes
+void benchPredictRaw(Runner &runner, EchoModel &model, const std::string &name,
+                     const SeldonMessage &message) {
+    if (runner.selected("predict_raw/json/" + name)) {
+        py::bytes json(toJson(message));
+        runner.run("predict_raw/json/" + name, [&]() { model.predictRaw(json); });
+    }
+    if (runner.selected("predict_raw/proto/" + name)) {
+        py::bytes proto(toProto(message));
+        runner.run("predict_raw/proto/" + name, [&]() { model.predictRawProto(proto); });
+    }
+}
+
+// handleBuffer, as the native servers call it
+void benchNative(Runner &runner, EchoModel &model, const std::string &name,
+                 const SeldonMessage &message) {
+    const std::pair<const char *, seldon::PayloadFormat> formats[] = {
+        {"json", seldon::PayloadFormat::Json}, {"proto", seldon::PayloadFormat::Proto}};
+    for (const auto &format : formats) {
+        std::string benchmark = std::string("native/") + format.first + "/" + name;
+        if (!runner.selected(benchmark)) {
+            continue;
+        }
+        std::string request = format.second == seldon::PayloadFormat::Json ? toJson(message)
+                                                                            : toProto(message);
+        std::string response;
+        runner.run(benchmark, [&]() {
+            model.handleBuffer(seldon::Method::Predict, request.data(), request.size(),
+                               format.second, response);
+        });
+    }
+}
+
+void benchThroughput(Runner &runner, EchoModel &model) {
+    int maxThreads = runner.options().maxThreads;
+    if (maxThreads <= 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::string request = toJson(payload("tensor", 100));
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        runner.runThreads("throughput/json/tensor/100/threads:" + std::to_string(threads), threads,
+                          [&]() {
+                              std::string response;
+                              model.handleBuffer(seldon::Method::Predict, request.data(),
+                                                 request.size(), seldon::PayloadFormat::Json,
+                                                 response);
+                          });
+    }
+}
+
+Options parseOptions(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        std::string value = argv[++i];
+        if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--min-time-ms") {
+            options.minTimeMs = std::atof(value.c_str());
+        } else if (arg == "--repetitions") {
+            options.repetitions = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--max-elements") {
+            options.maxElements = std::atoll(value.c_str());
+        } else if (arg == "--max-threads") {
+            options.maxThreads = std::atoi(value.c_str());
+        } else if (arg == "--out") {
+            options.out = value;
+        } else {
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+    }
+    return options;
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    // predictRaw releases and re-acquires the GIL
+    py::scoped_interpreter interpreter;
+    Runner runner(options);
+    EchoModel model;
+
+    for (const char *kind : {"ndarray", "tensor", "tftensor", "binData"}) {
+        for (int64_t elements = 1; elements <= options.maxElements; elements *= 100) {
+            std::string name = std::string(kind) + "/" + std::to_string(elements);
+            SeldonMessage message = payload(kind, elements);
+            benchPredictRaw(runner, model, name, message);
+            benchNative(runner, model, name, message);
+        }
+    }
+
+    SeldonMessage meta = metaHeavy();
+    benchPredictRaw(runner, model, "meta", meta);
+    benchNative(runner, model, "meta", meta);
+
+    {
+        py::gil_scoped_release release;
+        benchThroughput(runner, model);
+    }
+
+    std::string json = runner.json();
+    if (options.out.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(options.out) << json;
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+// seldon-loadgen for the wrapper itself: drives a model that echoes its
+// input, so the reports show what the wrapper and native servers add to
+// every request. Models get their own with SELDON_LOADGEN_MAIN, or can
+// point it at a running server with --address.
+
+#include "seldon/LoadGen.hpp"
+#include "seldon/SeldonModel.hpp"
+
+namespace {
+
+class EchoModel : public seldon::SeldonModelBase
+{
+public:
+    void predict(seldon::protos::SeldonMessage &input,
+                 seldon::protos::SeldonMessage &output) override {
+        output.Swap(&input);
+    }
+};
+
+}
+
+SELDON_LOADGEN_MAIN(EchoModel)
@@ -4,9 +4,16 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <thread>
+
+#include <pybind11/embed.h>
 
 #include "seldon/SeldonModel.hpp"
 
+// predictRaw releases and re-acquires the GIL, which requires a running
+// interpreter even when the module is not loaded from Python
+static py::scoped_interpreter interpreter;
+
 class TestModel : public seldon::SeldonModelBase {
 
     seldon::protos::SeldonMessage predict(seldon::protos::SeldonMessage &data) override {
@@ -16,17 +23,86 @@ class TestModel : public seldon::SeldonModelBase {
 
 TEST_CASE("TestSimpleMessageParsing", "Simple class parses data correctly") {
 
-    std::cout << "Starting" << std::endl;
-
     TestModel tm = TestModel();
-    std::cout << "Initialised" << std::endl;
 
     py::bytes input("{\"strData\":\"ndarray\"}");
 
     py::bytes result = tm.predictRaw(input);
-    std::cout << "Ran predict raw" << std::endl;
 
     std::string resultString = result;
-    std::cout << "result is " << resultString << std::endl;
+    SELDON_LOG_DEBUG("result is " << resultString);
+    REQUIRE(resultString == "{\"strData\":\"ndarray\"}");
+}
+
+TEST_CASE("TestSimpleProtoParsing", "Simple class parses protobuf data correctly") {
+
+    TestModel tm = TestModel();
+
+    seldon::protos::SeldonMessage message;
+    message.mutable_data()->mutable_tensor()->add_shape(1);
+    message.mutable_data()->mutable_tensor()->add_values(0.5);
+
+    std::string serialized;
+    message.SerializeToString(&serialized);
+    py::bytes input(serialized);
+
+    py::bytes result = tm.predictRawProto(input);
+
+    seldon::protos::SeldonMessage output;
+    REQUIRE(output.ParseFromString(result));
+    REQUIRE(output.data().tensor().values_size() == 1);
+    REQUIRE(output.data().tensor().values(0) == 0.5);
+}
+
+TEST_CASE("TestConcurrentPredictRaw", "Predict raw can run from several Python threads") {
+
+    TestModel tm = TestModel();
+    const int numThreads = 4;
+    std::vector<std::string> results(numThreads);
+
+    {
+        py::gil_scoped_release release;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; i++) {
+            threads.emplace_back([&tm, &results, i]() {
+                py::gil_scoped_acquire acquire;
+                py::bytes input("{\"strData\":\"" + std::to_string(i) + "\"}");
+                py::bytes result = tm.predictRaw(input);
+                results[i] = result;
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (int i = 0; i < numThreads; i++) {
+        REQUIRE(results[i] == "{\"strData\":\"" + std::to_string(i) + "\"}");
+    }
+}
+
+class TestArenaModel : public seldon::SeldonModelBase {
+
+public:
+    bool outputOnArena = false;
+
+    void predict(seldon::protos::SeldonMessage &data, seldon::protos::SeldonMessage &output) override {
+        outputOnArena = output.GetArena() != nullptr;
+        output.mutable_data()->mutable_tensor()->CopyFrom(data.data().tensor());
+        output.mutable_meta()->set_puid(data.meta().puid());
+    }
+};
+
+TEST_CASE("TestArenaPredict", "In-place predict receives arena allocated messages") {
+
+    TestArenaModel tm = TestArenaModel();
+
+    py::bytes input("{\"meta\":{\"puid\":\"abc\"},\"data\":{\"tensor\":{\"shape\":[1],\"values\":[2.0]}}}");
+
+    std::string result = tm.predictRaw(input);
+
+    REQUIRE(tm.outputOnArena);
+    REQUIRE(result == "{\"meta\":{\"puid\":\"abc\"},\"data\":{\"tensor\":{\"shape\":[1],\"values\":[2]}}}");
 }
 
@@ -0,0 +1,193 @@
+#include "catch_amalgamated.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "seldon/Aggregate.hpp"
+#include "seldon/Combiners.hpp"
+#include "seldon/TensorView.hpp"
+#include "seldon/ThreadPool.hpp"
+
+namespace {
+
+using seldon::protos::SeldonMessage;
+using seldon::protos::SeldonMessageList;
+
+void addTensor(SeldonMessageList &list, const std::vector<int64_t> &shape,
+               const std::vector<double> &values) {
+    auto output = seldon::TensorBuilder<double>::tensor(
+        *list.add_seldonmessages()->mutable_data(), shape);
+    std::copy(values.begin(), values.end(), output.begin());
+}
+
+void addFloatTensor(SeldonMessageList &list, const std::vector<int64_t> &shape, float value) {
+    auto output = seldon::TensorBuilder<float>::tftensor(
+        *list.add_seldonmessages()->mutable_data(), shape);
+    std::fill(output.begin(), output.end(), value);
+}
+
+std::vector<double> valuesOf(const SeldonMessage &message) {
+    seldon::TensorView<double> view(message);
+    return std::vector<double>(view.begin(), view.end());
+}
+
+}
+
+TEST_CASE("TestAggregateMean", "Mean and weighted mean reduce children element-wise") {
+
+    SeldonMessageList list;
+    addTensor(list, {2, 2}, {1, 2, 3, 4});
+    addTensor(list, {2, 2}, {3, 4, 5, 6});
+    list.mutable_seldonmessages(0)->mutable_data()->add_names("a");
+    auto &tags = *list.mutable_seldonmessages(1)->mutable_meta()->mutable_tags();
+    tags["model"].set_string_value("b");
+
+    SeldonMessage output;
+    seldon::aggregate::mean(list, output);
+    REQUIRE(output.data().has_tensor());
+    REQUIRE(output.data().tensor().shape_size() == 2);
+    REQUIRE(valuesOf(output) == std::vector<double>({2, 3, 4, 5}));
+    REQUIRE(output.data().names(0) == "a");
+    REQUIRE(output.meta().tags().at("model").string_value() == "b");
+
+    seldon::aggregate::weightedMean(list, {3, 1}, output);
+    REQUIRE(valuesOf(output) == std::vector<double>({1.5, 2.5, 3.5, 4.5}));
+
+    REQUIRE_THROWS_AS(seldon::aggregate::weightedMean(list, {1}, output), std::invalid_argument);
+    addTensor(list, {4}, {1, 2, 3, 4});
+    REQUIRE_THROWS_AS(seldon::aggregate::mean(list, output), std::invalid_argument);
+    REQUIRE_THROWS_AS(seldon::aggregate::mean(SeldonMessageList(), output),
+                      std::invalid_argument);
+}
+
+TEST_CASE("TestAggregateParallel", "Large float children are reduced across the pool") {
+
+    const int64_t size = 10000;
+    SeldonMessageList list;
+    for (int i = 0; i < 16; i++) {
+        addFloatTensor(list, {size}, static_cast<float>(i));
+    }
+
+    seldon::ThreadPool pool(4);
+    SeldonMessage output;
+    seldon::aggregate::mean(list, output, &pool);
+    REQUIRE(output.data().tftensor().dtype() == tensorflow::DT_FLOAT);
+    seldon::TensorView<float> mean(output);
+    REQUIRE(mean.size() == static_cast<size_t>(size));
+    REQUIRE(std::count(mean.begin(), mean.end(), 7.5f) == size);
+
+    seldon::aggregate::concat(list, output, 0, &pool);
+    seldon::TensorView<float> concatenated(output);
+    REQUIRE(concatenated.shape() == std::vector<int64_t>({16 * size}));
+    REQUIRE(concatenated[size * 3 + 5] == 3);
+}
+
+TEST_CASE("TestAggregateMaxVote", "Max vote counts the top class of every child") {
+
+    SeldonMessageList list;
+    addTensor(list, {2, 3}, {0.1, 0.7, 0.2, 0.5, 0.4, 0.1});
+    addTensor(list, {2, 3}, {0.2, 0.6, 0.2, 0.1, 0.1, 0.8});
+    addTensor(list, {2, 3}, {0.9, 0.0, 0.1, 0.3, 0.3, 0.3});
+    addTensor(list, {2, 3}, {0.0, 1.0, 0.0, 0.2, 0.2, 0.6});
+
+    SeldonMessage output;
+    seldon::aggregate::maxVote(list, output);
+    REQUIRE(valuesOf(output) == std::vector<double>({0.25, 0.75, 0, 0.5, 0, 0.5}));
+}
+
+TEST_CASE("TestAggregateConcat", "Concat joins children along an axis") {
+
+    SeldonMessageList list;
+    addTensor(list, {2, 1}, {1, 2});
+    addTensor(list, {2, 2}, {3, 4, 5, 6});
+    list.mutable_seldonmessages(0)->mutable_data()->add_names("a");
+    list.mutable_seldonmessages(1)->mutable_data()->add_names("b");
+    list.mutable_seldonmessages(1)->mutable_data()->add_names("c");
+
+    SeldonMessage output;
+    seldon::aggregate::concat(list, output);
+    REQUIRE(valuesOf(output) == std::vector<double>({1, 3, 4, 2, 5, 6}));
+    REQUIRE(output.data().tensor().shape(1) == 3);
+    REQUIRE(output.data().names_size() == 3);
+    REQUIRE(output.data().names(2) == "c");
+
+    REQUIRE_THROWS_AS(seldon::aggregate::concat(list, output, 0), std::invalid_argument);
+}
+
+TEST_CASE("TestAggregateCombiner", "Combiners serve aggregate requests") {
+
+    seldon::MeanCombiner model;
+    std::string request = "{\"seldonMessages\":[{\"data\":{\"tensor\":{\"shape\":[2],"
+                          "\"values\":[1,2]}}},{\"data\":{\"tensor\":{\"shape\":[2],"
+                          "\"values\":[3,4]}}}]}";
+    std::string response;
+    model.handleBuffer(seldon::Method::Aggregate, request.data(), request.size(),
+                       seldon::PayloadFormat::Json, response);
+    REQUIRE(response == "{\"data\":{\"tensor\":{\"shape\":[2],\"values\":[2,3]}}}");
+}
+
+TEST_CASE("TestAggregateWeightedCombiner", "Weighted combiners need valid weights to load") {
+
+    const char *name = "SELDON_CPP_COMBINER_WEIGHTS";
+    ::unsetenv(name);
+    REQUIRE_THROWS_AS(seldon::WeightedMeanCombiner(), std::runtime_error);
+    ::setenv(name, "1,abc", 1);
+    REQUIRE_THROWS_AS(seldon::WeightedMeanCombiner(), std::runtime_error);
+
+    ::setenv(name, "3,1", 1);
+    seldon::WeightedMeanCombiner model;
+    ::unsetenv(name);
+    std::string request = "{\"seldonMessages\":[{\"data\":{\"tensor\":{\"shape\":[2],"
+                          "\"values\":[1,2]}}},{\"data\":{\"tensor\":{\"shape\":[2],"
+                          "\"values\":[5,6]}}}]}";
+    std::string response;
+    model.handleBuffer(seldon::Method::Aggregate, request.data(), request.size(),
+                       seldon::PayloadFormat::Json, response);
+    REQUIRE(response == "{\"data\":{\"tensor\":{\"shape\":[2],\"values\":[2,3]}}}");
+}
+
+TEST_CASE("TestThreadPool", "parallelFor covers every index once and rethrows") {
+
+    seldon::ThreadPool pool(3);
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(hits.size(), 10, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            hits[i]++;
+        }
+    });
+    REQUIRE(std::count(hits.begin(), hits.end(), 1) == 1000);
+
+    REQUIRE_THROWS_AS(pool.parallelFor(100, 1,
+                                       [](size_t begin, size_t end) {
+                                           throw std::runtime_error("failed");
+                                       }),
+                      std::runtime_error);
+
+    // parallelFor doesn't wait on threads blocked in posted work, and work
+    // posted to the pool can fan out itself
+    std::vector<std::promise<void>> releases(3);
+    for (auto &release : releases) {
+        std::shared_future<void> released = release.get_future().share();
+        pool.post([released]() { released.wait(); });
+    }
+    std::atomic<size_t> covered{0};
+    auto count = [&covered](size_t begin, size_t end) { covered += end - begin; };
+    pool.parallelFor(1000, 10, count);
+    REQUIRE(covered == 1000);
+
+    releases[0].set_value();
+    std::promise<void> posted;
+    pool.post([&]() {
+        pool.parallelFor(1000, 10, count);
+        posted.set_value();
+    });
+    posted.get_future().get();
+    REQUIRE(covered == 2000);
+    releases[1].set_value();
+    releases[2].set_value();
+}
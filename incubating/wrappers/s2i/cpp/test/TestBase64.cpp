@@ -0,0 +1,176 @@
+#include "catch_amalgamated.hpp"
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/util/json_util.h>
+
+#include "seldon/Base64.hpp"
+#include "seldon/Codec.hpp"
+
+namespace {
+
+using seldon::base64::Kernel;
+
+std::vector<Kernel> supportedKernels() {
+    std::vector<Kernel> kernels;
+    for (Kernel kernel : {Kernel::Scalar, Kernel::Avx2, Kernel::Neon}) {
+        if (seldon::base64::supported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
+
+std::string randomBytes(size_t size, std::mt19937 &random) {
+    std::string bytes(size, '\0');
+    for (char &byte : bytes) {
+        byte = static_cast<char>(random() & 0xFF);
+    }
+    return bytes;
+}
+
+std::string encode(const std::string &bytes, Kernel kernel) {
+    std::string out(seldon::base64::encodedSize(bytes.size()), '\0');
+    seldon::base64::encode(bytes.data(), bytes.size(), &out[0], kernel);
+    return out;
+}
+
+bool decode(const std::string &text, Kernel kernel, std::string &out) {
+    out.assign(seldon::base64::decodedSize(text.size()), '\0');
+    size_t written = 0;
+    if (!seldon::base64::decode(text.data(), text.size(), &out[0], written, kernel)) {
+        return false;
+    }
+    out.resize(written);
+    return true;
+}
+
+// What the protobuf JSON printer writes for bytes
+std::string protobufEncode(const std::string &bytes) {
+    seldon::protos::SeldonMessage message;
+    message.set_bindata(bytes);
+    std::string json;
+    google::protobuf::util::MessageToJsonString(message, &json);
+    return json.substr(12, json.size() - 14);
+}
+
+}
+
+TEST_CASE("TestBase64Kernels") {
+    std::mt19937 random(7);
+    std::vector<size_t> sizes;
+    for (size_t size = 0; size < 200; size++) {
+        sizes.push_back(size);
+    }
+    sizes.push_back(4096);
+    sizes.push_back(100001);
+
+    for (Kernel kernel : supportedKernels()) {
+        INFO(seldon::base64::kernelName(kernel));
+        for (size_t size : sizes) {
+            INFO(size);
+            std::string bytes = randomBytes(size, random);
+            std::string text = encode(bytes, kernel);
+            REQUIRE(text == protobufEncode(bytes));
+
+            std::string decoded;
+            REQUIRE(decode(text, kernel, decoded));
+            REQUIRE(decoded == bytes);
+        }
+    }
+}
+
+TEST_CASE("TestBase64DecodeVariants") {
+    std::mt19937 random(11);
+    std::string bytes = randomBytes(1000, random);
+    std::string text = encode(bytes, Kernel::Scalar);
+
+    std::string urlSafe = text;
+    for (char &c : urlSafe) {
+        c = c == '+' ? '-' : c == '/' ? '_' : c;
+    }
+    std::string unpadded = text.substr(0, text.find('='));
+
+    for (Kernel kernel : supportedKernels()) {
+        INFO(seldon::base64::kernelName(kernel));
+        for (const std::string &variant : {urlSafe, unpadded}) {
+            std::string decoded;
+            REQUIRE(decode(variant, kernel, decoded));
+            REQUIRE(decoded == bytes);
+        }
+
+        // A bad char part way through a block, then in the tail
+        std::string decoded;
+        for (size_t at : {100, 1330}) {
+            std::string bad = text;
+            bad[at] = '*';
+            REQUIRE_FALSE(decode(bad, kernel, decoded));
+            bad[at] = ' ';
+            REQUIRE_FALSE(decode(bad, kernel, decoded));
+        }
+
+        // Both alphabets, with the URL-safe digit after a vectorized block
+        std::string mixed = text;
+        mixed[mixed.find_last_of("+/")] = '-';
+        REQUIRE(text.find_first_of("+/") < 1000);
+        REQUIRE_FALSE(decode(mixed, kernel, decoded));
+
+        REQUIRE_FALSE(decode("QUJD=", kernel, decoded));
+        REQUIRE_FALSE(decode("QUJDR", kernel, decoded));
+        REQUIRE_FALSE(decode("QQ===", kernel, decoded));
+        REQUIRE_FALSE(decode("QQ==QQ==", kernel, decoded));
+        REQUIRE_FALSE(decode("QR==", kernel, decoded));
+        REQUIRE_FALSE(decode("QUJ=", kernel, decoded));
+        REQUIRE(decode("QUI=", kernel, decoded));
+        REQUIRE(decoded == "AB");
+    }
+}
+
+TEST_CASE("TestCodecBinData") {
+    std::mt19937 random(13);
+    std::string blob = randomBytes(10000, random);
+    std::string text = encode(blob, Kernel::Scalar);
+
+    std::vector<std::string> requests = {
+        "{\"binData\":\"" + text + "\"}",
+        " { \"meta\" : {\"puid\":\"p\",\"tags\":{\"binData\":\"QQ==\"}} , \"binData\" : \"" +
+            text + "\" } ",
+        "{\"status\":{\"code\":3},\"binData\":\"" + text + "\",\"meta\":{\"puid\":\"p\"}}",
+        "{\"binData\":\"\"}",
+        "{\"binData\":\"-_-_\"}",
+        "{\"binData\":\"QUI\"}",
+        "{\"strData\":\"binData\"}",
+    };
+    for (const std::string &request : requests) {
+        INFO(request.substr(0, 80));
+        seldon::protos::SeldonMessage expected;
+        REQUIRE(google::protobuf::util::JsonStringToMessage(request, &expected).ok());
+
+        seldon::protos::SeldonMessage message;
+        seldon::decodeMessage(request.data(), request.size(), seldon::PayloadFormat::Json,
+                              message);
+        REQUIRE(message.SerializeAsString() == expected.SerializeAsString());
+
+        std::string json;
+        seldon::encodeMessage(message, seldon::PayloadFormat::Json, json);
+        std::string expectedJson;
+        google::protobuf::util::MessageToJsonString(expected, &expectedJson);
+        REQUIRE(json == expectedJson);
+    }
+
+    std::vector<std::string> invalid = {
+        "{\"binData\":\"QUJD*\"}",
+        "{\"binData\":\"QUJD\\n\"}",
+        "{\"binData\":\"QQ==\",\"x\":1}",
+        "{\"binData\":\"" + text + "\",\"strData\":\"a\"}",
+    };
+    for (const std::string &request : invalid) {
+        seldon::protos::SeldonMessage message;
+        REQUIRE_THROWS_AS(seldon::decodeMessage(request.data(), request.size(),
+                                                seldon::PayloadFormat::Json, message),
+                          std::invalid_argument);
+    }
+}
@@ -0,0 +1,141 @@
+#include "catch_amalgamated.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "seldon/Batcher.hpp"
+
+namespace {
+
+seldon::protos::SeldonMessage rowsRequest(const std::string &puid, int rows, double value) {
+    seldon::protos::SeldonMessage message;
+    message.mutable_meta()->set_puid(puid);
+    seldon::protos::Tensor *tensor = message.mutable_data()->mutable_tensor();
+    tensor->add_shape(rows);
+    tensor->add_shape(2);
+    for (int i = 0; i < rows * 2; i++) {
+        tensor->add_values(value);
+    }
+    return message;
+}
+
+}
+
+TEST_CASE("TestBatcherConcatenatesRequests", "Concurrent requests are predicted as one batch") {
+
+    std::mutex mutex;
+    std::vector<int> batchRows;
+    auto doubleValues = [&](seldon::protos::SeldonMessage &input,
+                            seldon::protos::SeldonMessage &output) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batchRows.push_back(input.data().tensor().shape(0));
+        }
+        output.mutable_data()->mutable_tensor()->CopyFrom(input.data().tensor());
+        for (double &value : *output.mutable_data()->mutable_tensor()->mutable_values()) {
+            value *= 2;
+        }
+    };
+
+    seldon::BatchOptions options;
+    options.maxBatchSize = 4;
+    // Long enough that the batch is only sent once it's full
+    options.maxBatchDelayUs = 10 * 1000 * 1000;
+    seldon::Batcher batcher(doubleValues, options);
+
+    std::atomic<int> correct{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; i++) {
+        threads.emplace_back([&batcher, &correct, i]() {
+            // Requests of 1, 2 and 1 rows fill the batch exactly
+            int rows = i == 1 ? 2 : 1;
+            seldon::protos::SeldonMessage input = rowsRequest("puid" + std::to_string(i), rows, i);
+            seldon::protos::SeldonMessage output;
+            batcher.predict(input, output);
+
+            const seldon::protos::Tensor &tensor = output.data().tensor();
+            bool ok = output.meta().puid() == "puid" + std::to_string(i) &&
+                      tensor.shape_size() == 2 && tensor.shape(0) == rows &&
+                      tensor.values_size() == rows * 2;
+            for (double value : tensor.values()) {
+                ok = ok && value == 2.0 * i;
+            }
+            if (ok) {
+                correct++;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(correct == 3);
+    REQUIRE(batchRows == std::vector<int>{4});
+}
+
+TEST_CASE("TestBatcherSubmit", "Submitted requests are called back once their batch has run") {
+
+    std::vector<int> batchRows;
+    seldon::BatchOptions options;
+    options.maxBatchSize = 3;
+    options.maxBatchDelayUs = 10 * 1000 * 1000;
+    seldon::Batcher batcher(
+        [&batchRows](seldon::protos::SeldonMessage &input, seldon::protos::SeldonMessage &output) {
+            batchRows.push_back(input.data().tensor().shape(0));
+            output.mutable_data()->mutable_tensor()->CopyFrom(input.data().tensor());
+        },
+        options);
+
+    // One thread submits the whole batch without waiting on any of it
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<std::string> puids;
+    for (int i = 0; i < 3; i++) {
+        batcher.submit(rowsRequest("puid" + std::to_string(i), 1, i),
+                       [&](std::exception_ptr error, seldon::protos::SeldonMessage &output) {
+            std::lock_guard<std::mutex> lock(mutex);
+            puids.push_back(error ? "error" : output.meta().puid());
+            finished.notify_one();
+        });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&puids]() { return puids.size() == 3; });
+    REQUIRE(puids == std::vector<std::string>{"puid0", "puid1", "puid2"});
+    REQUIRE(batchRows == std::vector<int>{3});
+}
+
+TEST_CASE("TestBatcherPassesThroughOtherRequests", "Requests that can't be concatenated skip the queue") {
+
+    int calls = 0;
+    seldon::Batcher batcher(
+        [&calls](seldon::protos::SeldonMessage &input, seldon::protos::SeldonMessage &output) {
+            calls++;
+            output.set_strdata(input.strdata());
+        });
+
+    seldon::protos::SeldonMessage input;
+    input.set_strdata("hello");
+    seldon::protos::SeldonMessage output;
+    batcher.predict(input, output);
+    REQUIRE(calls == 1);
+    REQUIRE(output.strdata() == "hello");
+}
+
+TEST_CASE("TestBatcherReportsErrors", "Errors reach every request of the batch") {
+
+    seldon::BatchOptions options;
+    options.maxBatchDelayUs = 0;
+    seldon::Batcher batcher(
+        [](seldon::protos::SeldonMessage &input, seldon::protos::SeldonMessage &output) {
+            throw std::runtime_error("failed");
+        },
+        options);
+
+    seldon::protos::SeldonMessage input = rowsRequest("abc", 1, 1.0);
+    seldon::protos::SeldonMessage output;
+    REQUIRE_THROWS_AS(batcher.predict(input, output), std::runtime_error);
+}
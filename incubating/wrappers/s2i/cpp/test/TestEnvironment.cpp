@@ -0,0 +1,49 @@
+#include "catch_amalgamated.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+#include "seldon/Environment.hpp"
+
+TEST_CASE("TestEnvironmentInt", "Integers are read from the environment, or fall back") {
+
+    const char *name = "SELDON_CPP_TEST_INT";
+    ::unsetenv(name);
+    REQUIRE(seldon::envInt(name, 7) == 7);
+
+    ::setenv(name, "", 1);
+    REQUIRE(seldon::envInt(name, 7) == 7);
+
+    ::setenv(name, "-12", 1);
+    REQUIRE(seldon::envInt(name, 7) == -12);
+
+    ::setenv(name, "4294967296 ", 1);
+    REQUIRE(seldon::envInt(name, 7) == 4294967296LL);
+
+    // Values that aren't integers are ignored with a warning, rather than
+    // read as 0 or as whatever digits they start with
+    for (const char *value : {"abc", "12ms", "1.5", "99999999999999999999"}) {
+        ::setenv(name, value, 1);
+        REQUIRE(seldon::envInt(name, 7) == 7);
+    }
+    ::unsetenv(name);
+}
+
+TEST_CASE("TestEnvironmentDoubles", "Comma separated numbers are read in full or not at all") {
+
+    const char *name = "SELDON_CPP_TEST_DOUBLES";
+    std::vector<double> values{9};
+    ::unsetenv(name);
+    REQUIRE(!seldon::envDoubles(name, values));
+
+    ::setenv(name, "1, 0.5,-2e1 ", 1);
+    REQUIRE(seldon::envDoubles(name, values));
+    REQUIRE(values == std::vector<double>{1, 0.5, -20});
+
+    for (const char *value : {"", "1,,2", "1,", "0.5x", "1;2", "nan", "inf,1", "1e999"}) {
+        ::setenv(name, value, 1);
+        REQUIRE(!seldon::envDoubles(name, values));
+        REQUIRE(values == std::vector<double>{1, 0.5, -20});
+    }
+    ::unsetenv(name);
+}
@@ -0,0 +1,95 @@
+#include "catch_amalgamated.hpp"
+
+#include <string>
+
+#include <grpcpp/generic/generic_stub.h>
+#include <grpcpp/grpcpp.h>
+
+#include "seldon/GrpcServer.hpp"
+#include "seldon/SeldonModel.hpp"
+
+namespace {
+
+class EchoModel : public seldon::SeldonModelBase {
+
+    seldon::protos::SeldonMessage predict(seldon::protos::SeldonMessage &data) override {
+        return data;
+    }
+};
+
+// Issues a unary call with a raw payload, the way generated stubs would
+grpc::Status call(grpc::GenericStub &stub, const std::string &method,
+                  const std::string &request, std::string &response) {
+
+    grpc::Slice slice(request);
+    grpc::ByteBuffer requestBuffer(&slice, 1);
+    grpc::ByteBuffer responseBuffer;
+    grpc::ClientContext context;
+    grpc::Status result;
+    grpc::CompletionQueue queue;
+
+    std::unique_ptr<grpc::ClientAsyncResponseReader<grpc::ByteBuffer>> reader =
+        stub.PrepareUnaryCall(&context, method, requestBuffer, &queue);
+    reader->StartCall();
+    reader->Finish(&responseBuffer, &result, nullptr);
+
+    void *tag;
+    bool ok;
+    REQUIRE(queue.Next(&tag, &ok));
+
+    grpc::Slice joined;
+    if (result.ok()) {
+        responseBuffer.DumpToSingleSlice(&joined);
+        response.assign(reinterpret_cast<const char *>(joined.begin()), joined.size());
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("TestGrpcServerMethods", "Native gRPC server serves the Model and Seldon services") {
+
+    EchoModel model;
+    seldon::GrpcServerOptions options;
+    options.host = "127.0.0.1";
+    options.port = 0;
+    options.threads = 2;
+    seldon::GrpcServer server(model, options);
+    server.start();
+
+    grpc::GenericStub stub(grpc::CreateChannel(
+        "127.0.0.1:" + std::to_string(server.port()), grpc::InsecureChannelCredentials()));
+
+    seldon::protos::SeldonMessage message;
+    message.mutable_meta()->set_puid("abc");
+    message.mutable_data()->mutable_tensor()->add_values(1.5);
+    std::string request;
+    message.SerializeToString(&request);
+
+    for (const char *method : {"/seldon.protos.Model/Predict", "/seldon.protos.Seldon/Predict"}) {
+        std::string response;
+        REQUIRE(call(stub, method, request, response).ok());
+        seldon::protos::SeldonMessage output;
+        REQUIRE(output.ParseFromString(response));
+        REQUIRE(output.meta().puid() == "abc");
+        REQUIRE(output.data().tensor().values(0) == 1.5);
+    }
+
+    std::string response;
+    REQUIRE(call(stub, "/seldon.protos.Model/SendFeedback", "", response).ok());
+    REQUIRE(call(stub, "/seldon.protos.Model/Metadata", "", response).ok());
+
+    REQUIRE(call(stub, "/seldon.protos.Model/Predict", "\xff\xff", response).error_code() ==
+            grpc::StatusCode::INVALID_ARGUMENT);
+    REQUIRE(call(stub, "/seldon.protos.Generic/Route", request, response).error_code() ==
+            grpc::StatusCode::UNIMPLEMENTED);
+    REQUIRE(call(stub, "/seldon.protos.Seldon/GraphMetadata", "", response).error_code() ==
+            grpc::StatusCode::UNIMPLEMENTED);
+
+    // Transformers pass requests through unless overridden
+    REQUIRE(call(stub, "/seldon.protos.Transformer/TransformInput", request, response).ok());
+    REQUIRE(response == request);
+
+    server.stop();
+    server.wait();
+}
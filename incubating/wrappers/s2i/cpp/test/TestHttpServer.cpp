@@ -0,0 +1,279 @@
+#include "catch_amalgamated.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "seldon/HttpServer.hpp"
+#include "seldon/SeldonModel.hpp"
+
+namespace {
+
+class EchoModel : public seldon::SeldonModelBase {
+
+    seldon::protos::SeldonMessage predict(seldon::protos::SeldonMessage &data) override {
+        return data;
+    }
+};
+
+// Echoes on a thread of its own, the first request finishing last
+class DelayedEchoModel : public seldon::SeldonModelBase {
+public:
+    DelayedEchoModel() { this->enableAsyncPredict(); }
+
+    ~DelayedEchoModel() {
+        for (auto &thread : this->mThreads) {
+            thread.join();
+        }
+    }
+
+    void predictAsync(seldon::protos::SeldonMessage &&input, Callback done) override {
+        auto message = std::make_shared<seldon::protos::SeldonMessage>(std::move(input));
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        auto delay = std::chrono::milliseconds(this->mThreads.empty() ? 100 : 0);
+        this->mThreads.emplace_back([message, done, delay]() {
+            std::this_thread::sleep_for(delay);
+            done(nullptr, *message);
+        });
+    }
+
+private:
+    std::mutex mMutex;
+    std::vector<std::thread> mThreads;
+};
+
+// Echoes batches, recording the largest it was sent
+class BatchingModel : public seldon::SeldonModelBase {
+public:
+    explicit BatchingModel(int maxBatchSize) {
+        seldon::BatchOptions options;
+        options.maxBatchSize = maxBatchSize;
+        // Long enough that the batch only runs once it's full
+        options.maxBatchDelayUs = 2 * 1000 * 1000;
+        this->enableBatching(options);
+    }
+
+    void predict(seldon::protos::SeldonMessage &input,
+                 seldon::protos::SeldonMessage &output) override {
+        int rows = input.data().tensor().shape(0);
+        int largest = this->largestBatch.load();
+        while (rows > largest && !this->largestBatch.compare_exchange_weak(largest, rows)) {
+        }
+        output.mutable_data()->mutable_tensor()->CopyFrom(input.data().tensor());
+    }
+
+    std::atomic<int> largestBatch{0};
+};
+
+int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+    return fd;
+}
+
+void sendAll(int fd, const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t count = ::send(fd, data.data() + sent, data.size() - sent, 0);
+        REQUIRE(count > 0);
+        sent += static_cast<size_t>(count);
+    }
+}
+
+struct Response
+{
+    int status = 0;
+    std::string contentType;
+    std::string body;
+};
+
+// Reads exactly one Content-Length delimited response
+Response readResponse(int fd, std::string &buffer) {
+    char chunk[4096];
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t count = ::recv(fd, chunk, sizeof(chunk), 0);
+        REQUIRE(count > 0);
+        buffer.append(chunk, static_cast<size_t>(count));
+    }
+
+    Response response;
+    response.status = std::stoi(buffer.substr(9, 3));
+    size_t typeStart = buffer.find("Content-Type: ") + 14;
+    response.contentType = buffer.substr(typeStart, buffer.find("\r\n", typeStart) - typeStart);
+    size_t lengthStart = buffer.find("Content-Length: ") + 16;
+    size_t length = std::stoul(buffer.substr(lengthStart, buffer.find("\r\n", lengthStart) - lengthStart));
+
+    while (buffer.size() < headerEnd + 4 + length) {
+        ssize_t count = ::recv(fd, chunk, sizeof(chunk), 0);
+        REQUIRE(count > 0);
+        buffer.append(chunk, static_cast<size_t>(count));
+    }
+    response.body = buffer.substr(headerEnd + 4, length);
+    buffer.erase(0, headerEnd + 4 + length);
+    return response;
+}
+
+std::string post(const std::string &path, const std::string &contentType, const std::string &body) {
+    return "POST " + path + " HTTP/1.1\r\nHost: localhost\r\nContent-Type: " + contentType +
+           "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+seldon::ServerOptions testOptions() {
+    seldon::ServerOptions options;
+    options.host = "127.0.0.1";
+    options.port = 0;
+    options.metricsPort = 0;
+    options.threads = 2;
+    return options;
+}
+
+}
+
+TEST_CASE("TestHttpServerRoutes", "Native server serves predictions, health and metrics") {
+
+    EchoModel model;
+    seldon::HttpServer server(model, testOptions());
+    server.start();
+
+    int fd = connectTo(server.port());
+    std::string buffer;
+
+    // Several requests on one keep-alive connection, the first two pipelined
+    std::string body = "{\"strData\":\"hello\"}";
+    sendAll(fd, post("/api/v1.0/predictions", "application/json", body) +
+                    "GET /health/ping HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+    Response prediction = readResponse(fd, buffer);
+    REQUIRE(prediction.status == 200);
+    REQUIRE(prediction.contentType == "application/json");
+    REQUIRE(prediction.body == body);
+
+    Response ping = readResponse(fd, buffer);
+    REQUIRE(ping.status == 200);
+    REQUIRE(ping.body == "pong");
+
+    seldon::protos::SeldonMessage message;
+    message.mutable_data()->mutable_tensor()->add_values(1.5);
+    std::string serialized;
+    message.SerializeToString(&serialized);
+    sendAll(fd, post("/predict", "application/x-protobuf", serialized));
+
+    Response proto = readResponse(fd, buffer);
+    REQUIRE(proto.status == 200);
+    REQUIRE(proto.contentType == "application/x-protobuf");
+    seldon::protos::SeldonMessage output;
+    REQUIRE(output.ParseFromString(proto.body));
+    REQUIRE(output.data().tensor().values(0) == 1.5);
+
+    sendAll(fd, post("/predict", "application/json", "{not json"));
+    Response invalid = readResponse(fd, buffer);
+    REQUIRE(invalid.status == 400);
+    REQUIRE(invalid.body.find("MICROSERVICE_BAD_DATA") != std::string::npos);
+
+    sendAll(fd, post("/api/v1.0/feedback", "application/json", "{\"reward\":1}"));
+    Response feedback = readResponse(fd, buffer);
+    REQUIRE(feedback.status == 200);
+    REQUIRE(feedback.body == "{}");
+
+    sendAll(fd, post("/transform-input", "application/json", "{\"strData\":\"x\"}"));
+    Response transformed = readResponse(fd, buffer);
+    REQUIRE(transformed.status == 200);
+    REQUIRE(transformed.body == "{\"strData\":\"x\"}");
+
+    sendAll(fd, post("/route", "application/json", "{\"strData\":\"x\"}"));
+    Response route = readResponse(fd, buffer);
+    REQUIRE(route.status == 501);
+    REQUIRE(route.body.find("MICROSERVICE_NOT_IMPLEMENTED") != std::string::npos);
+
+    sendAll(fd, "GET /metadata HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    REQUIRE(readResponse(fd, buffer).status == 200);
+
+    sendAll(fd, post("/metadata", "application/json", "{}"));
+    REQUIRE(readResponse(fd, buffer).status == 405);
+
+    sendAll(fd, "GET /unknown HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    REQUIRE(readResponse(fd, buffer).status == 404);
+
+    sendAll(fd, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    Response metrics = readResponse(fd, buffer);
+    REQUIRE(metrics.status == 200);
+    REQUIRE(metrics.body.find("seldon_cpp_requests_total") != std::string::npos);
+
+    close(fd);
+    server.stop();
+    server.wait();
+}
+
+TEST_CASE("TestHttpServerAsync", "Asynchronous predictions answer in request order") {
+
+    DelayedEchoModel model;
+    seldon::HttpServer server(model, testOptions());
+    server.start();
+
+    int slow = connectTo(server.port());
+    int fast = connectTo(server.port());
+    std::string slowBuffer;
+    std::string fastBuffer;
+
+    // The worker keeps serving other connections while a prediction is out
+    sendAll(slow, post("/predict", "application/json", "{\"strData\":\"first\"}") +
+                      post("/predict", "application/json", "{\"strData\":\"second\"}"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    sendAll(fast, "GET /health/ping HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    REQUIRE(readResponse(fast, fastBuffer).body == "pong");
+
+    REQUIRE(readResponse(slow, slowBuffer).body == "{\"strData\":\"first\"}");
+    REQUIRE(readResponse(slow, slowBuffer).body == "{\"strData\":\"second\"}");
+
+    close(slow);
+    close(fast);
+    server.stop();
+    server.wait();
+}
+
+TEST_CASE("TestHttpServerBatching", "Batches gather more requests than there are server threads") {
+
+    const int requests = 8;
+    BatchingModel model(requests);
+    seldon::HttpServer server(model, testOptions());
+    server.start();
+
+    std::vector<int> connections;
+    for (int i = 0; i < requests; i++) {
+        connections.push_back(connectTo(server.port()));
+        std::string value = std::to_string(i);
+        sendAll(connections.back(),
+                post("/predict", "application/json",
+                     "{\"data\":{\"tensor\":{\"shape\":[1,2],\"values\":[" + value + "," +
+                         value + "]}}}"));
+    }
+    for (int i = 0; i < requests; i++) {
+        std::string buffer;
+        Response response = readResponse(connections[i], buffer);
+        REQUIRE(response.status == 200);
+        std::string value = std::to_string(i);
+        REQUIRE(response.body.find("\"values\":[" + value + "," + value + "]") !=
+                std::string::npos);
+        close(connections[i]);
+    }
+    REQUIRE(model.largestBatch == requests);
+
+    server.stop();
+    server.wait();
+}
@@ -0,0 +1,183 @@
+#include "catch_amalgamated.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/util/json_util.h>
+
+#include "seldon/Codec.hpp"
+#include "seldon/JsonDecoder.hpp"
+
+namespace {
+
+// Deterministic, so maps compare equal whatever their order, and exact, so
+// -0 and 0 don't
+std::string canonical(const google::protobuf::Message &message) {
+    std::string out;
+    {
+        google::protobuf::io::StringOutputStream stream(&out);
+        google::protobuf::io::CodedOutputStream coded(&stream);
+        coded.SetSerializationDeterministic(true);
+        message.SerializeToCodedStream(&coded);
+    }
+    return out;
+}
+
+// Checks that the decoder takes json and agrees with the protobuf parser
+template <typename Message>
+void requireDecoded(const std::string &json) {
+    INFO(json.substr(0, 200));
+    Message expected;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(json, &expected).ok());
+    Message message;
+    REQUIRE(seldon::json::decode(json.data(), json.size(), message));
+    REQUIRE(canonical(message) == canonical(expected));
+}
+
+// Checks that the decoder leaves json to the protobuf parser, and that
+// decodeMessage then agrees with it, errors included
+void requireFallback(const std::string &json) {
+    INFO(json);
+    seldon::protos::SeldonMessage message;
+    REQUIRE_FALSE(seldon::json::decode(json.data(), json.size(), message));
+
+    seldon::protos::SeldonMessage expected;
+    message.Clear();
+    if (google::protobuf::util::JsonStringToMessage(json, &expected).ok()) {
+        seldon::decodeMessage(json.data(), json.size(), seldon::PayloadFormat::Json, message);
+        REQUIRE(canonical(message) == canonical(expected));
+    } else {
+        REQUIRE_THROWS_AS(seldon::decodeMessage(json.data(), json.size(),
+                                                seldon::PayloadFormat::Json, message),
+                          std::invalid_argument);
+    }
+}
+
+}
+
+TEST_CASE("TestJsonDecoderConformance") {
+    using seldon::protos::SeldonMessage;
+
+    std::vector<std::string> messages = {
+        "{}",
+        " \r\n\t{ } \n",
+        "{\"data\":{}}",
+        "{\"data\":{\"names\":[\"a\",\"b\"],\"tensor\":{\"shape\":[2,1],\"values\":[1,-2.5]}}}",
+        "{\"data\":{\"tensor\":{\"values\":[0.1,1e-3,-0,-0.0,1E+2,123456789012345678,"
+        "9007199254740993,1.7976931348623157e308,4.9e-324,2.2250738585072014e-308]}}}",
+        "{\"data\":{\"tensor\":{\"shape\":[-0,2147483647,-2147483648],\"values\":[]}}}",
+        "{\"data\":{\"tensor\":{}},\"meta\":{\"puid\":\"p\"}}",
+        "{\"data\":{\"ndarray\":[[1,2.5,-3e2],[true,false,null],[\"x\",[],{}]]}}",
+        "{\"data\":{\"ndarray\":[]},\"status\":{\"code\":-7,\"info\":\"i\",\"reason\":\"r\","
+        "\"status\":\"FAILURE\"}}",
+        "{\"strData\":\"plain\"}",
+        "{\"strData\":\"\\\"\\\\\\/\\b\\f\\n\\r\\t \\u0000\\u00e9\\u20AC\\ud83d\\ude00\"}",
+        "{\"strData\":\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 and a rather longer tail\"}",
+        "{\"jsonData\":{\"a\":[1,{\"b\":null}],\"c\":\"d\",\"e\":true}}",
+        "{\"jsonData\":null}",
+        "{\"jsonData\":3.25}",
+        "{\"binData\":\"QUJDRA==\"}",
+        "{\"binData\":\"\"}",
+        "{\"meta\":{\"puid\":\"abc\",\"tags\":{\"a\":1,\"b\":\"x\",\"c\":[1,2],\"\\u0064\":{}},"
+        "\"routing\":{\"r\":-1,\"s\":2},\"requestPath\":{\"m\":\"img:1\"},"
+        "\"metrics\":[{\"key\":\"k\",\"type\":\"TIMER\",\"value\":1.5,\"tags\":{\"t\":\"v\"}},"
+        "{\"type\":\"GAUGE\",\"value\":3.4028234e38},{}]}}",
+    };
+    for (const std::string &json : messages) {
+        requireDecoded<SeldonMessage>(json);
+    }
+
+    requireDecoded<seldon::protos::SeldonMessageList>(
+        "{\"seldonMessages\":[{\"data\":{\"ndarray\":[1]}},{\"strData\":\"s\"},{}]}");
+    requireDecoded<seldon::protos::SeldonMessageList>("{\"seldonMessages\":[]}");
+    requireDecoded<seldon::protos::Feedback>(
+        "{\"request\":{\"data\":{\"ndarray\":[1]}},\"response\":{\"meta\":{}},\"reward\":0.5,"
+        "\"truth\":{\"data\":{\"tensor\":{\"shape\":[1],\"values\":[2]}}}}");
+
+    std::vector<std::string> fallbacks = {
+        // Left to the protobuf parser, which takes them
+        "{\"customData\":{\"@type\":\"type.googleapis.com/google.protobuf.Duration\","
+        "\"value\":\"1s\"}}",
+        "{\"data\":{\"tftensor\":{\"dtype\":\"DT_FLOAT\",\"floatVal\":[1]}}}",
+        "{\"meta\":null}",
+        "{\"strData\":null}",
+        "{\"meta\":{\"requestPath\":{\"a\":null}}}",
+        "{\"data\":{\"tensor\":{\"shape\":[\"2\"],\"values\":[\"1\",\"NaN\",\"-Infinity\"]}}}",
+        "{\"data\":{\"tensor\":{\"shape\":[2.0]}}}",
+        "{\"status\":{\"status\":1}}",
+        "{\"meta\":{\"puid\":\"a\",\"puid\":\"b\"}}",
+        "{\"data\":{\"names\":[\"a\"],\"names\":[\"b\"]}}",
+        "{\"strData\":\"a\",}",
+        "{\"strData\":\"\t\"}",
+        "{\"data\":{\"ndarray\":[1.]}}",
+        "{\"binData\":\"QUJD\\u0044\"}",
+        // And ones it rejects
+        "{\"unknown\":1}",
+        "{\"strData\":\"a\"} x",
+        "{\"strData\":\"a\xff\"}",
+        "{\"strData\":\"\\ud800\"}",
+        "{\"strData\":\"a\"",
+        "{\"data\":{\"ndarray\":[01]}}",
+        "{\"data\":{\"ndarray\":[1e400]}}",
+        "{\"status\":{\"code\":2147483648}}",
+        "{\"meta\":{\"metrics\":[{\"value\":1e39}]}}",
+        "{\"meta\":{\"tags\":{\"a\":1,\"a\":2}}}",
+        "{\"binData\":\"QQ==\",\"strData\":\"a\"}",
+        "{\"data\":{\"tensor\":{},\"ndarray\":[]}}",
+        "{\"binData\":\"QR==\"}",
+        "{\"meta\":{\"puid\":1}}",
+        "[]",
+        "",
+    };
+    for (const std::string &json : fallbacks) {
+        requireFallback(json);
+    }
+}
+
+TEST_CASE("TestJsonDecoderNumbers") {
+    std::mt19937_64 random(5);
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    std::uniform_int_distribution<int> exponent(-320, 308);
+    const char *formats[] = {"%.17g", "%.6g", "%.3e", "%.0f", "%.20e", "%g"};
+
+    for (int batch = 0; batch < 20; batch++) {
+        std::string json = "{\"data\":{\"tensor\":{\"values\":[";
+        std::string ndarray = "{\"data\":{\"ndarray\":[";
+        for (int i = 0; i < 500; i++) {
+            double value = uniform(random);
+            if (i % 3 == 0) {
+                value *= std::pow(10.0, exponent(random));
+            } else if (i % 3 == 1) {
+                value = std::round(value * 1e6);
+            }
+            char text[64];
+            std::snprintf(text, sizeof(text), formats[i % 6], value);
+            if (i > 0) {
+                json.push_back(',');
+                ndarray.push_back(',');
+            }
+            json.append(text);
+            ndarray.append(text);
+        }
+        // Integers past 2^53 and 2^64, with more than 19 digits
+        json.append(",18446744073709551615,-9223372036854775808,123456789012345678901234567890");
+        requireDecoded<seldon::protos::SeldonMessage>(json + "]}}}");
+        requireDecoded<seldon::protos::SeldonMessage>(ndarray + "]}}");
+    }
+
+    // What the protobuf printer writes decodes back to the same values
+    seldon::protos::SeldonMessage message;
+    auto *values = message.mutable_data()->mutable_tensor()->mutable_values();
+    for (int i = 0; i < 10000; i++) {
+        values->Add(uniform(random) * std::pow(10.0, exponent(random)));
+    }
+    std::string json;
+    google::protobuf::util::MessageToJsonString(message, &json);
+    requireDecoded<seldon::protos::SeldonMessage>(json);
+}
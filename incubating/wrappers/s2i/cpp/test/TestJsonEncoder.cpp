@@ -0,0 +1,300 @@
+#include "catch_amalgamated.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/util/json_util.h>
+
+#include "seldon/Codec.hpp"
+#include "seldon/JsonEncoder.hpp"
+
+namespace {
+
+std::string canonical(const google::protobuf::Message &message) {
+    std::string out;
+    {
+        google::protobuf::io::StringOutputStream stream(&out);
+        google::protobuf::io::CodedOutputStream coded(&stream);
+        coded.SetSerializationDeterministic(true);
+        message.SerializeToCodedStream(&coded);
+    }
+    return out;
+}
+
+std::string printed(const google::protobuf::Message &message) {
+    std::string json;
+    REQUIRE(google::protobuf::util::MessageToJsonString(message, &json).ok());
+    return json;
+}
+
+std::string encoded(const seldon::protos::SeldonMessage &message,
+                    const seldon::json::EncodeOptions &options = seldon::json::EncodeOptions()) {
+    std::string json;
+    REQUIRE(seldon::json::encode(message, json, options));
+    return json;
+}
+
+std::string number(double value) {
+    char buffer[seldon::json::kMaxNumberSize];
+    return std::string(buffer, seldon::json::writeNumber(value, buffer));
+}
+
+std::string number(float value, int digits = 0) {
+    char buffer[seldon::json::kMaxNumberSize];
+    return std::string(buffer, seldon::json::writeNumber(value, digits, buffer));
+}
+
+// Significant digits of a decimal, without leading or trailing zeros
+int significantDigits(const std::string &text) {
+    std::string digits;
+    for (char c : text.substr(0, text.find('e'))) {
+        if (c >= '0' && c <= '9') {
+            digits.push_back(c);
+        }
+    }
+    size_t first = digits.find_first_not_of('0');
+    return static_cast<int>(digits.find_last_not_of('0') - first + 1);
+}
+
+// Checks that text reads back as value and no decimal with fewer digits
+// does, and that it is the closest one with as many digits
+template <typename T>
+void requireShortest(T value, const std::string &text) {
+    INFO(text);
+    auto read = [](const char *text) {
+        return sizeof(T) == sizeof(double) ? static_cast<T>(std::strtod(text, nullptr))
+                                           : static_cast<T>(std::strtof(text, nullptr));
+    };
+    REQUIRE(read(text.c_str()) == value);
+
+    int digits = significantDigits(text);
+    char shorter[32];
+    for (int precision = 1; precision < digits; precision++) {
+        std::snprintf(shorter, sizeof(shorter), "%.*e", precision - 1, static_cast<double>(value));
+        REQUIRE(read(shorter) != value);
+    }
+    char closest[32];
+    std::snprintf(closest, sizeof(closest), "%.*e", digits - 1, static_cast<double>(value));
+    if (read(closest) == value) {
+        REQUIRE(std::strtod(closest, nullptr) == std::strtod(text.c_str(), nullptr));
+    }
+}
+
+}
+
+TEST_CASE("TestJsonEncoderNumbers") {
+    REQUIRE(number(0.0) == "0");
+    REQUIRE(number(-0.0) == "-0");
+    REQUIRE(number(3.0) == "3");
+    REQUIRE(number(-1.5) == "-1.5");
+    REQUIRE(number(0.1) == "0.1");
+    REQUIRE(number(0.1 + 0.2) == "0.30000000000000004");
+    REQUIRE(number(1e15) == "1000000000000000");
+    REQUIRE(number(1e16) == "1e+16");
+    REQUIRE(number(1e-4) == "0.0001");
+    REQUIRE(number(1.25e-5) == "1.25e-05");
+    REQUIRE(number(1e300) == "1e+300");
+    REQUIRE(number(5e-324) == "5e-324");
+    REQUIRE(number(-2.2250738585072014e-308) == "-2.2250738585072014e-308");
+    REQUIRE(number(std::nan("")) == "\"NaN\"");
+    REQUIRE(number(-HUGE_VAL) == "\"-Infinity\"");
+    REQUIRE(number(0.1f) == "0.1");
+    REQUIRE(number(3.4028235e38f) == "3.4028235e+38");
+    REQUIRE(number(1e-45f) == "1e-45");
+    REQUIRE(number(0.123456789f, 3) == "0.123");
+    REQUIRE(number(0.0125f, 2) == "0.013");
+    REQUIRE(number(9.9999f, 3) == "10");
+    REQUIRE(number(-123456.7f, 2) == "-120000");
+    REQUIRE(number(0.5f, 9) == "0.5");
+
+    char buffer[seldon::json::kMaxNumberSize];
+    int64_t integers[] = {0, -7, INT64_MIN, INT64_MAX};
+    for (int64_t value : integers) {
+        REQUIRE(std::string(buffer, seldon::json::writeNumber(value, buffer)) ==
+                std::to_string(value));
+    }
+
+    std::mt19937_64 random(11);
+    for (int i = 0; i < 20000; i++) {
+        uint64_t bits = random();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        float single;
+        uint32_t singleBits = static_cast<uint32_t>(bits);
+        std::memcpy(&single, &singleBits, sizeof(single));
+        if (std::isfinite(value)) {
+            requireShortest(value, number(value));
+        }
+        if (std::isfinite(single)) {
+            requireShortest(single, number(single));
+        }
+    }
+    for (int exponent = -1074; exponent <= 1023; exponent++) {
+        double power = std::ldexp(1.0, exponent);
+        requireShortest(power, number(power));
+        requireShortest(std::nextafter(power, 0.0), number(std::nextafter(power, 0.0)));
+    }
+    for (int exponent = -149; exponent <= 127; exponent++) {
+        float power = std::ldexp(1.0f, exponent);
+        requireShortest(power, number(power));
+        requireShortest(std::nextafter(power, 0.0f), number(std::nextafter(power, 0.0f)));
+    }
+}
+
+TEST_CASE("TestJsonEncoderConformance") {
+    using seldon::protos::SeldonMessage;
+
+    std::vector<std::string> messages = {
+        "{}",
+        "{\"status\":{},\"meta\":{},\"data\":{}}",
+        "{\"status\":{\"code\":-3,\"info\":\"i\",\"reason\":\"r\",\"status\":\"FAILURE\"}}",
+        "{\"data\":{\"names\":[\"a\",\"b\"],\"tensor\":{\"shape\":[2,1],\"values\":[1,-2.5]}}}",
+        "{\"data\":{\"tensor\":{}}}",
+        "{\"data\":{\"ndarray\":[[1,2.5,-3e2],[true,false,null],[\"x\",[],{}]]}}",
+        "{\"data\":{\"ndarray\":[]}}",
+        "{\"data\":{\"tftensor\":{\"dtype\":\"DT_FLOAT\",\"tensorShape\":{\"dim\":[{\"size\":\"2\"},"
+        "{\"name\":\"n\"}],\"unknownRank\":true},\"versionNumber\":2,\"tensorContent\":\"eHl6\","
+        "\"floatVal\":[0.5,-2],\"doubleVal\":[1.25],\"intVal\":[-1],\"stringVal\":[\"YWI=\",\"\"],"
+        "\"scomplexVal\":[1,2],\"int64Val\":[\"-5\",\"9223372036854775807\"],\"boolVal\":[true,false],"
+        "\"dcomplexVal\":[3,4],\"halfVal\":[7],\"uint32Val\":[4294967295],"
+        "\"uint64Val\":[\"18446744073709551615\"]}}}",
+        "{\"data\":{\"tftensor\":{\"dtype\":999,\"tensorShape\":{}}}}",
+        "{\"binData\":\"QUJDRA==\"}",
+        "{\"binData\":\"\"}",
+        "{\"strData\":\"\"}",
+        "{\"strData\":\"\\\"\\\\/\\b\\f\\n\\r\\t\\u0000\\u001f\\u007f<>&' caf\\u00e9 \\u20ac "
+        "\\ud83d\\ude00\\u2028\\ufeff\\udb40\\udc01\"}",
+        "{\"jsonData\":{\"a\":[1,{\"b\":null}],\"c\":\"d\",\"e\":true}}",
+        "{\"jsonData\":null}",
+        "{\"jsonData\":\"NaN\"}",
+        "{\"meta\":{\"puid\":\"abc\",\"tags\":{\"a\":1,\"b\":\"x\",\"c\":[1,2],\"d\":{},\"e\":null,"
+        "\"f\":false,\"g\":\"<\\u00ad>\"},\"routing\":{\"r\":-1,\"s\":2,\"t\":0},"
+        "\"requestPath\":{\"m\":\"img:1\",\"n\":\"\"},"
+        "\"metrics\":[{\"key\":\"k\",\"type\":\"TIMER\",\"value\":1.5,\"tags\":{\"t\":\"v\",\"u\":\"w\"}},"
+        "{\"type\":\"GAUGE\",\"value\":-2},{}]}}",
+    };
+    for (const std::string &json : messages) {
+        INFO(json);
+        SeldonMessage message;
+        REQUIRE(google::protobuf::util::JsonStringToMessage(json, &message).ok());
+        REQUIRE(encoded(message) == printed(message));
+    }
+
+    // Map entries come out in the printer's order, however many there are
+    SeldonMessage message;
+    for (int i = 0; i < 100; i++) {
+        (*message.mutable_meta()->mutable_tags())["t" + std::to_string(i)].set_number_value(i);
+        (*message.mutable_meta()->mutable_routing())["r" + std::to_string(i)] = i;
+        (*message.mutable_meta()->mutable_requestpath())["p" + std::to_string(i)] = "x";
+    }
+    REQUIRE(encoded(message) == printed(message));
+
+    // Values with no kind are left out, like the printer does
+    message.Clear();
+    google::protobuf::ListValue *ndarray = message.mutable_data()->mutable_ndarray();
+    ndarray->add_values()->set_number_value(1);
+    ndarray->add_values();
+    (*ndarray->add_values()->mutable_struct_value()->mutable_fields())["unset"];
+    REQUIRE(encoded(message) == printed(message));
+    message.mutable_jsondata();
+    REQUIRE(encoded(message) == printed(message));
+
+    // Every code point is escaped the same way
+    std::string text;
+    for (uint32_t code = 1; code <= 0x10FFFF; code++) {
+        if (code >= 0xD800 && code <= 0xDFFF) {
+            continue;
+        }
+        if (code < 0x80) {
+            text.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            text.push_back(static_cast<char>(0xC0 | code >> 6));
+            text.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            text.push_back(static_cast<char>(0xE0 | code >> 12));
+            text.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+            text.push_back(static_cast<char>(0xF0 | code >> 18));
+            text.push_back(static_cast<char>(0x80 | (code >> 12 & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+    message.set_strdata(text);
+    REQUIRE(encoded(message) == printed(message));
+
+    // Numbers read back the same, though they may be shorter than printed
+    std::mt19937_64 random(3);
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    std::uniform_int_distribution<int> exponent(-320, 308);
+    message.Clear();
+    seldon::protos::Tensor *tensor = message.mutable_data()->mutable_tensor();
+    for (int i = 0; i < 5000; i++) {
+        tensor->add_values(uniform(random) * std::pow(10.0, exponent(random)));
+    }
+    message.mutable_meta()->add_metrics()->set_value(static_cast<float>(uniform(random)));
+    std::string json = encoded(message);
+    REQUIRE(json.size() <= printed(message).size());
+    SeldonMessage decoded;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(json, &decoded).ok());
+    REQUIRE(canonical(decoded) == canonical(message));
+
+    // What the encoder can't write is left to the printer
+    message.Clear();
+    message.mutable_customdata();
+    std::string out;
+    REQUIRE_FALSE(seldon::json::encode(message, out));
+    message.set_strdata("a\xff");
+    REQUIRE_FALSE(seldon::json::encode(message, out));
+    seldon::encodeMessage(message, seldon::PayloadFormat::Json, out);
+    REQUIRE(out == printed(message));
+}
+
+TEST_CASE("TestJsonEncoderOptions") {
+    seldon::protos::SeldonMessage message;
+    message.mutable_status();
+    message.mutable_meta();
+    tensorflow::TensorProto *tensor = message.mutable_data()->mutable_tftensor();
+    tensor->set_dtype(tensorflow::DT_FLOAT);
+    tensor->mutable_tensor_shape()->add_dim()->set_size(3);
+    tensor->add_float_val(0.123456f);
+    tensor->add_float_val(2.5f);
+    tensor->add_float_val(-1e-7f);
+
+    seldon::json::EncodeOptions options;
+    REQUIRE(encoded(message, options) ==
+            "{\"status\":{},\"meta\":{},\"data\":{\"tftensor\":{\"dtype\":\"DT_FLOAT\","
+            "\"tensorShape\":{\"dim\":[{\"size\":\"3\"}]},\"floatVal\":[0.123456,2.5,-1e-07]}}}");
+
+    options.floatDigits = 2;
+    options.omitDefaults = true;
+    REQUIRE(encoded(message, options) ==
+            "{\"data\":{\"tftensor\":{\"dtype\":\"DT_FLOAT\",\"tensorShape\":{\"dim\":[{\"size\":"
+            "\"3\"}]},\"floatVal\":[0.12,2.5,-1e-07]}}}");
+
+    options.ndarray = true;
+    REQUIRE(encoded(message, options) == "{\"data\":{\"ndarray\":[0.12,2.5,-1e-07]}}");
+
+    // Set fields are still written
+    message.mutable_meta()->set_puid("p");
+    message.mutable_status()->set_code(200);
+    REQUIRE(encoded(message, options) ==
+            "{\"status\":{\"code\":200},\"meta\":{\"puid\":\"p\"},"
+            "\"data\":{\"ndarray\":[0.12,2.5,-1e-07]}}");
+
+    // Other data is written as it is
+    message.mutable_data()->mutable_tensor()->add_values(0.125);
+    REQUIRE(encoded(message, options) ==
+            "{\"status\":{\"code\":200},\"meta\":{\"puid\":\"p\"},\"data\":{\"ndarray\":[0.125]}}");
+    message.set_strdata("s");
+    REQUIRE(encoded(message, options) ==
+            "{\"status\":{\"code\":200},\"meta\":{\"puid\":\"p\"},\"strData\":\"s\"}");
+}
@@ -0,0 +1,349 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/util/json_util.h>
+#include <google/protobuf/util/message_differencer.h>
+
+#include "seldon/Codec.hpp"
+#include "seldon/LazyMessage.hpp"
+#include "seldon/SeldonModel.hpp"
+#include "seldon/TensorView.hpp"
+
+namespace {
+
+using seldon::LazyMessage;
+using seldon::PayloadFormat;
+using seldon::protos::SeldonMessage;
+
+SeldonMessage fromJson(const std::string &json) {
+    SeldonMessage message;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(json, &message).ok());
+    return message;
+}
+
+std::string encode(LazyMessage &message, PayloadFormat format) {
+    std::string out;
+    message.encode(format, seldon::json::EncodeOptions(), out);
+    return out;
+}
+
+// Checks that json passes through a LazyMessage as the same message, in
+// both formats
+void requireRoundTrip(const std::string &json) {
+    INFO(json);
+    SeldonMessage expected = fromJson(json);
+    LazyMessage message;
+    message.parse(json.data(), json.size(), PayloadFormat::Json);
+    REQUIRE(message.data_oneof_case() == expected.data_oneof_case());
+    SeldonMessage output = fromJson(encode(message, PayloadFormat::Json));
+    REQUIRE(google::protobuf::util::MessageDifferencer::Equals(output, expected));
+
+    std::string wire = expected.SerializeAsString();
+    message.parse(wire.data(), wire.size(), PayloadFormat::Proto);
+    REQUIRE(output.ParseFromString(encode(message, PayloadFormat::Proto)));
+    REQUIRE(google::protobuf::util::MessageDifferencer::Equals(output, expected));
+    REQUIRE(google::protobuf::util::MessageDifferencer::Equals(message.message(), expected));
+}
+
+// Tags every request and routes on its tags, without reading the payload
+class TagModel : public seldon::SeldonModelBase {
+public:
+    TagModel() { this->enableLazyDecoding(); }
+
+    void transformInput(LazyMessage &message) override {
+        (*message.mutable_meta()->mutable_tags())["seen"].set_bool_value(true);
+    }
+
+    void route(LazyMessage &input, SeldonMessage &output) override {
+        auto *tensor = output.mutable_data()->mutable_tensor();
+        tensor->add_shape(1);
+        tensor->add_shape(1);
+        tensor->add_values(input.meta().tags().count("child") ? 1 : 0);
+        this->mDecoded = input.decoded();
+    }
+
+    bool mDecoded = true;
+};
+
+// Only overrides the overloads that take a message
+class DoublingModel : public seldon::SeldonModelBase {
+public:
+    DoublingModel() { this->enableLazyDecoding(); }
+
+    void transformOutput(SeldonMessage &input, SeldonMessage &output) override {
+        output = input;
+        for (double &value : *output.mutable_data()->mutable_tensor()->mutable_values()) {
+            value *= 2;
+        }
+    }
+};
+
+// Sums the bytes of a binData image, reading them in place
+class ImageModel : public seldon::SeldonModelBase {
+public:
+    ImageModel() { this->enableLazyDecoding(); }
+
+    void predict(LazyMessage &input, SeldonMessage &output) override {
+        google::protobuf::StringPiece pixels = input.binDataView();
+        double sum = 0;
+        for (char c : pixels) {
+            sum += static_cast<unsigned char>(c);
+        }
+        output.mutable_data()->mutable_tensor()->add_values(sum);
+        this->mPixels = pixels.data();
+    }
+
+    const char *mPixels = nullptr;
+};
+
+// Whether view points into buffer
+bool inside(google::protobuf::StringPiece view, const std::string &buffer) {
+    return view.data() >= buffer.data() && view.data() + view.size() <= buffer.data() + buffer.size();
+}
+
+std::string handle(seldon::RawModel &model, seldon::Method method, const std::string &request,
+                   PayloadFormat format = PayloadFormat::Json) {
+    std::string response;
+    model.handleBuffer(method, request.data(), request.size(), format, response);
+    return response;
+}
+
+}
+
+TEST_CASE("TestLazyMessageVerbatim", "Payloads are only decoded once read") {
+
+    // Unusual spacing and number text only survive if copied as sent
+    std::string json = "{\"meta\":{\"puid\":\"p\",\"tags\":{\"a\":\"b\"}},"
+                       "\"data\":{ \"tensor\" : {\"values\":[1.50, 2E0]}},\"status\":{\"code\":3}}";
+    LazyMessage message;
+    message.parse(json.data(), json.size(), PayloadFormat::Json);
+    REQUIRE(message.meta().puid() == "p");
+    REQUIRE(message.status().code() == 3);
+    REQUIRE(message.data_oneof_case() == SeldonMessage::kData);
+    REQUIRE_FALSE(message.decoded());
+    REQUIRE(message.verbatim());
+    REQUIRE(encode(message, PayloadFormat::Json) ==
+            "{\"status\":{\"code\":3},\"meta\":{\"puid\":\"p\",\"tags\":{\"a\":\"b\"}},"
+            "\"data\":{ \"tensor\" : {\"values\":[1.50, 2E0]}}}");
+
+    // Changes to meta are kept, and reading the payload leaves it verbatim
+    message.mutable_meta()->set_puid("q");
+    message.mutable_status()->Clear();
+    REQUIRE(message.message().data().tensor().values(0) == 1.5);
+    REQUIRE(message.decoded());
+    REQUIRE(message.message().meta().puid() == "q");
+    REQUIRE(encode(message, PayloadFormat::Json) ==
+            "{\"status\":{},\"meta\":{\"puid\":\"q\",\"tags\":{\"a\":\"b\"}},"
+            "\"data\":{ \"tensor\" : {\"values\":[1.50, 2E0]}}}");
+    // Other formats are encoded from the message
+    SeldonMessage proto;
+    REQUIRE(proto.ParseFromString(encode(message, PayloadFormat::Proto)));
+    REQUIRE(proto.data().tensor().values(1) == 2);
+    REQUIRE(proto.meta().puid() == "q");
+
+    // Until it is changed
+    message.mutable_message()->mutable_data()->mutable_tensor()->set_values(0, 4);
+    REQUIRE_FALSE(message.verbatim());
+    REQUIRE(encode(message, PayloadFormat::Json) ==
+            "{\"status\":{},\"meta\":{\"puid\":\"q\",\"tags\":{\"a\":\"b\"}},"
+            "\"data\":{\"tensor\":{\"values\":[4,2]}}}");
+
+    // Wire-format payloads are copied as sent too, after the status and meta
+    SeldonMessage request = fromJson("{\"binData\":\"QUJD\",\"meta\":{\"puid\":\"p\"}}");
+    std::string wire = request.SerializeAsString();
+    message.parse(wire.data(), wire.size(), PayloadFormat::Proto);
+    REQUIRE_FALSE(message.decoded());
+    REQUIRE(message.data_oneof_case() == SeldonMessage::kBinData);
+    message.mutable_meta()->set_puid("q");
+    request.mutable_meta()->set_puid("q");
+    REQUIRE(encode(message, PayloadFormat::Proto) == request.SerializeAsString());
+    REQUIRE(encode(message, PayloadFormat::Json) ==
+            "{\"meta\":{\"puid\":\"q\"},\"binData\":\"QUJD\"}");
+
+    // Requests without a payload have nothing left to decode
+    message.parse("{\"meta\":{}}", 11, PayloadFormat::Json);
+    REQUIRE(message.decoded());
+    REQUIRE_FALSE(message.verbatim());
+    REQUIRE(encode(message, PayloadFormat::Json) == "{\"meta\":{}}");
+}
+
+TEST_CASE("TestLazyMessageConformance", "Lazy messages encode as the message they hold") {
+
+    std::vector<std::string> messages = {
+        "{}",
+        "{\"data\":{}}",
+        "{\"data\":{\"names\":[\"a\"],\"ndarray\":[[1,2],[3,4]]},\"meta\":{\"puid\":\"x\"}}",
+        "{\"status\":{\"code\":1,\"status\":\"FAILURE\"},\"strData\":\"caf\xc3\xa9 \\\"q\\\"\"}",
+        "{\"jsonData\":{\"a\":[1,{\"b\":null}]},\"meta\":{\"routing\":{\"r\":2}}}",
+        "{\"jsonData\":3}",
+        "{\"binData\":\"\"}",
+        "{\"strData\":\"a\\u0041\"}",
+        "{\"customData\":{\"@type\":\"type.googleapis.com/google.protobuf.Duration\","
+        "\"value\":\"1s\"}}",
+        // Left to decodeMessage as a whole
+        "{\"\\u0062inData\":\"QQ==\"}",
+        "{\"strData\":null,\"meta\":{}}",
+        "{\"jsonData\":null}",
+        "{\"meta\":{\"puid\":\"a\"},\"meta\":{\"puid\":\"b\"}}",
+    };
+    for (const std::string &json : messages) {
+        requireRoundTrip(json);
+    }
+
+    // Protobuf merges repeated message fields, which the scan leaves to it
+    SeldonMessage first = fromJson("{\"meta\":{\"puid\":\"a\"}}");
+    SeldonMessage second = fromJson("{\"meta\":{\"tags\":{\"t\":1}},\"strData\":\"s\"}");
+    std::string wire = first.SerializeAsString() + second.SerializeAsString();
+    LazyMessage message;
+    message.parse(wire.data(), wire.size(), PayloadFormat::Proto);
+    REQUIRE(message.decoded());
+    REQUIRE(message.meta().puid() == "a");
+    REQUIRE(message.meta().tags().count("t") == 1);
+
+    // Malformed status or meta fail the parse, a malformed payload only its
+    // decoding
+    std::vector<std::string> errors = {"{\"meta\":{\"puid\":1},\"strData\":\"s\"}",
+                                       "{\"status\":[],\"strData\":\"s\"}",
+                                       "{\"unknown\":1}",
+                                       "{\"strData\":\"s\"",
+                                       "[]"};
+    for (const std::string &json : errors) {
+        INFO(json);
+        REQUIRE_THROWS_AS(message.parse(json.data(), json.size(), PayloadFormat::Json),
+                          std::invalid_argument);
+    }
+    std::string json = "{\"meta\":{},\"data\":{\"tensor\":{\"values\":[x]}}}";
+    message.parse(json.data(), json.size(), PayloadFormat::Json);
+    REQUIRE_THROWS_AS(message.message(), std::invalid_argument);
+    REQUIRE_THROWS_AS(message.parse("\x0a\x05", 2, PayloadFormat::Proto), std::invalid_argument);
+}
+
+TEST_CASE("TestLazyMessageNdarray", "Ndarray payloads are found without decoding them") {
+
+    std::vector<std::pair<std::string, bool>> cases = {
+        {"{\"data\":{\"names\":[\"ndarray\"],\"ndarray\":[1]}}", true},
+        {"{\"data\":{\"tensor\":{\"values\":[1]}}}", false},
+        {"{\"strData\":\"ndarray\"}", false},
+        {"{\"meta\":{}}", false},
+    };
+    for (const auto &test : cases) {
+        INFO(test.first);
+        LazyMessage message;
+        message.parse(test.first.data(), test.first.size(), PayloadFormat::Json);
+        REQUIRE(message.hasNdarray() == test.second);
+        std::string wire = fromJson(test.first).SerializeAsString();
+        message.parse(wire.data(), wire.size(), PayloadFormat::Proto);
+        REQUIRE(message.hasNdarray() == test.second);
+        REQUIRE(message.hasNdarray() == message.message().data().has_ndarray());
+    }
+}
+
+TEST_CASE("TestLazyMessageModel", "Lazy components only decode what they read") {
+
+    TagModel model;
+    std::string request = "{\"meta\":{\"tags\":{\"child\":\"b\"}},\"binData\":\"QUJDRA==\"}";
+    std::string response = handle(model, seldon::Method::TransformInput, request);
+    REQUIRE(fromJson(response).meta().tags().at("seen").bool_value());
+    REQUIRE(response.substr(response.size() - 22) == ",\"binData\":\"QUJDRA==\"}");
+    REQUIRE(handle(model, seldon::Method::Route, request) ==
+            "{\"data\":{\"tensor\":{\"shape\":[1,1],\"values\":[1]}}}");
+    REQUIRE_FALSE(model.mDecoded);
+
+    SeldonMessage proto = fromJson(request);
+    std::string wire = proto.SerializeAsString();
+    SeldonMessage output;
+    REQUIRE(output.ParseFromString(
+        handle(model, seldon::Method::TransformInput, wire, PayloadFormat::Proto)));
+    REQUIRE(output.bindata() == "ABCD");
+    REQUIRE(output.meta().tags().at("seen").bool_value());
+
+    // Output transformers still pass requests through unless overridden
+    REQUIRE(handle(model, seldon::Method::TransformOutput, request) == request);
+
+    // Predictions aren't lazy
+    REQUIRE_THROWS_AS(handle(model, seldon::Method::Predict, request), std::logic_error);
+
+    // Components that don't take a LazyMessage get the whole request
+    DoublingModel doubling;
+    REQUIRE(handle(doubling, seldon::Method::TransformOutput,
+                   "{\"meta\":{},\"data\":{\"tensor\":{\"values\":[1,2.5]}}}") ==
+            "{\"meta\":{},\"data\":{\"tensor\":{\"values\":[2,5]}}}");
+}
+
+TEST_CASE("TestLazyMessageViews", "Wire-format payloads are read in place") {
+
+    SeldonMessage request = fromJson("{\"binData\":\"AAECAwQ=\",\"meta\":{\"puid\":\"p\"}}");
+    std::string wire = request.SerializeAsString();
+    LazyMessage message;
+    message.parse(wire.data(), wire.size(), PayloadFormat::Proto);
+    google::protobuf::StringPiece view = message.binDataView();
+    REQUIRE(view == google::protobuf::StringPiece("\0\1\2\3\4", 5));
+    REQUIRE(inside(view, wire));
+    REQUIRE_FALSE(message.decoded());
+    REQUIRE(message.strDataView().empty());
+
+    // JSON payloads are decoded first
+    std::string json = "{\"strData\":\"caf\\u00e9\"}";
+    message.parse(json.data(), json.size(), PayloadFormat::Json);
+    REQUIRE(message.strDataView() == "caf\xc3\xa9");
+    REQUIRE(message.decoded());
+
+    // tensor_content is viewed apart from the rest of the tftensor
+    SeldonMessage tensor;
+    tensor.mutable_data()->add_names("x");
+    seldon::TensorBuilder<float> builder =
+        seldon::TensorBuilder<float>::tftensor(*tensor.mutable_data(), {2, 3});
+    for (size_t i = 0; i < builder.size(); i++) {
+        builder.data()[i] = static_cast<float>(i) / 2;
+    }
+    wire = tensor.SerializeAsString();
+    for (PayloadFormat format : {PayloadFormat::Proto, PayloadFormat::Json}) {
+        std::string request;
+        seldon::encodeMessage(tensor, format, request);
+        message.parse(request.data(), request.size(), format);
+        tensorflow::TensorProto header;
+        google::protobuf::StringPiece content;
+        REQUIRE(message.tftensorView(header, content));
+        REQUIRE(header.dtype() == tensorflow::DT_FLOAT);
+        REQUIRE(header.tensor_shape().dim_size() == 2);
+        REQUIRE(header.tensor_content().empty());
+        REQUIRE(content == tensor.data().tftensor().tensor_content());
+        REQUIRE(inside(content, request) == (format == PayloadFormat::Proto));
+        seldon::TensorView<float> values(header, content);
+        REQUIRE(values.shape() == std::vector<int64_t>{2, 3});
+        REQUIRE(values[5] == 2.5f);
+    }
+
+    // Typed values have no content to view
+    tensor = fromJson("{\"data\":{\"tftensor\":{\"dtype\":\"DT_DOUBLE\","
+                      "\"tensorShape\":{\"dim\":[{\"size\":\"2\"}]},\"doubleVal\":[1,2]}}}");
+    wire = tensor.SerializeAsString();
+    message.parse(wire.data(), wire.size(), PayloadFormat::Proto);
+    tensorflow::TensorProto header;
+    google::protobuf::StringPiece content;
+    REQUIRE(message.tftensorView(header, content));
+    REQUIRE(content.empty());
+    REQUIRE(seldon::TensorView<double>(header, content)[1] == 2);
+
+    // Neither are there tftensors in other payloads
+    wire = fromJson("{\"data\":{\"tensor\":{\"values\":[1]}}}").SerializeAsString();
+    message.parse(wire.data(), wire.size(), PayloadFormat::Proto);
+    REQUIRE_FALSE(message.tftensorView(header, content));
+    REQUIRE(message.binDataView().empty());
+
+    // Predictions read blobs straight from the request
+    ImageModel model;
+    wire = request.SerializeAsString();
+    std::string response;
+    model.handleBuffer(seldon::Method::Predict, wire.data(), wire.size(), PayloadFormat::Proto,
+                       response);
+    REQUIRE(inside(google::protobuf::StringPiece(model.mPixels, 5), wire));
+    SeldonMessage output;
+    REQUIRE(output.ParseFromString(response));
+    REQUIRE(output.data().tensor().values(0) == 10);
+    REQUIRE(handle(model, seldon::Method::Predict, "{\"binData\":\"AAECAwQ=\"}") ==
+            "{\"data\":{\"tensor\":{\"values\":[10]}}}");
+}
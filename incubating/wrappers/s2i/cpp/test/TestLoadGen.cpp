@@ -0,0 +1,86 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "seldon/LoadGen.hpp"
+#include "seldon/SeldonModel.hpp"
+
+namespace {
+
+// Echoes its input, failing requests whose strData is "fail"
+class LoadModel : public seldon::SeldonModelBase {
+
+    void predict(seldon::protos::SeldonMessage &input,
+                 seldon::protos::SeldonMessage &output) override {
+        if (input.strdata() == "fail") {
+            throw std::runtime_error("failed");
+        }
+        output.Swap(&input);
+    }
+};
+
+seldon::loadgen::LoadOptions shortRun(seldon::loadgen::Target target) {
+    seldon::loadgen::LoadOptions options;
+    options.target = target;
+    options.concurrency = 2;
+    options.durationSeconds = 0.2;
+    options.warmupSeconds = 0.05;
+    options.serverThreads = 2;
+    return options;
+}
+
+}
+
+TEST_CASE("TestLoadGenOptions", "seldon-loadgen parses its command line") {
+
+    const char *args[] = {"seldon-loadgen", "--target", "rest", "--rate", "100,200",
+                          "--concurrency", "4", "--method", "transform-input", "--json"};
+    auto options = seldon::loadgen::LoadOptions::fromArgs(10, const_cast<char **>(args));
+    REQUIRE(options.target == seldon::loadgen::Target::Rest);
+    REQUIRE(options.rates == std::vector<double>({100, 200}));
+    REQUIRE(options.concurrency == 4);
+    REQUIRE(options.method == seldon::Method::TransformInput);
+
+    const char *bad[] = {"seldon-loadgen", "--rate", "fast"};
+    REQUIRE_THROWS_AS(seldon::loadgen::LoadOptions::fromArgs(3, const_cast<char **>(bad)),
+                      std::invalid_argument);
+}
+
+TEST_CASE("TestLoadGenInProcess", "Open and closed loop runs report latency quantiles") {
+
+    LoadModel model;
+    auto options = shortRun(seldon::loadgen::Target::InProcess);
+    options.rates = {0, 500};
+    options.payloads = {"{\"strData\":\"{{seq}}\"}", "{\"strData\":\"fail\"}"};
+
+    auto reports = seldon::loadgen::run(&model, options);
+    REQUIRE(reports.size() == 2);
+    for (const auto &report : reports) {
+        REQUIRE(report.requests > 0);
+        REQUIRE(report.errors > 0);
+        REQUIRE(report.p50 > 0);
+        REQUIRE(report.p50 <= report.p99);
+        REQUIRE(report.p99 <= report.p999);
+        REQUIRE(report.p999 <= report.max * 1.01);
+    }
+    // Open loop sends at the rate, here about 100 measured requests
+    REQUIRE(reports[1].requests + reports[1].errors < 150);
+
+    std::string json = seldon::loadgen::formatJson(options, reports);
+    REQUIRE(json.find("\"p99.9\":") != std::string::npos);
+}
+
+TEST_CASE("TestLoadGenRest", "The native server is loaded over loopback") {
+
+    LoadModel model;
+    auto options = shortRun(seldon::loadgen::Target::Rest);
+    options.format = seldon::PayloadFormat::Proto;
+
+    auto reports = seldon::loadgen::run(&model, options);
+    REQUIRE(reports.size() == 1);
+    REQUIRE(reports[0].requests > 0);
+    REQUIRE(reports[0].errors == 0);
+    REQUIRE(reports[0].cpuSecondsPerRequest > 0);
+}
@@ -0,0 +1,33 @@
+#include "catch_amalgamated.hpp"
+
+#include "seldon/Logging.hpp"
+
+TEST_CASE("TestLogLevelParsing", "Log levels use the Python level names") {
+
+    seldon::log::Level level = seldon::log::Level::Info;
+
+    REQUIRE(seldon::log::parseLevel("warning", level));
+    REQUIRE(level == seldon::log::Level::Warning);
+
+    REQUIRE(seldon::log::parseLevel("DEBUG", level));
+    REQUIRE(level == seldon::log::Level::Debug);
+
+    REQUIRE_FALSE(seldon::log::parseLevel("verbose", level));
+    REQUIRE(level == seldon::log::Level::Debug);
+}
+
+TEST_CASE("TestLogLevelThreshold", "Only statements at or above the level are enabled") {
+
+    seldon::log::Level previous = seldon::log::getLevel();
+
+    seldon::log::setLevel(seldon::log::Level::Error);
+    REQUIRE_FALSE(seldon::log::isEnabled(seldon::log::Level::Warning));
+    REQUIRE(seldon::log::isEnabled(seldon::log::Level::Error));
+    REQUIRE(seldon::log::isEnabled(seldon::log::Level::Critical));
+
+    int evaluations = 0;
+    SELDON_LOG_WARNING("not evaluated " << ++evaluations);
+    REQUIRE(evaluations == 0);
+
+    seldon::log::setLevel(previous);
+}
@@ -0,0 +1,165 @@
+#include "catch_amalgamated.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "seldon/CustomMetrics.hpp"
+#include "seldon/Metrics.hpp"
+
+TEST_CASE("TestMetricsRender", "Registry renders the Prometheus text format") {
+
+    seldon::metrics::Registry registry(seldon::metrics::Labels{{"model_name", "test"}});
+
+    registry.counter("requests_total", "Requests", {{"code", "200"}}).inc(2);
+    registry.gauge("queue_depth", "Queue depth").set(3);
+    auto &histogram = registry.histogram("latency_seconds", "Latency", {}, {0.1, 1.0});
+    histogram.observe(0.05);
+    histogram.observe(0.5);
+    histogram.observe(5.0);
+
+    std::string rendered = registry.render();
+
+    REQUIRE(rendered.find("# TYPE requests_total counter\n") != std::string::npos);
+    REQUIRE(rendered.find("requests_total{code=\"200\",model_name=\"test\"} 2\n") != std::string::npos);
+    REQUIRE(rendered.find("queue_depth{model_name=\"test\"} 3\n") != std::string::npos);
+    REQUIRE(rendered.find("latency_seconds_bucket{model_name=\"test\",le=\"0.1\"} 1\n") != std::string::npos);
+    REQUIRE(rendered.find("latency_seconds_bucket{model_name=\"test\",le=\"1\"} 2\n") != std::string::npos);
+    REQUIRE(rendered.find("latency_seconds_bucket{model_name=\"test\",le=\"+Inf\"} 3\n") != std::string::npos);
+    REQUIRE(rendered.find("latency_seconds_count{model_name=\"test\"} 3\n") != std::string::npos);
+}
+
+TEST_CASE("TestMetricsSeriesAreShared", "Looking up a series twice returns the same metric") {
+
+    seldon::metrics::Registry registry;
+
+    auto &first = registry.counter("requests_total", "Requests", {{"code", "200"}});
+    auto &second = registry.counter("requests_total", "Requests", {{"code", "200"}});
+    REQUIRE(&first == &second);
+
+    // A programming error, not a bad request
+    REQUIRE_THROWS_AS(registry.gauge("requests_total", "Requests"), std::logic_error);
+    bool badRequest = false;
+    try {
+        registry.gauge("requests_total", "Requests");
+    } catch (const std::invalid_argument &) {
+        badRequest = true;
+    } catch (const std::logic_error &) {
+    }
+    REQUIRE(!badRequest);
+}
+
+TEST_CASE("TestMetricsHdrHistogram", "HDR histograms merge every thread's records") {
+
+    seldon::metrics::Registry registry;
+    auto &histogram = registry.hdrHistogram("stage_seconds", "Stage", {}, {0.001, 0.01});
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&histogram]() {
+            // 1us to 1000us, once each per thread
+            for (uint64_t micros = 1; micros <= 1000; micros++) {
+                histogram.record(micros * 1000);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(histogram.count() == 4000);
+    REQUIRE(histogram.sum() == Catch::Approx(4 * 0.5005).epsilon(1e-9));
+    REQUIRE(histogram.quantile(0.5) == Catch::Approx(500e-6).epsilon(0.01));
+    REQUIRE(histogram.quantile(0.99) == Catch::Approx(990e-6).epsilon(0.01));
+    REQUIRE(histogram.quantile(1.0) == Catch::Approx(1000e-6).epsilon(0.01));
+
+    std::string rendered = registry.render();
+    REQUIRE(rendered.find("# TYPE stage_seconds histogram\n") != std::string::npos);
+    REQUIRE(rendered.find("stage_seconds_bucket{le=\"0.001\"} 4000\n") != std::string::npos);
+    REQUIRE(rendered.find("stage_seconds_bucket{le=\"+Inf\"} 4000\n") != std::string::npos);
+    REQUIRE(rendered.find("stage_seconds_count 4000\n") != std::string::npos);
+}
+
+TEST_CASE("TestMetricsShardedCounter", "Sharded counters sum every thread's increments") {
+
+    seldon::metrics::Registry registry;
+    auto &counter = registry.shardedCounter("events_total", "Events", {{"kind", "a"}});
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&counter]() {
+            for (int i = 0; i < 1000; i++) {
+                counter.inc();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(counter.value() == 4000);
+    std::string rendered = registry.render();
+    REQUIRE(rendered.find("# TYPE events_total counter\n") != std::string::npos);
+    REQUIRE(rendered.find("events_total{kind=\"a\"} 4000\n") != std::string::npos);
+}
+
+TEST_CASE("TestCustomMetrics", "Custom metrics are exported and captured per request") {
+
+    seldon::protos::Meta meta;
+    {
+        seldon::metrics::Capture capture;
+        seldon::metrics::count("test_custom_total", 1, {{"model", "m"}});
+        seldon::metrics::count("test_custom_total", 2, {{"model", "m"}});
+        seldon::metrics::gauge("test_custom_gauge", 4);
+        seldon::metrics::gauge("test_custom_gauge", 5);
+        seldon::metrics::timer("test_custom_time", 20);
+        {
+            seldon::metrics::Capture inactive(false);
+            seldon::metrics::timer("test_custom_time", 30);
+        }
+        capture.appendTo(meta);
+    }
+    seldon::metrics::count("test_custom_total", 1, {{"model", "m"}});
+
+    REQUIRE(meta.metrics_size() == 4);
+    REQUIRE(meta.metrics(0).key() == "test_custom_total");
+    REQUIRE(meta.metrics(0).type() == seldon::protos::Metric::COUNTER);
+    REQUIRE(meta.metrics(0).value() == 3);
+    REQUIRE(meta.metrics(0).tags().at("model") == "m");
+    REQUIRE(meta.metrics(1).type() == seldon::protos::Metric::GAUGE);
+    REQUIRE(meta.metrics(1).value() == 5);
+    REQUIRE(meta.metrics(2).type() == seldon::protos::Metric::TIMER);
+    REQUIRE(meta.metrics(2).value() == 20);
+    REQUIRE(meta.metrics(3).value() == 30);
+
+    auto &registry = seldon::metrics::Registry::global();
+    REQUIRE(registry.shardedCounter("test_custom_total", "", {{"model", "m"}}).value() == 4);
+    REQUIRE(registry.gauge("test_custom_gauge", "").value() == 5);
+    REQUIRE(registry.hdrHistogram("test_custom_time", "").count() == 2);
+    REQUIRE(registry.render().find("# TYPE test_custom_total counter\n") != std::string::npos);
+}
+
+TEST_CASE("TestCustomMetricsInvalid", "Custom metrics that can't be exported are dropped") {
+
+    seldon::protos::Meta meta;
+    {
+        seldon::metrics::Capture capture;
+        REQUIRE_NOTHROW(seldon::metrics::timer("test-invalid-time", 10));
+        REQUIRE_NOTHROW(seldon::metrics::count("1test_invalid_total"));
+        REQUIRE_NOTHROW(seldon::metrics::count("test_invalid_total", 1, {{"bad-tag", "x"}}));
+        REQUIRE_NOTHROW(seldon::metrics::count("test_invalid_total", 1, {{"__name", "x"}}));
+        // Once a key is a counter it can't be a gauge too
+        seldon::metrics::count("test_clash:total");
+        REQUIRE_NOTHROW(seldon::metrics::gauge("test_clash:total", 2));
+        REQUIRE_NOTHROW(seldon::metrics::gauge("test_clash:total", 3));
+        capture.appendTo(meta);
+    }
+
+    REQUIRE(meta.metrics_size() == 1);
+    REQUIRE(meta.metrics(0).type() == seldon::protos::Metric::COUNTER);
+    std::string after = seldon::metrics::Registry::global().render();
+    REQUIRE(after.find("test-invalid") == std::string::npos);
+    REQUIRE(after.find("test_invalid_total") == std::string::npos);
+    REQUIRE(after.find("# TYPE test_clash:total counter\n") != std::string::npos);
+}
@@ -0,0 +1,253 @@
+#include "catch_amalgamated.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/util/json_util.h>
+
+#include "seldon/Ndarray.hpp"
+#include "seldon/SeldonModel.hpp"
+#include "seldon/TensorView.hpp"
+
+namespace {
+
+seldon::protos::SeldonMessage fromJson(const std::string &json) {
+    seldon::protos::SeldonMessage message;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(json, &message).ok());
+    return message;
+}
+
+class DoublingModel : public seldon::SeldonModelBase {
+public:
+    DoublingModel() { this->enableNdarrayResponses(); }
+
+    void predict(seldon::protos::SeldonMessage &input,
+                 seldon::protos::SeldonMessage &output) override {
+        seldon::TensorView<double> view(input);
+        auto builder = seldon::TensorBuilder<double>::tensor(*output.mutable_data(), view.shape());
+        for (size_t i = 0; i < view.size(); i++) {
+            builder[i] = view[i] * 2;
+        }
+        output.mutable_data()->mutable_names()->CopyFrom(input.data().names());
+        output.mutable_meta()->set_puid(input.meta().puid());
+    }
+};
+
+}
+
+TEST_CASE("TestNdarrayFlatten", "Nested ndarrays flatten to typed buffers") {
+
+    // Enough values to cover the vectorized kernels and their tails
+    seldon::protos::SeldonMessage message;
+    google::protobuf::ListValue *rows = message.mutable_data()->mutable_ndarray();
+    for (int row = 0; row < 3; row++) {
+        google::protobuf::ListValue *values = rows->add_values()->mutable_list_value();
+        for (int column = 0; column < 301; column++) {
+            values->add_values()->set_number_value(row * 1000 + column + 0.75);
+        }
+    }
+
+    std::vector<int64_t> shape;
+    std::vector<float> floats;
+    seldon::ndarray::flatten(message.data().ndarray(), shape, floats);
+    REQUIRE(shape == std::vector<int64_t>{3, 301});
+    REQUIRE(floats.size() == 903);
+    REQUIRE(floats[302] == 1001.75f);
+    REQUIRE(floats[902] == 2300.75f);
+
+    std::vector<int32_t> ints;
+    seldon::ndarray::flatten(message.data().ndarray(), shape, ints);
+    REQUIRE(ints[302] == 1001);
+    REQUIRE(ints[902] == 2300);
+
+    std::vector<double> doubles;
+    seldon::ndarray::flatten(fromJson("{\"data\":{\"ndarray\":[[],[]]}}").data().ndarray(), shape,
+                             doubles);
+    REQUIRE(shape == std::vector<int64_t>{2, 0});
+    REQUIRE(doubles.empty());
+
+    REQUIRE_THROWS_AS(seldon::ndarray::flatten(
+                          fromJson("{\"data\":{\"ndarray\":[[1,2],[3]]}}").data().ndarray(), shape,
+                          doubles),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(seldon::ndarray::flatten(
+                          fromJson("{\"data\":{\"ndarray\":[1,[2]]}}").data().ndarray(), shape,
+                          doubles),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(seldon::ndarray::flatten(
+                          fromJson("{\"data\":{\"ndarray\":[\"a\"]}}").data().ndarray(), shape,
+                          doubles),
+                      std::invalid_argument);
+}
+
+TEST_CASE("TestNdarrayFlattenRagged", "Ragged arrays are rejected before values is sized") {
+
+    // Each level's first element nests further and the rest are numbers,
+    // so the first elements alone claim 40^6 values
+    seldon::protos::SeldonMessage message;
+    google::protobuf::ListValue *list = message.mutable_data()->mutable_ndarray();
+    for (int depth = 0; depth < 6; depth++) {
+        google::protobuf::ListValue *first =
+            depth < 5 ? list->add_values()->mutable_list_value() : nullptr;
+        while (list->values_size() < 40) {
+            list->add_values()->set_number_value(1);
+        }
+        list = first;
+    }
+
+    std::vector<int64_t> shape;
+    std::vector<double> doubles;
+    REQUIRE_THROWS_AS(seldon::ndarray::flatten(message.data().ndarray(), shape, doubles),
+                      std::invalid_argument);
+    REQUIRE(doubles.empty());
+}
+
+TEST_CASE("TestNdarrayConvertRange", "int32 conversion rejects NaN and out of range values") {
+
+    std::vector<double> in{0.5, -1.5, 2147483647.9, -2147483648.9, 4, 5, 6};
+    std::vector<int32_t> out(in.size());
+    seldon::ndarray::convert(in.data(), in.size(), out.data());
+    REQUIRE(out == std::vector<int32_t>{0, -1, 2147483647, -2147483647 - 1, 4, 5, 6});
+
+    // Positions 1 and 2 are converted by the vectorized kernels, 6 by the tail
+    for (size_t position : {1, 2, 6}) {
+        for (double bad : {1e20, -1e20, 2147483648.0, std::nan("")}) {
+            std::vector<double> values(7, 1.0);
+            values[position] = bad;
+            REQUIRE_THROWS_AS(seldon::ndarray::convert(values.data(), values.size(), out.data()),
+                              std::invalid_argument);
+        }
+    }
+
+    std::vector<int32_t> ints;
+    std::vector<int64_t> shape;
+    REQUIRE_THROWS_AS(seldon::ndarray::flatten(
+                          fromJson("{\"data\":{\"ndarray\":[1,2,3,1e20]}}").data().ndarray(),
+                          shape, ints),
+                      std::invalid_argument);
+}
+
+TEST_CASE("TestNdarrayCheckedCast", "Every integer conversion rejects NaN and out of range values") {
+
+    std::vector<double> in{-9223372036854775808.0, 9223372036854774784.0, -1.5, 255.9};
+    std::vector<int64_t> longs(in.size());
+    seldon::ndarray::convert(in.data(), in.size(), longs.data());
+    REQUIRE(longs == std::vector<int64_t>{INT64_MIN, 9223372036854774784, -1, 255});
+
+    std::vector<uint8_t> bytes(2);
+    std::vector<double> small{-0.5, 255.9};
+    seldon::ndarray::convert(small.data(), small.size(), bytes.data());
+    REQUIRE(bytes == std::vector<uint8_t>{0, 255});
+
+    for (double bad : {9223372036854775808.0, -1e19, std::nan("")}) {
+        REQUIRE_THROWS_AS(seldon::ndarray::checkedCast<int64_t>(bad), std::invalid_argument);
+    }
+    for (double bad : {256.0, -1.0, std::nan("")}) {
+        REQUIRE_THROWS_AS(seldon::ndarray::checkedCast<uint8_t>(bad), std::invalid_argument);
+    }
+    REQUIRE_THROWS_AS(seldon::ndarray::checkedCast<int16_t>(40000.0f), std::invalid_argument);
+
+    std::vector<int64_t> shape;
+    REQUIRE_THROWS_AS(seldon::ndarray::flatten(
+                          fromJson("{\"data\":{\"ndarray\":[1,1e19]}}").data().ndarray(),
+                          shape, longs),
+                      std::invalid_argument);
+
+    // Through TensorView, as both ndarray and tftensor values
+    REQUIRE_THROWS_AS(
+        seldon::TensorView<uint8_t>(fromJson("{\"data\":{\"ndarray\":[1,300]}}")),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(seldon::TensorView<int64_t>(fromJson(
+                          "{\"data\":{\"tftensor\":{\"dtype\":\"DT_DOUBLE\","
+                          "\"tensorShape\":{\"dim\":[{\"size\":\"2\"}]},"
+                          "\"doubleVal\":[1,\"NaN\"]}}}")),
+                      std::invalid_argument);
+    seldon::TensorView<uint8_t> view(fromJson("{\"data\":{\"ndarray\":[1,255]}}"));
+    REQUIRE(view[1] == 255);
+}
+
+TEST_CASE("TestNdarrayJsonMatchesProtobuf", "ndarray text reads back as what the protobuf printer wrote") {
+
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> uniform(-1e6, 1e6);
+    std::vector<double> values = {0, -0.0, 1, -1, 0.1, 1e15, 123456789012345678.0, 1e-300,
+                                  1.0 / 3, 5e-324, 1e21};
+    for (int i = 0; i < 1000; i++) {
+        values.push_back(uniform(random));
+        values.push_back(std::round(uniform(random)));
+    }
+
+    seldon::protos::SeldonMessage message;
+    google::protobuf::ListValue *ndarray = message.mutable_data()->mutable_ndarray();
+    for (double value : values) {
+        ndarray->add_values()->set_number_value(value);
+    }
+    std::string expected;
+    google::protobuf::util::MessageToJsonString(message.data(), &expected);
+
+    std::string actual = "{\"ndarray\":";
+    seldon::ndarray::appendJson(values.data(), {static_cast<int64_t>(values.size())}, actual);
+    actual.push_back('}');
+    seldon::protos::DefaultData decoded;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(actual, &decoded).ok());
+    seldon::protos::DefaultData printed;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(expected, &printed).ok());
+    REQUIRE(decoded.SerializeAsString() == printed.SerializeAsString());
+}
+
+TEST_CASE("TestNdarrayResponses", "Tensor outputs answer ndarray requests as ndarray text") {
+
+    DoublingModel model;
+    std::string request =
+        "{\"meta\":{\"puid\":\"abc\"},\"data\":{\"names\":[\"a\",\"b\"],\"ndarray\":[[1,2],[3,4.5]]}}";
+    std::string response;
+    model.predictBuffer(request.data(), request.size(), seldon::PayloadFormat::Json, response);
+    REQUIRE(response ==
+            "{\"meta\":{\"puid\":\"abc\"},\"data\":{\"names\":[\"a\",\"b\"],\"ndarray\":[[2,4],[6,9]]}}");
+
+    // Tensor requests still get a tensor back
+    request = "{\"data\":{\"tensor\":{\"shape\":[1],\"values\":[1]}}}";
+    model.predictBuffer(request.data(), request.size(), seldon::PayloadFormat::Json, response);
+    REQUIRE(response == "{\"meta\":{},\"data\":{\"tensor\":{\"shape\":[1],\"values\":[2]}}}");
+}
+
+TEST_CASE("TestNdarrayWireFormat", "ListValue and Tensor bytes match protobuf's serializer") {
+
+    std::vector<double> values;
+    for (int i = 0; i < 2 * 3 * 40; i++) {
+        values.push_back(i * 0.5 - 7);
+    }
+
+    for (const std::vector<int64_t> &shape :
+         std::vector<std::vector<int64_t>>{{240}, {2, 120}, {2, 3, 40}, {2, 0}, {0}}) {
+        google::protobuf::ListValue expected;
+        std::function<void(google::protobuf::ListValue &, size_t, const double *&)> build =
+            [&](google::protobuf::ListValue &list, size_t depth, const double *&next) {
+                for (int64_t i = 0; i < shape[depth]; i++) {
+                    if (depth + 1 == shape.size()) {
+                        list.add_values()->set_number_value(*next++);
+                    } else {
+                        build(*list.add_values()->mutable_list_value(), depth + 1, next);
+                    }
+                }
+            };
+        const double *next = values.data();
+        build(expected, 0, next);
+
+        std::string actual(seldon::ndarray::listValueSize(shape), '\0');
+        seldon::ndarray::writeListValue(values.data(), shape, &actual[0]);
+        REQUIRE(actual == expected.SerializeAsString());
+
+        seldon::protos::Tensor tensor;
+        tensor.mutable_shape()->Add(shape.begin(), shape.end());
+        tensor.mutable_values()->Add(values.begin(),
+                                     values.begin() + seldon::detail::elementCount(shape));
+        actual.assign(seldon::ndarray::tensorSize(shape), '\0');
+        seldon::ndarray::writeTensor(values.data(), shape, &actual[0]);
+        REQUIRE(actual == tensor.SerializeAsString());
+    }
+}
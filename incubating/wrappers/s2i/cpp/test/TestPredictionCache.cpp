@@ -0,0 +1,239 @@
+#include "catch_amalgamated.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <google/protobuf/util/json_util.h>
+
+#include "seldon/Metrics.hpp"
+#include "seldon/PredictionCache.hpp"
+#include "seldon/SeldonModel.hpp"
+
+namespace {
+
+using seldon::PredictionCache;
+using seldon::protos::SeldonMessage;
+
+bool hit(PredictionCache &cache, const std::string &key) {
+    return cache.get(PredictionCache::Kind::Message, key.data(), key.size()) != nullptr;
+}
+
+void put(PredictionCache &cache, const std::string &key, const std::string &value) {
+    cache.put(PredictionCache::Kind::Message, key.data(), key.size(), value);
+}
+
+std::string keyOf(const std::string &json) {
+    SeldonMessage message;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(json, &message).ok());
+    std::string key;
+    REQUIRE(seldon::payloadKey(message, key));
+    return key;
+}
+
+// Counts the predictions that weren't served from the cache
+class CountingModel : public seldon::SeldonModelBase {
+public:
+    CountingModel() {
+        seldon::CacheOptions options;
+        options.shards = 1;
+        this->enableCache(options);
+    }
+
+    SeldonMessage predict(SeldonMessage &data) override {
+        this->calls++;
+        SeldonMessage result = data;
+        result.mutable_meta()->set_puid(data.meta().puid());
+        return result;
+    }
+
+    int calls = 0;
+};
+
+// Records a custom metric for every prediction it runs
+class MeteredModel : public CountingModel {
+public:
+    SeldonMessage predict(SeldonMessage &data) override {
+        seldon::metrics::count("test_cached_predictions_total");
+        return CountingModel::predict(data);
+    }
+};
+
+SeldonMessage parse(const std::string &json) {
+    SeldonMessage message;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(json, &message).ok());
+    return message;
+}
+
+}
+
+TEST_CASE("TestPredictionCache", "Entries are found by exact key until they expire") {
+
+    seldon::CacheOptions options;
+    options.ttlMs = 50;
+    PredictionCache cache(options);
+
+    put(cache, "a", "1");
+    auto value = cache.get(PredictionCache::Kind::Message, "a", 1);
+    REQUIRE(value);
+    REQUIRE(*value == "1");
+    REQUIRE(!cache.get(PredictionCache::Kind::JsonRequest, "a", 1));
+    REQUIRE(!hit(cache, "b"));
+
+    put(cache, "a", "2");
+    REQUIRE(*cache.get(PredictionCache::Kind::Message, "a", 1) == "2");
+    REQUIRE(cache.entries() == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    REQUIRE(!hit(cache, "a"));
+    REQUIRE(cache.entries() == 0);
+    REQUIRE(cache.bytes() == 0);
+}
+
+TEST_CASE("TestPredictionCacheAdmission", "Full shards keep the keys asked for most often") {
+
+    seldon::CacheOptions options;
+    options.shards = 1;
+    // Room for about four entries of 100 bytes
+    options.maxBytes = 4 * (100 + 140);
+    PredictionCache cache(options);
+    std::string value(100, 'x');
+
+    for (int i = 0; i < 4; i++) {
+        put(cache, "popular" + std::to_string(i), value);
+    }
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(hit(cache, "popular" + std::to_string(i)));
+        }
+    }
+
+    // Asked for once, so not admitted over keys that were asked for more
+    REQUIRE(!hit(cache, "oneoff"));
+    put(cache, "oneoff", value);
+    REQUIRE(!hit(cache, "oneoff"));
+    REQUIRE(hit(cache, "popular0"));
+
+    // Once it has been asked for more often, it replaces the least recent
+    for (int i = 0; i < 5; i++) {
+        hit(cache, "frequent");
+    }
+    put(cache, "frequent", value);
+    REQUIRE(hit(cache, "frequent"));
+    REQUIRE(!hit(cache, "popular1"));
+    REQUIRE(cache.bytes() <= static_cast<size_t>(options.maxBytes));
+}
+
+TEST_CASE("TestPredictionCacheKey", "Canonical keys ignore JSON formatting and meta") {
+
+    std::string key = keyOf("{\"data\":{\"tensor\":{\"shape\":[2],\"values\":[1,2]}}}");
+    REQUIRE(keyOf("{ \"meta\": {\"puid\": \"abc\"}, \"data\": {\"tensor\": "
+                  "{\"values\": [1.0, 2.0], \"shape\": [2]}}}") == key);
+    REQUIRE(keyOf("{\"data\":{\"tensor\":{\"shape\":[2],\"values\":[1,3]}}}") != key);
+    REQUIRE(keyOf("{\"strData\":\"a\"}") != keyOf("{\"binData\":\"YQ==\"}"));
+    REQUIRE(keyOf("{\"jsonData\":{\"a\":1,\"b\":2}}") == keyOf("{\"jsonData\":{\"b\":2,\"a\":1}}"));
+
+    std::string empty;
+    REQUIRE(!seldon::payloadKey(SeldonMessage(), empty));
+}
+
+TEST_CASE("TestPredictionCacheModel", "Cached models skip repeated predictions") {
+
+    CountingModel model;
+    auto &wireHits = seldon::metrics::Registry::global().counter(
+        "seldon_cpp_cache_hits_total", "Predictions served from the cache", {{"kind", "json"}});
+    auto &messageHits = seldon::metrics::Registry::global().counter(
+        "seldon_cpp_cache_hits_total", "Predictions served from the cache", {{"kind", "message"}});
+    double wireBefore = wireHits.value();
+    double messageBefore = messageHits.value();
+
+    std::string first = "{\"meta\":{\"puid\":\"1\"},\"data\":{\"tensor\":{\"values\":[1]}}}";
+    std::string out;
+    model.handleBuffer(seldon::Method::Predict, first.data(), first.size(),
+                       seldon::PayloadFormat::Json, out);
+    std::string expected = out;
+    model.handleBuffer(seldon::Method::Predict, first.data(), first.size(),
+                       seldon::PayloadFormat::Json, out);
+    REQUIRE(out == expected);
+    REQUIRE(model.calls == 1);
+    REQUIRE(wireHits.value() == wireBefore + 1);
+
+    // Same data with a new puid, answered with that puid
+    std::string second = "{\"meta\":{\"puid\":\"2\"},\"data\":{\"tensor\":{\"values\":[1.0]}}}";
+    model.handleBuffer(seldon::Method::Predict, second.data(), second.size(),
+                       seldon::PayloadFormat::Json, out);
+    REQUIRE(model.calls == 1);
+    REQUIRE(out.find("\"puid\":\"2\"") != std::string::npos);
+    REQUIRE(messageHits.value() == messageBefore + 1);
+
+    std::string other = "{\"data\":{\"tensor\":{\"values\":[2]}}}";
+    model.handleBuffer(seldon::Method::Predict, other.data(), other.size(),
+                       seldon::PayloadFormat::Json, out);
+    REQUIRE(model.calls == 2);
+
+    // Other methods are never cached
+    model.handleBuffer(seldon::Method::TransformInput, first.data(), first.size(),
+                       seldon::PayloadFormat::Json, out);
+    REQUIRE(out == first);
+}
+
+TEST_CASE("TestPredictionCacheMetrics", "Cached responses leave out the metrics of the request that ran") {
+
+    for (bool lazy : {false, true}) {
+        MeteredModel model;
+        model.enableMetricsInResponse();
+        if (lazy) {
+            model.enableLazyDecoding();
+        }
+
+        std::string request = "{\"data\":{\"tensor\":{\"values\":[1]}}}";
+        std::string out;
+        model.handleBuffer(seldon::Method::Predict, request.data(), request.size(),
+                           seldon::PayloadFormat::Json, out);
+        SeldonMessage first = parse(out);
+        REQUIRE(first.meta().metrics_size() == 1);
+        REQUIRE(first.meta().metrics(0).key() == "test_cached_predictions_total");
+
+        // A hit didn't record the counter, so it mustn't be counted again
+        model.handleBuffer(seldon::Method::Predict, request.data(), request.size(),
+                           seldon::PayloadFormat::Json, out);
+        REQUIRE(model.calls == 1);
+        SeldonMessage second = parse(out);
+        REQUIRE(second.meta().metrics_size() == 0);
+        REQUIRE(second.data().tensor().values(0) == 1);
+    }
+}
+
+TEST_CASE("TestPredictionCacheStageTimers", "Cached responses leave out the timings of the request that ran") {
+
+    CountingModel model;
+    model.enableStageTimers();
+    model.enableAsyncPredict();
+
+    std::string request = "{\"data\":{\"tensor\":{\"values\":[1]}}}";
+    std::string out;
+    model.handleBuffer(seldon::Method::Predict, request.data(), request.size(),
+                       seldon::PayloadFormat::Json, out);
+    REQUIRE(parse(out).meta().metrics_size() == 2);
+    model.handleBuffer(seldon::Method::Predict, request.data(), request.size(),
+                       seldon::PayloadFormat::Json, out);
+    REQUIRE(model.calls == 1);
+    REQUIRE(parse(out).meta().metrics_size() == 0);
+
+    auto handleAsync = [&model](const std::string &request) {
+        std::string response;
+        model.handleBufferAsync(seldon::Method::Predict, request.data(), request.size(),
+                                seldon::PayloadFormat::Json,
+                                [&response](std::exception_ptr error, std::string &out) {
+            REQUIRE(!error);
+            response = out;
+        });
+        return parse(response);
+    };
+    std::string other = "{\"data\":{\"tensor\":{\"values\":[2]}}}";
+    REQUIRE(handleAsync(other).meta().metrics(0).key() == "seldon_cpp_decode_time");
+    SeldonMessage hit = handleAsync(other);
+    REQUIRE(model.calls == 2);
+    REQUIRE(hit.meta().metrics_size() == 0);
+    REQUIRE(hit.data().tensor().values(0) == 2);
+}
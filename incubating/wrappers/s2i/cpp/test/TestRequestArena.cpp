@@ -0,0 +1,47 @@
+#include "catch_amalgamated.hpp"
+
+#include "prediction.pb.h"
+#include "seldon/RequestArena.hpp"
+
+namespace {
+
+void fillRequest(google::protobuf::Arena &arena, int numNames) {
+    auto *message = google::protobuf::Arena::CreateMessage<seldon::protos::SeldonMessage>(&arena);
+    for (int i = 0; i < numNames; i++) {
+        message->mutable_data()->add_names("feature_" + std::to_string(i));
+    }
+}
+
+}
+
+TEST_CASE("TestRequestArenaGrowsToFitRequests", "Initial block grows to fit the largest request") {
+
+    seldon::RequestArena arena;
+    REQUIRE(arena.blockSize() == seldon::RequestArena::kMinBlockSize);
+
+    fillRequest(arena.arena(), 10000);
+    arena.reset();
+
+    size_t grownSize = arena.blockSize();
+    REQUIRE(grownSize > seldon::RequestArena::kMinBlockSize);
+
+    // The same request now fits in the initial block, so nothing spills to the heap
+    fillRequest(arena.arena(), 10000);
+    REQUIRE(arena.arena().SpaceAllocated() <= grownSize);
+    arena.reset();
+    REQUIRE(arena.blockSize() == grownSize);
+}
+
+TEST_CASE("TestRequestArenaNestedScopes", "Only the outermost scope resets the arena") {
+
+    seldon::RequestArena::Scope outer;
+    auto *message = google::protobuf::Arena::CreateMessage<seldon::protos::SeldonMessage>(&outer.arena());
+    message->set_strdata("kept");
+
+    {
+        seldon::RequestArena::Scope inner;
+        REQUIRE(&inner.arena() == &outer.arena());
+    }
+
+    REQUIRE(message->strdata() == "kept");
+}
@@ -0,0 +1,220 @@
+#include "catch_amalgamated.hpp"
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "seldon/Metrics.hpp"
+#include "seldon/SeldonModel.hpp"
+
+namespace {
+
+using seldon::protos::SeldonMessage;
+
+// Implements every Generic method on tensors
+class GraphModel : public seldon::SeldonModelBase {
+
+    void transformInput(SeldonMessage &input, SeldonMessage &output) override {
+        output = input;
+        for (double &value : *output.mutable_data()->mutable_tensor()->mutable_values()) {
+            value += 1;
+        }
+    }
+
+    SeldonMessage route(SeldonMessage &data) override {
+        SeldonMessage result;
+        auto *tensor = result.mutable_data()->mutable_tensor();
+        tensor->add_shape(1);
+        tensor->add_shape(1);
+        tensor->add_values(data.data().tensor().values_size() > 1 ? 1 : 0);
+        return result;
+    }
+
+    SeldonMessage aggregate(seldon::protos::SeldonMessageList &data) override {
+        SeldonMessage result;
+        auto *tensor = result.mutable_data()->mutable_tensor();
+        tensor->add_shape(1);
+        tensor->add_values(0);
+        for (const SeldonMessage &message : data.seldonmessages()) {
+            for (double value : message.data().tensor().values()) {
+                tensor->set_values(0, tensor->values(0) + value);
+            }
+        }
+        return result;
+    }
+
+    SeldonMessage sendFeedback(seldon::protos::Feedback &feedback) override {
+        SeldonMessage result;
+        result.mutable_data()->mutable_tensor()->add_values(feedback.reward());
+        return result;
+    }
+};
+
+// Doubles tensor values on a thread of its own for every request
+class AsyncModel : public seldon::SeldonModelBase {
+public:
+    AsyncModel() { this->enableAsyncPredict(); }
+
+    ~AsyncModel() {
+        for (auto &thread : this->mThreads) {
+            thread.join();
+        }
+    }
+
+    void predictAsync(SeldonMessage &&input, Callback done) override {
+        auto message = std::make_shared<SeldonMessage>(std::move(input));
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mThreads.emplace_back([message, done]() {
+            if (message->data().tensor().values_size() == 0) {
+                done(std::make_exception_ptr(std::invalid_argument("No values")), *message);
+                return;
+            }
+            for (double &value : *message->mutable_data()->mutable_tensor()->mutable_values()) {
+                value *= 2;
+            }
+            done(nullptr, *message);
+        });
+    }
+
+private:
+    std::mutex mMutex;
+    std::vector<std::thread> mThreads;
+};
+
+std::string handle(seldon::RawModel &model, seldon::Method method, const std::string &request,
+                   seldon::PayloadFormat format = seldon::PayloadFormat::Json) {
+    std::string response;
+    model.handleBuffer(method, request.data(), request.size(), format, response);
+    return response;
+}
+
+}
+
+TEST_CASE("TestSeldonModelGeneric", "SeldonModel serves every method of the Generic service") {
+
+    GraphModel model;
+
+    REQUIRE(handle(model, seldon::Method::TransformInput,
+                   "{\"data\":{\"tensor\":{\"shape\":[2],\"values\":[1,2]}}}") ==
+            "{\"data\":{\"tensor\":{\"shape\":[2],\"values\":[2,3]}}}");
+
+    REQUIRE(handle(model, seldon::Method::Route,
+                   "{\"data\":{\"tensor\":{\"shape\":[2],\"values\":[1,2]}}}") ==
+            "{\"data\":{\"tensor\":{\"shape\":[1,1],\"values\":[1]}}}");
+
+    REQUIRE(handle(model, seldon::Method::Aggregate,
+                   "{\"seldonMessages\":[{\"data\":{\"tensor\":{\"values\":[1]}}},"
+                   "{\"data\":{\"tensor\":{\"values\":[2.5]}}}]}") ==
+            "{\"data\":{\"tensor\":{\"shape\":[1],\"values\":[3.5]}}}");
+
+    REQUIRE(handle(model, seldon::Method::SendFeedback, "{\"reward\":0.5}") ==
+            "{\"data\":{\"tensor\":{\"values\":[0.5]}}}");
+
+    // Output transformers pass requests through unless overridden
+    REQUIRE(handle(model, seldon::Method::TransformOutput, "{\"strData\":\"x\"}") ==
+            "{\"strData\":\"x\"}");
+
+    seldon::protos::SeldonMessageList list;
+    list.add_seldonmessages()->mutable_data()->mutable_tensor()->add_values(4);
+    std::string request;
+    list.SerializeToString(&request);
+    SeldonMessage output;
+    REQUIRE(output.ParseFromString(
+        handle(model, seldon::Method::Aggregate, request, seldon::PayloadFormat::Proto)));
+    REQUIRE(output.data().tensor().values(0) == 4);
+
+    // Aggregated ndarrays are answered with an ndarray, like predictions
+    model.enableNdarrayResponses();
+    REQUIRE(handle(model, seldon::Method::Aggregate,
+                   "{\"seldonMessages\":[{\"data\":{\"ndarray\":[1]}}]}") ==
+            "{\"data\":{\"ndarray\":[0]}}");
+}
+
+TEST_CASE("TestSeldonModelNotImplemented", "Methods left out raise NotImplementedError") {
+
+    seldon::SeldonModelBase model;
+
+    REQUIRE_THROWS_AS(handle(model, seldon::Method::Route, "{}"), seldon::NotImplementedError);
+    REQUIRE_THROWS_AS(handle(model, seldon::Method::Aggregate, "{}"),
+                      seldon::NotImplementedError);
+    REQUIRE_THROWS_AS(handle(model, seldon::Method::TransformInput, "{"), std::invalid_argument);
+}
+
+TEST_CASE("TestSeldonModelAsync", "predictAsync completes requests off the calling thread") {
+
+    AsyncModel model;
+    seldon::SeldonModelBase &base = model;
+
+    SeldonMessage input;
+    input.mutable_data()->mutable_tensor()->add_values(1.5);
+    REQUIRE(base.predictAsync(std::move(input)).get().data().tensor().values(0) == 3);
+    REQUIRE_THROWS_AS(base.predictAsync(SeldonMessage()).get(), std::invalid_argument);
+
+    std::string request = "{\"data\":{\"tensor\":{\"values\":[1,2]}}}";
+    std::promise<std::string> response;
+    model.handleBufferAsync(seldon::Method::Predict, request.data(), request.size(),
+                            seldon::PayloadFormat::Json,
+                            [&response](std::exception_ptr error, std::string &out) {
+        REQUIRE(!error);
+        response.set_value(out);
+    });
+    REQUIRE(response.get_future().get() == "{\"data\":{\"tensor\":{\"values\":[2,4]}}}");
+
+    // Decoding errors are passed to the completion rather than thrown
+    std::exception_ptr decodeError;
+    model.handleBufferAsync(seldon::Method::Predict, "{", 1, seldon::PayloadFormat::Json,
+                            [&decodeError](std::exception_ptr error, std::string &out) {
+        decodeError = error;
+    });
+    REQUIRE_THROWS_AS(std::rethrow_exception(decodeError), std::invalid_argument);
+}
+
+TEST_CASE("TestSeldonModelStageTimers", "Requests are timed per stage") {
+
+    GraphModel model;
+    model.enableStageTimers();
+    auto &decode = seldon::metrics::Registry::global().hdrHistogram(
+        "seldon_cpp_decode_seconds", "Time spent decoding requests",
+        {{"method", "transform-input"}});
+    uint64_t before = decode.count();
+
+    std::string response = handle(model, seldon::Method::TransformInput,
+                                  "{\"data\":{\"tensor\":{\"values\":[1]}}}");
+    REQUIRE(decode.count() == before + 1);
+
+    SeldonMessage output;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(response, &output).ok());
+    REQUIRE(output.meta().metrics_size() == 2);
+    REQUIRE(output.meta().metrics(0).key() == "seldon_cpp_decode_time");
+    REQUIRE(output.meta().metrics(1).key() == "seldon_cpp_predict_time");
+    REQUIRE(output.meta().metrics(1).type() == seldon::protos::Metric::TIMER);
+    REQUIRE(output.meta().metrics(1).value() >= 0);
+
+    std::string rendered = seldon::metrics::Registry::global().render();
+    REQUIRE(rendered.find("seldon_cpp_encode_seconds_count{") != std::string::npos);
+}
+
+TEST_CASE("TestSeldonModelMetricsInResponse", "Custom metrics are added to the response") {
+
+    class CountingModel : public seldon::SeldonModelBase {
+        void transformInput(SeldonMessage &input, SeldonMessage &output) override {
+            seldon::metrics::count("test_transformed_total");
+            output = input;
+        }
+    };
+
+    CountingModel model;
+    model.enableMetricsInResponse();
+    std::string response = handle(model, seldon::Method::TransformInput,
+                                  "{\"data\":{\"tensor\":{\"values\":[1]}}}");
+
+    SeldonMessage output;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(response, &output).ok());
+    REQUIRE(output.meta().metrics_size() == 1);
+    REQUIRE(output.meta().metrics(0).key() == "test_transformed_total");
+    REQUIRE(output.meta().metrics(0).type() == seldon::protos::Metric::COUNTER);
+    REQUIRE(output.meta().metrics(0).value() == 1);
+}
@@ -0,0 +1,118 @@
+#include "catch_amalgamated.hpp"
+
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "seldon/SeldonModel.hpp"
+#include "seldon/Task.hpp"
+#include "seldon/ThreadPool.hpp"
+
+namespace {
+
+using seldon::protos::SeldonMessage;
+
+seldon::Task<int> add(int a, int b) {
+    co_return a + b;
+}
+
+seldon::Task<int> addOnPool(seldon::ThreadPool &pool, int a, int b, std::thread::id &ranOn) {
+    co_await seldon::schedule(pool);
+    ranOn = std::this_thread::get_id();
+    co_return co_await add(a, b);
+}
+
+seldon::Task<int> fail() {
+    throw std::invalid_argument("failed");
+    co_return 0;
+}
+
+// Synchronous model, served through the default predictTask
+class DoubleModel : public seldon::SeldonModelBase {
+
+    SeldonMessage predict(SeldonMessage &data) override {
+        SeldonMessage result = data;
+        for (double &value : *result.mutable_data()->mutable_tensor()->mutable_values()) {
+            value *= 2;
+        }
+        return result;
+    }
+};
+
+// Awaits the synchronous predict after hopping onto its own pool
+class CoroutineModel : public DoubleModel {
+public:
+    CoroutineModel() : mPool(1) { this->enableTaskPredict(); }
+
+    seldon::Task<SeldonMessage> predictTask(SeldonMessage input) override {
+        co_await seldon::schedule(this->mPool);
+        SeldonMessage output = co_await DoubleModel::predictTask(std::move(input));
+        output.mutable_meta()->set_puid("coroutine");
+        co_return output;
+    }
+
+private:
+    seldon::ThreadPool mPool;
+};
+
+}
+
+TEST_CASE("TestTask", "Tasks run when awaited and pass on results and errors") {
+
+    seldon::ThreadPool pool(2);
+    std::thread::id ranOn;
+    REQUIRE(seldon::syncWait(addOnPool(pool, 1, 2, ranOn)) == 3);
+    REQUIRE(ranOn != std::this_thread::get_id());
+
+    REQUIRE_THROWS_AS(seldon::syncWait(fail()), std::invalid_argument);
+
+    std::promise<int> result;
+    seldon::spawn(pool, add(2, 3), [&result](std::exception_ptr error, int &value) {
+        result.set_value(value);
+    });
+    REQUIRE(result.get_future().get() == 5);
+
+    // Callbacks made inline and from other threads both resume the task
+    using Done = std::function<void(std::exception_ptr, int &)>;
+    auto inlineCallback = []() -> seldon::Task<int> {
+        co_return co_await seldon::awaitCallback<int>([](Done done) {
+            int value = 7;
+            done(nullptr, value);
+        });
+    };
+    REQUIRE(seldon::syncWait(inlineCallback()) == 7);
+
+    std::thread worker;
+    auto threadCallback = [&worker]() -> seldon::Task<int> {
+        co_return co_await seldon::awaitCallback<int>([&worker](Done done) {
+            worker = std::thread([done]() {
+                int value = 8;
+                done(nullptr, value);
+            });
+        });
+    };
+    REQUIRE(seldon::syncWait(threadCallback()) == 8);
+    worker.join();
+}
+
+TEST_CASE("TestTaskModel", "Synchronous and coroutine models are served through predictTask") {
+
+    DoubleModel sync;
+    SeldonMessage input;
+    input.mutable_data()->mutable_tensor()->add_values(1.5);
+    REQUIRE(seldon::syncWait(sync.predictTask(input)).data().tensor().values(0) == 3);
+
+    CoroutineModel model;
+    std::string request = "{\"data\":{\"tensor\":{\"values\":[1,2]}}}";
+    std::promise<std::string> response;
+    model.handleBufferAsync(seldon::Method::Predict, request.data(), request.size(),
+                            seldon::PayloadFormat::Json,
+                            [&response](std::exception_ptr error, std::string &out) {
+        REQUIRE(!error);
+        response.set_value(out);
+    });
+    REQUIRE(response.get_future().get() ==
+            "{\"meta\":{\"puid\":\"coroutine\"},\"data\":{\"tensor\":{\"values\":[2,4]}}}");
+}
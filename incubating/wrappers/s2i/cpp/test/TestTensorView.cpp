@@ -0,0 +1,125 @@
+#include "catch_amalgamated.hpp"
+
+#include <google/protobuf/util/json_util.h>
+
+#include "seldon/TensorView.hpp"
+
+namespace {
+
+seldon::protos::SeldonMessage fromJson(const std::string &json) {
+    seldon::protos::SeldonMessage message;
+    REQUIRE(google::protobuf::util::JsonStringToMessage(json, &message).ok());
+    return message;
+}
+
+}
+
+TEST_CASE("TestTensorViewTensor", "Tensor values are viewed in place as doubles") {
+
+    auto message = fromJson("{\"data\":{\"tensor\":{\"shape\":[2,3],\"values\":[1,2,3,4,5,6]}}}");
+
+    seldon::TensorView<double> view(message);
+    REQUIRE(!view.owning());
+    REQUIRE(view.data() == message.data().tensor().values().data());
+    REQUIRE(view.shape() == std::vector<int64_t>{2, 3});
+    REQUIRE(view.strides() == std::vector<int64_t>{3, 1});
+    REQUIRE(view[4] == 5);
+
+    // Other types are converted
+    seldon::TensorView<float> floats(message);
+    REQUIRE(floats.owning());
+    REQUIRE(floats[5] == 6.0f);
+
+    REQUIRE_THROWS_AS(seldon::TensorView<double>(fromJson(
+                          "{\"data\":{\"tensor\":{\"shape\":[2,2],\"values\":[1,2,3]}}}")),
+                      std::invalid_argument);
+}
+
+TEST_CASE("TestTensorViewTfTensor", "tftensor content and typed values are viewed in place") {
+
+    seldon::protos::SeldonMessage message;
+    auto builder = seldon::TensorBuilder<float>::tftensor(*message.mutable_data(), {2, 2});
+    REQUIRE(builder.size() == 4);
+    for (size_t i = 0; i < builder.size(); i++) {
+        builder[i] = static_cast<float>(i) + 0.5f;
+    }
+    REQUIRE(message.data().tftensor().dtype() == tensorflow::DT_FLOAT);
+    REQUIRE(message.data().tftensor().tensor_content().size() == 4 * sizeof(float));
+
+    seldon::TensorView<float> content(message);
+    REQUIRE(!content.owning());
+    REQUIRE(content.shape() == std::vector<int64_t>{2, 2});
+    REQUIRE(content[3] == 3.5f);
+
+    seldon::protos::SeldonMessage typed;
+    tensorflow::TensorProto *tensor = typed.mutable_data()->mutable_tftensor();
+    tensor->set_dtype(tensorflow::DT_INT64);
+    tensor->mutable_tensor_shape()->add_dim()->set_size(3);
+    tensor->add_int64_val(7);
+    tensor->add_int64_val(8);
+    tensor->add_int64_val(9);
+    seldon::TensorView<int64_t> values(typed);
+    REQUIRE(!values.owning());
+    REQUIRE(values[2] == 9);
+
+    // A single value fills the whole shape
+    tensor->clear_int64_val();
+    tensor->add_int64_val(1);
+    REQUIRE(seldon::TensorView<int64_t>(typed)[2] == 1);
+
+    // but only up to SELDON_CPP_MAX_BROADCAST_ELEMENTS
+    tensor->mutable_tensor_shape()->mutable_dim(0)->set_size(int64_t(1) << 20);
+    tensor->mutable_tensor_shape()->add_dim()->set_size(int64_t(1) << 12);
+    REQUIRE_THROWS_AS(seldon::TensorView<int64_t>(typed), std::invalid_argument);
+
+    // Negative and overflowing shapes are rejected before anything is sized
+    tensor->mutable_tensor_shape()->mutable_dim(1)->set_size(-1);
+    REQUIRE_THROWS_AS(seldon::TensorView<int64_t>(typed), std::invalid_argument);
+    tensor->mutable_tensor_shape()->mutable_dim(0)->set_size(int64_t(1) << 62);
+    tensor->mutable_tensor_shape()->mutable_dim(1)->set_size(4);
+    REQUIRE_THROWS_AS(seldon::TensorView<int64_t>(typed), std::invalid_argument);
+
+    // A count whose byte size wraps around doesn't match short content
+    tensor->mutable_tensor_shape()->mutable_dim(0)->set_size((int64_t(1) << 61) + 1);
+    tensor->mutable_tensor_shape()->mutable_dim(1)->set_size(1);
+    tensor->set_tensor_content(std::string(8, '\0'));
+    REQUIRE_THROWS_AS(seldon::TensorView<int64_t>(typed), std::invalid_argument);
+
+    // bool content is read a byte at a time, any byte but 0 being true
+    seldon::protos::SeldonMessage bools;
+    tensor = bools.mutable_data()->mutable_tftensor();
+    tensor->set_dtype(tensorflow::DT_BOOL);
+    tensor->mutable_tensor_shape()->add_dim()->set_size(3);
+    tensor->set_tensor_content(std::string("\x00\x01\x02", 3));
+    seldon::TensorView<uint8_t> flags(bools);
+    REQUIRE(flags.owning());
+    REQUIRE(flags[0] == 0);
+    REQUIRE(flags[1] == 1);
+    REQUIRE(flags[2] == 1);
+    REQUIRE(seldon::TensorView<float>(bools)[2] == 1.0f);
+}
+
+TEST_CASE("TestTensorViewNdarray", "ndarrays are flattened with their shape") {
+
+    seldon::TensorView<double> view(fromJson("{\"data\":{\"ndarray\":[[1,2,3],[4,5,6]]}}"));
+    REQUIRE(view.owning());
+    REQUIRE(view.shape() == std::vector<int64_t>{2, 3});
+    REQUIRE(view[3] == 4);
+
+    REQUIRE_THROWS_AS(seldon::TensorView<double>(fromJson("{\"data\":{\"ndarray\":[[1,2],[3]]}}")),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(seldon::TensorView<double>(fromJson("{\"data\":{\"ndarray\":[[1],2]}}")),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(seldon::TensorView<double>(fromJson("{\"strData\":\"x\"}")),
+                      std::invalid_argument);
+}
+
+TEST_CASE("TestTensorBuilderTensor", "Tensor outputs are written in place") {
+
+    seldon::protos::SeldonMessage message;
+    auto builder = seldon::TensorBuilder<double>::tensor(*message.mutable_data(), {1, 2});
+    builder[0] = 1.5;
+    builder[1] = 2.5;
+    REQUIRE(message.data().tensor().shape_size() == 2);
+    REQUIRE(message.data().tensor().values(1) == 2.5);
+}
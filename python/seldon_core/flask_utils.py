@@ -5,6 +5,8 @@ from http import HTTPStatus
 from flask import request, current_app, jsonify as flask_jsonify
 from typing import Dict, Union
 
+PROTOBUF_CONTENT_TYPE = "application/x-protobuf"
+
 
 def get_multi_form_data_request() -> Dict:
     """
@@ -39,6 +41,21 @@ def get_multi_form_data_request() -> Dict:
     return req_dict
 
 
+def is_proto_request() -> bool:
+    """
+    Check whether the current request body is a binary SeldonMessage
+
+    Returns
+    -------
+       True if the request was sent with Content-type:application/x-protobuf
+
+    """
+    return (
+        request.content_type is not None
+        and PROTOBUF_CONTENT_TYPE in request.content_type
+    )
+
+
 def get_request(skip_decoding=False) -> Union[Dict, bytes]:
     """
     Parse a request to get JSON dict
@@ -6,6 +6,7 @@ logger = logging.getLogger(__name__)
 # Variables to check if certain extra dependencies are included or
 # not
 _TF_PRESENT = False
+_NATIVE_PRESENT = False
 
 try:
     #  Fix for https://github.com/SeldonIO/seldon-core/issues/1076
@@ -37,3 +38,13 @@ except ImportError:
         """
     )
     logger.info(notice)
+
+try:
+    # Native payload conversions, built from the C++ wrapper with
+    # SELDON_OPT_BUILD_PYTHON_NATIVE. seldon_core.utils uses them when present
+    # and falls back to the pure Python versions otherwise.
+    import seldon_core_native  # noqa: F401
+
+    _NATIVE_PRESENT = True
+except ImportError:
+    _NATIVE_PRESENT = False
@@ -67,6 +67,27 @@ def handle_raw_custom_metrics(
     seldon_metrics.update(metrics, method)
 
 
+def handle_raw_proto(
+    raw_proto_method: Any,
+    request: Union[
+        prediction_pb2.SeldonMessage,
+        prediction_pb2.SeldonMessageList,
+        prediction_pb2.Feedback,
+    ],
+    seldon_metrics: SeldonMetrics,
+    method: str,
+) -> prediction_pb2.SeldonMessage:
+    """
+    Call a `<method>_raw_proto` entry point (e.g. of a C++ model), which takes
+    and returns wire-format bytes, and update custom metrics from the response
+    """
+    response = prediction_pb2.SeldonMessage.FromString(
+        raw_proto_method(request.SerializeToString())
+    )
+    handle_raw_custom_metrics(response, seldon_metrics, True, method)
+    return response
+
+
 def predict(
     user_model: Any,
     request: Union[prediction_pb2.SeldonMessage, List, Dict, bytes],
@@ -97,6 +118,17 @@ def predict(
         logger.warning("predict_grpc is deprecated. Please use predict_raw")
         return user_model.predict_grpc(request)
     else:
+        if is_proto and hasattr(user_model, "predict_raw_proto"):
+            try:
+                return handle_raw_proto(
+                    user_model.predict_raw_proto,
+                    request,
+                    seldon_metrics,
+                    PREDICT_METRIC_METHOD_TAG,
+                )
+            except SeldonNotImplementedError:
+                pass
+
         if hasattr(user_model, "predict_raw"):
             try:
                 response = user_model.predict_raw(request)
@@ -190,6 +222,19 @@ def send_feedback(
         response_json = user_model.send_feedback_grpc(request)
         return json_to_seldon_message(response_json)
     else:
+        if isinstance(request, prediction_pb2.Feedback) and hasattr(
+            user_model, "send_feedback_raw_proto"
+        ):
+            try:
+                return handle_raw_proto(
+                    user_model.send_feedback_raw_proto,
+                    request,
+                    seldon_metrics,
+                    FEEDBACK_METRIC_METHOD_TAG,
+                )
+            except SeldonNotImplementedError:
+                pass
+
         if hasattr(user_model, "send_feedback_raw"):
             try:
                 response = user_model.send_feedback_raw(request)
@@ -262,6 +307,17 @@ def transform_input(
         )
         return user_model.transform_input_grpc(request)
     else:
+        if is_proto and hasattr(user_model, "transform_input_raw_proto"):
+            try:
+                return handle_raw_proto(
+                    user_model.transform_input_raw_proto,
+                    request,
+                    seldon_metrics,
+                    INPUT_TRANSFORM_METRIC_METHOD_TAG,
+                )
+            except SeldonNotImplementedError:
+                pass
+
         if hasattr(user_model, "transform_input_raw"):
             try:
                 response = user_model.transform_input_raw(request)
@@ -356,6 +412,17 @@ def transform_output(
         )
         return user_model.transform_output_grpc(request)
     else:
+        if is_proto and hasattr(user_model, "transform_output_raw_proto"):
+            try:
+                return handle_raw_proto(
+                    user_model.transform_output_raw_proto,
+                    request,
+                    seldon_metrics,
+                    OUTPUT_TRANSFORM_METRIC_METHOD_TAG,
+                )
+            except SeldonNotImplementedError:
+                pass
+
         if hasattr(user_model, "transform_output_raw"):
             try:
                 response = user_model.transform_output_raw(request)
@@ -444,6 +511,17 @@ def route(
         logger.warning("route_grpc is deprecated. Please use route_raw")
         return user_model.route_grpc(request)
     else:
+        if is_proto and hasattr(user_model, "route_raw_proto"):
+            try:
+                return handle_raw_proto(
+                    user_model.route_raw_proto,
+                    request,
+                    seldon_metrics,
+                    ROUTER_METRIC_METHOD_TAG,
+                )
+            except SeldonNotImplementedError:
+                pass
+
         if hasattr(user_model, "route_raw"):
             try:
                 response = user_model.route_raw(request)
@@ -556,6 +634,17 @@ def aggregate(
         logger.warning("aggregate_grpc is deprecated. Please use aggregate_raw")
         return user_model.aggregate_grpc(request)
     else:
+        if is_proto and hasattr(user_model, "aggregate_raw_proto"):
+            try:
+                return handle_raw_proto(
+                    user_model.aggregate_raw_proto,
+                    request,
+                    seldon_metrics,
+                    AGGREGATE_METRIC_METHOD_TAG,
+                )
+            except SeldonNotImplementedError:
+                pass
+
         if hasattr(user_model, "aggregate_raw"):
             try:
                 response = user_model.aggregate_raw(request)
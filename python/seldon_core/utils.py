@@ -17,13 +17,16 @@ from seldon_core.user_model import (
     client_feature_names,
     SeldonComponent,
 )
-from seldon_core.imports_helper import _TF_PRESENT
+from seldon_core.imports_helper import _TF_PRESENT, _NATIVE_PRESENT
 from typing import Tuple, Dict, Union, List, Optional, Iterable
 
 if _TF_PRESENT:
     import tensorflow as tf
     from tensorflow.core.framework.tensor_pb2 import TensorProto
 
+if _NATIVE_PRESENT:
+    import seldon_core_native
+
 logger = logging.getLogger(__name__)
 
 
@@ -61,6 +64,16 @@ def json_to_seldon_message(
     if message_json is None:
         message_json = {}
     message_proto = prediction_pb2.SeldonMessage()
+    if _NATIVE_PRESENT and isinstance(message_json, dict):
+        try:
+            message_proto.ParseFromString(
+                seldon_core_native.json_to_message(json.dumps(message_json))
+            )
+            return message_proto
+        except (TypeError, ValueError):
+            # Payloads the native parser can't take, such as customData or
+            # NaN values, get the full ParseDict treatment and its errors
+            message_proto.Clear()
     try:
         json_format.ParseDict(message_json, message_proto)
         return message_proto
@@ -233,8 +246,15 @@ def grpc_datadef_to_array(datadef: prediction_pb2.DefaultData) -> np.ndarray:
             # Python 2 version which is slower
             features = np.array(datadef.tensor.values).reshape(datadef.tensor.shape)
     elif data_type == "ndarray":
-        py_arr = json_format.MessageToDict(datadef.ndarray)
-        features = np.array(py_arr)
+        features = None
+        if _NATIVE_PRESENT:
+            # None unless the ndarray is rectangular and numeric
+            features = seldon_core_native.ndarray_to_array(
+                datadef.ndarray.SerializeToString()
+            )
+        if features is None:
+            py_arr = json_format.MessageToDict(datadef.ndarray)
+            features = np.array(py_arr)
     elif data_type == "tftensor":
         features = tf.make_ndarray(datadef.tftensor)
     else:
@@ -312,7 +332,10 @@ def array_to_grpc_datadef(
        SeldonMessage DefaultData
 
     """
-    if data_type == "tensor":
+    if data_type == "tensor" and _native_numeric(array):
+        datadef = prediction_pb2.DefaultData(names=names)
+        datadef.tensor.ParseFromString(seldon_core_native.array_to_tensor(array))
+    elif data_type == "tensor":
         datadef = prediction_pb2.DefaultData(
             names=names,
             tensor=prediction_pb2.Tensor(
@@ -352,6 +375,9 @@ def array_to_list_value(array: np.ndarray, lv: Optional[ListValue] = None) -> Li
     """
     if lv is None:
         lv = ListValue()
+        if _native_numeric(array) and array.ndim > 0:
+            lv.ParseFromString(seldon_core_native.array_to_list_value(array))
+            return lv
     if len(array.shape) == 1:
         lv.extend(array.tolist())
     else:
@@ -361,6 +387,19 @@ def array_to_list_value(array: np.ndarray, lv: Optional[ListValue] = None) -> Li
     return lv
 
 
+def _native_numeric(array) -> bool:
+    """
+    Whether the native conversions can take array, which they do for numeric
+    numpy arrays. Booleans, strings and objects convert differently through
+    tolist(), so they stay with the Python versions.
+    """
+    return (
+        _NATIVE_PRESENT
+        and isinstance(array, np.ndarray)
+        and array.dtype.kind in "iuf"
+    )
+
+
 def construct_response_json(
     user_model: SeldonComponent,
     is_request: bool,
@@ -7,19 +7,26 @@ import seldon_core.seldon_methods
 from concurrent import futures
 from flask import Flask, send_from_directory, request, Response
 from flask_cors import CORS
+from google.protobuf.message import DecodeError
 from seldon_core.utils import (
     seldon_message_to_json,
     json_to_seldon_model_metadata,
     json_to_feedback,
     getenv_as_bool,
 )
-from seldon_core.flask_utils import get_request, jsonify
+from seldon_core.flask_utils import (
+    get_request,
+    is_proto_request,
+    jsonify,
+    PROTOBUF_CONTENT_TYPE,
+)
 from seldon_core.flask_utils import (
     SeldonMicroserviceException,
     ANNOTATION_GRPC_MAX_MSG_SIZE,
 )
 from seldon_core.proto import prediction_pb2_grpc
 from seldon_core.proto import prediction_pb2
+from seldon_core.user_model import SeldonComponent
 
 logger = logging.getLogger(__name__)
 
@@ -28,6 +35,19 @@ METRICS_ENDPOINT = os.environ.get("PREDICTIVE_UNIT_METRICS_ENDPOINT", "/metrics"
 PAYLOAD_PASSTHROUGH = getenv_as_bool("PAYLOAD_PASSTHROUGH", default=False)
 
 
+def implements_raw(user_model, method: str) -> bool:
+    """
+    Whether the user model implements `<method>_raw` itself, rather than
+    inheriting the stub from SeldonComponent
+    """
+    name = method + "_raw"
+    if not hasattr(user_model, name):
+        return False
+    return getattr(type(user_model), name, None) is not getattr(
+        SeldonComponent, name, None
+    )
+
+
 def get_rest_microservice(user_model, seldon_metrics):
     app = Flask(__name__, static_url_path="")
     CORS(app)
@@ -38,6 +58,13 @@ def get_rest_microservice(user_model, seldon_metrics):
     # None value will represent a validation error
     metadata_data = seldon_core.seldon_methods.init_metadata(user_model)
 
+    # Besides predict, payloads are only passed through to methods that take
+    # them as they were sent
+    passthrough = {
+        method: PAYLOAD_PASSTHROUGH and implements_raw(user_model, method)
+        for method in ["transform_input", "transform_output", "route", "aggregate"]
+    }
+
     if hasattr(user_model, "model_error_handler"):
         logger.info("Registering the custom error handler...")
         app.register_blueprint(user_model.model_error_handler)
@@ -57,6 +84,28 @@ def get_rest_microservice(user_model, seldon_metrics):
     @app.route("/api/v1.0/predictions", methods=["POST"])
     @app.route("/api/v0.1/predictions", methods=["POST"])
     def Predict():
+        if is_proto_request() and hasattr(user_model, "predict_raw_proto"):
+            logger.debug("REST Protobuf Request: %s", request)
+            try:
+                requestProto = prediction_pb2.SeldonMessage.FromString(
+                    request.get_data()
+                )
+            except DecodeError as e:
+                raise SeldonMicroserviceException(
+                    "Invalid protobuf request: %s" % e, status_code=400
+                )
+            # Falls back to the other entry points like the JSON path when
+            # predict_raw_proto raises SeldonNotImplementedError
+            response = seldon_core.seldon_methods.predict(
+                user_model, requestProto, seldon_metrics
+            )
+            if isinstance(response, prediction_pb2.SeldonMessage):
+                return Response(
+                    response=response.SerializeToString(),
+                    mimetype=PROTOBUF_CONTENT_TYPE,
+                )
+            return jsonify(response)
+
         requestJson = get_request(skip_decoding=PAYLOAD_PASSTHROUGH)
         logger.debug("REST Request: %s", request)
         response = seldon_core.seldon_methods.predict(
@@ -90,43 +139,43 @@ def get_rest_microservice(user_model, seldon_metrics):
 
     @app.route("/transform-input", methods=["GET", "POST"])
     def TransformInput():
-        requestJson = get_request()
+        requestJson = get_request(skip_decoding=passthrough["transform_input"])
         logger.debug("REST Request: %s", request)
         response = seldon_core.seldon_methods.transform_input(
             user_model, requestJson, seldon_metrics
         )
         logger.debug("REST Response: %s", response)
-        return jsonify(response)
+        return jsonify(response, skip_encoding=passthrough["transform_input"])
 
     @app.route("/transform-output", methods=["GET", "POST"])
     def TransformOutput():
-        requestJson = get_request()
+        requestJson = get_request(skip_decoding=passthrough["transform_output"])
         logger.debug("REST Request: %s", request)
         response = seldon_core.seldon_methods.transform_output(
             user_model, requestJson, seldon_metrics
         )
         logger.debug("REST Response: %s", response)
-        return jsonify(response)
+        return jsonify(response, skip_encoding=passthrough["transform_output"])
 
     @app.route("/route", methods=["GET", "POST"])
     def Route():
-        requestJson = get_request()
+        requestJson = get_request(skip_decoding=passthrough["route"])
         logger.debug("REST Request: %s", request)
         response = seldon_core.seldon_methods.route(
             user_model, requestJson, seldon_metrics
         )
         logger.debug("REST Response: %s", response)
-        return jsonify(response)
+        return jsonify(response, skip_encoding=passthrough["route"])
 
     @app.route("/aggregate", methods=["GET", "POST"])
     def Aggregate():
-        requestJson = get_request()
+        requestJson = get_request(skip_decoding=passthrough["aggregate"])
         logger.debug("REST Request: %s", request)
         response = seldon_core.seldon_methods.aggregate(
             user_model, requestJson, seldon_metrics
         )
         logger.debug("REST Response: %s", response)
-        return jsonify(response)
+        return jsonify(response, skip_encoding=passthrough["aggregate"])
 
     @app.route("/health/ping", methods=["GET"])
     def HealthPing():
@@ -11,7 +11,7 @@ from unittest import mock
 from seldon_core.wrapper import get_rest_microservice, SeldonModelGRPC, get_grpc_server
 from seldon_core.metrics import SeldonMetrics
 from seldon_core.proto import prediction_pb2
-from seldon_core.user_model import SeldonComponent
+from seldon_core.user_model import SeldonComponent, SeldonNotImplementedError
 from seldon_core.utils import seldon_message_to_json, json_to_seldon_message
 from seldon_core.flask_utils import SeldonMicroserviceException
 from seldon_core.imports_helper import _TF_PRESENT
@@ -240,6 +240,25 @@ class UserObjectLowLevelGrpc(SeldonComponent):
         logging.info("Feedback called")
 
 
+class UserObjectLowLevelWithPredictRawProto(SeldonComponent):
+    def predict_raw_proto(self, msg_bytes):
+        msg = prediction_pb2.SeldonMessage.FromString(msg_bytes)
+        arr = np.array(msg.data.tensor.values) * 2
+        datadef = prediction_pb2.DefaultData(
+            tensor=prediction_pb2.Tensor(shape=msg.data.tensor.shape, values=arr)
+        )
+        response = prediction_pb2.SeldonMessage(data=datadef)
+        return response.SerializeToString()
+
+
+class UserObjectLowLevelWithPredictRawProtoNotImplemented(SeldonComponent):
+    def predict_raw_proto(self, msg_bytes):
+        raise SeldonNotImplementedError("predict_raw_proto is not implemented")
+
+    def predict(self, X, features_names):
+        return X
+
+
 def test_model_ok():
     user_object = UserObject()
     seldon_metrics = SeldonMetrics()
@@ -908,6 +927,76 @@ def test_proto_lowlevel():
     assert j["data"]["tensor"]["values"] == [9, 9]
 
 
+def test_proto_lowlevel_raw_proto():
+    user_object = UserObjectLowLevelWithPredictRawProto()
+    seldon_metrics = SeldonMetrics()
+    app = SeldonModelGRPC(user_object, seldon_metrics)
+    arr = np.array([1, 2])
+    datadef = prediction_pb2.DefaultData(
+        tensor=prediction_pb2.Tensor(shape=(2, 1), values=arr)
+    )
+    request = prediction_pb2.SeldonMessage(data=datadef)
+    resp = app.Predict(request, None)
+    assert list(resp.data.tensor.shape) == [2, 1]
+    assert list(resp.data.tensor.values) == [2, 4]
+
+
+def test_model_lowlevel_raw_proto_rest():
+    user_object = UserObjectLowLevelWithPredictRawProto()
+    seldon_metrics = SeldonMetrics()
+    app = get_rest_microservice(user_object, seldon_metrics)
+    client = app.test_client()
+    arr = np.array([1, 2])
+    datadef = prediction_pb2.DefaultData(
+        tensor=prediction_pb2.Tensor(shape=(2, 1), values=arr)
+    )
+    request = prediction_pb2.SeldonMessage(data=datadef)
+    rv = client.post(
+        "/predict",
+        data=request.SerializeToString(),
+        content_type="application/x-protobuf",
+    )
+    assert rv.status_code == 200
+    assert rv.content_type == "application/x-protobuf"
+    resp = prediction_pb2.SeldonMessage.FromString(rv.data)
+    assert list(resp.data.tensor.shape) == [2, 1]
+    assert list(resp.data.tensor.values) == [2, 4]
+
+
+def test_model_lowlevel_raw_proto_rest_invalid():
+    user_object = UserObjectLowLevelWithPredictRawProto()
+    seldon_metrics = SeldonMetrics()
+    app = get_rest_microservice(user_object, seldon_metrics)
+    client = app.test_client()
+    rv = client.post(
+        "/predict", data=b"\xff\xff\xff\xff", content_type="application/x-protobuf"
+    )
+    j = json.loads(rv.data)
+    assert rv.status_code == 400
+    assert j["status"]["reason"] == "MICROSERVICE_BAD_DATA"
+
+
+def test_model_lowlevel_raw_proto_rest_not_implemented():
+    user_object = UserObjectLowLevelWithPredictRawProtoNotImplemented()
+    seldon_metrics = SeldonMetrics()
+    app = get_rest_microservice(user_object, seldon_metrics)
+    client = app.test_client()
+    arr = np.array([1, 2])
+    datadef = prediction_pb2.DefaultData(
+        tensor=prediction_pb2.Tensor(shape=(2, 1), values=arr)
+    )
+    request = prediction_pb2.SeldonMessage(data=datadef)
+    rv = client.post(
+        "/predict",
+        data=request.SerializeToString(),
+        content_type="application/x-protobuf",
+    )
+    assert rv.status_code == 200
+    assert rv.content_type == "application/x-protobuf"
+    resp = prediction_pb2.SeldonMessage.FromString(rv.data)
+    assert list(resp.data.tensor.values) == [1, 2]
+
+
 def test_proto_feedback():
     user_object = UserObject()
     seldon_metrics = SeldonMetrics()
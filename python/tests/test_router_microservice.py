@@ -6,7 +6,7 @@ from seldon_core.wrapper import get_rest_microservice, SeldonModelGRPC, get_grpc
 from seldon_core.metrics import SeldonMetrics
 from seldon_core.proto import prediction_pb2
 from seldon_core.utils import seldon_message_to_json
-from seldon_core.user_model import SeldonComponent
+from seldon_core.user_model import SeldonComponent, SeldonNotImplementedError
 from typing import Dict, List, Union
 
 
@@ -353,3 +353,52 @@ def test_unimplemented_route_raw():
     logging.info(j)
     assert rv.status_code == 200
     assert j["data"]["ndarray"] == [[53]]
+
+
+class UserObjectLowLevelRawProto:
+    def route_raw_proto(self, msg_bytes):
+        msg = prediction_pb2.SeldonMessage.FromString(msg_bytes)
+        arr = np.array([len(msg.data.tensor.values)])
+        datadef = prediction_pb2.DefaultData(
+            tensor=prediction_pb2.Tensor(shape=(1, 1), values=arr)
+        )
+        response = prediction_pb2.SeldonMessage(data=datadef)
+        return response.SerializeToString()
+
+
+def test_router_proto_lowlevel_raw_proto_ok():
+    user_object = UserObjectLowLevelRawProto()
+    seldon_metrics = SeldonMetrics()
+    app = SeldonModelGRPC(user_object, seldon_metrics)
+    arr = np.array([1, 2])
+    datadef = prediction_pb2.DefaultData(
+        tensor=prediction_pb2.Tensor(shape=(2, 1), values=arr)
+    )
+    request = prediction_pb2.SeldonMessage(data=datadef)
+    resp = app.Route(request, None)
+    jStr = json_format.MessageToJson(resp)
+    j = json.loads(jStr)
+    logging.info(j)
+    assert j["data"]["tensor"]["shape"] == [1, 1]
+    assert j["data"]["tensor"]["values"] == [2]
+
+
+def test_unimplemented_route_raw_proto():
+    class CustomObject:
+        def route_raw_proto(self, msg_bytes):
+            raise SeldonNotImplementedError("Route not defined")
+
+        def route(self, X, features_names):
+            return 53
+
+    user_object = CustomObject()
+    seldon_metrics = SeldonMetrics()
+    app = SeldonModelGRPC(user_object, seldon_metrics)
+    datadef = prediction_pb2.DefaultData(
+        tensor=prediction_pb2.Tensor(shape=(1, 1), values=np.array([2]))
+    )
+    request = prediction_pb2.SeldonMessage(data=datadef)
+    resp = app.Route(request, None)
+    j = json.loads(json_format.MessageToJson(resp))
+    logging.info(j)
+    assert j["data"]["tensor"]["values"] == [53]
@@ -5,6 +5,7 @@ import numpy as np
 from google.protobuf import json_format
 import base64
 
+import seldon_core.wrapper
 from seldon_core.wrapper import get_rest_microservice, SeldonModelGRPC, get_grpc_server
 from seldon_core.metrics import SeldonMetrics
 from seldon_core.proto import prediction_pb2
@@ -850,3 +851,51 @@ def test_unimplemented_transform_output_raw():
     logging.info(j)
     assert rv.status_code == 200
     assert j["data"]["ndarray"] == [2.0]
+
+
+def test_transform_input_payload_passthrough_raw(monkeypatch):
+    monkeypatch.setattr(seldon_core.wrapper, "PAYLOAD_PASSTHROUGH", True)
+
+    class CustomObject:
+        def transform_input_raw(self, request):
+            assert isinstance(request, bytes)
+            return request.replace(b"[1]", b"[2]")
+
+    user_object = CustomObject()
+    seldon_metrics = SeldonMetrics()
+    app = get_rest_microservice(user_object, seldon_metrics)
+    client = app.test_client()
+    rv = client.post(
+        "/transform-input",
+        data='{"data":{"ndarray":[1]}}',
+        content_type="application/json",
+    )
+
+    assert rv.status_code == 200
+    assert rv.data == b'{"data":{"ndarray":[2]}}'
+
+
+def test_transform_payload_passthrough_high_level(monkeypatch):
+    monkeypatch.setattr(seldon_core.wrapper, "PAYLOAD_PASSTHROUGH", True)
+
+    # Methods without a raw variant of their own still get decoded payloads
+    class CustomSeldonComponent(SeldonComponent):
+        def transform_input(self, X, features_names, **kwargs):
+            return X * 2
+
+        def transform_output(self, X, features_names, **kwargs):
+            return X * 3
+
+    user_object = CustomSeldonComponent()
+    seldon_metrics = SeldonMetrics()
+    app = get_rest_microservice(user_object, seldon_metrics)
+    client = app.test_client()
+    for path, expected in [("/transform-input", [2.0]), ("/transform-output", [3.0])]:
+        rv = client.post(
+            path, data='{"data":{"ndarray":[1]}}', content_type="application/json"
+        )
+        j = json.loads(rv.data)
+
+        logging.info(j)
+        assert rv.status_code == 200
+        assert j["data"]["ndarray"] == expected
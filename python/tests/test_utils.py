@@ -9,7 +9,7 @@ from seldon_core.flask_utils import SeldonMicroserviceException
 from seldon_core.imports_helper import _TF_PRESENT
 from google.protobuf.struct_pb2 import Value
 from google.protobuf import any_pb2
-from .utils import skipif_tf_missing
+from .utils import skipif_tf_missing, skipif_native_missing
 
 if _TF_PRESENT:
     import tensorflow as tf
@@ -393,6 +393,69 @@ def test_get_data_from_proto_ndarray():
     assert arr[1][0] == 2
 
 
+@skipif_native_missing
+@pytest.mark.parametrize(
+    "data",
+    [
+        {"data": {"names": ["a", "b"], "ndarray": [[1, 2], [3.5, -4]]}},
+        {"data": {"tensor": {"shape": [2, 2], "values": [1, 2, 3, 4]}}},
+        {"data": {"ndarray": [["a", 1], [True, None]]}},
+        {"binData": base64.b64encode(b"\x00\x01").decode("utf-8")},
+        {"strData": "my string data", "meta": {"puid": "1", "tags": {"a": 1}}},
+        {"jsonData": {"some": ["value", 1]}},
+    ],
+)
+def test_json_to_seldon_message_native(monkeypatch, data):
+    native = scu.json_to_seldon_message(data)
+    monkeypatch.setattr(scu, "_NATIVE_PRESENT", False)
+    assert native == scu.json_to_seldon_message(data)
+
+
+@skipif_native_missing
+def test_json_to_seldon_message_native_bad_data():
+    with pytest.raises(SeldonMicroserviceException):
+        scu.json_to_seldon_message({"foo": "bar"})
+
+
+@skipif_native_missing
+@pytest.mark.parametrize(
+    "arr",
+    [
+        np.array([1, 2, 3]),
+        np.array([[1.5, 2], [3, -4]], dtype=np.float32),
+        np.arange(24).reshape(2, 3, 4),
+        np.zeros((2, 0)),
+        np.array([[1, 2], [3, 4]], dtype=np.uint8).T,
+    ],
+)
+def test_array_conversions_native(monkeypatch, arr):
+    lv = scu.array_to_list_value(arr)
+    tensor = scu.array_to_grpc_datadef("tensor", arr, ["a"])
+    ndarray = scu.array_to_grpc_datadef("ndarray", arr, ["a"])
+    native = scu.grpc_datadef_to_array(ndarray)
+
+    monkeypatch.setattr(scu, "_NATIVE_PRESENT", False)
+    assert lv == scu.array_to_list_value(arr)
+    assert tensor == scu.array_to_grpc_datadef("tensor", arr, ["a"])
+    assert ndarray == scu.array_to_grpc_datadef("ndarray", arr, ["a"])
+    python = scu.grpc_datadef_to_array(ndarray)
+    assert native.shape == python.shape
+    assert np.array_equal(native, python)
+
+
+@skipif_native_missing
+def test_grpc_datadef_to_array_native_fallback():
+    datadef = prediction_pb2.DefaultData(
+        ndarray=scu.array_to_list_value(np.array(["a", "b"]))
+    )
+    assert scu.grpc_datadef_to_array(datadef).tolist() == ["a", "b"]
+
+    datadef = scu.json_to_seldon_message({"data": {"ndarray": [True, False]}}).data
+    arr = scu.grpc_datadef_to_array(datadef)
+    assert arr.dtype == np.bool_
+    assert arr.tolist() == [True, False]
+
+
 @skipif_tf_missing
 def test_get_data_from_proto_tftensor():
     arr = np.array([[1], [2]])
@@ -1,6 +1,10 @@
 import pytest
-from seldon_core.imports_helper import _TF_PRESENT
+from seldon_core.imports_helper import _TF_PRESENT, _NATIVE_PRESENT
 
 skipif_tf_missing = pytest.mark.skipif(
     not _TF_PRESENT, reason="tensorflow is not present"
 )
+
+skipif_native_missing = pytest.mark.skipif(
+    not _NATIVE_PRESENT, reason="seldon_core_native is not present"
+)